@@ -34,18 +34,27 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <pthread.h>
 
 /* Headers required by PAPI */
 #include "papi.h"
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "linux-timer.h"
 
 #include "appio.h"
 
 // The PIC test implies it's built for shared linkage
 #ifdef PIC
 #  include "dlfcn.h"
+#  include <sys/uio.h>
+#  include <sys/socket.h>
+#  include <sys/mman.h>
+#  include <linux/aio_abi.h>
 #endif
 
 /*
@@ -65,8 +74,8 @@ papi_vector_t _appio_vector;
 static APPIO_native_event_entry_t * _appio_native_events;
 
 
-/* If you modify the appio_stats_t below, you MUST update APPIO_MAX_COUNTERS */
-static __thread long long _appio_register_current[APPIO_MAX_COUNTERS];
+/* If you modify the appio_stats_t below, you MUST update APPIO_BASE_COUNTERS */
+static __thread long long _appio_register_current[APPIO_BASE_COUNTERS];
 typedef enum {
   READ_BYTES = 0,
   READ_CALLS,
@@ -112,13 +121,53 @@ typedef enum {
   SOCK_WRITE_USEC,
   SEEK_CALLS,
   SEEK_ABS_STRIDE_SIZE,
-  SEEK_USEC
+  SEEK_USEC,
+  /* The groups below are laid out BYTES, CALLS, [BATCH_SIZE,] USEC
+     for appio_count_call() */
+  PREAD_BYTES,
+  PREAD_CALLS,
+  PREAD_USEC,
+  PWRITE_BYTES,
+  PWRITE_CALLS,
+  PWRITE_USEC,
+  READV_BYTES,
+  READV_CALLS,
+  READV_BATCH_SIZE,
+  READV_USEC,
+  WRITEV_BYTES,
+  WRITEV_CALLS,
+  WRITEV_BATCH_SIZE,
+  WRITEV_USEC,
+  RECVMSG_BYTES,
+  RECVMSG_CALLS,
+  RECVMSG_BATCH_SIZE,
+  RECVMSG_USEC,
+  SENDMSG_BYTES,
+  SENDMSG_CALLS,
+  SENDMSG_BATCH_SIZE,
+  SENDMSG_USEC,
+  SENDFILE_BYTES,
+  SENDFILE_CALLS,
+  SENDFILE_USEC,
+  SPLICE_BYTES,
+  SPLICE_CALLS,
+  SPLICE_USEC,
+  MMAP_BYTES,
+  MMAP_CALLS,
+  MMAP_USEC,
+  AIO_SUBMIT_CALLS,
+  AIO_SUBMIT_BATCH_SIZE,
+  AIO_SUBMIT_USEC,
+  AIO_GETEVENTS_CALLS,
+  AIO_GETEVENTS_BATCH_SIZE,
+  AIO_GETEVENTS_USEC,
+  AIO_BYTES
 } _appio_stats_t ;
 
 static const struct appio_counters {
     const char *name;
     const char *description;
-} _appio_counter_info[APPIO_MAX_COUNTERS] = {
+} _appio_counter_info[APPIO_BASE_COUNTERS] = {
     { "READ_BYTES",      "Bytes read"},
     { "READ_CALLS",      "Number of read calls"},
     { "READ_ERR",        "Number of read calls that resulted in an error"},
@@ -163,18 +212,288 @@ static const struct appio_counters {
     { "SOCK_WRITE_USEC", "Real microseconds spent in write(s) to socket(s)"},
     { "SEEK_CALLS",      "Number of seek calls"},
     { "SEEK_ABS_STRIDE_SIZE", "Average absolute stride size of seeks"},
-    { "SEEK_USEC",       "Real microseconds spent in seek calls"}
+    { "SEEK_USEC",       "Real microseconds spent in seek calls"},
+    { "PREAD_BYTES",     "Bytes read in pread/pread64"},
+    { "PREAD_CALLS",     "Number of pread/pread64 calls"},
+    { "PREAD_USEC",      "Real microseconds spent in pread/pread64"},
+    { "PWRITE_BYTES",    "Bytes written in pwrite/pwrite64"},
+    { "PWRITE_CALLS",    "Number of pwrite/pwrite64 calls"},
+    { "PWRITE_USEC",     "Real microseconds spent in pwrite/pwrite64"},
+    { "READV_BYTES",     "Bytes read in readv/preadv"},
+    { "READV_CALLS",     "Number of readv/preadv calls"},
+    { "READV_BATCH_SIZE","Average number of buffers per readv/preadv call"},
+    { "READV_USEC",      "Real microseconds spent in readv/preadv"},
+    { "WRITEV_BYTES",    "Bytes written in writev/pwritev"},
+    { "WRITEV_CALLS",    "Number of writev/pwritev calls"},
+    { "WRITEV_BATCH_SIZE","Average number of buffers per writev/pwritev call"},
+    { "WRITEV_USEC",     "Real microseconds spent in writev/pwritev"},
+    { "RECVMSG_BYTES",   "Bytes received in recvmsg/recvmmsg"},
+    { "RECVMSG_CALLS",   "Number of recvmsg/recvmmsg calls"},
+    { "RECVMSG_BATCH_SIZE","Average number of messages received per recvmsg/recvmmsg call"},
+    { "RECVMSG_USEC",    "Real microseconds spent in recvmsg/recvmmsg"},
+    { "SENDMSG_BYTES",   "Bytes sent in sendmsg/sendmmsg"},
+    { "SENDMSG_CALLS",   "Number of sendmsg/sendmmsg calls"},
+    { "SENDMSG_BATCH_SIZE","Average number of messages sent per sendmsg/sendmmsg call"},
+    { "SENDMSG_USEC",    "Real microseconds spent in sendmsg/sendmmsg"},
+    { "SENDFILE_BYTES",  "Bytes copied by sendfile"},
+    { "SENDFILE_CALLS",  "Number of sendfile calls"},
+    { "SENDFILE_USEC",   "Real microseconds spent in sendfile"},
+    { "SPLICE_BYTES",    "Bytes moved by splice"},
+    { "SPLICE_CALLS",    "Number of splice calls"},
+    { "SPLICE_USEC",     "Real microseconds spent in splice"},
+    { "MMAP_BYTES",      "Bytes of files mapped by mmap"},
+    { "MMAP_CALLS",      "Number of mmap calls mapping a file"},
+    { "MMAP_USEC",       "Real microseconds spent in mmap calls mapping a file"},
+    { "AIO_SUBMIT_CALLS","Number of io_submit calls"},
+    { "AIO_SUBMIT_BATCH_SIZE","Average number of requests queued per io_submit call"},
+    { "AIO_SUBMIT_USEC", "Real microseconds spent in io_submit"},
+    { "AIO_GETEVENTS_CALLS","Number of io_getevents calls"},
+    { "AIO_GETEVENTS_BATCH_SIZE","Average number of completions per io_getevents call"},
+    { "AIO_GETEVENTS_USEC","Real microseconds spent in io_getevents"},
+    { "AIO_BYTES",       "Bytes transferred by completions returned from io_getevents"}
 };
 
+/* The histogram events follow, numbered class, then operation, then
+   metric, then percentile; names and descriptions are built at init */
+static const char *_appio_hist_class[APPIO_HIST_CLASSES][2] = {
+    { "FILE", "files" }, { "SOCK", "sockets" }, { "PIPE", "pipes" },
+    { "PATH", "tracked descriptors" }
+};
+static const char *_appio_hist_op[2][2] = {
+    { "READ", "reads" }, { "WRITE", "writes" }
+};
+static const char *_appio_hist_metric[2][2] = {
+    { "NSEC", "latency in nanoseconds" }, { "SIZE", "request size in bytes" }
+};
+static const struct {
+    const char *name;
+    const char *description;
+    int permille;
+} _appio_hist_percentile[APPIO_HIST_PERCENTILES] = {
+    { "P50", "Median", 500 }, { "P99", "99th percentile", 990 },
+    { "P999", "99.9th percentile", 999 }
+};
+
+#define APPIO_OP_READ   0
+#define APPIO_OP_WRITE  1
+#define APPIO_HIST_NSEC 0
+#define APPIO_HIST_SIZE 1
+
+static char _appio_hist_names[APPIO_HIST_COUNTERS][PAPI_MIN_STR_LEN];
+static char _appio_hist_descrs[APPIO_HIST_COUNTERS][PAPI_MAX_STR_LEN];
+
+
+/* Class of each descriptor, found by the first read or write on it and
+   forgotten when it is closed or replaced.  Every intercepted call that
+   hands out or closes a descriptor sets or clears it, so a number the
+   kernel reuses never inherits the class of the one it replaces.
+   Shared by all threads, as descriptors are; two threads filling the
+   same slot store the same. */
+static unsigned char _appio_fd_class[APPIO_MAX_FDS];
+
+/* Time in calls is summed in appio_ticks() and scaled to microseconds
+   only when read: raw TSC cycles when PAPI's real time clock is the
+   calibrated TSC, nanoseconds otherwise.                             */
+static int _appio_use_tsc = 0;
+static unsigned long long _appio_tick_mult = 1ULL << LINUX_TSC_SHIFT;
+
+/* Histograms are kept only while an EventSet using them is running.
+   Starting one opens a new epoch; a thread finding its block from an
+   older epoch clears it before recording.  Blocks stay on the list
+   after their thread exits, so its I/O is still merged, and are then
+   claimed by the next thread that needs one.  They are never freed: a
+   thread may be recording into its block at any time.                */
+static int _appio_hist_on = 0;
+static int _appio_hist_running = 0;
+static unsigned int _appio_hist_epoch = 0;
+static APPIO_hist_block_t *_appio_hist_blocks = NULL;
+static __thread APPIO_hist_block_t *_appio_hist;
+static pthread_key_t _appio_hist_key;
+static pthread_once_t _appio_hist_key_once = PTHREAD_ONCE_INIT;
+
+/* Descriptors opened under this path prefix, or this descriptor number,
+   are also recorded in the PATH_* histograms (PAPI_APPIO_HIST_PATH)   */
+static char _appio_hist_path[PATH_MAX];
+static size_t _appio_hist_path_len = 0;
+
 
 /*********************************************************************
  ***  BEGIN FUNCTIONS  USED INTERNALLY SPECIFIC TO THIS COMPONENT ****
  ********************************************************************/
 
+static inline long long
+appio_ticks(void)
+{
+#if defined(__x86_64__)
+  if (_appio_use_tsc) {
+    unsigned int a, d;
+    __asm__ __volatile__ ("rdtsc" : "=a" (a), "=d" (d));
+    return ((long long) a) | (((long long) d) << 32);
+  }
+#endif
+  return PAPI_get_real_nsec();
+}
+
+static int
+appio_fd_class(int fd)
+{
+  struct stat st;
+  int cls;
+
+  if ((fd >= 0) && (fd < APPIO_MAX_FDS) &&
+      (_appio_fd_class[fd] & APPIO_FD_CLASS_MASK))
+    return _appio_fd_class[fd];
+
+  if (fstat(fd, &st) != 0) return APPIO_FD_UNKNOWN;
+  if (S_ISSOCK(st.st_mode)) cls = APPIO_FD_SOCKET;
+  else if (S_ISFIFO(st.st_mode)) cls = APPIO_FD_PIPE;
+  else cls = APPIO_FD_FILE;
+
+  if ((fd >= 0) && (fd < APPIO_MAX_FDS)) {
+    cls |= _appio_fd_class[fd] & APPIO_FD_TRACKED;
+    _appio_fd_class[fd] = cls;
+  }
+  return cls;
+}
+
+static inline void
+appio_fd_set_class(int fd, int cls)
+{
+  if ((fd >= 0) && (fd < APPIO_MAX_FDS)) _appio_fd_class[fd] = cls;
+}
+
+/* Reset the class of fd, just opened on pathname */
+static inline void
+appio_fd_opened(int fd, const char *pathname)
+{
+  if (fd < 0) return;
+  /* may be a FIFO, so leave the class to the first read or write */
+  if (_appio_hist_path_len &&
+      (strncmp(pathname, _appio_hist_path, _appio_hist_path_len) == 0))
+    appio_fd_set_class(fd, APPIO_FD_UNKNOWN | APPIO_FD_TRACKED);
+  else
+    appio_fd_set_class(fd, APPIO_FD_UNKNOWN);
+}
+
+/* Hand the block of an exiting thread to the next one */
+static void
+appio_hist_release_block(void *arg)
+{
+  APPIO_hist_block_t *h = (APPIO_hist_block_t *) arg;
+
+  __sync_synchronize();
+  h->in_use = 0;
+}
+
+static void
+appio_hist_key_create(void)
+{
+  pthread_key_create(&_appio_hist_key, appio_hist_release_block);
+}
+
+/* Take a block no thread owns, or add a new one to the list */
+static APPIO_hist_block_t *
+appio_hist_claim_block(void)
+{
+  APPIO_hist_block_t *h;
+
+  for (h = _appio_hist_blocks; h != NULL; h = h->next) {
+    if ((h->in_use == 0) && __sync_bool_compare_and_swap(&h->in_use, 0, 1))
+      break;
+  }
+
+  if (h == NULL) {
+    h = calloc(1, sizeof(*h));
+    if (h == NULL) return NULL;
+    h->in_use = 1;
+    h->epoch = _appio_hist_epoch;
+    do {
+      h->next = _appio_hist_blocks;
+    } while (!__sync_bool_compare_and_swap(&_appio_hist_blocks, h->next, h));
+  }
+
+  pthread_once(&_appio_hist_key_once, appio_hist_key_create);
+  pthread_setspecific(_appio_hist_key, h);
+  _appio_hist = h;
+  return h;
+}
+
+/* This thread's histogram block for the current epoch */
+static APPIO_hist_block_t *
+appio_hist_block(void)
+{
+  APPIO_hist_block_t *h = _appio_hist;
+
+  if ((h == NULL) && ((h = appio_hist_claim_block()) == NULL)) return NULL;
+  if (h->epoch != _appio_hist_epoch) {
+    memset(h->counts, 0, sizeof(h->counts));
+    h->epoch = _appio_hist_epoch;
+  }
+  return h;
+}
+
+static inline int
+appio_hist_bucket(unsigned long long v)
+{
+  int e;
+
+  if (v < (1ULL << APPIO_HIST_SUB_BITS)) return (int) v;
+  e = 63 - __builtin_clzll(v);
+  return ((e - APPIO_HIST_SUB_BITS + 1) << APPIO_HIST_SUB_BITS) +
+         (int) ((v >> (e - APPIO_HIST_SUB_BITS)) & ((1 << APPIO_HIST_SUB_BITS) - 1));
+}
+
+/* Highest value that falls in a bucket */
+static unsigned long long
+appio_hist_upper(int b)
+{
+  int e, sub;
+
+  if (b < (1 << APPIO_HIST_SUB_BITS)) return (unsigned long long) b;
+  e = (b >> APPIO_HIST_SUB_BITS) + APPIO_HIST_SUB_BITS - 1;
+  sub = b & ((1 << APPIO_HIST_SUB_BITS) - 1);
+  if (e == 63 && sub == (1 << APPIO_HIST_SUB_BITS) - 1) return ~0ULL;
+  return ((((unsigned long long) (1 << APPIO_HIST_SUB_BITS) + sub + 1)
+           << (e - APPIO_HIST_SUB_BITS)) - 1);
+}
+
+static inline void
+appio_hist_add(APPIO_hist_block_t *h, int hcls, int op,
+               long long ticks, size_t size)
+{
+  int hist = (hcls * 2 + op) * 2;
+
+  h->counts[hist + APPIO_HIST_NSEC][appio_hist_bucket(ticks > 0 ? ticks : 0)]++;
+  h->counts[hist + APPIO_HIST_SIZE][appio_hist_bucket(size)]++;
+}
+
+/* Record one completed call on a descriptor of class cls */
+static inline void
+appio_hist_record(int cls, int op, long long ticks, size_t size)
+{
+  APPIO_hist_block_t *h;
+
+  if (!_appio_hist_on) return;
+  if ((h = appio_hist_block()) == NULL) return;
+
+  switch (cls & APPIO_FD_CLASS_MASK) {
+    case APPIO_FD_FILE:   appio_hist_add(h, 0, op, ticks, size); break;
+    case APPIO_FD_SOCKET: appio_hist_add(h, 1, op, ticks, size); break;
+    case APPIO_FD_PIPE:   appio_hist_add(h, 2, op, ticks, size); break;
+    default: break;
+  }
+  if (cls & APPIO_FD_TRACKED) appio_hist_add(h, 3, op, ticks, size);
+}
+
+/* The library is built with -fvisibility=hidden; the wrappers must be
+   exported from libpapi.so to take the place of the libc calls */
+#pragma GCC visibility push(default)
+
 int __close(int fd);
 int close(int fd) {
   int retval;
   SUBDBG("appio: intercepted close(%d)\n", fd);
+  appio_fd_set_class(fd, APPIO_FD_UNKNOWN);
   retval = __close(fd);
   if ((retval == 0) && (_appio_register_current[OPEN_FDS]>0)) _appio_register_current[OPEN_FDS]--;
   return retval;
@@ -188,20 +507,128 @@ int open(const char *pathname, int flags, mode_t mode) {
   _appio_register_current[OPEN_CALLS]++;
   if (retval < 0) _appio_register_current[OPEN_ERR]++;
   else _appio_register_current[OPEN_FDS]++;
+  appio_fd_opened(retval, pathname);
   return retval;
 }
 
-/* we use timeval as a zero value timeout to select in read/write
-   for polling if the operation would block */
-struct timeval zerotv; /* this has to be zero, so define it here */
+/* What open() becomes under _FILE_OFFSET_BITS=64 */
+int __open64(const char *pathname, int flags, mode_t mode);
+int open64(const char *pathname, int flags, mode_t mode) {
+  int retval;
+  SUBDBG("appio: intercepted open64(%s,%d,%d)\n", pathname, flags, mode);
+  retval = __open64(pathname,flags,mode);
+  appio_fd_opened(retval, pathname);
+  return retval;
+}
+
+/* fopen() and fclose() open and close the descriptor inside libc,
+   where close() and open() above never see it */
+FILE *_IO_fopen(const char *pathname, const char *mode);
+FILE *fopen(const char *pathname, const char *mode) {
+  FILE *retval;
+  SUBDBG("appio: intercepted fopen(%s,%s)\n", pathname, mode);
+  retval = _IO_fopen(pathname, mode);
+  appio_fd_opened(retval ? fileno(retval) : -1, pathname);
+  return retval;
+}
+
+int _IO_fclose(FILE *stream);
+int fclose(FILE *stream) {
+  int retval;
+  int fd = fileno(stream);
+  SUBDBG("appio: intercepted fclose(%p)\n", (void*) stream);
+  appio_fd_set_class(fd, APPIO_FD_UNKNOWN);
+  retval = _IO_fclose(stream);
+  return retval;
+}
+
+#if defined(SYS_close_range)
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
+int close_range(unsigned int first, unsigned int last, int flags) {
+  int retval;
+  unsigned int fd;
+  SUBDBG("appio: intercepted close_range(%u,%u,%d)\n", first, last, flags);
+  retval = syscall(SYS_close_range, first, last, flags);
+  if ((retval == 0) && !(flags & CLOSE_RANGE_CLOEXEC)) {
+    for (fd = first; (fd <= last) && (fd < APPIO_MAX_FDS); fd++)
+      appio_fd_set_class(fd, APPIO_FD_UNKNOWN);
+  }
+  return retval;
+}
+#endif
+
+/* glibc exports no __dup, so go to the kernel directly */
+int dup(int oldfd) {
+  int retval;
+  SUBDBG("appio: intercepted dup(%d)\n", oldfd);
+  retval = syscall(SYS_dup, oldfd);
+  if (retval >= 0) appio_fd_set_class(retval, appio_fd_class(oldfd));
+  return retval;
+}
+
+int __dup2(int oldfd, int newfd);
+int dup2(int oldfd, int newfd) {
+  int retval;
+  SUBDBG("appio: intercepted dup2(%d,%d)\n", oldfd, newfd);
+  retval = __dup2(oldfd, newfd);
+  if ((retval >= 0) && (oldfd != newfd))
+    appio_fd_set_class(newfd, appio_fd_class(oldfd));
+  return retval;
+}
+
+int dup3(int oldfd, int newfd, int flags) {
+  int retval;
+  SUBDBG("appio: intercepted dup3(%d,%d,%d)\n", oldfd, newfd, flags);
+  retval = syscall(SYS_dup3, oldfd, newfd, flags);
+  if (retval >= 0) appio_fd_set_class(newfd, appio_fd_class(oldfd));
+  return retval;
+}
+
+/* <fcntl.h> would clash with the open() above, so only the commands
+   that hand out a descriptor are spelled out */
+#ifndef F_DUPFD
+#define F_DUPFD 0
+#endif
+#ifndef F_DUPFD_CLOEXEC
+#define F_DUPFD_CLOEXEC 1030
+#endif
+
+int __fcntl(int fd, int cmd, ...);
+int fcntl(int fd, int cmd, ...) {
+  int retval;
+  va_list ap;
+  void *arg;
+  va_start(ap, cmd);
+  arg = va_arg(ap, void *);
+  va_end(ap);
+  SUBDBG("appio: intercepted fcntl(%d,%d,%p)\n", fd, cmd, arg);
+  retval = __fcntl(fd, cmd, arg);
+  if ((retval >= 0) && ((cmd == F_DUPFD) || (cmd == F_DUPFD_CLOEXEC)))
+    appio_fd_set_class(retval, appio_fd_class(fd));
+  return retval;
+}
+
+int __pipe(int pipefd[2]);
+int pipe(int pipefd[2]) {
+  int retval;
+  SUBDBG("appio: intercepted pipe(%p)\n", (void*) pipefd);
+  retval = __pipe(pipefd);
+  if (retval == 0) {
+    appio_fd_set_class(pipefd[0], APPIO_FD_PIPE);
+    appio_fd_set_class(pipefd[1], APPIO_FD_PIPE);
+  }
+  return retval;
+}
 
 int __select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
 int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout) {
   int retval;
   SUBDBG("appio: intercepted select(%d,%p,%p,%p,%p)\n", nfds,readfds,writefds,exceptfds,timeout);
-  long long start_ts = PAPI_get_real_usec();
+  long long start_ts = appio_ticks();
   retval = __select(nfds,readfds,writefds,exceptfds,timeout);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
   _appio_register_current[SELECT_USEC] += duration;
   return retval;
 }
@@ -210,9 +637,9 @@ off_t __lseek(int fd, off_t offset, int whence);
 off_t lseek(int fd, off_t offset, int whence) {
   off_t retval;
   SUBDBG("appio: intercepted lseek(%d,%ld,%d)\n", fd, offset, whence);
-  long long start_ts = PAPI_get_real_usec();
+  long long start_ts = appio_ticks();
   retval = __lseek(fd, offset, whence);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
   int n = _appio_register_current[SEEK_CALLS]++;
   _appio_register_current[SEEK_USEC] += duration;
   if (offset < 0) offset = -offset; // get abs offset
@@ -226,24 +653,12 @@ ssize_t read(int fd, void *buf, size_t count) {
   int retval;
   SUBDBG("appio: intercepted read(%d,%p,%lu)\n", fd, buf, (unsigned long)count);
 
-  struct stat st;
-  int issocket = 0;
-  if (fstat(fd, &st) == 0) {
-    if ((st.st_mode & S_IFMT) == S_IFSOCK) issocket = 1;
-  }
-  // check if read would block on descriptor
-  fd_set readfds;
-  FD_ZERO(&readfds);
-  FD_SET(fd, &readfds);
-  int ready = __select(fd+1, &readfds, NULL, NULL, &zerotv);
-  if (ready == 0) {
-     _appio_register_current[READ_WOULD_BLOCK]++; 
-     if (issocket) _appio_register_current[SOCK_READ_WOULD_BLOCK]++; 
-  }
-
-  long long start_ts = PAPI_get_real_usec();
+  int cls = appio_fd_class(fd);
+  int issocket = ((cls & APPIO_FD_CLASS_MASK) == APPIO_FD_SOCKET);
+  long long start_ts = appio_ticks();
   retval = __read(fd,buf, count);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
+  if (retval >= 0) appio_hist_record(cls, APPIO_OP_READ, duration, count);
   int n = _appio_register_current[READ_CALLS]++; // read calls
   if (issocket) _appio_register_current[SOCK_READ_CALLS]++; // read calls
   if (retval > 0) {
@@ -262,10 +677,10 @@ ssize_t read(int fd, void *buf, size_t count) {
     if (issocket) _appio_register_current[SOCK_READ_ERR]++; // read err
     if (EINTR == errno)
       _appio_register_current[READ_INTERRUPTED]++; // signal interrupted the read
-    //if ((EAGAIN == errno) || (EWOULDBLOCK == errno)) {
-    //  _appio_register_current[READ_WOULD_BLOCK]++; //read would block on descriptor marked as non-blocking
-    //  if (issocket) _appio_register_current[SOCK_READ_WOULD_BLOCK]++; //read would block on descriptor marked as non-blocking
-    //}
+    if ((EAGAIN == errno) || (EWOULDBLOCK == errno)) {
+      _appio_register_current[READ_WOULD_BLOCK]++; //read would block on descriptor marked as non-blocking
+      if (issocket) _appio_register_current[SOCK_READ_WOULD_BLOCK]++; //read would block on descriptor marked as non-blocking
+    }
   }
   if (retval == 0) _appio_register_current[READ_EOF]++; // read eof
   return retval;
@@ -275,9 +690,11 @@ size_t _IO_fread(void *ptr, size_t size, size_t nmemb, FILE *stream);
 size_t fread(void *ptr, size_t size, size_t nmemb, FILE *stream) {
   size_t retval;
   SUBDBG("appio: intercepted fread(%p,%lu,%lu,%p)\n", ptr, (unsigned long) size, (unsigned long) nmemb, (void*) stream);
-  long long start_ts = PAPI_get_real_usec();
+  long long start_ts = appio_ticks();
   retval = _IO_fread(ptr,size,nmemb,stream);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
+  if ((retval > 0) && _appio_hist_on)
+    appio_hist_record(appio_fd_class(fileno(stream)), APPIO_OP_READ, duration, size*nmemb);
   int n = _appio_register_current[READ_CALLS]++; // read calls
   if (retval > 0) {
     _appio_register_current[READ_BLOCK_SIZE]= (n * _appio_register_current[READ_BLOCK_SIZE]+ size*nmemb)/(n+1);//mean size
@@ -298,25 +715,13 @@ ssize_t __write(int fd, const void *buf, size_t count);
 ssize_t write(int fd, const void *buf, size_t count) {
   int retval;
   SUBDBG("appio: intercepted write(%d,%p,%lu)\n", fd, buf, (unsigned long)count);
-  struct stat st;
-  int issocket = 0;
-  if (fstat(fd, &st) == 0) {
-    if ((st.st_mode & S_IFMT) == S_IFSOCK) issocket = 1;
-  }
 
-  // check if write would block on descriptor
-  fd_set writefds;
-  FD_ZERO(&writefds);
-  FD_SET(fd, &writefds);
-  int ready = __select(fd+1, NULL, &writefds, NULL, &zerotv);
-  if (ready == 0) {
-    _appio_register_current[WRITE_WOULD_BLOCK]++; 
-    if (issocket) _appio_register_current[SOCK_WRITE_WOULD_BLOCK]++; 
-  }
-
-  long long start_ts = PAPI_get_real_usec();
+  int cls = appio_fd_class(fd);
+  int issocket = ((cls & APPIO_FD_CLASS_MASK) == APPIO_FD_SOCKET);
+  long long start_ts = appio_ticks();
   retval = __write(fd,buf, count);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
+  if (retval >= 0) appio_hist_record(cls, APPIO_OP_WRITE, duration, count);
   int n = _appio_register_current[WRITE_CALLS]++; // write calls
   if (issocket) _appio_register_current[SOCK_WRITE_CALLS]++; // socket write
   if (retval >= 0) {
@@ -335,10 +740,10 @@ ssize_t write(int fd, const void *buf, size_t count) {
     if (issocket) _appio_register_current[SOCK_WRITE_ERR]++;
     if (EINTR == errno)
       _appio_register_current[WRITE_INTERRUPTED]++; // signal interrupted the op
-    //if ((EAGAIN == errno) || (EWOULDBLOCK == errno)) {
-    //  _appio_register_current[WRITE_WOULD_BLOCK]++; //op would block on descriptor marked as non-blocking
-    //  if (issocket) _appio_register_current[SOCK_WRITE_WOULD_BLOCK]++;
-    //}
+    if ((EAGAIN == errno) || (EWOULDBLOCK == errno)) {
+      _appio_register_current[WRITE_WOULD_BLOCK]++; //op would block on descriptor marked as non-blocking
+      if (issocket) _appio_register_current[SOCK_WRITE_WOULD_BLOCK]++;
+    }
   }
   return retval;
 }
@@ -354,16 +759,11 @@ ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
     fprintf(stderr, "appio,c Internal Error: Could not obtain handle for real recv\n");
     exit(1);
   }
-  // check if recv would block on descriptor
-  fd_set readfds;
-  FD_ZERO(&readfds);
-  FD_SET(sockfd, &readfds);
-  int ready = __select(sockfd+1, &readfds, NULL, NULL, &zerotv);
-  if (ready == 0) _appio_register_current[RECV_WOULD_BLOCK]++; 
-
-  long long start_ts = PAPI_get_real_usec();
+  long long start_ts = appio_ticks();
   retval = __recv(sockfd, buf, len, flags);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
+  if ((retval >= 0) && _appio_hist_on)
+    appio_hist_record(appio_fd_class(sockfd), APPIO_OP_READ, duration, len);
   int n = _appio_register_current[RECV_CALLS]++; // read calls
   if (retval > 0) {
     _appio_register_current[RECV_BLOCK_SIZE]= (n * _appio_register_current[RECV_BLOCK_SIZE] + len)/(n+1); // mean size
@@ -381,15 +781,445 @@ ssize_t recv(int sockfd, void *buf, size_t len, int flags) {
   if (retval == 0) _appio_register_current[RECV_EOF]++; // read eof
   return retval;
 }
+
+/* The calls below have no __ alias in glibc, so the real ones are
+   found with dlsym the first time through, as for recv. */
+#define APPIO_REAL(fn) \
+  do { \
+    if (!__##fn) __##fn = dlsym(RTLD_NEXT, #fn); \
+    if (!__##fn) { \
+      fprintf(stderr, "appio.c Internal Error: Could not obtain handle for real " #fn "\n"); \
+      exit(1); \
+    } \
+  } while (0)
+
+/* Calls that hand out descriptors and have no __ alias either */
+static int (*__openat)(int dirfd, const char *pathname, int flags, mode_t mode) = NULL;
+int openat(int dirfd, const char *pathname, int flags, mode_t mode) {
+  int retval;
+  SUBDBG("appio: intercepted openat(%d,%s,%d,%d)\n", dirfd, pathname, flags, mode);
+  APPIO_REAL(openat);
+  retval = __openat(dirfd, pathname, flags, mode);
+  appio_fd_opened(retval, pathname);
+  return retval;
+}
+
+static int (*__openat64)(int dirfd, const char *pathname, int flags, mode_t mode) = NULL;
+int openat64(int dirfd, const char *pathname, int flags, mode_t mode) {
+  int retval;
+  SUBDBG("appio: intercepted openat64(%d,%s,%d,%d)\n", dirfd, pathname, flags, mode);
+  APPIO_REAL(openat64);
+  retval = __openat64(dirfd, pathname, flags, mode);
+  appio_fd_opened(retval, pathname);
+  return retval;
+}
+
+static FILE *(*__fopen64)(const char *pathname, const char *mode) = NULL;
+FILE *fopen64(const char *pathname, const char *mode) {
+  FILE *retval;
+  SUBDBG("appio: intercepted fopen64(%s,%s)\n", pathname, mode);
+  APPIO_REAL(fopen64);
+  retval = __fopen64(pathname, mode);
+  appio_fd_opened(retval ? fileno(retval) : -1, pathname);
+  return retval;
+}
+
+/* What fcntl() becomes under _FILE_OFFSET_BITS=64 on 32-bit glibc */
+static int (*__fcntl64)(int fd, int cmd, ...) = NULL;
+int fcntl64(int fd, int cmd, ...) {
+  int retval;
+  va_list ap;
+  void *arg;
+  va_start(ap, cmd);
+  arg = va_arg(ap, void *);
+  va_end(ap);
+  SUBDBG("appio: intercepted fcntl64(%d,%d,%p)\n", fd, cmd, arg);
+  APPIO_REAL(fcntl64);
+  retval = __fcntl64(fd, cmd, arg);
+  if ((retval >= 0) && ((cmd == F_DUPFD) || (cmd == F_DUPFD_CLOEXEC)))
+    appio_fd_set_class(retval, appio_fd_class(fd));
+  return retval;
+}
+
+static int (*__pipe2)(int pipefd[2], int flags) = NULL;
+int pipe2(int pipefd[2], int flags) {
+  int retval;
+  SUBDBG("appio: intercepted pipe2(%p,%d)\n", (void*) pipefd, flags);
+  APPIO_REAL(pipe2);
+  retval = __pipe2(pipefd, flags);
+  if (retval == 0) {
+    appio_fd_set_class(pipefd[0], APPIO_FD_PIPE);
+    appio_fd_set_class(pipefd[1], APPIO_FD_PIPE);
+  }
+  return retval;
+}
+
+static int (*__socket)(int domain, int type, int protocol) = NULL;
+int socket(int domain, int type, int protocol) {
+  int retval;
+  SUBDBG("appio: intercepted socket(%d,%d,%d)\n", domain, type, protocol);
+  APPIO_REAL(socket);
+  retval = __socket(domain, type, protocol);
+  if (retval >= 0) appio_fd_set_class(retval, APPIO_FD_SOCKET);
+  return retval;
+}
+
+static int (*__socketpair)(int domain, int type, int protocol, int sv[2]) = NULL;
+int socketpair(int domain, int type, int protocol, int sv[2]) {
+  int retval;
+  SUBDBG("appio: intercepted socketpair(%d,%d,%d,%p)\n", domain, type, protocol, (void*) sv);
+  APPIO_REAL(socketpair);
+  retval = __socketpair(domain, type, protocol, sv);
+  if (retval == 0) {
+    appio_fd_set_class(sv[0], APPIO_FD_SOCKET);
+    appio_fd_set_class(sv[1], APPIO_FD_SOCKET);
+  }
+  return retval;
+}
+
+static int (*__accept)(int sockfd, __SOCKADDR_ARG addr, socklen_t *addrlen) = NULL;
+int accept(int sockfd, __SOCKADDR_ARG addr, socklen_t *addrlen) {
+  int retval;
+  SUBDBG("appio: intercepted accept(%d)\n", sockfd);
+  APPIO_REAL(accept);
+  retval = __accept(sockfd, addr, addrlen);
+  if (retval >= 0) appio_fd_set_class(retval, APPIO_FD_SOCKET);
+  return retval;
+}
+
+static int (*__accept4)(int sockfd, __SOCKADDR_ARG addr, socklen_t *addrlen, int flags) = NULL;
+int accept4(int sockfd, __SOCKADDR_ARG addr, socklen_t *addrlen, int flags) {
+  int retval;
+  SUBDBG("appio: intercepted accept4(%d,%d)\n", sockfd, flags);
+  APPIO_REAL(accept4);
+  retval = __accept4(sockfd, addr, addrlen, flags);
+  if (retval >= 0) appio_fd_set_class(retval, APPIO_FD_SOCKET);
+  return retval;
+}
+
+/* Count one call of a group laid out BYTES, CALLS, [BATCH_SIZE,] USEC;
+   batch < 0 for groups without a batch size */
+static inline void
+appio_count_call(int group, ssize_t retval, long long batch, long long duration)
+{
+  int n = _appio_register_current[group + 1]++;
+  if (retval > 0) _appio_register_current[group] += retval;
+  if (batch >= 0) {
+    _appio_register_current[group + 2] = (n * _appio_register_current[group + 2] + batch)/(n+1); // mean batch
+    _appio_register_current[group + 3] += duration;
+  }
+  else _appio_register_current[group + 2] += duration;
+}
+
+static ssize_t (*__pread)(int fd, void *buf, size_t count, off_t offset) = NULL;
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted pread(%d,%p,%lu,%ld)\n", fd, buf, (unsigned long)count, (long)offset);
+  APPIO_REAL(pread);
+  long long start_ts = appio_ticks();
+  retval = __pread(fd, buf, count, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(PREAD_BYTES, retval, -1, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_READ, duration, count);
+  return retval;
+}
+
+static ssize_t (*__pread64)(int fd, void *buf, size_t count, off64_t offset) = NULL;
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted pread64(%d,%p,%lu,%lld)\n", fd, buf, (unsigned long)count, (long long)offset);
+  APPIO_REAL(pread64);
+  long long start_ts = appio_ticks();
+  retval = __pread64(fd, buf, count, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(PREAD_BYTES, retval, -1, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_READ, duration, count);
+  return retval;
+}
+
+static ssize_t (*__pwrite)(int fd, const void *buf, size_t count, off_t offset) = NULL;
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted pwrite(%d,%p,%lu,%ld)\n", fd, buf, (unsigned long)count, (long)offset);
+  APPIO_REAL(pwrite);
+  long long start_ts = appio_ticks();
+  retval = __pwrite(fd, buf, count, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(PWRITE_BYTES, retval, -1, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_WRITE, duration, count);
+  return retval;
+}
+
+static ssize_t (*__pwrite64)(int fd, const void *buf, size_t count, off64_t offset) = NULL;
+ssize_t pwrite64(int fd, const void *buf, size_t count, off64_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted pwrite64(%d,%p,%lu,%lld)\n", fd, buf, (unsigned long)count, (long long)offset);
+  APPIO_REAL(pwrite64);
+  long long start_ts = appio_ticks();
+  retval = __pwrite64(fd, buf, count, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(PWRITE_BYTES, retval, -1, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_WRITE, duration, count);
+  return retval;
+}
+
+static size_t
+appio_iov_bytes(const struct iovec *iov, int iovcnt)
+{
+  size_t bytes = 0;
+  int i;
+  for (i = 0; i < iovcnt; i++) bytes += iov[i].iov_len;
+  return bytes;
+}
+
+static ssize_t (*__readv)(int fd, const struct iovec *iov, int iovcnt) = NULL;
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted readv(%d,%p,%d)\n", fd, iov, iovcnt);
+  APPIO_REAL(readv);
+  long long start_ts = appio_ticks();
+  retval = __readv(fd, iov, iovcnt);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(READV_BYTES, retval, iovcnt, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_READ, duration, appio_iov_bytes(iov, iovcnt));
+  return retval;
+}
+
+static ssize_t (*__writev)(int fd, const struct iovec *iov, int iovcnt) = NULL;
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted writev(%d,%p,%d)\n", fd, iov, iovcnt);
+  APPIO_REAL(writev);
+  long long start_ts = appio_ticks();
+  retval = __writev(fd, iov, iovcnt);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(WRITEV_BYTES, retval, iovcnt, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_WRITE, duration, appio_iov_bytes(iov, iovcnt));
+  return retval;
+}
+
+static ssize_t (*__preadv)(int fd, const struct iovec *iov, int iovcnt, off_t offset) = NULL;
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted preadv(%d,%p,%d,%ld)\n", fd, iov, iovcnt, (long)offset);
+  APPIO_REAL(preadv);
+  long long start_ts = appio_ticks();
+  retval = __preadv(fd, iov, iovcnt, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(READV_BYTES, retval, iovcnt, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_READ, duration, appio_iov_bytes(iov, iovcnt));
+  return retval;
+}
+
+static ssize_t (*__preadv64)(int fd, const struct iovec *iov, int iovcnt, off64_t offset) = NULL;
+ssize_t preadv64(int fd, const struct iovec *iov, int iovcnt, off64_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted preadv64(%d,%p,%d,%lld)\n", fd, iov, iovcnt, (long long)offset);
+  APPIO_REAL(preadv64);
+  long long start_ts = appio_ticks();
+  retval = __preadv64(fd, iov, iovcnt, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(READV_BYTES, retval, iovcnt, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_READ, duration, appio_iov_bytes(iov, iovcnt));
+  return retval;
+}
+
+static ssize_t (*__pwritev)(int fd, const struct iovec *iov, int iovcnt, off_t offset) = NULL;
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted pwritev(%d,%p,%d,%ld)\n", fd, iov, iovcnt, (long)offset);
+  APPIO_REAL(pwritev);
+  long long start_ts = appio_ticks();
+  retval = __pwritev(fd, iov, iovcnt, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(WRITEV_BYTES, retval, iovcnt, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_WRITE, duration, appio_iov_bytes(iov, iovcnt));
+  return retval;
+}
+
+static ssize_t (*__pwritev64)(int fd, const struct iovec *iov, int iovcnt, off64_t offset) = NULL;
+ssize_t pwritev64(int fd, const struct iovec *iov, int iovcnt, off64_t offset) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted pwritev64(%d,%p,%d,%lld)\n", fd, iov, iovcnt, (long long)offset);
+  APPIO_REAL(pwritev64);
+  long long start_ts = appio_ticks();
+  retval = __pwritev64(fd, iov, iovcnt, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(WRITEV_BYTES, retval, iovcnt, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(fd), APPIO_OP_WRITE, duration, appio_iov_bytes(iov, iovcnt));
+  return retval;
+}
+
+static ssize_t (*__recvmsg)(int sockfd, struct msghdr *msg, int flags) = NULL;
+ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted recvmsg(%d,%p,%d)\n", sockfd, msg, flags);
+  APPIO_REAL(recvmsg);
+  long long start_ts = appio_ticks();
+  retval = __recvmsg(sockfd, msg, flags);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(RECVMSG_BYTES, retval, retval >= 0, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(sockfd), APPIO_OP_READ, duration, appio_iov_bytes(msg->msg_iov, msg->msg_iovlen));
+  return retval;
+}
+
+static ssize_t (*__sendmsg)(int sockfd, const struct msghdr *msg, int flags) = NULL;
+ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted sendmsg(%d,%p,%d)\n", sockfd, msg, flags);
+  APPIO_REAL(sendmsg);
+  long long start_ts = appio_ticks();
+  retval = __sendmsg(sockfd, msg, flags);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(SENDMSG_BYTES, retval, retval >= 0, duration);
+  if ((retval >= 0) && _appio_hist_on) appio_hist_record(appio_fd_class(sockfd), APPIO_OP_WRITE, duration, appio_iov_bytes(msg->msg_iov, msg->msg_iovlen));
+  return retval;
+}
+
+/* Bytes moved by the first n messages of a recvmmsg/sendmmsg vector */
+static ssize_t
+appio_mmsg_bytes(const struct mmsghdr *msgvec, int n)
+{
+  ssize_t bytes = 0;
+  int i;
+  for (i = 0; i < n; i++) bytes += msgvec[i].msg_len;
+  return bytes;
+}
+
+static int (*__recvmmsg)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) = NULL;
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags, struct timespec *timeout) {
+  int retval;
+  SUBDBG("appio: intercepted recvmmsg(%d,%p,%u,%d,%p)\n", sockfd, msgvec, vlen, flags, timeout);
+  APPIO_REAL(recvmmsg);
+  long long start_ts = appio_ticks();
+  retval = __recvmmsg(sockfd, msgvec, vlen, flags, timeout);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(RECVMSG_BYTES, appio_mmsg_bytes(msgvec, retval), retval > 0 ? retval : 0, duration);
+  return retval;
+}
+
+static int (*__sendmmsg)(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) = NULL;
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags) {
+  int retval;
+  SUBDBG("appio: intercepted sendmmsg(%d,%p,%u,%d)\n", sockfd, msgvec, vlen, flags);
+  APPIO_REAL(sendmmsg);
+  long long start_ts = appio_ticks();
+  retval = __sendmmsg(sockfd, msgvec, vlen, flags);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(SENDMSG_BYTES, appio_mmsg_bytes(msgvec, retval), retval > 0 ? retval : 0, duration);
+  return retval;
+}
+
+static ssize_t (*__sendfile)(int out_fd, int in_fd, off_t *offset, size_t count) = NULL;
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted sendfile(%d,%d,%p,%lu)\n", out_fd, in_fd, offset, (unsigned long)count);
+  APPIO_REAL(sendfile);
+  long long start_ts = appio_ticks();
+  retval = __sendfile(out_fd, in_fd, offset, count);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(SENDFILE_BYTES, retval, -1, duration);
+  return retval;
+}
+
+static ssize_t (*__sendfile64)(int out_fd, int in_fd, off64_t *offset, size_t count) = NULL;
+ssize_t sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted sendfile64(%d,%d,%p,%lu)\n", out_fd, in_fd, offset, (unsigned long)count);
+  APPIO_REAL(sendfile64);
+  long long start_ts = appio_ticks();
+  retval = __sendfile64(out_fd, in_fd, offset, count);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(SENDFILE_BYTES, retval, -1, duration);
+  return retval;
+}
+
+static ssize_t (*__splice)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) = NULL;
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+  ssize_t retval;
+  SUBDBG("appio: intercepted splice(%d,%p,%d,%p,%lu,%u)\n", fd_in, off_in, fd_out, off_out, (unsigned long)len, flags);
+  APPIO_REAL(splice);
+  long long start_ts = appio_ticks();
+  retval = __splice(fd_in, off_in, fd_out, off_out, len, flags);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(SPLICE_BYTES, retval, -1, duration);
+  return retval;
+}
+
+/* Only mappings of a file count; anonymous memory is not I/O */
+static void *(*__mmap)(void *addr, size_t length, int prot, int flags, int fd, off_t offset) = NULL;
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) {
+  void *retval;
+  APPIO_REAL(mmap);
+  if ((flags & MAP_ANONYMOUS) || (fd < 0))
+    return __mmap(addr, length, prot, flags, fd, offset);
+  SUBDBG("appio: intercepted mmap(%p,%lu,%d,%d,%d,%ld)\n", addr, (unsigned long)length, prot, flags, fd, (long)offset);
+  long long start_ts = appio_ticks();
+  retval = __mmap(addr, length, prot, flags, fd, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(MMAP_BYTES, (retval != MAP_FAILED) ? (ssize_t) length : -1, -1, duration);
+  return retval;
+}
+
+static void *(*__mmap64)(void *addr, size_t length, int prot, int flags, int fd, off64_t offset) = NULL;
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+  void *retval;
+  APPIO_REAL(mmap64);
+  if ((flags & MAP_ANONYMOUS) || (fd < 0))
+    return __mmap64(addr, length, prot, flags, fd, offset);
+  SUBDBG("appio: intercepted mmap64(%p,%lu,%d,%d,%d,%lld)\n", addr, (unsigned long)length, prot, flags, fd, (long long)offset);
+  long long start_ts = appio_ticks();
+  retval = __mmap64(addr, length, prot, flags, fd, offset);
+  long long duration = appio_ticks() - start_ts;
+  appio_count_call(MMAP_BYTES, (retval != MAP_FAILED) ? (ssize_t) length : -1, -1, duration);
+  return retval;
+}
+
+/* Linux native AIO through libaio; the context is opaque here and the
+   request and completion layouts are the kernel's */
+static int (*__io_submit)(void *ctx, long nr, struct iocb **iocbpp) = NULL;
+int io_submit(void *ctx, long nr, struct iocb **iocbpp) {
+  int retval;
+  SUBDBG("appio: intercepted io_submit(%p,%ld,%p)\n", ctx, nr, iocbpp);
+  APPIO_REAL(io_submit);
+  long long start_ts = appio_ticks();
+  retval = __io_submit(ctx, nr, iocbpp);
+  long long duration = appio_ticks() - start_ts;
+  int n = _appio_register_current[AIO_SUBMIT_CALLS]++;
+  if (retval > 0)
+    _appio_register_current[AIO_SUBMIT_BATCH_SIZE]= (n * _appio_register_current[AIO_SUBMIT_BATCH_SIZE] + retval)/(n+1); // mean batch
+  _appio_register_current[AIO_SUBMIT_USEC] += duration;
+  return retval;
+}
+
+static int (*__io_getevents)(void *ctx, long min_nr, long nr, struct io_event *events, struct timespec *timeout) = NULL;
+int io_getevents(void *ctx, long min_nr, long nr, struct io_event *events, struct timespec *timeout) {
+  int retval, i;
+  SUBDBG("appio: intercepted io_getevents(%p,%ld,%ld,%p,%p)\n", ctx, min_nr, nr, events, timeout);
+  APPIO_REAL(io_getevents);
+  long long start_ts = appio_ticks();
+  retval = __io_getevents(ctx, min_nr, nr, events, timeout);
+  long long duration = appio_ticks() - start_ts;
+  int n = _appio_register_current[AIO_GETEVENTS_CALLS]++;
+  if (retval >= 0)
+    _appio_register_current[AIO_GETEVENTS_BATCH_SIZE]= (n * _appio_register_current[AIO_GETEVENTS_BATCH_SIZE] + retval)/(n+1); // mean batch
+  for (i = 0; i < retval; i++) {
+    if (events[i].res > 0) _appio_register_current[AIO_BYTES] += events[i].res;
+  }
+  _appio_register_current[AIO_GETEVENTS_USEC] += duration;
+  return retval;
+}
 #endif /* PIC */
 
 size_t _IO_fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream);
 size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
   size_t retval;
   SUBDBG("appio: intercepted fwrite(%p,%lu,%lu,%p)\n", ptr, (unsigned long) size, (unsigned long) nmemb, (void*) stream);
-  long long start_ts = PAPI_get_real_usec();
+  long long start_ts = appio_ticks();
   retval = _IO_fwrite(ptr,size,nmemb,stream);
-  long long duration = PAPI_get_real_usec() - start_ts;
+  long long duration = appio_ticks() - start_ts;
+  if ((retval > 0) && _appio_hist_on)
+    appio_hist_record(appio_fd_class(fileno(stream)), APPIO_OP_WRITE, duration, size*nmemb);
   int n = _appio_register_current[WRITE_CALLS]++; // write calls
   if (retval > 0) {
     _appio_register_current[WRITE_BLOCK_SIZE]= (n * _appio_register_current[WRITE_BLOCK_SIZE] + size*nmemb)/(n+1); // mean block size
@@ -401,6 +1231,77 @@ size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *stream) {
   return retval;
 }
 
+#pragma GCC visibility pop
+
+/* Percentile of a histogram event, merged over all threads */
+static long long
+appio_hist_value(int index)
+{
+  unsigned long long merged[APPIO_HIST_BUCKETS];
+  unsigned long long total = 0, rank, cum = 0, value;
+  APPIO_hist_block_t *h;
+  int pct = index % APPIO_HIST_PERCENTILES;
+  int hist = index / APPIO_HIST_PERCENTILES;
+  int b;
+
+  memset(merged, 0, sizeof(merged));
+  for (h = _appio_hist_blocks; h != NULL; h = h->next) {
+    if (h->epoch != _appio_hist_epoch) continue;
+    for (b = 0; b < APPIO_HIST_BUCKETS; b++) {
+      merged[b] += h->counts[hist][b];
+      total += h->counts[hist][b];
+    }
+  }
+  if (total == 0) return 0;
+
+  rank = (total * _appio_hist_percentile[pct].permille + 999) / 1000;
+  for (b = 0; b < APPIO_HIST_BUCKETS - 1; b++) {
+    cum += merged[b];
+    if (cum >= rank) break;
+  }
+  value = appio_hist_upper(b);
+
+  if ((hist & 1) == APPIO_HIST_NSEC) {
+    return (long long) ((double) value * (double) _appio_tick_mult /
+                        (double) (1ULL << LINUX_TSC_SHIFT));
+  }
+  return (long long) value;
+}
+
+/* Value of a counter as PAPI reports it; times are kept in ticks */
+static long long
+appio_value(int index)
+{
+  if (index >= APPIO_BASE_COUNTERS)
+    return appio_hist_value(index - APPIO_BASE_COUNTERS);
+
+  switch (index) {
+    case READ_USEC:
+    case WRITE_USEC:
+    case SELECT_USEC:
+    case RECV_USEC:
+    case SOCK_READ_USEC:
+    case SOCK_WRITE_USEC:
+    case SEEK_USEC:
+    case PREAD_USEC:
+    case PWRITE_USEC:
+    case READV_USEC:
+    case WRITEV_USEC:
+    case RECVMSG_USEC:
+    case SENDMSG_USEC:
+    case SENDFILE_USEC:
+    case SPLICE_USEC:
+    case MMAP_USEC:
+    case AIO_SUBMIT_USEC:
+    case AIO_GETEVENTS_USEC:
+      return (long long) ((double) _appio_register_current[index] *
+                          (double) _appio_tick_mult /
+                          (double) (1ULL << LINUX_TSC_SHIFT) / 1000.0);
+    default:
+      return _appio_register_current[index];
+  }
+}
+
 
 /*********************************************************************
  ***************  BEGIN PAPI's COMPONENT REQUIRED FUNCTIONS  *********
@@ -435,11 +1336,52 @@ _appio_init_component( int cidx  )
     }
     int i;
     for (i=0; i<APPIO_MAX_COUNTERS; i++) {
-      _appio_native_events[i].name = _appio_counter_info[i].name;
-      _appio_native_events[i].description = _appio_counter_info[i].description;
+      if (i < APPIO_BASE_COUNTERS) {
+        _appio_native_events[i].name = _appio_counter_info[i].name;
+        _appio_native_events[i].description = _appio_counter_info[i].description;
+      }
+      else {
+        int j = i - APPIO_BASE_COUNTERS;
+        int pct = j % APPIO_HIST_PERCENTILES;
+        int metric = (j / APPIO_HIST_PERCENTILES) % 2;
+        int op = (j / APPIO_HIST_PERCENTILES / 2) % 2;
+        int cls = j / APPIO_HIST_PERCENTILES / 4;
+        snprintf(_appio_hist_names[j], PAPI_MIN_STR_LEN, "%s_%s_%s_%s",
+                 _appio_hist_class[cls][0], _appio_hist_op[op][0],
+                 _appio_hist_metric[metric][0], _appio_hist_percentile[pct].name);
+        snprintf(_appio_hist_descrs[j], PAPI_MAX_STR_LEN, "%s %s of %s on %s",
+                 _appio_hist_percentile[pct].description,
+                 _appio_hist_metric[metric][1], _appio_hist_op[op][1],
+                 _appio_hist_class[cls][1]);
+        _appio_native_events[i].name = _appio_hist_names[j];
+        _appio_native_events[i].description = _appio_hist_descrs[j];
+      }
       _appio_native_events[i].resources.selector = i + 1;
     }
+
+    /* A path prefix, or a descriptor number, to track */
+    char *env = getenv("PAPI_APPIO_HIST_PATH");
+    if (env && *env) {
+      char *end;
+      long fd = strtol(env, &end, 10);
+      if (*end == '\0') {
+        appio_fd_set_class((int) fd, APPIO_FD_UNKNOWN | APPIO_FD_TRACKED);
+      }
+      else {
+        snprintf(_appio_hist_path, sizeof(_appio_hist_path), "%s", env);
+        _appio_hist_path_len = strlen(_appio_hist_path);
+      }
+    }
   
+    /* Time calls with rdtsc if PAPI's real time clock trusts the TSC */
+#if defined(__x86_64__)
+    if (_linux_tsc_mult() != 0) {
+      _appio_tick_mult = _linux_tsc_mult();
+      _appio_use_tsc = 1;
+    }
+#endif
+    SUBDBG("appio: timing calls with %s\n", _appio_use_tsc ? "rdtsc" : "PAPI_get_real_nsec");
+
     /* Export the total number of events available */
     _appio_vector.cmp_info.num_native_events = APPIO_MAX_COUNTERS;;
 
@@ -450,6 +1392,17 @@ _appio_init_component( int cidx  )
 }
 
 
+/* Whether an EventSet reads any histogram event */
+static int
+appio_uses_hist(APPIO_control_state_t *appio_ctl)
+{
+    int i;
+    for ( i=0; i<appio_ctl->num_events; i++ ) {
+        if (appio_ctl->counter_bits[i] >= APPIO_BASE_COUNTERS) return 1;
+    }
+    return 0;
+}
+
 /*
  * Control of counters (Reading/Writing/Starting/Stopping/Setup)
  * functions
@@ -472,10 +1425,17 @@ _appio_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
     APPIO_control_state_t *appio_ctl = (APPIO_control_state_t *) ctl;
 
     /* this memset needs to move to thread_init */
-    memset(_appio_register_current, 0, APPIO_MAX_COUNTERS * sizeof(_appio_register_current[0]));
+    memset(_appio_register_current, 0, APPIO_BASE_COUNTERS * sizeof(_appio_register_current[0]));
 
     /* set initial values to 0 */
     memset(appio_ctl->values, 0, APPIO_MAX_COUNTERS*sizeof(appio_ctl->values[0]));
+
+    /* Histograms restart for every thread */
+    if (appio_uses_hist(appio_ctl)) {
+        __sync_fetch_and_add(&_appio_hist_epoch, 1);
+        __sync_fetch_and_add(&_appio_hist_running, 1);
+        _appio_hist_on = 1;
+    }
     
     return PAPI_OK;
 }
@@ -495,7 +1455,7 @@ _appio_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
     for ( i=0; i<appio_ctl->num_events; i++ ) {
             int index = appio_ctl->counter_bits[i];
             SUBDBG("event=%d, index=%d, val=%lld\n", i, index, _appio_register_current[index]);
-            appio_ctl->values[index] = _appio_register_current[index];
+            appio_ctl->values[index] = appio_value(index);
     }
     *events = appio_ctl->values;
 
@@ -514,9 +1474,14 @@ _appio_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
     for ( i=0; i<appio_ctl->num_events; i++ ) {
             int index = appio_ctl->counter_bits[i];
             SUBDBG("event=%d, index=%d, val=%lld\n", i, index, _appio_register_current[index]);
-            appio_ctl->values[i] = _appio_register_current[index];
+            appio_ctl->values[i] = appio_value(index);
     }
 
+    /* Stop recording once no EventSet reads the histograms */
+    if (appio_uses_hist(appio_ctl) &&
+        (__sync_sub_and_fetch(&_appio_hist_running, 1) == 0))
+        _appio_hist_on = 0;
+
     return PAPI_OK;
 }
 
@@ -539,6 +1504,10 @@ _appio_shutdown_thread( hwd_context_t *ctx )
 static int
 _appio_shutdown_component( void )
 {
+    /* The histogram blocks stay; threads may still hold them */
+    _appio_hist_on = 0;
+    _appio_hist_running = 0;
+
     papi_free( _appio_native_events );
     return PAPI_OK;
 }
@@ -660,7 +1629,7 @@ _appio_ntv_name_to_code( const char *name, unsigned int *EventCode )
     int i;
 
     for ( i=0; i<APPIO_MAX_COUNTERS; i++) {
-        if (strcmp(name, _appio_counter_info[i].name) == 0) {
+        if (strcmp(name, _appio_native_events[i].name) == 0) {
             *EventCode = i;
             return PAPI_OK;
         }
@@ -679,7 +1648,7 @@ _appio_ntv_code_to_name( unsigned int EventCode, char *name, int len )
     int index = EventCode;
 
     if ( index >= 0 && index < APPIO_MAX_COUNTERS ) {
-        strncpy( name, _appio_counter_info[index].name, len );
+        strncpy( name, _appio_native_events[index].name, len );
         return PAPI_OK;
     }
 
@@ -696,7 +1665,7 @@ _appio_ntv_code_to_descr( unsigned int EventCode, char *desc, int len )
     int index = EventCode;
 
     if ( index >= 0 && index < APPIO_MAX_COUNTERS ) {
-        strncpy(desc, _appio_counter_info[index].description, len );
+        strncpy(desc, _appio_native_events[index].description, len );
         return PAPI_OK;
     }
 
@@ -29,7 +29,32 @@
 /*************************  DEFINES SECTION  ***********************************/
 
 /* Set this equal to the number of elements in _appio_counter_info array */
-#define APPIO_MAX_COUNTERS 45
+#define APPIO_BASE_COUNTERS 83
+
+/* Latency and request size histograms: per class of descriptor, for
+   reads and writes, each reported at three percentiles */
+#define APPIO_HIST_CLASSES     4   /* file, socket, pipe, tracked path */
+#define APPIO_HIST_PERCENTILES 3   /* p50, p99, p999 */
+#define APPIO_NUM_HISTS        (APPIO_HIST_CLASSES * 2 * 2)
+#define APPIO_HIST_COUNTERS    (APPIO_NUM_HISTS * APPIO_HIST_PERCENTILES)
+
+#define APPIO_MAX_COUNTERS (APPIO_BASE_COUNTERS + APPIO_HIST_COUNTERS)
+
+/* Log-linear buckets: values below 16 exactly, then 16 per power of two,
+   so a bucket is at most 1/16 wider than its lower edge */
+#define APPIO_HIST_SUB_BITS 4
+#define APPIO_HIST_BUCKETS  ((64 - APPIO_HIST_SUB_BITS + 1) << APPIO_HIST_SUB_BITS)
+
+/* Descriptors whose class is cached; higher ones are fstat'ed per call */
+#define APPIO_MAX_FDS 65536
+
+/* Descriptor classes */
+#define APPIO_FD_UNKNOWN  0
+#define APPIO_FD_FILE     1
+#define APPIO_FD_SOCKET   2
+#define APPIO_FD_PIPE     3
+#define APPIO_FD_CLASS_MASK 0x7f
+#define APPIO_FD_TRACKED  0x80  /* also recorded in the path histograms */
 
 /** Structure that stores private information of each event */
 typedef struct APPIO_register
@@ -55,6 +80,17 @@ typedef struct APPIO_native_event_entry
     const char* description;
 } APPIO_native_event_entry_t;
 
+/* One thread's histograms.  Only the owning thread writes them; reads
+   merge the blocks of every thread that did I/O in the current epoch.
+   A block is handed on to a new thread once its owner has exited.    */
+typedef struct APPIO_hist_block
+{
+    struct APPIO_hist_block *next;
+    volatile int in_use;
+    unsigned int epoch;
+    unsigned int counts[APPIO_NUM_HISTS][APPIO_HIST_BUCKETS];
+} APPIO_hist_block_t;
+
 
 typedef struct APPIO_reg_alloc
 {
@@ -0,0 +1,159 @@
+/*
+ * Test case for appio
+ *
+ * Description: Checks that reads are attributed to sockets by the
+ *              cached class of their descriptor, that the class is
+ *              dropped when the descriptor is closed by close or
+ *              fclose or replaced by open, dup2, pipe or fopen, and
+ *              that would-block is counted from EAGAIN on a
+ *              non-blocking socket.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_EVENTS 5
+
+int main(int argc, char** argv) {
+  const char* names[NUM_EVENTS] = {"READ_CALLS", "READ_WOULD_BLOCK", "SOCK_READ_CALLS", "SOCK_READ_WOULD_BLOCK", "READ_USEC"};
+  long long values[NUM_EVENTS];
+  int EventSet = PAPI_NULL;
+  int retval, e, sv[2], sv2[2], sv3[2], p[2], fd;
+  FILE *fp;
+  char buf[64];
+
+  /* Set TESTS_QUIET variable */
+  tests_quiet( argc, argv );
+
+  retval = PAPI_library_init (PAPI_VER_CURRENT);
+  if (retval != PAPI_VER_CURRENT) {
+    test_fail(__FILE__, __LINE__, "PAPI_library_init", retval);
+  }
+
+  if (PAPI_create_eventset(&EventSet) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_create_eventset", 0);
+  }
+  for (e=0; e<NUM_EVENTS; e++) {
+    retval = PAPI_add_named_event(EventSet, (char*)names[e]);
+    if (retval != PAPI_OK) {
+      test_fail(__FILE__, __LINE__, "PAPI_add_named_event", retval);
+    }
+  }
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+    test_skip(__FILE__, __LINE__, "socketpair", PAPI_ESYS);
+  }
+  fcntl(sv[1], F_SETFL, O_NONBLOCK);
+
+  if (PAPI_start(EventSet) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_start", 0);
+  }
+
+  /* 1 socket read that succeeds, 1 that would block */
+  if (write(sv[0], "x", 1) != 1) {
+    test_fail(__FILE__, __LINE__, "write", PAPI_ESYS);
+  }
+  if (read(sv[1], buf, sizeof(buf)) != 1) {
+    test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+  }
+  if ((read(sv[1], buf, sizeof(buf)) >= 0) || (errno != EAGAIN)) {
+    test_fail(__FILE__, __LINE__, "read did not return EAGAIN", PAPI_ESYS);
+  }
+
+  /* The socket's number is reused for a file: 1 file read */
+  close(sv[1]);
+  fd = open("/dev/zero", O_RDONLY, 0);
+  if (fd < 0) {
+    test_fail(__FILE__, __LINE__, "open", PAPI_ESYS);
+  }
+  if (read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+    test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+  }
+
+  /* The file is replaced by another socket: 1 socket read */
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv2) != 0) {
+    test_fail(__FILE__, __LINE__, "socketpair", PAPI_ESYS);
+  }
+  if (write(sv2[0], "y", 1) != 1) {
+    test_fail(__FILE__, __LINE__, "write", PAPI_ESYS);
+  }
+  if (dup2(sv2[1], fd) != fd) {
+    test_fail(__FILE__, __LINE__, "dup2", PAPI_ESYS);
+  }
+  if (read(fd, buf, sizeof(buf)) != 1) {
+    test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+  }
+
+  /* A socket closed inside fclose, its number reused by pipe: 1 socket
+     read, then 1 pipe read */
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv3) != 0) {
+    test_fail(__FILE__, __LINE__, "socketpair", PAPI_ESYS);
+  }
+  if (write(sv3[0], "z", 1) != 1) {
+    test_fail(__FILE__, __LINE__, "write", PAPI_ESYS);
+  }
+  if (read(sv3[1], buf, sizeof(buf)) != 1) {
+    test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+  }
+  fp = fdopen(sv3[1], "r");
+  if ((fp == NULL) || (fclose(fp) != 0)) {
+    test_fail(__FILE__, __LINE__, "fclose", PAPI_ESYS);
+  }
+  if (pipe(p) != 0) {
+    test_fail(__FILE__, __LINE__, "pipe", PAPI_ESYS);
+  }
+  if (write(p[1], "p", 1) != 1) {
+    test_fail(__FILE__, __LINE__, "write", PAPI_ESYS);
+  }
+  if (read(p[0], buf, sizeof(buf)) != 1) {
+    test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+  }
+
+  /* The other end closed the same way, its number reused by fopen:
+     1 file read */
+  fp = fdopen(sv3[0], "w");
+  if ((fp == NULL) || (fclose(fp) != 0)) {
+    test_fail(__FILE__, __LINE__, "fclose", PAPI_ESYS);
+  }
+  fp = fopen("/dev/zero", "r");
+  if (fp == NULL) {
+    test_fail(__FILE__, __LINE__, "fopen", PAPI_ESYS);
+  }
+  if (read(fileno(fp), buf, sizeof(buf)) != sizeof(buf)) {
+    test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+  }
+
+  if (PAPI_stop(EventSet, values) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_stop", 0);
+  }
+
+  if (!TESTS_QUIET) {
+    printf("----\n");
+    for (e=0; e<NUM_EVENTS; e++)
+      printf("%s: %lld\n", names[e], values[e]);
+  }
+
+  close(fd);
+  close(sv[0]);
+  close(sv2[0]);
+  close(sv2[1]);
+  close(p[0]);
+  close(p[1]);
+  fclose(fp);
+
+  if (values[0] != 7) test_fail(__FILE__, __LINE__, "READ_CALLS", values[0]);
+  if (values[1] != 1) test_fail(__FILE__, __LINE__, "READ_WOULD_BLOCK", values[1]);
+  if (values[2] != 4) test_fail(__FILE__, __LINE__, "SOCK_READ_CALLS", values[2]);
+  if (values[3] != 1) test_fail(__FILE__, __LINE__, "SOCK_READ_WOULD_BLOCK", values[3]);
+
+  test_pass( __FILE__ );
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * Test case for appio
+ *
+ * Description: Checks the latency and request size percentiles.
+ *              The main thread reads 990 x 64 bytes from /dev/zero,
+ *              which is tracked through PAPI_APPIO_HIST_PATH, and
+ *              10 x 4096 bytes from /dev/urandom; a second thread
+ *              writes 100 x 128 bytes into a pipe.  Percentiles are
+ *              reported as the top of a bucket 1/16 wide.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_EVENTS 7
+
+static int pipefd[2];
+
+static void *writer(void *arg) {
+  char buf[128];
+  int i;
+
+  (void) arg;
+  memset(buf, 'x', sizeof(buf));
+  for (i=0; i<100; i++) {
+    if (write(pipefd[1], buf, sizeof(buf)) != sizeof(buf)) break;
+  }
+  return NULL;
+}
+
+/* v lies in the bucket whose top is reported */
+static int in_bucket(long long reported, long long v) {
+  return (reported >= v) && (reported <= v + v/16);
+}
+
+int main(int argc, char** argv) {
+  const char* names[NUM_EVENTS] = {"FILE_READ_SIZE_P50", "FILE_READ_SIZE_P99", "FILE_READ_SIZE_P999", "PATH_READ_SIZE_P999", "PIPE_WRITE_SIZE_P50", "FILE_READ_NSEC_P50", "SOCK_READ_NSEC_P99"};
+  long long values[NUM_EVENTS];
+  int EventSet = PAPI_NULL;
+  int retval, e, i, zero, urandom;
+  char buf[4096];
+  pthread_t thread;
+
+  /* Set TESTS_QUIET variable */
+  tests_quiet( argc, argv );
+
+  setenv("PAPI_APPIO_HIST_PATH", "/dev/zero", 1);
+
+  retval = PAPI_library_init (PAPI_VER_CURRENT);
+  if (retval != PAPI_VER_CURRENT) {
+    test_fail(__FILE__, __LINE__, "PAPI_library_init", retval);
+  }
+
+  if (PAPI_create_eventset(&EventSet) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_create_eventset", 0);
+  }
+  for (e=0; e<NUM_EVENTS; e++) {
+    retval = PAPI_add_named_event(EventSet, (char*)names[e]);
+    if (retval != PAPI_OK) {
+      test_fail(__FILE__, __LINE__, "PAPI_add_named_event", retval);
+    }
+  }
+
+  zero = open("/dev/zero", O_RDONLY, 0);
+  urandom = open("/dev/urandom", O_RDONLY, 0);
+  if ((zero < 0) || (urandom < 0) || (pipe(pipefd) != 0)) {
+    test_skip(__FILE__, __LINE__, "open", PAPI_ESYS);
+  }
+
+  if (PAPI_start(EventSet) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_start", 0);
+  }
+
+  for (i=0; i<990; i++) {
+    if (read(zero, buf, 64) != 64) {
+      test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+    }
+  }
+  for (i=0; i<10; i++) {
+    if (read(urandom, buf, 4096) <= 0) {
+      test_fail(__FILE__, __LINE__, "read", PAPI_ESYS);
+    }
+  }
+
+  /* Merged in from another thread */
+  pthread_create(&thread, NULL, writer, NULL);
+  pthread_join(thread, NULL);
+
+  if (PAPI_stop(EventSet, values) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_stop", 0);
+  }
+
+  if (!TESTS_QUIET) {
+    printf("----\n");
+    for (e=0; e<NUM_EVENTS; e++)
+      printf("%s: %lld\n", names[e], values[e]);
+  }
+
+  close(zero);
+  close(urandom);
+  close(pipefd[0]);
+  close(pipefd[1]);
+
+  if (!in_bucket(values[0], 64)) test_fail(__FILE__, __LINE__, names[0], values[0]);
+  if (!in_bucket(values[1], 64)) test_fail(__FILE__, __LINE__, names[1], values[1]);
+  if (!in_bucket(values[2], 4096)) test_fail(__FILE__, __LINE__, names[2], values[2]);
+  if (!in_bucket(values[3], 64)) test_fail(__FILE__, __LINE__, names[3], values[3]);
+  if (!in_bucket(values[4], 128)) test_fail(__FILE__, __LINE__, names[4], values[4]);
+  if (values[5] <= 0) test_fail(__FILE__, __LINE__, names[5], values[5]);
+  if (values[6] != 0) test_fail(__FILE__, __LINE__, names[6], values[6]);
+
+  test_pass( __FILE__ );
+  return 0;
+}
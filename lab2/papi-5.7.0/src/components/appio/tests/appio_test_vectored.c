@@ -0,0 +1,146 @@
+/*
+ * Test case for appio
+ *
+ * Description: Checks the positioned, vectored and zero-copy calls.
+ *              A temporary file is written with pwrite and writev (3
+ *              buffers), read back with pread, readv and a mapping,
+ *              sent over a socket with sendfile, and moved through a
+ *              pipe with splice; a message of 2 buffers is passed
+ *              over a socketpair with sendmsg/recvmsg.  These calls
+ *              are only intercepted by the shared library.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_EVENTS 14
+
+int main(int argc, char** argv) {
+  const char* names[NUM_EVENTS] = {"PWRITE_BYTES", "PREAD_BYTES", "WRITEV_BYTES", "WRITEV_BATCH_SIZE", "READV_BYTES", "READV_CALLS", "SENDMSG_BYTES", "RECVMSG_BYTES", "RECVMSG_BATCH_SIZE", "SENDFILE_BYTES", "SPLICE_BYTES", "MMAP_BYTES", "MMAP_CALLS", "READ_CALLS"};
+  long long expected[NUM_EVENTS] = {4352, 256, 192, 3, 192, 1, 48, 48, 1, 512, 512, 4096, 1, 0};
+  long long values[NUM_EVENTS];
+  int EventSet = PAPI_NULL;
+  int retval, e, fd, sv[2], pipefd[2];
+  char tmpl[] = "/tmp/appio_vectoredXXXXXX";
+  char a[64], b[64], c[64], buf[4096];
+  struct iovec iov[3];
+  struct msghdr msg;
+  void *map;
+
+  /* Set TESTS_QUIET variable */
+  tests_quiet( argc, argv );
+
+  retval = PAPI_library_init (PAPI_VER_CURRENT);
+  if (retval != PAPI_VER_CURRENT) {
+    test_fail(__FILE__, __LINE__, "PAPI_library_init", retval);
+  }
+
+  if (PAPI_create_eventset(&EventSet) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_create_eventset", 0);
+  }
+  for (e=0; e<NUM_EVENTS; e++) {
+    retval = PAPI_add_named_event(EventSet, (char*)names[e]);
+    if (retval != PAPI_OK) {
+      test_fail(__FILE__, __LINE__, "PAPI_add_named_event", retval);
+    }
+  }
+
+  fd = mkstemp(tmpl);
+  if ((fd < 0) || (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) || (pipe(pipefd) != 0)) {
+    test_skip(__FILE__, __LINE__, "mkstemp", PAPI_ESYS);
+  }
+  unlink(tmpl);
+  memset(a, 'a', sizeof(a));
+  memset(b, 'b', sizeof(b));
+  memset(c, 'c', sizeof(c));
+  memset(buf, 'x', sizeof(buf));
+
+  if (PAPI_start(EventSet) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_start", 0);
+  }
+
+  if (pwrite(fd, buf, sizeof(buf), 0) != sizeof(buf)) {
+    test_fail(__FILE__, __LINE__, "pwrite", PAPI_ESYS);
+  }
+  if (pwrite(fd, buf, 256, 0) != 256) {
+    test_fail(__FILE__, __LINE__, "pwrite", PAPI_ESYS);
+  }
+
+  iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b; iov[1].iov_len = sizeof(b);
+  iov[2].iov_base = c; iov[2].iov_len = sizeof(c);
+  if (writev(fd, iov, 3) != 192) {
+    test_fail(__FILE__, __LINE__, "writev", PAPI_ESYS);
+  }
+  if (pread(fd, buf, 256, 0) != 256) {
+    test_fail(__FILE__, __LINE__, "pread", PAPI_ESYS);
+  }
+  lseek(fd, 0, SEEK_SET);
+  if (readv(fd, iov, 3) != 192) {
+    test_fail(__FILE__, __LINE__, "readv", PAPI_ESYS);
+  }
+
+  map = mmap(NULL, 4096, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED) {
+    test_fail(__FILE__, __LINE__, "mmap", PAPI_ESYS);
+  }
+  munmap(map, 4096);
+  /* Anonymous memory is not counted */
+  map = mmap(NULL, 4096, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if (map != MAP_FAILED) munmap(map, 4096);
+
+  /* 2 buffers in one message */
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  iov[0].iov_len = 32;
+  iov[1].iov_len = 16;
+  if (sendmsg(sv[0], &msg, 0) != 48) {
+    test_fail(__FILE__, __LINE__, "sendmsg", PAPI_ESYS);
+  }
+  if (recvmsg(sv[1], &msg, 0) != 48) {
+    test_fail(__FILE__, __LINE__, "recvmsg", PAPI_ESYS);
+  }
+
+  lseek(fd, 0, SEEK_SET);
+  if (sendfile(sv[0], fd, NULL, 512) != 512) {
+    test_fail(__FILE__, __LINE__, "sendfile", PAPI_ESYS);
+  }
+  if (splice(sv[1], NULL, pipefd[1], NULL, 512, 0) != 512) {
+    test_fail(__FILE__, __LINE__, "splice", PAPI_ESYS);
+  }
+
+  if (PAPI_stop(EventSet, values) != PAPI_OK) {
+    test_fail(__FILE__, __LINE__, "PAPI_stop", 0);
+  }
+
+  if (!TESTS_QUIET) {
+    printf("----\n");
+    for (e=0; e<NUM_EVENTS; e++)
+      printf("%s: %lld (expected %lld)\n", names[e], values[e], expected[e]);
+  }
+
+  close(fd);
+  close(sv[0]);
+  close(sv[1]);
+  close(pipefd[0]);
+  close(pipefd[1]);
+
+  for (e=0; e<NUM_EVENTS; e++) {
+    if (values[e] != expected[e]) test_fail(__FILE__, __LINE__, names[e], values[e]);
+  }
+
+  test_pass( __FILE__ );
+  return 0;
+}
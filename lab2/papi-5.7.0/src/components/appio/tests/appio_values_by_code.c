@@ -20,7 +20,7 @@
 #include "papi.h"
 #include "papi_test.h"
 
-#define MAX_EVENTS 48
+#define MAX_EVENTS 128
 
 int main (int argc, char **argv)
 {
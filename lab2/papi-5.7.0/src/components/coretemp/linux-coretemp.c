@@ -5,6 +5,7 @@
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "linux-common.h"
 
 #include "linux-coretemp.h"
 
@@ -311,30 +312,40 @@ done_error:
 static long long
 getEventValue( int index ) 
 {
-    char buf[PAPI_MAX_STR_LEN];
-    FILE* fp;
-    long result;
+    char buf[PAPI_MIN_STR_LEN];
+    long long result;
 
     if (_coretemp_native_events[index].stone) {
        return _coretemp_native_events[index].value;
     }
 
-    fp = fopen(_coretemp_native_events[index].path, "r");
-    if (fp==NULL) {
+    if (_coretemp_native_events[index].fd < 0) {
        return INVALID_RESULT;
     }
 
-    if (fgets(buf, PAPI_MAX_STR_LEN, fp)==NULL) {
-        result=INVALID_RESULT;
+    if (_linux_sysfile_read(_coretemp_native_events[index].fd,
+			    buf, sizeof(buf)) <= 0) {
+       return INVALID_RESULT;
     }
-    else {
-        result=strtoll(buf, NULL, 10);
+
+    if (_linux_sysfile_ll(buf, &result)==NULL) {
+       return INVALID_RESULT;
     }
-    fclose(fp);
 
     return result;
 }
 
+/* Read every event of an EventSet in one pass */
+static void
+readEventSet( CORETEMP_control_state_t *control )
+{
+    int i;
+
+    for ( i = 0; i < control->num_events; i++ ) {
+	control->counts[i] = getEventValue( control->which_counter[i] );
+    }
+}
+
 /*****************************************************************************
  *******************  BEGIN PAPI's COMPONENT REQUIRED FUNCTIONS  *************
  *****************************************************************************/
@@ -398,6 +409,7 @@ _coretemp_init_component( int cidx )
 	strncpy(_coretemp_native_events[i].description,t->description,PAPI_MAX_STR_LEN);
         _coretemp_native_events[i].description[PAPI_MAX_STR_LEN-1] = '\0';
 	_coretemp_native_events[i].stone = 0;
+	_coretemp_native_events[i].fd = -1;
 	_coretemp_native_events[i].resources.selector = i + 1;
 	last	= t;
 	t		= t->next;
@@ -425,13 +437,9 @@ _coretemp_init_component( int cidx )
 static int
 _coretemp_init_control_state( hwd_control_state_t * ctl)
 {
-    int i;
-
     CORETEMP_control_state_t *coretemp_ctl = (CORETEMP_control_state_t *) ctl;
 
-    for ( i=0; i < num_events; i++ ) {
-	coretemp_ctl->counts[i] = getEventValue(i);
-    }
+    coretemp_ctl->num_events = 0;
 
     /* Set last access time for caching results */
     coretemp_ctl->lastupdate = PAPI_get_real_usec();
@@ -457,15 +465,12 @@ _coretemp_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 
     CORETEMP_control_state_t* control = (CORETEMP_control_state_t*) ctl;
     long long now = PAPI_get_real_usec();
-    int i;
 
     /* Only read the values from the kernel if enough time has passed */
     /* since the last read.  Otherwise return cached values.          */
 
     if ( now - control->lastupdate > REFRESH_LAT ) {
-	for ( i = 0; i < num_events; i++ ) {
-	   control->counts[i] = getEventValue( i );
-	}
+	readEventSet( control );
 	control->lastupdate = now;
     }
 
@@ -481,11 +486,8 @@ _coretemp_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
     (void) ctx;
     /* read values */
     CORETEMP_control_state_t* control = (CORETEMP_control_state_t*) ctl;
-    int i;
 
-    for ( i = 0; i < num_events; i++ ) {
-	control->counts[i] = getEventValue( i );
-    }
+    readEventSet( control );
 
     return PAPI_OK;
 }
@@ -505,8 +507,14 @@ _coretemp_shutdown_thread( hwd_context_t * ctx )
 static int
 _coretemp_shutdown_component( ) 
 {
+    int i;
+
     if ( is_initialized ) {
        is_initialized = 0;
+       for ( i = 0; i < num_events; i++ ) {
+	  if ( _coretemp_native_events[i].fd >= 0 )
+	     close( _coretemp_native_events[i].fd );
+       }
        papi_free(_coretemp_native_events);
        _coretemp_native_events = NULL;
     }
@@ -534,14 +542,35 @@ _coretemp_update_control_state(	hwd_control_state_t *ptr,
 				NativeInfo_t * native, int count,
 				hwd_context_t * ctx )
 {
-    int i, index;
+    CORETEMP_control_state_t *control = (CORETEMP_control_state_t *) ptr;
+    int i, index, fd;
     ( void ) ctx;
-    ( void ) ptr;
 
     for ( i = 0; i < count; i++ ) {
 	index = native[i].ni_event;
-	native[i].ni_position = _coretemp_native_events[index].resources.selector - 1;
+
+	/* Open each sensor file once; it stays open until shutdown */
+	if ( _coretemp_native_events[index].fd < 0 &&
+	     !_coretemp_native_events[index].stone ) {
+	   fd = _linux_sysfile_open( _coretemp_native_events[index].path );
+	   if ( fd < 0 ) {
+	      SUBDBG( "Cannot open %s\n", _coretemp_native_events[index].path );
+	      return PAPI_ESYS;
+	   }
+	   if ( !__sync_bool_compare_and_swap( &_coretemp_native_events[index].fd,
+					       -1, fd ) ) {
+	      close( fd );
+	   }
+	}
+
+	control->which_counter[i] = index;
+	native[i].ni_position = i;
     }
+    control->num_events = count;
+
+    /* Have the first read of the new set go to the kernel */
+    control->lastupdate = 0;
+
     return PAPI_OK;
 }
 
@@ -59,6 +59,7 @@ typedef struct CORETEMP_native_event_entry
   char path[PATH_MAX];
   int stone; /* some counters are set in stone, a max temperature is just that... */
   long value;
+  int fd;    /* opened when the event is first added, -1 until then */
   CORETEMP_register_t resources;
 } CORETEMP_native_event_entry_t;
 
@@ -71,6 +72,8 @@ typedef struct CORETEMP_reg_alloc
 typedef struct CORETEMP_control_state
 {
 	long long counts[CORETEMP_MAX_COUNTERS];	// used for caching
+	int which_counter[CORETEMP_MAX_COUNTERS];
+	int num_events;
 	long long lastupdate;
 } CORETEMP_control_state_t;
 
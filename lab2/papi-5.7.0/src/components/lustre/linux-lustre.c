@@ -25,6 +25,9 @@
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "linux-common.h"
+
+struct lustre_fs_struct;
 
 /** describes a single counter with its properties */
 typedef struct counter_info_struct
@@ -34,6 +37,7 @@ typedef struct counter_info_struct
 	char *description;
 	char *unit;
 	unsigned long long value;
+	struct lustre_fs_struct *fs;	/**< filesystem whose files hold the value */
 } counter_info;
 
 typedef struct
@@ -48,6 +52,8 @@ typedef struct lustre_fs_struct
 {
 	char *proc_file;
 	char *proc_file_readahead;
+	int proc_fd;			/**< proc_file, opened on first use */
+	int proc_fd_readahead;
 	counter_info *write_cntr;
 	counter_info *read_cntr;
 	counter_info *readahead_cntr;
@@ -69,6 +75,8 @@ typedef struct LUSTRE_control_state
         long long difference[LUSTRE_MAX_COUNTERS];
         int which_counter[LUSTRE_MAX_COUNTERS];
 	int num_events;
+	struct lustre_fs_struct *which_fs[LUSTRE_MAX_COUNTERS];	/* each fs once */
+	int num_fs;
 } LUSTRE_control_state_t;
 
 
@@ -178,6 +186,8 @@ addLustreFS( const char *name,
 	   return PAPI_ENOMEM;
 	}
 
+	fs->proc_fd = -1;
+	fs->proc_fd_readahead = -1;
 	fs->proc_file=strdup(procpath_general);
 	fff = fopen( procpath_general, "r" );
 	if ( fff == NULL ) {
@@ -232,6 +242,10 @@ addLustreFS( const char *name,
 			return PAPI_ENOMEM;
 	}
 
+	fs->read_cntr->fs = fs;
+	fs->write_cntr->fs = fs;
+	fs->readahead_cntr->fs = fs;
+
 	fs->next = NULL;
 
 	/* Insert into the linked list */
@@ -341,50 +355,94 @@ init_lustre_counters( void  )
 }
 
 /**
- * updates all Lustre related counters
+ * opens the stats files of a Lustre fs, once
+ */
+static int
+open_lustre_fs( lustre_fs *fs )
+{
+	int fd;
+
+	if ( fs->proc_fd < 0 ) {
+	  fd = _linux_sysfile_open( fs->proc_file );
+	  if ( fd < 0 ) {
+		SUBDBG("can not open '%s'\n", fs->proc_file );
+		return PAPI_ESYS;
+	  }
+	  if ( !__sync_bool_compare_and_swap( &fs->proc_fd, -1, fd ) )
+		close( fd );
+	}
+
+	if ( fs->proc_fd_readahead < 0 ) {
+	  fd = _linux_sysfile_open( fs->proc_file_readahead );
+	  if ( fd < 0 ) {
+		SUBDBG("can not open '%s'\n", fs->proc_file_readahead );
+		return PAPI_ESYS;
+	  }
+	  if ( !__sync_bool_compare_and_swap( &fs->proc_fd_readahead, -1, fd ) )
+		close( fd );
+	}
+
+	return PAPI_OK;
+}
+
+/**
+ * returns the n-th number on the line of buffer containing key
+ */
+static int
+find_lustre_value( char *buffer, const char *key, int n,
+		   unsigned long long *value )
+{
+	char *p;
+	long long v = 0;
+
+	p = strstr( buffer, key );
+	if ( p == NULL )
+		return PAPI_ENOEVNT;
+
+	p += strlen( key );
+	while ( n-- > 0 ) {
+	  p = _linux_sysfile_ll( p, &v );
+	  if ( p == NULL )
+		return PAPI_ENOEVNT;
+	}
+	*value = ( unsigned long long ) v;
+
+	return PAPI_OK;
+}
+
+/**
+ * updates the counters of the Lustre fs used by an EventSet
  */
 static void
-read_lustre_counter( )
+read_lustre_counter( LUSTRE_control_state_t *lustre_ctl )
 {
-	lustre_fs *fs = root_lustre_fs;
-	FILE *fff;
+	lustre_fs *fs;
 	char buffer[BUFSIZ];
+	int i;
 
-	while ( fs != NULL ) {
+	for ( i = 0; i < lustre_ctl->num_fs; i++ ) {
+	  fs = lustre_ctl->which_fs[i];
 
-	  /* read values from stats file */
-	  fff=fopen(fs->proc_file,"r" );
-	  if (fff != NULL) {
-		  while(1) {
-			if (fgets(buffer,BUFSIZ,fff)==NULL) break;
-	
-			if (strstr( buffer, "write_bytes" )) {
-			  sscanf(buffer,"%*s %*d %*s %*s %*d %*d %llu",&fs->write_cntr->value);
-			  SUBDBG("Read %llu write_bytes\n",fs->write_cntr->value);
-			}
-	
-			if (strstr( buffer, "read_bytes" )) {
-			  sscanf(buffer,"%*s %*d %*s %*s %*d %*d %llu",&fs->read_cntr->value);
-			  SUBDBG("Read %llu read_bytes\n",fs->read_cntr->value);
-			}
-		  }
-		  fclose(fff);
+	  /* read values from stats file; */
+	  /* name count samples [unit] min max sum */
+	  if ( _linux_sysfile_read( fs->proc_fd, buffer, sizeof ( buffer ) ) > 0 ) {
+		if ( find_lustre_value( buffer, "write_bytes", 4,
+					&fs->write_cntr->value ) == PAPI_OK ) {
+		  SUBDBG("Read %llu write_bytes\n",fs->write_cntr->value);
+		}
+		if ( find_lustre_value( buffer, "read_bytes", 4,
+					&fs->read_cntr->value ) == PAPI_OK ) {
+		  SUBDBG("Read %llu read_bytes\n",fs->read_cntr->value);
+		}
 	  }
 
-	  fff=fopen(fs->proc_file_readahead,"r");
-	  if (fff != NULL) {
-		  while(1) {
-			if (fgets(buffer,BUFSIZ,fff)==NULL) break;
-	
-			if (strstr( buffer, "read but discarded")) {
-			   sscanf(buffer,"%*s %*s %*s %llu",&fs->readahead_cntr->value);
-			   SUBDBG("Read %llu discared\n",fs->readahead_cntr->value);
-			   break;
-			}
-	  	  }
-		  fclose(fff);
+	  if ( _linux_sysfile_read( fs->proc_fd_readahead, buffer,
+				   sizeof ( buffer ) ) > 0 ) {
+		if ( find_lustre_value( buffer, "read but discarded", 1,
+					&fs->readahead_cntr->value ) == PAPI_OK ) {
+		  SUBDBG("Read %llu discared\n",fs->readahead_cntr->value);
+		}
 	  }
-	  fs = fs->next;
 	}
 }
 
@@ -419,6 +477,10 @@ host_finalize( void )
 
 	while ( fs != NULL ) {
 		next_fs = fs->next;
+		if ( fs->proc_fd >= 0 )
+			close( fs->proc_fd );
+		if ( fs->proc_fd_readahead >= 0 )
+			close( fs->proc_fd_readahead );
    	free(fs->read_cntr);
    	free(fs->write_cntr);
       free(fs->proc_file_readahead);                         // strdup.
@@ -513,6 +575,8 @@ _lustre_init_control_state( hwd_control_state_t *ctl )
 
     memset(lustre_ctl->start_count,0,sizeof(long long)*LUSTRE_MAX_COUNTERS);
     memset(lustre_ctl->current_count,0,sizeof(long long)*LUSTRE_MAX_COUNTERS);
+    lustre_ctl->num_events=0;
+    lustre_ctl->num_fs=0;
 
     return PAPI_OK;
 }
@@ -530,12 +594,28 @@ _lustre_update_control_state( hwd_control_state_t *ctl,
    SUBDBG("ENTER: ctl: %p, native: %p, count: %d, ctx: %p\n", ctl, native, count, ctx);
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
     ( void ) ctx;
-    int i, index;
+    lustre_fs *fs;
+    int i, j, index;
 
+    lustre_ctl->num_fs=0;
     for ( i = 0; i < count; i++ ) {
        index = native[i].ni_event;
        lustre_ctl->which_counter[i]=index;
        native[i].ni_position = i;
+
+       /* each fs is read once per update, however many of its */
+       /* counters are in the EventSet                         */
+       fs = lustre_native_table[index]->fs;
+       for ( j = 0; j < lustre_ctl->num_fs; j++ ) {
+          if ( lustre_ctl->which_fs[j] == fs ) break;
+       }
+       if ( j == lustre_ctl->num_fs ) {
+          if ( open_lustre_fs( fs ) != PAPI_OK ) {
+             SUBDBG("EXIT: PAPI_ESYS\n");
+             return PAPI_ESYS;
+          }
+          lustre_ctl->which_fs[lustre_ctl->num_fs++] = fs;
+       }
     }
 
     lustre_ctl->num_events=count;
@@ -555,7 +635,7 @@ _lustre_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
     int i;
 
-    read_lustre_counter(  );
+    read_lustre_counter( lustre_ctl );
 
     for(i=0;i<lustre_ctl->num_events;i++) {
        lustre_ctl->current_count[i]=
@@ -581,7 +661,7 @@ _lustre_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
     int i;
 
-    read_lustre_counter(  );
+    read_lustre_counter( lustre_ctl );
 
     for(i=0;i<lustre_ctl->num_events;i++) {
        lustre_ctl->current_count[i]=
@@ -607,7 +687,7 @@ _lustre_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
     LUSTRE_control_state_t *lustre_ctl = (LUSTRE_control_state_t *)ctl;
     int i;
 
-    read_lustre_counter(  );
+    read_lustre_counter( lustre_ctl );
 
     for(i=0;i<lustre_ctl->num_events;i++) {
        lustre_ctl->current_count[i]=
@@ -28,6 +28,7 @@
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "linux-common.h"
 
 #include "linux-net.h"
 
@@ -38,10 +39,17 @@ papi_vector_t _net_vector;
  * Private
  ********************************************************************/
 
-/* Network stats refresh latency in usec (default: 1 sec) */
+/* Default network stats refresh latency in usec (1 sec); */
+/* an EventSet can change it with PAPI_REFRESH_NS          */
 #define NET_REFRESH_LATENCY   1000000
 
 #define NET_PROC_FILE          "/proc/net/dev"
+#define NET_SYSFS_DIR          "/sys/class/net"
+
+/* Where an event is read from */
+#define NET_SOURCE_UNKNOWN     0    /* not used yet */
+#define NET_SOURCE_SYSFS       1    /* /sys/class/net/<if>/statistics */
+#define NET_SOURCE_PROC        2    /* /proc/net/dev */
 
 /* /proc/net/dev line size
  * interface name + 8 RX counters + 8 TX counters + separators
@@ -56,13 +64,15 @@ static NET_native_event_entry_t * _net_native_events=NULL;
 static int num_events       = 0;
 static int is_initialized   = 0;
 
-static long long _net_register_start[NET_MAX_COUNTERS];
-static long long _net_register_current[NET_MAX_COUNTERS];
+/* /proc/net/dev, kept open for the events sysfs cannot serve */
+static int proc_fd          = -1;
 
 /* temporary event */
 struct temp_event {
     char name[PAPI_MAX_STR_LEN];
     char description[PAPI_MAX_STR_LEN];
+    char ifname[IFNAMSIZ];
+    int counter;
     struct temp_event *next;
 };
 static struct temp_event* root = NULL;
@@ -70,28 +80,33 @@ static struct temp_event* root = NULL;
 /* /proc/net/dev: network counters by interface */
 #define NET_INTERFACE_COUNTERS 16
 
+/* The sysfs statistics that the kernel adds up for each /proc/net/dev */
+/* column (see dev_seq_printf_stats() in net/core/net-procfs.c)       */
 static const struct net_counters {
     char *name;
     char *description;
+    char *sysfs[NET_SYSFS_MAX_FILES];
 } _net_counter_info[NET_INTERFACE_COUNTERS] = {
     /* Receive */
-    { "rx:bytes",      "receive bytes"},
-    { "rx:packets",    "receive packets"},
-    { "rx:errors",     "receive errors"},
-    { "rx:dropped",    "receive dropped"},
-    { "rx:fifo",       "receive fifo"},
-    { "rx:frame",      "receive frame"},
-    { "rx:compressed", "receive compressed"},
-    { "rx:multicast",  "receive multicast"},
+    { "rx:bytes",      "receive bytes",      { "rx_bytes" } },
+    { "rx:packets",    "receive packets",    { "rx_packets" } },
+    { "rx:errors",     "receive errors",     { "rx_errors" } },
+    { "rx:dropped",    "receive dropped",    { "rx_dropped", "rx_missed_errors" } },
+    { "rx:fifo",       "receive fifo",       { "rx_fifo_errors" } },
+    { "rx:frame",      "receive frame",      { "rx_length_errors", "rx_over_errors",
+                                               "rx_crc_errors", "rx_frame_errors" } },
+    { "rx:compressed", "receive compressed", { "rx_compressed" } },
+    { "rx:multicast",  "receive multicast",  { "multicast" } },
     /* Transmit */
-    { "tx:bytes",      "transmit bytes"},
-    { "tx:packets",    "transmit packets"},
-    { "tx:errors",     "transmit errors"},
-    { "tx:dropped",    "transmit dropped"},
-    { "tx:fifo",       "transmit fifo"},
-    { "tx:colls",      "transmit colls"},
-    { "tx:carrier",    "transmit carrier"},
-    { "tx:compressed", "transmit compressed"},
+    { "tx:bytes",      "transmit bytes",     { "tx_bytes" } },
+    { "tx:packets",    "transmit packets",   { "tx_packets" } },
+    { "tx:errors",     "transmit errors",    { "tx_errors" } },
+    { "tx:dropped",    "transmit dropped",   { "tx_dropped" } },
+    { "tx:fifo",       "transmit fifo",      { "tx_fifo_errors" } },
+    { "tx:colls",      "transmit colls",     { "collisions" } },
+    { "tx:carrier",    "transmit carrier",   { "tx_carrier_errors", "tx_aborted_errors",
+                                               "tx_window_errors", "tx_heartbeat_errors" } },
+    { "tx:compressed", "transmit compressed", { "tx_compressed" } },
 };
 
 
@@ -170,6 +185,8 @@ generateNetEventList( void )
                     ifname, _net_counter_info[j].name);
             snprintf(temp->description, PAPI_MAX_STR_LEN, "%s %s",
                     ifname, _net_counter_info[j].description);
+            snprintf(temp->ifname, IFNAMSIZ, "%.*s", IFNAMSIZ - 1, ifname);
+            temp->counter = j;
 
             count++;
         }
@@ -181,97 +198,160 @@ generateNetEventList( void )
 }
 
 
+/*
+ * Decide where an event is read from, opening its sysfs files once
+ */
 static int
-getInterfaceBaseIndex(const char *ifname)
+open_net_event( int index )
 {
-    int i;
-
-    for ( i=0; i<num_events; i+=NET_INTERFACE_COUNTERS ) {
-        if (strncmp(_net_native_events[i].name, ifname, strlen(ifname)) == 0) {
-            return i;
+    NET_native_event_entry_t *event = &_net_native_events[index];
+    const struct net_counters *info = &_net_counter_info[event->counter];
+    char path[PATH_MAX];
+    int k, source = NET_SOURCE_SYSFS;
+
+    _papi_hwi_lock( COMPONENT_LOCK );
+
+    if ( event->source == NET_SOURCE_UNKNOWN ) {
+        for ( k = 0; k < NET_SYSFS_MAX_FILES && info->sysfs[k]; k++ ) {
+            snprintf( path, sizeof ( path ), NET_SYSFS_DIR "/%s/statistics/%s",
+                      event->ifname, info->sysfs[k] );
+            event->fd[k] = _linux_sysfile_open( path );
+            if ( event->fd[k] < 0 ) {
+                SUBDBG( "Can't open %s, using %s\n", path, NET_PROC_FILE );
+                source = NET_SOURCE_PROC;
+                break;
+            }
         }
+        if ( source == NET_SOURCE_PROC ) {
+            while ( --k >= 0 ) {
+                close( event->fd[k] );
+                event->fd[k] = -1;
+            }
+        }
+        event->source = source;
+    }
+
+    _papi_hwi_unlock( COMPONENT_LOCK );
+
+    if ( event->source == NET_SOURCE_PROC && proc_fd < 0 ) {
+        return PAPI_ESYS;
     }
 
-    return -1;  /* Not found */
+    return PAPI_OK;
 }
 
 
+/*
+ * Read the counters of the interfaces in /proc/net/dev that the
+ * EventSet measures, in a single pass over the file
+ */
 static int
-read_net_counters( long long *values )
+read_net_proc( NET_control_state_t *net_ctl, long long *values )
 {
-    FILE *fin;
-    char line[NET_PROC_MAX_LINE];
-    char *retval, *ifname, *data;
-    int i, nf, if_bidx;
-
-    fin = fopen(NET_PROC_FILE, "r");
-    if (fin == NULL) {
-        SUBDBG("Can't find %s, are you sure the /proc file-system is mounted?\n",
-           NET_PROC_FILE);
-        return NET_INVALID_RESULT;
+    NET_native_event_entry_t *event;
+    long long data[NET_INTERFACE_COUNTERS];
+    char *line, *next, *colon, *ifname, *p;
+    int i, j, len;
+
+    /* grow the buffer until the whole file fits */
+    while ( 1 ) {
+        len = _linux_sysfile_read( proc_fd, net_ctl->proc_buffer,
+                                   net_ctl->proc_buffer_size );
+        if ( len < 0 ) {
+            return PAPI_ESYS;
+        }
+        if ( len < net_ctl->proc_buffer_size - 1 ) {
+            break;
+        }
+        p = papi_realloc( net_ctl->proc_buffer, net_ctl->proc_buffer_size * 2 );
+        if ( p == NULL ) {
+            return PAPI_ENOMEM;
+        }
+        net_ctl->proc_buffer = p;
+        net_ctl->proc_buffer_size *= 2;
     }
 
     /* skip the 2 header lines */
-    for (i=0; i<2; i++) {
-        retval = fgets (line, NET_PROC_MAX_LINE, fin);
-        if (retval == NULL) {
-            SUBDBG("Not enough lines in %s\n", NET_PROC_FILE);
-			fclose(fin);
-            return 0;
-        }
+    line = net_ctl->proc_buffer;
+    for ( i = 0; i < 2 && line; i++ ) {
+        line = strchr( line, '\n' );
+        if ( line ) line++;
     }
 
-    while ((fgets (line, NET_PROC_MAX_LINE, fin)) == line) {
+    for ( ; line && *line; line = next ) {
+        next = strchr( line, '\n' );
+        if ( next ) next++;
 
         /* split the interface name from its 16 counters */
-        retval = strstr(line, ":");
-        if (retval == NULL) {
-            SUBDBG("Wrong line format <%s>\n", line);
+        colon = strchr( line, ':' );
+        if ( colon == NULL || ( next && colon > next ) ) {
+            SUBDBG("Wrong line format in %s\n", NET_PROC_FILE);
             continue;
         }
-
-        *retval = '\0';
-        data = retval + 1;
         ifname = line;
-        while (isspace(*ifname)) { ifname++; }
+        while ( isspace( *ifname ) ) { ifname++; }
+        len = colon - ifname;
+        if ( len >= IFNAMSIZ ) {
+            continue;
+        }
 
-        if_bidx = getInterfaceBaseIndex(ifname);
-        if (if_bidx < 0) {
-            SUBDBG("Interface <%s> not found\n", ifname);
-        } else {
-            nf = sscanf( data,
-                "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld\n",
-                &values[if_bidx + 0],  &values[if_bidx + 1],
-                &values[if_bidx + 2],  &values[if_bidx + 3],
-                &values[if_bidx + 4],  &values[if_bidx + 5],
-                &values[if_bidx + 6],  &values[if_bidx + 7],
-                &values[if_bidx + 8],  &values[if_bidx + 9],
-                &values[if_bidx + 10], &values[if_bidx + 11],
-                &values[if_bidx + 12], &values[if_bidx + 13],
-                &values[if_bidx + 14], &values[if_bidx + 15]);
-
-            SUBDBG("\nRead "
-                "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld\n",
-                values[if_bidx + 0],  values[if_bidx + 1],
-                values[if_bidx + 2],  values[if_bidx + 3],
-                values[if_bidx + 4],  values[if_bidx + 5],
-                values[if_bidx + 6],  values[if_bidx + 7],
-                values[if_bidx + 8],  values[if_bidx + 9],
-                values[if_bidx + 10], values[if_bidx + 11],
-                values[if_bidx + 12], values[if_bidx + 13],
-                values[if_bidx + 14], values[if_bidx + 15]);
-
-            if ( nf != NET_INTERFACE_COUNTERS ) {
-                /* This shouldn't happen */
-                SUBDBG("/proc line with wrong number of fields\n");
+        p = colon + 1;
+        j = -1;
+        for ( i = 0; i < net_ctl->num_events; i++ ) {
+            event = &_net_native_events[net_ctl->which_counter[i]];
+            if ( event->source != NET_SOURCE_PROC ||
+                 strncmp( event->ifname, ifname, len ) != 0 ||
+                 event->ifname[len] != '\0' ) {
+                continue;
+            }
+            /* parse the line the first time one of its counters is used */
+            for ( ; j < NET_INTERFACE_COUNTERS - 1; j++ ) {
+                p = _linux_sysfile_ll( p, &data[j + 1] );
+                if ( p == NULL ) {
+                    SUBDBG("/proc line with wrong number of fields\n");
+                    return PAPI_ESYS;
+                }
             }
+            values[i] = data[event->counter];
         }
+    }
+
+    return PAPI_OK;
+}
+
 
+/*
+ * Read the current value of every event in an EventSet
+ */
+static int
+read_net_counters( NET_control_state_t *net_ctl, long long *values )
+{
+    NET_native_event_entry_t *event;
+    char buf[PAPI_MIN_STR_LEN];
+    long long value;
+    int i, k;
+
+    for ( i = 0; i < net_ctl->num_events; i++ ) {
+        event = &_net_native_events[net_ctl->which_counter[i]];
+        if ( event->source != NET_SOURCE_SYSFS ) {
+            continue;
+        }
+        values[i] = 0;
+        for ( k = 0; k < NET_SYSFS_MAX_FILES && event->fd[k] >= 0; k++ ) {
+            if ( _linux_sysfile_read( event->fd[k], buf, sizeof ( buf ) ) < 0 ||
+                 _linux_sysfile_ll( buf, &value ) == NULL ) {
+                /* interface went away */
+                value = 0;
+            }
+            values[i] += value;
+        }
     }
 
-    fclose(fin);
+    if ( net_ctl->use_proc ) {
+        return read_net_proc( net_ctl, values );
+    }
 
-    return 0;
+    return PAPI_OK;
 }
 
 
@@ -301,14 +381,11 @@ _net_init_component( int cidx  )
     int i = 0;
     struct temp_event *t, *last;
 
+    int k;
+
     if ( is_initialized )
         return PAPI_OK;
 
-    memset(_net_register_start, 0,
-    		NET_MAX_COUNTERS*sizeof(_net_register_start[0]));
-    memset(_net_register_current, 0, 
-    		NET_MAX_COUNTERS*sizeof(_net_register_current[0]));
-
     is_initialized = 1;
 
     /* The network interfaces are listed in /proc/net/dev */
@@ -328,6 +405,12 @@ _net_init_component( int cidx  )
         _net_native_events[i].name[PAPI_MAX_STR_LEN-1] = '\0';
         strncpy(_net_native_events[i].description, t->description, PAPI_MAX_STR_LEN-1);
         _net_native_events[i].description[PAPI_MAX_STR_LEN-1] = '\0';
+        strcpy(_net_native_events[i].ifname, t->ifname);
+        _net_native_events[i].counter = t->counter;
+        _net_native_events[i].source = NET_SOURCE_UNKNOWN;
+        for (k=0; k<NET_SYSFS_MAX_FILES; k++) {
+            _net_native_events[i].fd[k] = -1;
+        }
         _net_native_events[i].resources.selector = i + 1;
         last    = t;
         t       = t->next;
@@ -336,6 +419,9 @@ _net_init_component( int cidx  )
     } while (t != NULL);
     root = NULL;
 
+    /* Interfaces sysfs cannot serve are read from here */
+    proc_fd = _linux_sysfile_open(NET_PROC_FILE);
+
     /* Export the total number of events available */
     _net_vector.cmp_info.num_native_events = num_events;
 
@@ -353,7 +439,13 @@ _net_init_component( int cidx  )
 static int
 _net_init_control_state( hwd_control_state_t *ctl )
 {
-    ( void ) ctl;
+    NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
+
+    net_ctl->num_events = 0;
+    net_ctl->use_proc = 0;
+    net_ctl->proc_buffer = NULL;
+    net_ctl->proc_buffer_size = 0;
+    net_ctl->refresh = NET_REFRESH_LATENCY;
 
     return PAPI_OK;
 }
@@ -366,13 +458,17 @@ _net_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 
     NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
     long long now = PAPI_get_real_usec();
+    int retval;
 
-    read_net_counters(_net_register_start);
-    memcpy(_net_register_current, _net_register_start,
-            NET_MAX_COUNTERS * sizeof(_net_register_start[0]));
+    retval = read_net_counters(net_ctl, net_ctl->start);
+    if ( retval != PAPI_OK ) {
+        return retval;
+    }
+    memcpy(net_ctl->current, net_ctl->start,
+            net_ctl->num_events * sizeof(net_ctl->start[0]));
 
     /* set initial values to 0 */
-    memset(net_ctl->values, 0, NET_MAX_COUNTERS*sizeof(net_ctl->values[0]));
+    memset(net_ctl->values, 0, net_ctl->num_events*sizeof(net_ctl->values[0]));
     
     /* Set last access time for caching purposes */
     net_ctl->lastupdate = now;
@@ -393,13 +489,13 @@ _net_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
     int i;
 
     /* Caching
-     * Only read new values from /proc if enough time has passed
+     * Only read new values from the kernel if enough time has passed
      * since the last read.
      */
-    if ( now - net_ctl->lastupdate > NET_REFRESH_LATENCY ) {
-        read_net_counters(_net_register_current);
-        for ( i=0; i<NET_MAX_COUNTERS; i++ ) {
-            net_ctl->values[i] = _net_register_current[i] - _net_register_start[i];
+    if ( now - net_ctl->lastupdate > net_ctl->refresh ) {
+        read_net_counters(net_ctl, net_ctl->current);
+        for ( i=0; i<net_ctl->num_events; i++ ) {
+            net_ctl->values[i] = net_ctl->current[i] - net_ctl->start[i];
         }
         net_ctl->lastupdate = now;
     }
@@ -418,9 +514,9 @@ _net_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
     long long now = PAPI_get_real_usec();
     int i;
 
-    read_net_counters(_net_register_current);
-    for ( i=0; i<NET_MAX_COUNTERS; i++ ) {
-        net_ctl->values[i] = _net_register_current[i] - _net_register_start[i];
+    read_net_counters(net_ctl, net_ctl->current);
+    for ( i=0; i<net_ctl->num_events; i++ ) {
+        net_ctl->values[i] = net_ctl->current[i] - net_ctl->start[i];
     }
     net_ctl->lastupdate = now;
 
@@ -446,14 +542,26 @@ _net_shutdown_thread( hwd_context_t *ctx )
 static int
 _net_shutdown_component( void )
 {
+    int i, k;
+
     if ( is_initialized )
     {
       is_initialized = 0;
       if (_net_native_events != NULL)
       {
+         for (i=0; i<num_events; i++) {
+            for (k=0; k<NET_SYSFS_MAX_FILES; k++) {
+               if (_net_native_events[i].fd[k] >= 0)
+                  close(_net_native_events[i].fd[k]);
+            }
+         }
          papi_free(_net_native_events);
          _net_native_events = NULL;
       }
+      if (proc_fd >= 0) {
+         close(proc_fd);
+         proc_fd = -1;
+      }
     }
 
     return PAPI_OK;
@@ -469,8 +577,17 @@ static int
 _net_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 {
     ( void ) ctx;
-    ( void ) code;
-    ( void ) option;
+
+    NET_control_state_t *net_ctl;
+
+    if ( code == PAPI_REFRESH_NS ) {
+        net_ctl = (NET_control_state_t *) option->refresh.ESI->ctl_state;
+        if ( option->refresh.ns == 0 ) {
+            net_ctl->refresh = NET_REFRESH_LATENCY;
+        } else {
+            net_ctl->refresh = option->refresh.ns / 1000;
+        }
+    }
 
     return PAPI_OK;
 }
@@ -481,13 +598,38 @@ _net_update_control_state( hwd_control_state_t *ctl,
         NativeInfo_t *native, int count, hwd_context_t *ctx )
 {
     ( void ) ctx;
-    ( void ) ctl;
 
-    int i, index;
+    NET_control_state_t *net_ctl = (NET_control_state_t *) ctl;
+    int i, index, retval;
 
+    net_ctl->use_proc = 0;
     for ( i = 0; i < count; i++ ) {
         index = native[i].ni_event;
-        native[i].ni_position = _net_native_events[index].resources.selector - 1;
+        retval = open_net_event( index );
+        if ( retval != PAPI_OK ) {
+            return retval;
+        }
+        if ( _net_native_events[index].source == NET_SOURCE_PROC ) {
+            net_ctl->use_proc = 1;
+        }
+        net_ctl->which_counter[i] = index;
+        native[i].ni_position = i;
+    }
+    net_ctl->num_events = count;
+
+    if ( net_ctl->use_proc && net_ctl->proc_buffer == NULL ) {
+        net_ctl->proc_buffer_size = NET_PROC_MAX_LINE * 4;
+        net_ctl->proc_buffer = papi_malloc( net_ctl->proc_buffer_size );
+        if ( net_ctl->proc_buffer == NULL ) {
+            return PAPI_ENOMEM;
+        }
+    }
+
+    /* calling with a count of 0 is a cleanup */
+    if ( count == 0 && net_ctl->proc_buffer != NULL ) {
+        papi_free( net_ctl->proc_buffer );
+        net_ctl->proc_buffer = NULL;
+        net_ctl->proc_buffer_size = 0;
     }
 
     return PAPI_OK;
@@ -656,6 +798,7 @@ papi_vector_t _net_vector = {
         .fast_virtual_timer    = 0,
         .attach                = 0,
         .attach_must_ptrace    = 0,
+        .refresh               = 1,
     },
 
     /* sizes of framework-opaque component-private structures */
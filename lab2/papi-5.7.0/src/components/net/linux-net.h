@@ -26,13 +26,17 @@
 #define _PAPI_NET_H
 
 #include <unistd.h>
+#include <net/if.h>
 
 /*************************  DEFINES SECTION  ***********************************
  *******************************************************************************/
 /* this number assumes that there will never be more events than indicated
- * 20 INTERFACES * 16 COUNTERS = 320 */
+ * in one EventSet: 20 INTERFACES * 16 COUNTERS = 320 */
 #define NET_MAX_COUNTERS 320
 
+/* most sysfs statistics files summed into one /proc/net/dev counter */
+#define NET_SYSFS_MAX_FILES 4
+
 /** Structure that stores private information of each event */
 typedef struct NET_register
 {
@@ -54,6 +58,10 @@ typedef struct NET_native_event_entry
     NET_register_t resources;
     char name[PAPI_MAX_STR_LEN];
     char description[PAPI_MAX_STR_LEN];
+    char ifname[IFNAMSIZ];
+    int counter;                    /* which of the interface's counters */
+    int source;                     /* NET_SOURCE_*, decided on first use */
+    int fd[NET_SYSFS_MAX_FILES];    /* open sysfs statistics files */
 } NET_native_event_entry_t;
 
 
@@ -66,6 +74,14 @@ typedef struct NET_reg_alloc
 typedef struct NET_control_state
 {
     long long values[NET_MAX_COUNTERS]; // used for caching
+    long long start[NET_MAX_COUNTERS];
+    long long current[NET_MAX_COUNTERS];
+    int which_counter[NET_MAX_COUNTERS];
+    int num_events;
+    int use_proc;                       // some events come from /proc/net/dev
+    char *proc_buffer;
+    int proc_buffer_size;
+    long long refresh;                  // usec between kernel reads
     long long lastupdate;
 } NET_control_state_t;
 
@@ -0,0 +1,166 @@
+/****************************/
+/* THIS IS OPEN SOURCE CODE */
+/****************************/
+
+/**
+ * test case for the linux-net component
+ *
+ * @brief
+ *   Sets PAPI_REFRESH_NS on an EventSet of loopback events and checks
+ *   that packets sent while it runs show up in the next PAPI_read
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define IFNAME     "lo"
+#define NUM_EVENTS 2
+#define NUM_PACKETS 100
+
+/* Send packets to ourselves over the loopback interface */
+static int
+send_packets( int count )
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof ( addr );
+    char buf[64];
+    int rx, tx, i;
+
+    rx = socket( AF_INET, SOCK_DGRAM, 0 );
+    tx = socket( AF_INET, SOCK_DGRAM, 0 );
+    if ( rx < 0 || tx < 0 ) {
+        return -1;
+    }
+
+    memset( &addr, 0, sizeof ( addr ) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr( "127.0.0.1" );
+    addr.sin_port = 0;
+    if ( bind( rx, ( struct sockaddr * ) &addr, sizeof ( addr ) ) < 0 ||
+         getsockname( rx, ( struct sockaddr * ) &addr, &len ) < 0 ) {
+        close( rx );
+        close( tx );
+        return -1;
+    }
+
+    memset( buf, 0, sizeof ( buf ) );
+    for ( i = 0; i < count; i++ ) {
+        sendto( tx, buf, sizeof ( buf ), 0, ( struct sockaddr * ) &addr,
+                sizeof ( addr ) );
+        recv( rx, buf, sizeof ( buf ), 0 );
+    }
+
+    close( rx );
+    close( tx );
+    return 0;
+}
+
+int main (int argc, char **argv)
+{
+    int i, retval;
+    int EventSet = PAPI_NULL;
+    char *event_name[NUM_EVENTS] = {
+        IFNAME ":tx:packets",
+        IFNAME ":rx:packets",
+    };
+    long long values[NUM_EVENTS];
+    PAPI_option_t opt;
+
+    /* Set TESTS_QUIET variable */
+    tests_quiet( argc, argv );
+
+    /* PAPI Initialization */
+    retval = PAPI_library_init( PAPI_VER_CURRENT );
+    if ( retval != PAPI_VER_CURRENT ) {
+        test_fail(__FILE__, __LINE__,"PAPI_library_init failed\n",retval);
+    }
+
+    retval = PAPI_create_eventset( &EventSet );
+    if (retval != PAPI_OK) {
+        test_fail(__FILE__, __LINE__, "PAPI_create_eventset()", retval);
+    }
+
+    for ( i=0; i<NUM_EVENTS; i++ ) {
+        retval = PAPI_add_named_event( EventSet, event_name[i] );
+        if ( retval != PAPI_OK ) {
+            test_skip( __FILE__, __LINE__, "No loopback interface", retval );
+        }
+    }
+
+    /* A fresh EventSet uses the component default */
+    memset( &opt, 0, sizeof ( opt ) );
+    opt.refresh.eventset = EventSet;
+    retval = PAPI_get_opt( PAPI_REFRESH_NS, &opt );
+    if ( retval != PAPI_OK || opt.refresh.ns != 0 ) {
+        test_fail(__FILE__, __LINE__, "PAPI_get_opt(PAPI_REFRESH_NS)", retval);
+    }
+
+    /* Go to the kernel on every read */
+    opt.refresh.ns = 1;
+    retval = PAPI_set_opt( PAPI_REFRESH_NS, &opt );
+    if ( retval != PAPI_OK ) {
+        test_fail(__FILE__, __LINE__, "PAPI_set_opt(PAPI_REFRESH_NS)", retval);
+    }
+    opt.refresh.ns = 0;
+    retval = PAPI_get_opt( PAPI_REFRESH_NS, &opt );
+    if ( retval != PAPI_OK || opt.refresh.ns != 1 ) {
+        test_fail(__FILE__, __LINE__, "PAPI_get_opt(PAPI_REFRESH_NS)", retval);
+    }
+
+    retval = PAPI_start( EventSet );
+    if (retval != PAPI_OK) {
+        test_fail(__FILE__, __LINE__, "PAPI_start()", retval);
+    }
+
+    if ( send_packets( NUM_PACKETS ) < 0 ) {
+        test_skip( __FILE__, __LINE__, "Cannot use the loopback interface", 0 );
+    }
+    usleep( 1000 );
+
+    retval = PAPI_read( EventSet, values );
+    if (retval != PAPI_OK) {
+        test_fail(__FILE__, __LINE__, "PAPI_read()", retval);
+    }
+
+    if (!TESTS_QUIET) {
+        printf("Net events read every time (%d packets sent)\n", NUM_PACKETS);
+        for ( i=0; i<NUM_EVENTS; i++ ) {
+            printf("%-16s : %lld\n", event_name[i], values[i]);
+        }
+    }
+
+    for ( i=0; i<NUM_EVENTS; i++ ) {
+        if ( values[i] < NUM_PACKETS ) {
+            test_fail(__FILE__, __LINE__, "Packets missing from PAPI_read", i);
+        }
+    }
+
+    retval = PAPI_stop( EventSet, values );
+    if (retval != PAPI_OK) {
+        test_fail(__FILE__, __LINE__, "PAPI_stop()", retval);
+    }
+
+    retval = PAPI_cleanup_eventset( EventSet );
+    if (retval != PAPI_OK) {
+        test_fail(__FILE__, __LINE__, "PAPI_cleanup_eventset()", retval);
+    }
+
+    retval = PAPI_destroy_eventset( &EventSet );
+    if (retval != PAPI_OK) {
+        test_fail(__FILE__, __LINE__, "PAPI_destroy_eventset()", retval);
+    }
+
+    test_pass( __FILE__ );
+
+    return 0;
+}
+
+/* vim:set ts=4 sw=4 sts=4 et: */
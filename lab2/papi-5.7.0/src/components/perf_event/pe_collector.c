@@ -0,0 +1,290 @@
+/*
+* File:    pe_collector.c
+*
+* One thread per process that sleeps in poll() on the sampling fds of
+* every running EventSet in collector mode.  The kernel wakes it once
+* per wakeup_events samples, it empties the rings through
+* _pe_collector_drain(), and the measured threads never take a signal.
+*
+* The same thread takes the time series snapshots and exports counts
+* to shared memory: each EventSet doing so adds a timerfd to the poll
+* set, and every expiry is turned into one _pe_timeseries_sample() or
+* _pe_export_sample().
+*/
+
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "papi.h"
+#include "papi_memory.h"
+#include "papi_internal.h"
+
+#include PEINCLUDE
+#include "perf_event_lib.h"
+#include "pe_collector.h"
+
+static pthread_mutex_t collector_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t collector_thread;
+static int collector_running = 0;
+static int collector_wake[2] = { -1, -1 };
+
+/* EventSets being collected; changes bump collector_gen */
+static pe_control_t **collector_ctls = NULL;
+static int collector_num = 0;
+static int collector_max = 0;
+static unsigned int collector_gen = 0;
+
+/* Interrupt the collector's poll() so it notices a registry change */
+static void
+collector_kick( void )
+{
+	char c = 0;
+
+	if ( write( collector_wake[1], &c, 1 ) < 0 && errno != EAGAIN ) {
+		SUBDBG( "collector wakeup failed: %s\n", strerror( errno ) );
+	}
+}
+
+/* Rebuild the poll set.  Slot 0 is always the wakeup pipe. */
+static int
+collector_build_fds( struct pollfd **fds, int *max )
+{
+	int i, j, n = 1;
+
+	for ( i = 0; i < collector_num; i++ ) {
+		n += collector_ctls[i]->num_events + 2;
+	}
+	if ( n > *max ) {
+		struct pollfd *grown = papi_realloc( *fds, n * sizeof ( **fds ) );
+		if ( grown == NULL ) {
+			return -1;
+		}
+		*fds = grown;
+		*max = n;
+	}
+
+	( *fds )[0].fd = collector_wake[0];
+	( *fds )[0].events = POLLIN;
+	n = 1;
+	for ( i = 0; i < collector_num; i++ ) {
+		for ( j = 0; j < collector_ctls[i]->num_events; j++ ) {
+			if ( collector_ctls[i]->events[j].streaming ) {
+				( *fds )[n].fd = collector_ctls[i]->events[j].event_fd;
+				( *fds )[n].events = POLLIN;
+				n++;
+			}
+		}
+		if ( collector_ctls[i]->ts_fd >= 0 ) {
+			( *fds )[n].fd = collector_ctls[i]->ts_fd;
+			( *fds )[n].events = POLLIN;
+			n++;
+		}
+		if ( collector_ctls[i]->export_fd >= 0 ) {
+			( *fds )[n].fd = collector_ctls[i]->export_fd;
+			( *fds )[n].events = POLLIN;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static void *
+collector_main( void *arg )
+{
+	struct pollfd *fds = NULL;
+	unsigned int gen = collector_gen - 1;
+	int i, ret, nfds = 1, max = 0;
+	char buf[64];
+	uint64_t expired;
+
+	( void ) arg;
+
+	for ( ;; ) {
+		pthread_mutex_lock( &collector_lock );
+		if ( !collector_running ) {
+			pthread_mutex_unlock( &collector_lock );
+			break;
+		}
+		if ( gen != collector_gen ) {
+			ret = collector_build_fds( &fds, &max );
+			if ( ret > 0 ) {
+				nfds = ret;
+				gen = collector_gen;
+			}
+		}
+		pthread_mutex_unlock( &collector_lock );
+
+		ret = poll( fds, ( nfds_t ) nfds, -1 );
+		if ( ret < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			PAPIERROR( "collector poll() failed: %s", strerror( errno ) );
+			break;
+		}
+
+		if ( fds[0].revents & POLLIN ) {
+			while ( read( collector_wake[0], buf, sizeof ( buf ) ) > 0 );
+		}
+
+		/* A monitored thread that exited leaves a hung-up fd behind; */
+		/* stop polling it until the registry changes.                */
+		for ( i = 1; i < nfds; i++ ) {
+			if ( fds[i].revents & ( POLLHUP | POLLERR | POLLNVAL ) ) {
+				fds[i].fd = -1;
+			}
+		}
+
+		/* The kernel only flags readiness once per wakeup, so drain */
+		/* everything rather than trusting individual revents.       */
+		/* A timer that fired several times since we last looked  */
+		/* still yields one snapshot; its timestamp shows the gap. */
+		pthread_mutex_lock( &collector_lock );
+		for ( i = 0; i < collector_num; i++ ) {
+			pe_control_t *ctl = collector_ctls[i];
+
+			if ( ctl->collect ) {
+				_pe_collector_drain( ctl );
+			}
+			if ( ctl->ts_fd >= 0 &&
+			     read( ctl->ts_fd, &expired, sizeof ( expired ) ) ==
+			     sizeof ( expired ) ) {
+				_pe_timeseries_sample( ctl );
+			}
+			if ( ctl->export_fd >= 0 &&
+			     read( ctl->export_fd, &expired, sizeof ( expired ) ) ==
+			     sizeof ( expired ) ) {
+				_pe_export_sample( ctl );
+			}
+		}
+		pthread_mutex_unlock( &collector_lock );
+	}
+
+	papi_free( fds );
+
+	return NULL;
+}
+
+/* Start the collector on first use.  Called with collector_lock held. */
+static int
+collector_start( void )
+{
+	sigset_t all, old;
+	int ret;
+
+	if ( pipe( collector_wake ) < 0 ) {
+		return PAPI_ESYS;
+	}
+	for ( ret = 0; ret < 2; ret++ ) {
+		fcntl( collector_wake[ret], F_SETFL, O_NONBLOCK );
+		fcntl( collector_wake[ret], F_SETFD, FD_CLOEXEC );
+	}
+
+	/* Keep PAPI's overflow and multiplex signals away from the collector */
+	sigfillset( &all );
+	pthread_sigmask( SIG_SETMASK, &all, &old );
+	collector_running = 1;
+	ret = pthread_create( &collector_thread, NULL, collector_main, NULL );
+	pthread_sigmask( SIG_SETMASK, &old, NULL );
+
+	if ( ret != 0 ) {
+		collector_running = 0;
+		close( collector_wake[0] );
+		close( collector_wake[1] );
+		collector_wake[0] = collector_wake[1] = -1;
+		return PAPI_ESYS;
+	}
+
+	return PAPI_OK;
+}
+
+/* Hand a started control state to the collector */
+int
+_pe_collector_register( pe_control_t *ctl )
+{
+	pe_control_t **grown;
+	int ret = PAPI_OK;
+
+	pthread_mutex_lock( &collector_lock );
+
+	if ( !collector_running ) {
+		ret = collector_start(  );
+	}
+
+	if ( ret == PAPI_OK && collector_num == collector_max ) {
+		grown = papi_realloc( collector_ctls,
+				      ( collector_max + 16 ) * sizeof ( *grown ) );
+		if ( grown == NULL ) {
+			ret = PAPI_ENOMEM;
+		}
+		else {
+			collector_ctls = grown;
+			collector_max += 16;
+		}
+	}
+
+	if ( ret == PAPI_OK ) {
+		collector_ctls[collector_num++] = ctl;
+		collector_gen++;
+	}
+
+	pthread_mutex_unlock( &collector_lock );
+
+	if ( ret == PAPI_OK ) {
+		collector_kick(  );
+	}
+
+	return ret;
+}
+
+/* Take a control state back.  Once this returns the collector */
+/* will not touch ctl again.                                   */
+void
+_pe_collector_unregister( pe_control_t *ctl )
+{
+	int i;
+
+	pthread_mutex_lock( &collector_lock );
+	for ( i = 0; i < collector_num; i++ ) {
+		if ( collector_ctls[i] == ctl ) {
+			collector_ctls[i] = collector_ctls[--collector_num];
+			collector_gen++;
+			break;
+		}
+	}
+	pthread_mutex_unlock( &collector_lock );
+
+	if ( collector_running ) {
+		collector_kick(  );
+	}
+}
+
+void
+_pe_collector_shutdown( void )
+{
+	pthread_mutex_lock( &collector_lock );
+	if ( !collector_running ) {
+		pthread_mutex_unlock( &collector_lock );
+		return;
+	}
+	collector_running = 0;
+	pthread_mutex_unlock( &collector_lock );
+
+	collector_kick(  );
+	pthread_join( collector_thread, NULL );
+
+	close( collector_wake[0] );
+	close( collector_wake[1] );
+	collector_wake[0] = collector_wake[1] = -1;
+
+	papi_free( collector_ctls );
+	collector_ctls = NULL;
+	collector_num = collector_max = 0;
+}
@@ -0,0 +1,14 @@
+/*
+* File:    pe_collector.h
+*/
+
+/* Prototypes for the perf_event background sample collector */
+
+int _pe_collector_register( pe_control_t *ctl );
+void _pe_collector_unregister( pe_control_t *ctl );
+void _pe_collector_shutdown( void );
+
+/* Provided by perf_event.c, called with the collector lock held */
+void _pe_collector_drain( pe_control_t *ctl );
+void _pe_timeseries_sample( pe_control_t *ctl );
+void _pe_export_sample( pe_control_t *ctl );
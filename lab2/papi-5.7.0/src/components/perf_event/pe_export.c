@@ -0,0 +1,233 @@
+/*
+* File:    pe_export.c
+*
+* Publishes the counts of exported EventSets into one shared memory
+* segment per process, PAPI_EXPORT_PATH, one PAPI_export_slot_t per
+* EventSet.  Each slot is guarded by a sequence lock: its single writer
+* makes seq odd, fills the slot and makes seq even again, so readers
+* in other processes copy it without a system call or a lock.
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <sys/mman.h>
+
+#include "papi.h"
+#include "papi_memory.h"
+#include "papi_internal.h"
+
+#include "pe_export.h"
+
+#define EXPORT_SIZE ( sizeof ( PAPI_export_header_t ) + \
+		      PAPI_EXPORT_SLOTS * sizeof ( PAPI_export_slot_t ) )
+
+static pthread_mutex_t export_lock = PTHREAD_MUTEX_INITIALIZER;
+static PAPI_export_header_t *export_segment = NULL;
+static char export_path[PATH_MAX];
+static char export_used[PAPI_EXPORT_SLOTS];
+
+static inline PAPI_export_slot_t *
+export_slot( int i )
+{
+	return ( PAPI_export_slot_t * ) ( export_segment + 1 ) + i;
+}
+
+/* Whether slot lies in a segment this process created.  After a fork */
+/* the child still maps its parent's segment, and slots acquired     */
+/* before the fork point into it: the child must leave them alone.   */
+static inline int
+slot_ours( PAPI_export_slot_t *slot )
+{
+	PAPI_export_header_t *seg = export_segment;
+
+	return seg && seg->pid == ( int ) getpid(  ) &&
+		slot >= ( PAPI_export_slot_t * ) ( seg + 1 ) &&
+		slot < ( PAPI_export_slot_t * ) ( seg + 1 ) + PAPI_EXPORT_SLOTS;
+}
+
+static inline void
+slot_write_begin( PAPI_export_slot_t *slot )
+{
+	slot->seq++;
+	__sync_synchronize();
+}
+
+static inline void
+slot_write_end( PAPI_export_slot_t *slot )
+{
+	__sync_synchronize();
+	slot->seq++;
+}
+
+/* Create this process' segment.  Called with export_lock held. */
+static int
+export_create( void )
+{
+	PAPI_export_header_t *seg;
+	int fd;
+
+	snprintf( export_path, sizeof ( export_path ), PAPI_EXPORT_PATH,
+		  ( int ) getpid(  ) );
+
+	/* Anything already there was left by a dead process with our pid */
+	unlink( export_path );
+	fd = open( export_path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+	if ( fd < 0 ) {
+		PAPIERROR( "open(%s) failed: %s", export_path, strerror( errno ) );
+		return PAPI_ESYS;
+	}
+	if ( ftruncate( fd, EXPORT_SIZE ) < 0 ) {
+		PAPIERROR( "ftruncate(%s) failed: %s", export_path,
+			   strerror( errno ) );
+		close( fd );
+		unlink( export_path );
+		return PAPI_ESYS;
+	}
+	seg = mmap( NULL, EXPORT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( seg == MAP_FAILED ) {
+		PAPIERROR( "mmap(%s) failed: %s", export_path, strerror( errno ) );
+		unlink( export_path );
+		return PAPI_ESYS;
+	}
+
+	/* ftruncate zero-filled the slots, so they all start out free.  */
+	/* The magic goes in last: readers ignore a half-built header.   */
+	seg->version = PAPI_EXPORT_VERSION;
+	seg->slot_size = sizeof ( PAPI_export_slot_t );
+	seg->nslots = PAPI_EXPORT_SLOTS;
+	seg->pid = ( int ) getpid(  );
+	__sync_synchronize();
+	seg->magic = PAPI_EXPORT_MAGIC;
+
+	export_segment = seg;
+	memset( export_used, 0, sizeof ( export_used ) );
+	SUBDBG( "Exporting counts through %s\n", export_path );
+
+	return PAPI_OK;
+}
+
+/* Claim a slot for an EventSet, creating the segment on first use */
+int
+_pe_export_acquire( const char *label, int eventset,
+		    PAPI_export_slot_t **slot )
+{
+	int i, ret = PAPI_OK;
+
+	pthread_mutex_lock( &export_lock );
+
+	/* A forked child must not write into its parent's segment.  It   */
+	/* stays mapped, as slots acquired before the fork still point    */
+	/* into it and publish or release may be looking at them.         */
+	if ( export_segment && export_segment->pid != ( int ) getpid(  ) ) {
+		export_segment = NULL;
+	}
+	if ( export_segment == NULL ) {
+		ret = export_create(  );
+	}
+
+	if ( ret == PAPI_OK ) {
+		ret = PAPI_ENOMEM;
+		for ( i = 0; i < PAPI_EXPORT_SLOTS; i++ ) {
+			if ( !export_used[i] ) {
+				export_used[i] = 1;
+				*slot = export_slot( i );
+				slot_write_begin( *slot );
+				( *slot )->eventset = eventset;
+				( *slot )->num_events = 0;
+				( *slot )->tid = -1;
+				slot_write_end( *slot );
+				ret = PAPI_OK;
+				break;
+			}
+		}
+	}
+
+	pthread_mutex_unlock( &export_lock );
+
+	if ( ret == PAPI_OK ) {
+		_pe_export_label( *slot, label );
+	}
+
+	return ret;
+}
+
+/* Whether slot may still be written: not if it was acquired before a fork */
+int
+_pe_export_owned( PAPI_export_slot_t *slot )
+{
+	return slot_ours( slot );
+}
+
+void
+_pe_export_label( PAPI_export_slot_t *slot, const char *label )
+{
+	if ( !slot_ours( slot ) )
+		return;
+	slot_write_begin( slot );
+	strncpy( slot->label, label, sizeof ( slot->label ) - 1 );
+	slot->label[sizeof ( slot->label ) - 1] = '\0';
+	slot_write_end( slot );
+}
+
+/* Say which thread and events the slot is about to carry */
+void
+_pe_export_describe( PAPI_export_slot_t *slot, int tid, int *events,
+		     int num_events )
+{
+	if ( !slot_ours( slot ) )
+		return;
+	slot_write_begin( slot );
+	slot->tid = tid;
+	slot->num_events = num_events;
+	memcpy( slot->events, events, num_events * sizeof ( int ) );
+	memset( slot->values, 0, sizeof ( slot->values ) );
+	slot->time = 0;
+	slot_write_end( slot );
+}
+
+void
+_pe_export_publish( PAPI_export_slot_t *slot, long long time,
+		    long long *values )
+{
+	/* Counts read in a forked child are not the parent's to publish */
+	if ( !slot_ours( slot ) )
+		return;
+	slot_write_begin( slot );
+	slot->time = time;
+	memcpy( slot->values, values, slot->num_events * sizeof ( long long ) );
+	slot_write_end( slot );
+}
+
+void
+_pe_export_release( PAPI_export_slot_t *slot )
+{
+	pthread_mutex_lock( &export_lock );
+	/* Slots handed out before a fork belong to the parent's segment */
+	if ( slot_ours( slot ) ) {
+		slot_write_begin( slot );
+		slot->tid = 0;
+		slot->num_events = 0;
+		slot_write_end( slot );
+		export_used[slot - export_slot( 0 )] = 0;
+	}
+	pthread_mutex_unlock( &export_lock );
+}
+
+void
+_pe_export_shutdown( void )
+{
+	pthread_mutex_lock( &export_lock );
+	if ( export_segment && export_segment->pid == ( int ) getpid(  ) ) {
+		munmap( export_segment, EXPORT_SIZE );
+		/* Gone already if a reader unlinked it once it was mapped */
+		unlink( export_path );
+	}
+	export_segment = NULL;
+	pthread_mutex_unlock( &export_lock );
+}
@@ -0,0 +1,16 @@
+/*
+* File:    pe_export.h
+*/
+
+/* Prototypes for the perf_event shared memory counter export */
+
+int _pe_export_acquire( const char *label, int eventset,
+			PAPI_export_slot_t **slot );
+int _pe_export_owned( PAPI_export_slot_t *slot );
+void _pe_export_label( PAPI_export_slot_t *slot, const char *label );
+void _pe_export_describe( PAPI_export_slot_t *slot, int tid, int *events,
+			  int num_events );
+void _pe_export_publish( PAPI_export_slot_t *slot, long long time,
+			 long long *values );
+void _pe_export_release( PAPI_export_slot_t *slot );
+void _pe_export_shutdown( void );
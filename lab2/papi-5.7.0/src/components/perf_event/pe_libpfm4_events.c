@@ -31,6 +31,81 @@
 // used to step through the attributes when enumerating events
 static int attr_idx;
 
+/** @class  hash_event_name
+ *  @brief  FNV-1a hash of an event name, reduced to a name_hash bucket
+ */
+
+static unsigned int hash_event_name(const char *name) {
+  unsigned int h = 2166136261u;
+
+  while (*name) {
+    h ^= (unsigned char)*name++;
+    h *= 16777619u;
+  }
+  return h & (NATIVE_EVENT_HASH_SIZE-1);
+}
+
+/** @class  lookup_event_name
+ *  @brief  walk one hash chain looking for a key of the given form
+ *
+ *  Lock free: chain heads are published with release semantics after
+ *  the entry is fully built and entries are never unlinked until
+ *  shutdown.
+ */
+
+static int lookup_event_name(const char *name, int base_form,
+                             struct native_event_table_t *event_table) {
+  struct native_event_name_t *entry;
+
+  if (event_table->name_hash == NULL) {
+    return PAPI_ENOEVNT;
+  }
+
+  entry = __atomic_load_n(&event_table->name_hash[hash_event_name(name)],
+                          __ATOMIC_ACQUIRE);
+  while (entry != NULL) {
+    if ((entry->base_form == base_form) && !strcmp(name, entry->name)) {
+      return entry->event_idx;
+    }
+    entry = entry->next;
+  }
+  return PAPI_ENOEVNT;
+}
+
+/** @class  add_event_name
+ *  @brief  publish a lookup key for native event event_idx
+ *
+ *  Caller must hold NAMELIB_LOCK, which serializes writers.  The first
+ *  event registered under a key keeps it, like the old linear scan.
+ */
+
+static void add_event_name(const char *name, int base_form, int event_idx,
+                           struct native_event_table_t *event_table) {
+  struct native_event_name_t *entry;
+  unsigned int bucket;
+
+  if ((event_table->name_hash == NULL) ||
+      (lookup_event_name(name, base_form, event_table) >= 0)) {
+    return;
+  }
+
+  entry = malloc(sizeof(struct native_event_name_t));
+  if (entry == NULL) {
+    return;
+  }
+  entry->name = strdup(name);
+  if (entry->name == NULL) {
+    free(entry);
+    return;
+  }
+  entry->base_form = base_form;
+  entry->event_idx = event_idx;
+
+  bucket = hash_event_name(name);
+  entry->next = event_table->name_hash[bucket];
+  __atomic_store_n(&event_table->name_hash[bucket], entry, __ATOMIC_RELEASE);
+}
+
 /** @class  find_existing_event
  *  @brief  looks up an event, returns it if it exists
  *
@@ -47,34 +122,15 @@ static int find_existing_event(const char *name,
                                struct native_event_table_t *event_table) {
   SUBDBG("Entry: name: %s, event_table: %p, num_native_events: %d\n", name, event_table, event_table->num_native_events);
 
-  int i,event=PAPI_ENOEVNT;
+  int event;
 
-  _papi_hwi_lock( NAMELIB_LOCK );
+  // Most names passed in will contain the pmu name, so first we look for the allocated name (it has pmu name on front)
+  event = lookup_event_name(name, 0, event_table);
 
-  for(i=0;i<event_table->num_native_events;i++) {
-    // Most names passed in will contain the pmu name, so first we compare to the allocated name (it has pmu name on front)
-    if (!strcmp(name,event_table->native_events[i].allocated_name)) {
-      SUBDBG("Found allocated_name: %s, libpfm4_idx: %#x, papi_event_code: %#x\n", 
-         event_table->native_events[i].allocated_name, event_table->native_events[i].libpfm4_idx, event_table->native_events[i].papi_event_code);
-      event=i;
-      break;
-    }
-    // some callers have an event name without the pmu name on the front, so we also compare to the base name (just the event name part)
-    if (!strcmp(name,event_table->native_events[i].base_name)) {
-      int nameLen = strlen(event_table->native_events[i].base_name);
-      // the name we are looking for must be the same length as this event table entry name for them to match
-      if (strlen(name) != nameLen + strlen(event_table->native_events[i].mask_string) + 1) {
-        continue;
-      }
-      if(!strcmp(name+nameLen+1, event_table->native_events[i].mask_string)) {
-          SUBDBG("Found base_name: %s, mask_string: %s, libpfm4_idx: %#x, papi_event_code: %#x\n",
-            event_table->native_events[i].base_name, event_table->native_events[i].mask_string , event_table->native_events[i].libpfm4_idx, event_table->native_events[i].papi_event_code);
-          event=i;
-          break;
-      }
-    }
+  // some callers have an event name without the pmu name on the front, so we also look for the base name plus mask string
+  if (event < 0) {
+    event = lookup_event_name(name, 1, event_table);
   }
-  _papi_hwi_unlock( NAMELIB_LOCK );
 
   SUBDBG("EXIT: returned: %#x\n", event);
   return event;
@@ -190,7 +246,7 @@ static struct native_event_t *allocate_native_event(
 
 	/* use user provided name of the event to get the */
 	/* perf_event encoding and a fully qualified event string */
-	ret = pfm_get_os_event_encoding(name,
+	ret = _papi_libpfm4_get_os_event_encoding(name,
 					PFM_PLM0 | PFM_PLM3,
 					PFM_OS_PERF_EVENT_EXT,
 					&perf_arg);
@@ -457,8 +513,19 @@ static struct native_event_t *allocate_native_event(
 		return NULL;
 	}
 
-	// if we created a new event, bump the number used
+	// if we created a new event, index its names and bump the number used
 	if (event_num < 0) {
+		add_event_name(ntv_evt->allocated_name, 0, nevt_idx, event_table);
+		if (ntv_evt->mask_string[0] != '\0') {
+			char *base_plus_masks = malloc(strlen(ntv_evt->base_name) +
+					strlen(ntv_evt->mask_string) + 2);
+			if (base_plus_masks != NULL) {
+				sprintf(base_plus_masks, "%s:%s",
+					ntv_evt->base_name, ntv_evt->mask_string);
+				add_event_name(base_plus_masks, 1, nevt_idx, event_table);
+				free(base_plus_masks);
+			}
+		}
 		event_table->num_native_events++;
 	}
 
@@ -1099,6 +1166,20 @@ _pe_libpfm4_shutdown(papi_vector_t *my_vector,
 
   free(event_table->native_events);
 
+  /* free the name index */
+  if (event_table->name_hash != NULL) {
+     struct native_event_name_t *entry, *next;
+     for( i=0; i<NATIVE_EVENT_HASH_SIZE; i++) {
+        for (entry=event_table->name_hash[i]; entry!=NULL; entry=next) {
+           next=entry->next;
+           free(entry->name);
+           free(entry);
+        }
+     }
+     free(event_table->name_hash);
+     event_table->name_hash=NULL;
+  }
+
   _papi_hwi_unlock( NAMELIB_LOCK );
 
   SUBDBG("EXIT: PAPI_OK\n");
@@ -1146,6 +1227,14 @@ _pe_libpfm4_init(papi_vector_t *component, int cidx,
 
 	event_table->allocated_native_events=NATIVE_EVENT_CHUNK;
 
+	event_table->name_hash=calloc(NATIVE_EVENT_HASH_SIZE,
+					sizeof(struct native_event_name_t *));
+	if (event_table->name_hash==NULL) {
+		strncpy(component->cmp_info.disabled_reason,
+			"calloc NATIVE_EVENT_HASH_SIZE failed",PAPI_MAX_STR_LEN);
+		return PAPI_ENOMEM;
+	}
+
 	/* Count number of present PMUs */
 	detected_pmus=0;
 	ncnt=0;
@@ -1281,6 +1370,12 @@ _peu_libpfm4_init(papi_vector_t *my_vector, int cidx,
    }
    event_table->allocated_native_events=NATIVE_EVENT_CHUNK;
 
+   event_table->name_hash=calloc(NATIVE_EVENT_HASH_SIZE,
+					   sizeof(struct native_event_name_t *));
+   if (event_table->name_hash==NULL) {
+      return PAPI_ENOMEM;
+   }
+
    /* Count number of present PMUs */
    detected_pmus=0;
    ncnt=0;
@@ -31,6 +31,7 @@
 #include <sys/utsname.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/timerfd.h>
 
 /* PAPI-specific includes */
 #include "papi.h"
@@ -54,6 +55,8 @@
 
 #include "perf_event_lib.h"
 #include "perf_helpers.h"
+#include "pe_collector.h"
+#include "pe_export.h"
 
 /* Set to enable pre-Linux 2.6.34 perf_event workarounds   */
 /* If disabling them gets no complaints then we can remove */
@@ -621,6 +624,26 @@ configure_fd_for_sampling( pe_control_t *ctl, int evt_idx )
 	return PAPI_OK;
 }
 
+/* A streaming sampler is drained by polling its ring, so unlike */
+/* configure_fd_for_sampling() no signal is ever routed to it.    */
+static int
+configure_fd_for_streaming( pe_control_t *ctl, int evt_idx )
+{
+	int fd = ctl->events[evt_idx].event_fd;
+
+	if ( fcntl( fd, F_SETFL, O_NONBLOCK ) == -1 ) {
+		PAPIERROR ( "fcntl(%d, F_SETFL, O_NONBLOCK) "
+			"returned error: %s", fd, strerror( errno ) );
+		return PAPI_ESYS;
+	}
+
+	if ( fcntl( fd, F_SETFD, FD_CLOEXEC ) == -1 ) {
+		return PAPI_ESYS;
+	}
+
+	return PAPI_OK;
+}
+
 static int
 set_up_mmap( pe_control_t *ctl, int evt_idx)
 {
@@ -676,6 +699,277 @@ set_up_mmap( pe_control_t *ctl, int evt_idx)
 
 
 
+/********************************************************************/
+/* A cpu set opens every event once on each cpu of the set, with a  */
+/* group of its own per cpu, and counts every process on them like  */
+/* a PAPI_GRN_SYS EventSet would.  The fds and the per-cpu counts   */
+/* are kept in rows of num_events, one row per cpu.                 */
+/********************************************************************/
+
+/* Event 0 leads each cpu's group, unless everyone is a leader */
+static int
+cpuset_leader( pe_control_t *ctl, int i )
+{
+	return ( i == 0 ) || ctl->multiplexed;
+}
+
+/* Fill in the online cpus from sysfs, e.g. "0-3,6,8-11" */
+static int
+cpuset_online( unsigned int **cpus )
+{
+	FILE *fff;
+	unsigned int *set, first, last, c;
+	int num = 0, max, n;
+	char sep;
+
+	max = sysconf( _SC_NPROCESSORS_CONF );
+	if ( max <= 0 ) {
+		return PAPI_ESYS;
+	}
+
+	fff = fopen( "/sys/devices/system/cpu/online", "r" );
+	if ( fff == NULL ) {
+		return PAPI_ESYS;
+	}
+
+	set = papi_malloc( max * sizeof ( unsigned int ) );
+	if ( set == NULL ) {
+		fclose( fff );
+		return PAPI_ENOMEM;
+	}
+
+	while ( fscanf( fff, "%u", &first ) == 1 ) {
+		last = first;
+		n = fscanf( fff, "%c", &sep );
+		if ( n == 1 && sep == '-' ) {
+			if ( fscanf( fff, "%u", &last ) != 1 ) {
+				break;
+			}
+			n = fscanf( fff, "%c", &sep );
+		}
+		for ( c = first; c <= last && num < max; c++ ) {
+			set[num++] = c;
+		}
+		if ( n != 1 || sep != ',' ) {
+			break;
+		}
+	}
+	fclose( fff );
+
+	if ( num == 0 ) {
+		papi_free( set );
+		return PAPI_ESYS;
+	}
+
+	*cpus = set;
+	return num;
+}
+
+static void
+close_pe_cpuset( pe_control_t *ctl )
+{
+	int c, i, fd;
+
+	/* Close the members of each group before its leaders */
+	if ( ctl->cpu_fds ) {
+		for ( c = 0; c < ctl->num_cpus; c++ ) {
+			for ( i = ctl->num_events - 1; i >= 0; i-- ) {
+				fd = ctl->cpu_fds[c * ctl->num_events + i];
+				if ( fd >= 0 && close( fd ) ) {
+					PAPIERROR( "close of fd = %d returned error: %s",
+						fd, strerror( errno ) );
+				}
+			}
+		}
+		papi_free( ctl->cpu_fds );
+		ctl->cpu_fds = NULL;
+	}
+	if ( ctl->cpu_counts ) {
+		papi_free( ctl->cpu_counts );
+		ctl->cpu_counts = NULL;
+	}
+
+	for ( i = 0; i < ctl->num_events; i++ ) {
+		ctl->events[i].event_opened = 0;
+	}
+}
+
+/* Enable and disable go to the leaders of each cpu, reset to every event */
+static int
+cpuset_ioctl( pe_control_t *ctl, unsigned long request )
+{
+	int c, i, fd;
+
+	for ( c = 0; c < ctl->num_cpus; c++ ) {
+		for ( i = 0; i < ctl->num_events; i++ ) {
+			if ( request != PERF_EVENT_IOC_RESET &&
+			     !cpuset_leader( ctl, i ) ) {
+				continue;
+			}
+			fd = ctl->cpu_fds[c * ctl->num_events + i];
+			if ( ioctl( fd, request, NULL ) == -1 ) {
+				PAPIERROR( "ioctl(%d, %#lx, NULL) on cpu %u "
+					"returned error, Linux says: %s",
+					fd, request, ctl->cpus[c],
+					strerror( errno ) );
+				return PAPI_ESYS;
+			}
+		}
+	}
+
+	return PAPI_OK;
+}
+
+static int
+open_pe_cpuset( pe_context_t *ctx, pe_control_t *ctl )
+{
+	long long papi_pe_buffer[READ_BUFFER_SIZE];
+	int c, i, fd, leader_fd, ret, n = ctl->num_events;
+
+	ctl->cpu_fds = papi_malloc( ctl->num_cpus * n * sizeof ( int ) );
+	ctl->cpu_counts = papi_calloc( ctl->num_cpus * n,
+				       sizeof ( long long ) );
+	if ( ctl->cpu_fds == NULL || ctl->cpu_counts == NULL ) {
+		ret = PAPI_ENOMEM;
+		goto cpuset_cleanup;
+	}
+	for ( i = 0; i < ctl->num_cpus * n; i++ ) {
+		ctl->cpu_fds[i] = -1;
+	}
+
+	/* Same attr set up as open_pe_events, less inherit and mmap */
+	for ( i = 0; i < n; i++ ) {
+		if ((ctl->events[i].attr.exclude_guest) &&
+			(exclude_guest_unsupported)) {
+			ctl->events[i].attr.exclude_guest=0;
+		}
+		ctl->events[i].attr.pinned =
+			cpuset_leader( ctl, i ) && !ctl->multiplexed;
+		ctl->events[i].attr.disabled = cpuset_leader( ctl, i );
+		ctl->events[i].attr.read_format = get_read_format(
+				ctl->multiplexed, 0,
+				cpuset_leader( ctl, i ) && !ctl->multiplexed );
+		ctl->events[i].nr_mmap_pages = 0;
+		ctl->events[i].mmap_buf = NULL;
+	}
+
+	for ( c = 0; c < ctl->num_cpus; c++ ) {
+		for ( i = 0; i < n; i++ ) {
+			leader_fd = cpuset_leader( ctl, i ) ?
+				-1 : ctl->cpu_fds[c * n];
+
+			perf_event_dump_attr( &ctl->events[i].attr, -1,
+				ctl->cpus[c], leader_fd, 0 );
+
+			fd = sys_perf_event_open( &ctl->events[i].attr, -1,
+				ctl->cpus[c], leader_fd, 0 );
+			if ( fd == -1 ) {
+				SUBDBG("sys_perf_event_open returned error "
+					"on event #%d, cpu %u.  Error: %s\n",
+					i, ctl->cpus[c], strerror( errno ) );
+				ret = map_perf_event_errors_to_papi( errno );
+				goto cpuset_cleanup;
+			}
+			ctl->cpu_fds[c * n + i] = fd;
+		}
+
+		/* As check_scheduability does, see that the group */
+		/* of this cpu actually gets scheduled              */
+		if ( !ctl->multiplexed ) {
+			fd = ctl->cpu_fds[c * n];
+			if ( ioctl( fd, PERF_EVENT_IOC_ENABLE, NULL ) == -1 ||
+			     ioctl( fd, PERF_EVENT_IOC_DISABLE, NULL ) == -1 ) {
+				PAPIERROR( "ioctl on cpu %u failed", ctl->cpus[c] );
+				ret = PAPI_ESYS;
+				goto cpuset_cleanup;
+			}
+			ret = read( fd, papi_pe_buffer, sizeof ( papi_pe_buffer ) );
+			if ( ret <= 0 ) {
+				ret = ( ret == 0 ) ? PAPI_ECNFLCT : PAPI_ESYS;
+				goto cpuset_cleanup;
+			}
+		}
+	}
+
+	ret = cpuset_ioctl( ctl, PERF_EVENT_IOC_RESET );
+	if ( ret != PAPI_OK ) {
+		goto cpuset_cleanup;
+	}
+
+	/* The first cpu stands in for the others in events[] */
+	for ( i = 0; i < n; i++ ) {
+		ctl->events[i].event_fd = ctl->cpu_fds[i];
+		ctl->events[i].group_leader_fd = cpuset_leader( ctl, i ) ?
+			-1 : ctl->cpu_fds[0];
+		ctl->events[i].cpu = ctl->cpus[0];
+		ctl->events[i].event_opened = 1;
+	}
+
+	ctx->state |= PERF_EVENTS_OPENED;
+
+	return PAPI_OK;
+
+cpuset_cleanup:
+	close_pe_cpuset( ctl );
+	return ret;
+}
+
+/* One read per cpu: its group, or each event when the kernel cannot */
+/* group them.  counts gets the sum over the cpus.                   */
+static int
+_pe_read_cpu_groups( pe_control_t *ctl, long long *counts )
+{
+	long long papi_pe_buffer[READ_BUFFER_SIZE];
+	long long *row, enabled, running;
+	int c, i, ret, n = ctl->num_events;
+	int group = !ctl->multiplexed && !bug_format_group();
+
+	memset( counts, 0, n * sizeof ( long long ) );
+
+	for ( c = 0; c < ctl->num_cpus; c++ ) {
+		row = ctl->cpu_counts + c * n;
+
+		if ( group ) {
+			ret = read( ctl->cpu_fds[c * n], papi_pe_buffer,
+				    sizeof ( papi_pe_buffer ) );
+			if ( ret < (signed)((1+n)*sizeof(long long)) ||
+			     papi_pe_buffer[0] != n ) {
+				PAPIERROR( "Error! short read on cpu %u",
+					ctl->cpus[c] );
+				return PAPI_ESYS;
+			}
+			memcpy( row, papi_pe_buffer + 1, n * sizeof ( long long ) );
+		}
+		else for ( i = 0; i < n; i++ ) {
+			ret = read( ctl->cpu_fds[c * n + i], papi_pe_buffer,
+				    sizeof ( papi_pe_buffer ) );
+			if ( ret < (signed)((ctl->multiplexed ? 3 : 1) *
+					    sizeof(long long)) ) {
+				PAPIERROR( "Error! short read on cpu %u",
+					ctl->cpus[c] );
+				return PAPI_ESYS;
+			}
+			row[i] = papi_pe_buffer[0];
+
+			/* scaled as in _pe_read_multiplexed */
+			enabled = papi_pe_buffer[1];
+			running = papi_pe_buffer[2];
+			if ( ctl->multiplexed && running && enabled &&
+			     running != enabled ) {
+				row[i] = ( ( enabled * 100LL ) / running ) *
+					papi_pe_buffer[0] / 100LL;
+			}
+		}
+
+		for ( i = 0; i < n; i++ ) {
+			counts[i] += row[i];
+		}
+	}
+
+	return PAPI_OK;
+}
+
+
 /* Open all events in the control state */
 static int
 open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
@@ -684,6 +978,9 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 	int i, ret = PAPI_OK;
 	long pid;
 
+	if (ctl->num_cpus) {
+		return open_pe_cpuset( ctx, ctl );
+	}
 
 	/* Set the pid setting */
 	/* If attached, this is the pid of process we are attached to. */
@@ -706,6 +1003,7 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 	for( i = 0; i < ctl->num_events; i++ ) {
 
 		ctl->events[i].event_opened=0;
+		ctl->events[i].mmap_buf=NULL;
 
 		/* set up the attr structure.			*/
 		/* We don't set up all fields here		*/
@@ -823,7 +1121,11 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 			/* must be a power of 2 (1, 4, 8, 16, etc) or zero. */
 			/* This is required to optimize dealing with        */
 			/* circular buffer wrapping of the mapped pages.    */
-			if (ctl->events[i].sampling) {
+			if (ctl->events[i].streaming) {
+				ctl->events[i].nr_mmap_pages =
+					1 + ctl->events[i].ring_pages;
+			}
+			else if (ctl->events[i].sampling) {
 				ctl->events[i].nr_mmap_pages = 1 + 2;
 			}
 			else if (_perf_event_vector.cmp_info.fast_counter_read) {
@@ -844,8 +1146,22 @@ open_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 
 	for ( i = 0; i < ctl->num_events; i++ ) {
 
+		/* A streaming ring is the only place its samples go, */
+		/* so failing to map it is fatal.                      */
+		if (ctl->events[i].streaming) {
+			if (ctl->events[i].mmap_buf == NULL) {
+				ret = PAPI_ESYS;
+			}
+			else {
+				ret = configure_fd_for_streaming( ctl, i );
+			}
+			if ( ret != PAPI_OK ) {
+				i = ctl->num_events;
+				goto open_pe_cleanup;
+			}
+		}
 		/* If sampling is enabled, hook up signal handler */
-		if (ctl->events[i].attr.sample_period) {
+		else if (ctl->events[i].attr.sample_period) {
 
 			ret = configure_fd_for_sampling( ctl, i );
 			if ( ret != PAPI_OK ) {
@@ -868,6 +1184,11 @@ open_pe_cleanup:
 	/* That's probably not strictly necessary.                            */
 	while ( i > 0 ) {
 		i--;
+		if (ctl->events[i].mmap_buf) {
+			munmap( ctl->events[i].mmap_buf,
+				ctl->events[i].nr_mmap_pages * getpagesize() );
+			ctl->events[i].mmap_buf = NULL;
+		}
 		if (ctl->events[i].event_fd>=0) {
 			close( ctl->events[i].event_fd );
 			ctl->events[i].event_opened=0;
@@ -892,9 +1213,9 @@ close_event( pe_event_info_t *event )
 			PAPIERROR( "munmap of fd = %d returned error: %s",
 							event->event_fd,
 							strerror( errno ) );
-			event->mmap_buf=NULL;
 			munmap_error=1;
 		}
+		event->mmap_buf=NULL;
 	}
 	if ( close( event->event_fd ) ) {
 		PAPIERROR( "close of fd = %d returned error: %s",
@@ -924,6 +1245,13 @@ close_pe_events( pe_context_t *ctx, pe_control_t *ctl )
 		SUBDBG("Closing without stopping first\n");
 	}
 
+	if ( ctl->num_cpus ) {
+		close_pe_cpuset( ctl );
+		ctl->num_events=0;
+		ctx->state &= ~PERF_EVENTS_OPENED;
+		return PAPI_OK;
+	}
+
 	/* Close child events first */
 	/* Is that necessary? -- vmw */
 	for( i=0; i<ctl->num_events; i++ ) {
@@ -1039,6 +1367,10 @@ _pe_reset( hwd_context_t *ctx, hwd_control_state_t *ctl )
 
 	( void ) ctx;			 /*unused */
 
+	if ( pe_ctl->num_cpus ) {
+		return cpuset_ioctl( pe_ctl, PERF_EVENT_IOC_RESET );
+	}
+
 	/* We need to reset all of the events, not just the group leaders */
 	for( i = 0; i < pe_ctl->num_events; i++ ) {
 		ret = ioctl( pe_ctl->events[i].event_fd,
@@ -1150,7 +1482,7 @@ _pe_rdpmc_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 
 
 static int
-_pe_read_multiplexed( pe_control_t *pe_ctl )
+_pe_read_multiplexed( pe_control_t *pe_ctl, long long *counts )
 {
 	int i,ret=-1;
 	long long papi_pe_buffer[READ_BUFFER_SIZE];
@@ -1195,7 +1527,7 @@ _pe_read_multiplexed( pe_control_t *pe_ctl )
 
 		if (tot_time_running == tot_time_enabled) {
 			/* No scaling needed */
-			pe_ctl->counts[i] = papi_pe_buffer[0];
+			counts[i] = papi_pe_buffer[0];
 		} else if (tot_time_running && tot_time_enabled) {
 			/* Scale to give better results */
 			/* avoid truncation.            */
@@ -1203,7 +1535,7 @@ _pe_read_multiplexed( pe_control_t *pe_ctl )
 			scale = (tot_time_enabled * 100LL) / tot_time_running;
 			scale = scale * papi_pe_buffer[0];
 			scale = scale / 100LL;
-			pe_ctl->counts[i] = scale;
+			counts[i] = scale;
 		} else {
 			/* This should not happen, but Phil reports it sometime does. */
 			SUBDBG("perf_event kernel bug(?) count, enabled, "
@@ -1211,7 +1543,7 @@ _pe_read_multiplexed( pe_control_t *pe_ctl )
 				papi_pe_buffer[0],tot_time_enabled,
 				tot_time_running);
 
-			pe_ctl->counts[i] = papi_pe_buffer[0];
+			counts[i] = papi_pe_buffer[0];
 		}
 	}
 	return PAPI_OK;
@@ -1222,7 +1554,7 @@ _pe_read_multiplexed( pe_control_t *pe_ctl )
 /* This includes when INHERIT is set, as well as various bugs */
 
 static int
-_pe_read_nogroup( pe_control_t *pe_ctl ) {
+_pe_read_nogroup( pe_control_t *pe_ctl, long long *counts ) {
 
 	int i,ret=-1;
 	long long papi_pe_buffer[READ_BUFFER_SIZE];
@@ -1252,45 +1584,34 @@ _pe_read_nogroup( pe_control_t *pe_ctl ) {
 			pe_ctl->events[i].cpu, ret);
 		SUBDBG("read: %lld\n",papi_pe_buffer[0]);
 
-		pe_ctl->counts[i] = papi_pe_buffer[0];
+		counts[i] = papi_pe_buffer[0];
 	}
 
 	return PAPI_OK;
 
 }
 
+/* Read every counter of pe_ctl into counts with read(2).  Unlike */
+/* rdpmc this works from any thread, which the time series need.  */
 static int
-_pe_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
-	       long long **events, int flags )
+_pe_read_counts( pe_control_t *pe_ctl, long long *counts )
 {
-	SUBDBG("ENTER: ctx: %p, ctl: %p, events: %p, flags: %#x\n",
-		ctx, ctl, events, flags);
-
-	( void ) flags;			 /*unused */
-	( void ) ctx;			 /*unused */
 	int i, j, ret = -1;
-	pe_control_t *pe_ctl = ( pe_control_t *) ctl;
 	long long papi_pe_buffer[READ_BUFFER_SIZE];
-	int result;
 
-	/* Handle fast case */
-	/* FIXME: we fallback to slow reads if *any* event in eventset fails */
-	/*        in theory we could only fall back for the one event        */
-	/*        but that makes the code more complicated.                  */
-	if ((_perf_event_vector.cmp_info.fast_counter_read) && (!pe_ctl->inherit)) {
-		result=_pe_rdpmc_read( ctx, ctl, events, flags);
-		/* if successful we are done, otherwise fall back to read */
-		if (result==PAPI_OK) return PAPI_OK;
+	/* Handle case where we count on a set of cpus */
+	if (pe_ctl->num_cpus) {
+		return _pe_read_cpu_groups(pe_ctl, counts);
 	}
 
 	/* Handle case where we are multiplexing */
 	if (pe_ctl->multiplexed) {
-		_pe_read_multiplexed(pe_ctl);
+		return _pe_read_multiplexed(pe_ctl, counts);
 	}
 
 	/* Handle cases where we cannot use FORMAT GROUP */
-	else if (bug_format_group() || pe_ctl->inherit) {
-		_pe_read_nogroup(pe_ctl);
+	if (bug_format_group() || pe_ctl->inherit) {
+		return _pe_read_nogroup(pe_ctl, counts);
 	}
 
 	/* Handle common case where we are using FORMAT_GROUP	*/
@@ -1300,46 +1621,75 @@ _pe_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 	/* of 64-bit values.  The first is the total number of    */
 	/* events, followed by the counts for them.               */
 
-	else {
-		if (pe_ctl->events[0].group_leader_fd!=-1) {
-			PAPIERROR("Was expecting group leader");
-		}
+	if (pe_ctl->events[0].group_leader_fd!=-1) {
+		PAPIERROR("Was expecting group leader");
+	}
 
-		ret = read( pe_ctl->events[0].event_fd,
-			papi_pe_buffer,
-			sizeof ( papi_pe_buffer ) );
+	ret = read( pe_ctl->events[0].event_fd,
+		papi_pe_buffer,
+		sizeof ( papi_pe_buffer ) );
 
-		if ( ret == -1 ) {
-			PAPIERROR("read returned an error: ",
-				strerror( errno ));
-			return PAPI_ESYS;
-		}
+	if ( ret == -1 ) {
+		PAPIERROR("read returned an error: ",
+			strerror( errno ));
+		return PAPI_ESYS;
+	}
 
-		/* we read 1 64-bit value (number of events) then     */
-		/* num_events more 64-bit values that hold the counts */
-		if (ret<(signed)((1+pe_ctl->num_events)*sizeof(long long))) {
-			PAPIERROR("Error! short read");
-			return PAPI_ESYS;
-		}
+	/* we read 1 64-bit value (number of events) then     */
+	/* num_events more 64-bit values that hold the counts */
+	if (ret<(signed)((1+pe_ctl->num_events)*sizeof(long long))) {
+		PAPIERROR("Error! short read");
+		return PAPI_ESYS;
+	}
 
-		SUBDBG("read: fd: %2d, tid: %ld, cpu: %d, ret: %d\n",
-			pe_ctl->events[0].event_fd,
-			(long)pe_ctl->tid, pe_ctl->events[0].cpu, ret);
+	SUBDBG("read: fd: %2d, tid: %ld, cpu: %d, ret: %d\n",
+		pe_ctl->events[0].event_fd,
+		(long)pe_ctl->tid, pe_ctl->events[0].cpu, ret);
 
-		for(j=0;j<ret/8;j++) {
-			SUBDBG("read %d: %lld\n",j,papi_pe_buffer[j]);
-		}
+	for(j=0;j<ret/8;j++) {
+		SUBDBG("read %d: %lld\n",j,papi_pe_buffer[j]);
+	}
 
-		/* Make sure the kernel agrees with how many events we have */
-		if (papi_pe_buffer[0]!=pe_ctl->num_events) {
-			PAPIERROR("Error!  Wrong number of events");
-			return PAPI_ESYS;
-		}
+	/* Make sure the kernel agrees with how many events we have */
+	if (papi_pe_buffer[0]!=pe_ctl->num_events) {
+		PAPIERROR("Error!  Wrong number of events");
+		return PAPI_ESYS;
+	}
 
-		/* put the count values in their proper location */
-		for(i=0;i<pe_ctl->num_events;i++) {
-			pe_ctl->counts[i] = papi_pe_buffer[1+i];
-		}
+	/* put the count values in their proper location */
+	for(i=0;i<pe_ctl->num_events;i++) {
+		counts[i] = papi_pe_buffer[1+i];
+	}
+
+	return PAPI_OK;
+}
+
+static int
+_pe_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
+	       long long **events, int flags )
+{
+	SUBDBG("ENTER: ctx: %p, ctl: %p, events: %p, flags: %#x\n",
+		ctx, ctl, events, flags);
+
+	( void ) flags;			 /*unused */
+	( void ) ctx;			 /*unused */
+	pe_control_t *pe_ctl = ( pe_control_t *) ctl;
+	int result;
+
+	/* Handle fast case */
+	/* FIXME: we fallback to slow reads if *any* event in eventset fails */
+	/*        in theory we could only fall back for the one event        */
+	/*        but that makes the code more complicated.                  */
+	if ((_perf_event_vector.cmp_info.fast_counter_read) && (!pe_ctl->inherit) &&
+	    (!pe_ctl->num_cpus)) {
+		result=_pe_rdpmc_read( ctx, ctl, events, flags);
+		/* if successful we are done, otherwise fall back to read */
+		if (result==PAPI_OK) return PAPI_OK;
+	}
+
+	result = _pe_read_counts( pe_ctl, pe_ctl->counts );
+	if ( result != PAPI_OK ) {
+		return result;
 	}
 
 	/* point PAPI to the values we read */
@@ -1387,27 +1737,215 @@ _pe_read_bug_sync( hwd_context_t *ctx, hwd_control_state_t *ctl,
 	/* If we disabled the counters due to the sync_read_bug(), */
 	/* then we need to re-enable them now.                     */
 
-	if ( pe_ctx->state & PERF_EVENTS_RUNNING ) {
-		for ( i = 0; i < pe_ctl->num_events; i++ ) {
-			if ( pe_ctl->events[i].group_leader_fd == -1 ) {
-				/* this should refresh any overflow counters too */
-				ret = ioctl( pe_ctl->events[i].event_fd,
-					PERF_EVENT_IOC_ENABLE, NULL );
-				if ( ret == -1 ) {
-					/* Should never happen */
-					PAPIERROR("ioctl(PERF_EVENT_IOC_ENABLE) returned an error: ",
-						strerror( errno ));
-					return PAPI_ESYS;
-				}
+	if ( pe_ctx->state & PERF_EVENTS_RUNNING ) {
+		for ( i = 0; i < pe_ctl->num_events; i++ ) {
+			if ( pe_ctl->events[i].group_leader_fd == -1 ) {
+				/* this should refresh any overflow counters too */
+				ret = ioctl( pe_ctl->events[i].event_fd,
+					PERF_EVENT_IOC_ENABLE, NULL );
+				if ( ret == -1 ) {
+					/* Should never happen */
+					PAPIERROR("ioctl(PERF_EVENT_IOC_ENABLE) returned an error: ",
+						strerror( errno ));
+					return PAPI_ESYS;
+				}
+			}
+		}
+	}
+
+	return result;
+}
+
+#endif
+
+/* A non-blocking timerfd that the collector thread can poll */
+static int
+periodic_timer_open( long long period )
+{
+	struct itimerspec its;
+	int fd;
+
+	fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+	if ( fd < 0 ) {
+		PAPIERROR( "timerfd_create() failed: %s", strerror( errno ) );
+		return -1;
+	}
+
+	its.it_interval.tv_sec = period / 1000000000LL;
+	its.it_interval.tv_nsec = period % 1000000000LL;
+	its.it_value = its.it_interval;
+	if ( timerfd_settime( fd, 0, &its, NULL ) < 0 ) {
+		PAPIERROR( "timerfd_settime() failed: %s", strerror( errno ) );
+		close( fd );
+		return -1;
+	}
+
+	return fd;
+}
+
+/* Take one snapshot of the counters into the time series ring.     */
+/* Runs in the collector thread, and in the thread calling         */
+/* PAPI_start() or PAPI_stop() for the first and last snapshots.   */
+void
+_pe_timeseries_sample( pe_control_t *ctl )
+{
+	pe_timeseries_t *ts = ctl->ts;
+	unsigned long head = ts->head;
+	long long *record;
+
+	__sync_synchronize();
+	if ( head - ts->tail > ts->mask ) {
+		ts->dropped++;
+		return;
+	}
+
+	record = ts->data + ( head & ts->mask ) * ( ts->width + 1 );
+	record[0] = _papi_os_vector.get_real_nsec(  );
+	if ( _pe_read_counts( ctl, record + 1 ) != PAPI_OK ) {
+		ts->dropped++;
+		return;
+	}
+
+	/* publish the record only once it is complete */
+	__sync_synchronize();
+	ts->head = head + 1;
+}
+
+static void
+timeseries_disarm( pe_control_t *ctl )
+{
+	if ( ctl->ts_fd >= 0 ) {
+		close( ctl->ts_fd );
+		ctl->ts_fd = -1;
+	}
+}
+
+/* Size the ring for the current events, start the timer and */
+/* record the starting counts                               */
+static int
+timeseries_arm( pe_control_t *ctl )
+{
+	unsigned long records = 1;
+	int width = ctl->num_events;
+
+	while ( records < ( unsigned long ) ctl->ts_records ) {
+		records <<= 1;
+	}
+
+	if ( ctl->ts &&
+	     ( ctl->ts->width != width || ctl->ts->mask != records - 1 ) ) {
+		papi_free( ctl->ts );
+		ctl->ts = NULL;
+	}
+	if ( ctl->ts == NULL ) {
+		ctl->ts = papi_calloc( 1, sizeof ( pe_timeseries_t ) +
+				       ( records * ( width + 1 ) - 1 ) *
+				       sizeof ( long long ) );
+		if ( ctl->ts == NULL ) {
+			return PAPI_ENOMEM;
+		}
+		ctl->ts->mask = records - 1;
+		ctl->ts->width = width;
+	}
+
+	/* Each run starts a fresh series */
+	ctl->ts->head = ctl->ts->tail = 0;
+	ctl->ts->dropped = 0;
+
+	ctl->ts_fd = periodic_timer_open( ctl->ts_period );
+	if ( ctl->ts_fd < 0 ) {
+		return PAPI_ESYS;
+	}
+
+	_pe_timeseries_sample( ctl );
+
+	return PAPI_OK;
+}
+
+/* Publish the current values to the EventSet's export slot.    */
+/* Runs in the collector thread, and in the thread calling       */
+/* PAPI_start() or PAPI_stop() for the first and last values.    */
+void
+_pe_export_sample( pe_control_t *ctl )
+{
+	long long counts[PERF_EVENT_MAX_MPX_COUNTERS];
+	long long values[PAPI_EXPORT_MAX_EVENTS];
+
+	if ( _pe_read_counts( ctl, counts ) != PAPI_OK ) {
+		return;
+	}
+	_papi_hwi_map_counts( ctl->export_esi, counts, values );
+	_pe_export_publish( ctl->export_slot, _papi_os_vector.get_real_nsec(  ),
+			    values );
+}
+
+static void
+export_disarm( pe_control_t *ctl )
+{
+	if ( ctl->export_fd >= 0 ) {
+		close( ctl->export_fd );
+		ctl->export_fd = -1;
+	}
+}
+
+/* Tell readers what the slot now counts and start the timer */
+static int
+export_arm( pe_control_t *ctl )
+{
+	EventSetInfo_t *ESI = ctl->export_esi;
+	int events[PAPI_EXPORT_MAX_EVENTS];
+	int i;
+
+	/* Events may have been added since PAPI_export_set() */
+	if ( ESI->NumberOfEvents > PAPI_EXPORT_MAX_EVENTS ) {
+		return PAPI_EINVAL;
+	}
+	for ( i = 0; i < ESI->NumberOfEvents; i++ ) {
+		events[i] = ( int ) ESI->EventInfoArray[i].event_code;
+	}
+	_pe_export_describe( ctl->export_slot,
+			     ctl->attached ? ( int ) ctl->tid : mygettid(  ),
+			     events, ESI->NumberOfEvents );
+
+	ctl->export_fd = periodic_timer_open( ctl->export_period );
+	if ( ctl->export_fd < 0 ) {
+		return PAPI_ESYS;
+	}
+
+	_pe_export_sample( ctl );
+
+	return PAPI_OK;
+}
+
+/* Disable the group leaders, which stops their whole groups */
+static int
+pe_disable( pe_control_t *pe_ctl )
+{
+	int ret;
+	int i;
+
+	if ( pe_ctl->num_cpus ) {
+		ret = cpuset_ioctl( pe_ctl, PERF_EVENT_IOC_DISABLE );
+		if ( ret != PAPI_OK ) {
+			return PAPI_EBUG;
+		}
+	}
+	else for ( i = 0; i < pe_ctl->num_events; i++ ) {
+		if ( pe_ctl->events[i].group_leader_fd == -1 ) {
+			ret=ioctl( pe_ctl->events[i].event_fd,
+				PERF_EVENT_IOC_DISABLE, NULL);
+			if ( ret == -1 ) {
+				PAPIERROR( "ioctl(%d, PERF_EVENT_IOC_DISABLE, NULL) "
+					"returned error, Linux says: %s",
+					pe_ctl->events[i].event_fd, strerror( errno ) );
+				return PAPI_EBUG;
 			}
 		}
 	}
 
-	return result;
+	return PAPI_OK;
 }
 
-#endif
-
 /* Start counting events */
 static int
 _pe_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
@@ -1426,7 +1964,14 @@ _pe_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 
 	/* Enable all of the group leaders                */
 	/* All group leaders have a group_leader_fd of -1 */
-	for( i = 0; i < pe_ctl->num_events; i++ ) {
+	if ( pe_ctl->num_cpus ) {
+		ret = cpuset_ioctl( pe_ctl, PERF_EVENT_IOC_ENABLE );
+		if ( ret != PAPI_OK ) {
+			goto start_cleanup;
+		}
+		did_something++;
+	}
+	else for( i = 0; i < pe_ctl->num_events; i++ ) {
 		if (pe_ctl->events[i].group_leader_fd == -1) {
 			SUBDBG("ioctl(enable): fd: %d\n",
 				pe_ctl->events[i].event_fd);
@@ -1436,7 +1981,8 @@ _pe_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 			/* ioctls always return -1 on failure */
 			if (ret == -1) {
 				PAPIERROR("ioctl(PERF_EVENT_IOC_ENABLE) failed");
-				return PAPI_ESYS;
+				ret = PAPI_ESYS;
+				goto start_cleanup;
 			}
 
 			did_something++;
@@ -1448,10 +1994,40 @@ _pe_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
 		return PAPI_EBUG;
 	}
 
+	if ( pe_ctl->ts_period ) {
+		ret = timeseries_arm( pe_ctl );
+		if ( ret != PAPI_OK ) {
+			goto start_cleanup;
+		}
+	}
+
+	if ( pe_ctl->export_period ) {
+		ret = export_arm( pe_ctl );
+		if ( ret != PAPI_OK ) {
+			goto start_cleanup;
+		}
+	}
+
+	/* From here on the collector thread owns draining the rings, */
+	/* taking the time series snapshots and exporting the counts  */
+	if ( pe_ctl->collect || pe_ctl->ts_period || pe_ctl->export_period ) {
+		ret = _pe_collector_register( pe_ctl );
+		if ( ret != PAPI_OK ) {
+			goto start_cleanup;
+		}
+	}
+
 	pe_ctx->state |= PERF_EVENTS_RUNNING;
 
 	return PAPI_OK;
 
+start_cleanup:
+	/* PAPI_start fails, so nothing may be left counting */
+	timeseries_disarm( pe_ctl );
+	export_disarm( pe_ctl );
+	pe_disable( pe_ctl );
+
+	return ret;
 }
 
 /* Stop all of the counters */
@@ -1461,22 +2037,31 @@ _pe_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
 	SUBDBG( "ENTER: ctx: %p, ctl: %p\n", ctx, ctl);
 
 	int ret;
-	int i;
 	pe_context_t *pe_ctx = ( pe_context_t *) ctx;
 	pe_control_t *pe_ctl = ( pe_control_t *) ctl;
 
 	/* Just disable the group leaders */
-	for ( i = 0; i < pe_ctl->num_events; i++ ) {
-		if ( pe_ctl->events[i].group_leader_fd == -1 ) {
-			ret=ioctl( pe_ctl->events[i].event_fd,
-				PERF_EVENT_IOC_DISABLE, NULL);
-			if ( ret == -1 ) {
-				PAPIERROR( "ioctl(%d, PERF_EVENT_IOC_DISABLE, NULL) "
-					"returned error, Linux says: %s",
-					pe_ctl->events[i].event_fd, strerror( errno ) );
-				return PAPI_EBUG;
-			}
-		}
+	ret = pe_disable( pe_ctl );
+	if ( ret != PAPI_OK ) {
+		return ret;
+	}
+
+	/* Take the rings back and hand over whatever is left */
+	if ( pe_ctl->collect || pe_ctl->ts_period || pe_ctl->export_period ) {
+		_pe_collector_unregister( pe_ctl );
+	}
+	if ( pe_ctl->collect ) {
+		_pe_collector_drain( pe_ctl );
+	}
+
+	/* Close the series with the final counts */
+	if ( pe_ctl->ts_period ) {
+		_pe_timeseries_sample( pe_ctl );
+		timeseries_disarm( pe_ctl );
+	}
+	if ( pe_ctl->export_period ) {
+		_pe_export_sample( pe_ctl );
+		export_disarm( pe_ctl );
 	}
 
 	pe_ctx->state &= ~PERF_EVENTS_RUNNING;
@@ -1520,6 +2105,19 @@ _pe_update_control_state( hwd_control_state_t *ctl,
 	/* Calling with count==0 should be OK, it's how things are deallocated */
 	/* when an eventset is destroyed.                                      */
 	if ( count == 0 ) {
+		/* The time series go with the events */
+		if ( pe_ctl->ts ) {
+			papi_free( pe_ctl->ts );
+			pe_ctl->ts = NULL;
+		}
+		pe_ctl->ts_period = 0;
+		if ( pe_ctl->export_slot ) {
+			_pe_export_release( pe_ctl->export_slot );
+			pe_ctl->export_slot = NULL;
+		}
+		pe_ctl->export_period = 0;
+		/* The cpu set is kept for events added back after the last */
+		/* one is removed; _pe_cleanup_eventset drops it.           */
 		SUBDBG( "EXIT: Called with count == 0\n" );
 		return PAPI_OK;
 	}
@@ -1558,6 +2156,10 @@ _pe_update_control_state( hwd_control_state_t *ctl,
 			/* Move this events hardware config values and other attributes to the perf_events attribute structure */
 			memcpy (&pe_ctl->events[i].attr, &ntv_evt->attr, sizeof(perf_event_attr_t));
 
+			/* the attr copy just dropped any sample period, so  */
+			/* this slot no longer streams                        */
+			pe_ctl->events[i].streaming = 0;
+
 			/* may need to update the attribute structure with information from event set level domain settings (values set by PAPI_set_domain) */
 			/* only done if the event mask which controls each counting domain was not provided */
 
@@ -1655,6 +2257,10 @@ _pe_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 
       case PAPI_ATTACH:
 	   pe_ctl = ( pe_control_t * ) ( option->attach.ESI->ctl_state );
+	   /* a cpu set counts every process on its cpus */
+	   if (pe_ctl->num_cpus) {
+	      return PAPI_ECNFLCT;
+	   }
 	   ret = check_permissions( option->attach.tid, pe_ctl->cpu,
 				  pe_ctl->domain, pe_ctl->granularity,
 				  pe_ctl->multiplexed,
@@ -1739,6 +2345,9 @@ _pe_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
 
       case PAPI_INHERIT:
 	   pe_ctl = (pe_control_t *) ( option->inherit.ESI->ctl_state );
+	   if (pe_ctl->num_cpus && option->inherit.inherit) {
+	      return PAPI_ECNFLCT;
+	   }
 	   ret = check_permissions( pe_ctl->tid, pe_ctl->cpu, pe_ctl->domain,
 				  pe_ctl->granularity, pe_ctl->multiplexed,
 				    option->inherit.inherit );
@@ -1819,6 +2428,10 @@ _pe_init_control_state( hwd_control_state_t *ctl )
 
 	pe_ctl->cidx=our_cidx;
 
+	/* no time series or export timer yet */
+	pe_ctl->ts_fd = -1;
+	pe_ctl->export_fd = -1;
+
 	/* Set cpu number in the control block to show events */
 	/* are not tied to specific cpu                       */
 	pe_ctl->cpu = -1;
@@ -2093,7 +2706,8 @@ _pe_stop_profiling( ThreadInfo_t *thread, EventSetInfo_t *ESI )
 	for ( i = 0; i < ctl->num_events; i++ ) {
 		/* Use the mmap_buf field as an indicator */
 		/* of this fd being used for profiling.   */
-		if ( ctl->events[i].profiling ) {
+		/* Collected rings were already drained by _pe_stop() */
+		if ( ctl->events[i].profiling && !ctl->events[i].streaming ) {
 			/* Process any remaining samples in the sample buffer */
 			ret = process_smpl_buf( i, &thread, cidx );
 			if ( ret ) {
@@ -2135,6 +2749,19 @@ _pe_set_overflow( EventSetInfo_t *ESI, int EventIndex, int threshold )
 		return PAPI_EINVAL;
 	}
 
+	/* Overflow signals and streamed samples share the sample */
+	/* period, so an event cannot do both.                     */
+	if ( ctl->events[evt_idx].streaming ) {
+		SUBDBG("EXIT: PAPI_ECNFLCT, event is streaming samples\n");
+		return PAPI_ECNFLCT;
+	}
+
+	/* A cpu set only counts; nothing would take its signals */
+	if ( ctl->num_cpus && threshold ) {
+		SUBDBG("EXIT: PAPI_ECNFLCT, EventSet has a cpu set\n");
+		return PAPI_ECNFLCT;
+	}
+
 	/* It's an error to disable overflow if it wasn't set in the	*/
 	/* first place.							*/
 	if (( threshold == 0 ) &&
@@ -2206,13 +2833,405 @@ _pe_set_overflow( EventSetInfo_t *ESI, int EventIndex, int threshold )
 	return retval;
 }
 
+/* Set up an event to stream samples into its mmap ring */
+/* If period==0 then stop streaming for that event      */
+static int
+_pe_set_sampling( EventSetInfo_t *ESI, int EventIndex, long long period,
+		  int sample_type, int ring_pages )
+{
+	SUBDBG("ENTER: ESI: %p, EventIndex: %d, period: %lld, "
+		"sample_type: %#x, ring_pages: %d\n",
+		ESI, EventIndex, period, sample_type, ring_pages);
+
+	pe_context_t *ctx;
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	pe_event_info_t *pe;
+	int evt_idx, retval;
+
+	ctx = ( pe_context_t *) ( ESI->master->context[ctl->cidx] );
+
+	evt_idx = ESI->EventInfoArray[EventIndex].pos[0];
+	if (evt_idx<0) {
+		return PAPI_EINVAL;
+	}
+	pe = &ctl->events[evt_idx];
+
+	/* Inherited events cannot be mmap()ed, so there is no ring, */
+	/* and a cpu set does not map its fds either                  */
+	if ( ctl->inherit || ctl->num_cpus ) {
+		return PAPI_ECNFLCT;
+	}
+
+	if ( period == 0 ) {
+		if ( !pe->streaming ) {
+			return PAPI_EINVAL;
+		}
+		pe->streaming = 0;
+		pe->sampling = 0;
+		pe->ring_pages = 0;
+		pe->attr.sample_period = 0;
+		pe->attr.sample_type = 0;
+	}
+	else {
+		/* PAPI_overflow() owns sample periods it has set */
+		if ( pe->attr.sample_period && !pe->streaming ) {
+			return PAPI_ECNFLCT;
+		}
+		pe->streaming = 1;
+		pe->sampling = 1;
+		pe->ring_pages = ring_pages ? ring_pages : PAPI_SAMPLE_DEF_PAGES;
+		pe->attr.sample_period = period;
+		pe->attr.sample_type = 0;
+		if ( sample_type & PAPI_SAMPLE_IP )
+			pe->attr.sample_type |= PERF_SAMPLE_IP;
+		if ( sample_type & PAPI_SAMPLE_TID )
+			pe->attr.sample_type |= PERF_SAMPLE_TID;
+		if ( sample_type & PAPI_SAMPLE_TIME )
+			pe->attr.sample_type |= PERF_SAMPLE_TIME;
+		if ( sample_type & PAPI_SAMPLE_ADDR )
+			pe->attr.sample_type |= PERF_SAMPLE_ADDR;
+		if ( sample_type & PAPI_SAMPLE_CALLCHAIN )
+			pe->attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+		if ( sample_type & PAPI_SAMPLE_READ )
+			pe->attr.sample_type |= PERF_SAMPLE_READ;
+		/* Only the collector thread is ever woken up, and only */
+		/* once per batch; otherwise the ring is just polled.   */
+		pe->attr.wakeup_events = ctl->collect ? ctl->collect_batch : 0;
+	}
+
+	retval = _pe_update_control_state( ctl, NULL, ctl->num_events, ctx );
+
+	SUBDBG("EXIT: return: %d\n", retval);
+
+	return retval;
+}
+
+/* Map a native position back to the EventSet index the user knows */
+static int
+find_event_index( EventSetInfo_t *ESI, int evt_idx )
+{
+	int i;
+
+	for ( i = 0; i < ESI->NumberOfEvents; i++ ) {
+		if ( ESI->EventInfoArray[i].pos[0] == evt_idx ) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* Copy samples out of the rings of all streaming events */
+static int
+_pe_read_samples( EventSetInfo_t *ESI, PAPI_sample_t *samples, int max )
+{
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	int i, count = 0;
+
+	for ( i = 0; i < ctl->num_events && count < max; i++ ) {
+		if ( !ctl->events[i].streaming ) {
+			continue;
+		}
+
+		count += mmap_read_samples( &ctl->events[i],
+					    find_event_index( ESI, i ),
+					    samples + count, max - count );
+	}
+
+	return count;
+}
+
+/* Hand an EventSet's samples to the collector thread */
+/* A NULL handler turns collection off                  */
+static int
+_pe_set_collector( EventSetInfo_t *ESI, PAPI_sample_handler_t handler,
+		   void *context, int batch )
+{
+	pe_context_t *ctx;
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	int i;
+
+	ctx = ( pe_context_t *) ( ESI->master->context[ctl->cidx] );
+
+	/* Collected profiles feed the PAPI_sprofil buffers instead */
+	if ( ctl->collect && ctl->collect_handler == NULL ) {
+		return PAPI_ECNFLCT;
+	}
+
+	ctl->collect = ( handler != NULL );
+	ctl->collect_handler = handler;
+	ctl->collect_context = context;
+	ctl->collect_esi = ESI;
+	ctl->collect_batch = batch ? batch : PAPI_SAMPLE_COLLECT_BATCH;
+
+	for ( i = 0; i < ctl->num_events; i++ ) {
+		if ( ctl->events[i].streaming ) {
+			ctl->events[i].attr.wakeup_events =
+				ctl->collect ? ctl->collect_batch : 0;
+		}
+	}
+
+	return _pe_update_control_state( ctl, NULL, ctl->num_events, ctx );
+}
+
+/* Empty every streaming ring of a collected EventSet, either into */
+/* its PAPI_sprofil buffers or through the user's handler.         */
+/* Runs in the collector thread, and in the thread calling         */
+/* PAPI_stop() for the final flush.                                */
+void
+_pe_collector_drain( pe_control_t *ctl )
+{
+	EventSetInfo_t *ESI = ctl->collect_esi;
+	PAPI_sample_t batch[PAPI_SAMPLE_BATCH];
+	int i, j, n, flags, profile_index;
+	unsigned int native_index;
+
+	for ( i = 0; i < ctl->num_events; i++ ) {
+		pe_event_info_t *pe = &ctl->events[i];
+
+		if ( !pe->streaming ) {
+			continue;
+		}
+
+		profile_index = -1;
+		if ( pe->profiling &&
+		     find_profile_index( ESI, i, &flags, &native_index,
+					 &profile_index ) != PAPI_OK ) {
+			continue;
+		}
+
+		do {
+			n = mmap_read_samples( pe, find_event_index( ESI, i ),
+					       batch, PAPI_SAMPLE_BATCH );
+			if ( profile_index >= 0 ) {
+				for ( j = 0; j < n; j++ ) {
+					if ( batch[j].type & PAPI_SAMPLE_IP ) {
+						_papi_hwi_dispatch_profile( ESI,
+							( caddr_t ) ( unsigned long ) batch[j].ip,
+							0, profile_index );
+					}
+				}
+			}
+			else if ( n > 0 && ctl->collect_handler ) {
+				ctl->collect_handler( ESI->EventSetIndex, batch, n,
+						      ctl->collect_context );
+			}
+		} while ( n == PAPI_SAMPLE_BATCH );
+	}
+}
+
+/* Have the collector thread snapshot an EventSet every period ns */
+/* A zero period turns the time series off                        */
+static int
+_pe_set_timeseries( EventSetInfo_t *ESI, long long period, int records )
+{
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+
+	ctl->ts_period = period;
+	ctl->ts_records = records;
+
+	if ( period == 0 && ctl->ts ) {
+		papi_free( ctl->ts );
+		ctl->ts = NULL;
+	}
+
+	return PAPI_OK;
+}
+
+/* Copy up to max snapshots out of the ring, oldest first.  counts */
+/* gets num_events native counts per snapshot.                     */
+static int
+_pe_read_timeseries( EventSetInfo_t *ESI, long long *times,
+		     long long *counts, int max, long long *dropped )
+{
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	pe_timeseries_t *ts = ctl->ts;
+	unsigned long tail, avail;
+	long long *record;
+	int i, n;
+
+	if ( ts == NULL ) {
+		*dropped = 0;
+		return 0;
+	}
+
+	tail = ts->tail;
+	avail = ts->head - tail;
+	__sync_synchronize();
+
+	n = avail < ( unsigned long ) max ? ( int ) avail : max;
+	for ( i = 0; i < n; i++ ) {
+		record = ts->data + ( ( tail + i ) & ts->mask ) * ( ts->width + 1 );
+		times[i] = record[0];
+		memcpy( counts + i * ts->width, record + 1,
+			ts->width * sizeof ( long long ) );
+	}
+
+	/* hand the slots back only after they have been copied */
+	__sync_synchronize();
+	ts->tail = tail + n;
+	*dropped = ts->dropped;
+
+	return n;
+}
+
+/* Publish an EventSet's values to shared memory every period ns */
+/* A NULL label stops exporting and frees the slot                */
+static int
+_pe_set_export( EventSetInfo_t *ESI, const char *label, long long period )
+{
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	int ret;
+
+	/* A slot inherited across fork is the parent's: take a new one */
+	if ( ctl->export_slot && !_pe_export_owned( ctl->export_slot ) ) {
+		ctl->export_slot = NULL;
+	}
+
+	if ( label == NULL ) {
+		if ( ctl->export_slot ) {
+			_pe_export_release( ctl->export_slot );
+			ctl->export_slot = NULL;
+		}
+		ctl->export_period = 0;
+		return PAPI_OK;
+	}
+
+	if ( ctl->export_slot ) {
+		_pe_export_label( ctl->export_slot, label );
+	}
+	else {
+		ret = _pe_export_acquire( label, ESI->EventSetIndex,
+					  &ctl->export_slot );
+		if ( ret != PAPI_OK ) {
+			ctl->export_slot = NULL;
+			return ret;
+		}
+	}
+
+	ctl->export_period = period;
+	ctl->export_esi = ESI;
+
+	return PAPI_OK;
+}
+
+/* Count the EventSet on a set of cpus, every online one if cpus */
+/* is NULL.  The events are reopened on the new set right away.    */
+static int
+_pe_set_cpuset( EventSetInfo_t *ESI, const unsigned int *cpus, int num_cpus )
+{
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	pe_context_t *ctx = (pe_context_t *) ( ESI->master->context[ctl->cidx] );
+	unsigned int *set;
+	int i, ret, num_events;
+
+	/* Counts of every process on a cpu have no thread to follow, */
+	/* and nothing to send signals or samples to                   */
+	if ( ctl->attached || ctl->inherit ) {
+		return PAPI_ECNFLCT;
+	}
+	for ( i = 0; i < ctl->num_events; i++ ) {
+		if ( ctl->events[i].attr.sample_period ) {
+			return PAPI_ECNFLCT;
+		}
+	}
+
+	if ( cpus == NULL ) {
+		num_cpus = cpuset_online( &set );
+		if ( num_cpus < 0 ) {
+			return num_cpus;
+		}
+	}
+	else {
+		set = papi_malloc( num_cpus * sizeof ( unsigned int ) );
+		if ( set == NULL ) {
+			return PAPI_ENOMEM;
+		}
+		memcpy( set, cpus, num_cpus * sizeof ( unsigned int ) );
+	}
+
+	ret = check_permissions( ctl->tid, set[0], ctl->domain, PAPI_GRN_SYS,
+				 ctl->multiplexed, 0 );
+	if ( ret != PAPI_OK ) {
+		papi_free( set );
+		return ret;
+	}
+
+	/* Close the events on the old set before switching */
+	num_events = ctl->num_events;
+	close_pe_events( ctx, ctl );
+	if ( ctl->cpus ) {
+		papi_free( ctl->cpus );
+	}
+	ctl->cpus = set;
+	ctl->num_cpus = num_cpus;
+
+	if ( num_events == 0 ) {
+		return PAPI_OK;
+	}
+
+	ret = _pe_update_control_state( ctl, NULL, num_events, ctx );
+	if ( ret != PAPI_OK ) {
+		/* Fall back to counting as before the call */
+		papi_free( ctl->cpus );
+		ctl->cpus = NULL;
+		ctl->num_cpus = 0;
+		_pe_update_control_state( ctl, NULL, num_events, ctx );
+	}
+
+	return ret;
+}
+
+/* The cpu set lasts until the EventSet is cleaned up */
+static int
+_pe_cleanup_eventset( hwd_control_state_t *ctl )
+{
+	pe_control_t *pe_ctl = ( pe_control_t *) ctl;
+
+	/* Its events are still open; without the set, */
+	/* close_pe_events would not know to close them */
+	if ( pe_ctl->num_cpus ) {
+		close_pe_cpuset( pe_ctl );
+	}
+	if ( pe_ctl->cpus ) {
+		papi_free( pe_ctl->cpus );
+		pe_ctl->cpus = NULL;
+	}
+	pe_ctl->num_cpus = 0;
+
+	return PAPI_OK;
+}
+
+/* Read every cpu of the set.  counts is pointed at num_cpus rows of */
+/* num_events native counts, cpus at the cpu numbers of the rows.    */
+static int
+_pe_read_cpuset( EventSetInfo_t *ESI, unsigned int **cpus, long long **counts )
+{
+	pe_control_t *ctl = (pe_control_t *) ( ESI->ctl_state );
+	int ret;
+
+	if ( ctl->num_cpus == 0 || ctl->cpu_fds == NULL ) {
+		return PAPI_EINVAL;
+	}
+
+	ret = _pe_read_cpu_groups( ctl, ctl->counts );
+	if ( ret != PAPI_OK ) {
+		return ret;
+	}
+
+	*cpus = ctl->cpus;
+	*counts = ctl->cpu_counts;
+
+	return ctl->num_cpus;
+}
+
 /* Enable/disable profiling */
 /* If threshold is zero, we disable */
 static int
 _pe_set_profile( EventSetInfo_t *ESI, int EventIndex, int threshold )
 {
 	int ret;
-	int evt_idx;
+	int i, evt_idx;
 	pe_control_t *ctl = ( pe_control_t *) ( ESI->ctl_state );
 
 	/* Since you can't profile on a derived event,	*/
@@ -2264,9 +3283,36 @@ _pe_set_profile( EventSetInfo_t *ESI, int EventIndex, int threshold )
 			/* Linux currently does not have this ability. FIXME */
 			return PAPI_ENOSUPP;
 		}
+
+		/* One EventSet cannot feed both a handler and profiles */
+		if ( ( ESI->profile.flags & PAPI_PROFIL_COLLECTOR ) &&
+		     ctl->collect_handler ) {
+			return PAPI_ECNFLCT;
+		}
 		ctl->events[evt_idx].profiling=1;
 	}
 
+	/* Collected profiles stream through the ring like PAPI_sample_set() */
+	/* and never arm the overflow signal.                                */
+	if ( ESI->profile.flags & PAPI_PROFIL_COLLECTOR ) {
+		if ( threshold ) {
+			ctl->collect = 1;
+			ctl->collect_esi = ESI;
+			ctl->collect_batch = PAPI_SAMPLE_COLLECT_BATCH;
+		}
+		ret = _pe_set_sampling( ESI, EventIndex, threshold,
+					PAPI_SAMPLE_IP, 0 );
+		if ( threshold == 0 ) {
+			ctl->collect = 0;
+			for ( i = 0; i < ctl->num_events; i++ ) {
+				if ( ctl->events[i].streaming ) {
+					ctl->collect = 1;
+				}
+			}
+		}
+		return ret;
+	}
+
 	ret = _pe_set_overflow( ESI, EventIndex, threshold );
 	if ( ret != PAPI_OK ) return ret;
 
@@ -2281,6 +3327,10 @@ _pe_set_profile( EventSetInfo_t *ESI, int EventIndex, int threshold )
 static int
 _pe_shutdown_component( void ) {
 
+	/* stop the sample collector thread, if it ever ran */
+	_pe_collector_shutdown(  );
+	_pe_export_shutdown(  );
+
 	/* deallocate our event table */
 	_pe_libpfm4_shutdown(&_perf_event_vector, &perf_native_event_table);
 
@@ -2626,10 +3676,19 @@ papi_vector_t _perf_event_vector = {
   .shutdown_thread =       _pe_shutdown_thread,
   .ctl =                   _pe_ctl,
   .update_control_state =  _pe_update_control_state,
+  .cleanup_eventset =      _pe_cleanup_eventset,
   .set_domain =            _pe_set_domain,
   .reset =                 _pe_reset,
   .set_overflow =          _pe_set_overflow,
   .set_profile =           _pe_set_profile,
+  .set_sampling =          _pe_set_sampling,
+  .read_samples =          _pe_read_samples,
+  .set_collector =         _pe_set_collector,
+  .set_timeseries =        _pe_set_timeseries,
+  .read_timeseries =       _pe_read_timeseries,
+  .set_export =            _pe_set_export,
+  .set_cpuset =            _pe_set_cpuset,
+  .read_cpuset =           _pe_read_cpuset,
   .stop_profiling =        _pe_stop_profiling,
   .write =                 _pe_write,
 
@@ -13,6 +13,8 @@ typedef struct
   int event_opened;               /* event successfully opened            */
   int profiling;                  /* event is profiling                   */
   int sampling;			  /* event is a sampling event            */
+  int streaming;                  /* samples are polled, not signalled    */
+  uint32_t ring_pages;            /* data pages of a streaming ring       */
   uint32_t nr_mmap_pages;         /* number pages in the mmap buffer      */
   void *mmap_buf;                 /* used for control/profiling           */
   uint64_t tail;                  /* current read location in mmap buffer */
@@ -22,6 +24,18 @@ typedef struct
 } pe_event_info_t;
 
 
+/* Periodic snapshots of an EventSet.  The collector thread is the  */
+/* only writer of head, the thread reading the series the only one   */
+/* of tail, so neither side needs a lock.                            */
+typedef struct {
+  unsigned long mask;             /* records - 1, records a power of 2 */
+  int width;                      /* counts per record                 */
+  volatile unsigned long head;    /* next record to fill               */
+  volatile unsigned long tail;    /* next record to hand out           */
+  volatile long long dropped;     /* snapshots lost to a full ring     */
+  long long data[1];              /* records of timestamp, counts      */
+} pe_timeseries_t;
+
 typedef struct {
   int num_events;                 /* number of events in control state */
   unsigned int domain;            /* control-state wide domain         */
@@ -34,6 +48,23 @@ typedef struct {
   int cidx;                       /* current component                 */
   int cpu;                        /* which cpu to measure              */
   pid_t tid;                      /* thread we are monitoring          */
+  unsigned int collect;           /* rings drained by collector thread */
+  int collect_batch;              /* samples per collector wakeup      */
+  PAPI_sample_handler_t collect_handler; /* receives collected samples */
+  void *collect_context;          /* passed through to the handler     */
+  EventSetInfo_t *collect_esi;    /* EventSet owning this state        */
+  long long ts_period;            /* ns between snapshots, 0 for none  */
+  int ts_records;                 /* snapshots the ring holds          */
+  int ts_fd;                      /* timerfd pacing the snapshots      */
+  pe_timeseries_t *ts;            /* snapshot ring                     */
+  long long export_period;        /* ns between exports, 0 for none    */
+  int export_fd;                  /* timerfd pacing the exports        */
+  PAPI_export_slot_t *export_slot; /* shared memory slot we fill       */
+  EventSetInfo_t *export_esi;     /* EventSet owning this state        */
+  int num_cpus;                   /* cpus of the cpu set, 0 for none   */
+  unsigned int *cpus;             /* the cpus, in the order given      */
+  int *cpu_fds;                   /* a row of num_events fds per cpu   */
+  long long *cpu_counts;          /* a row of num_events counts per cpu */
   pe_event_info_t events[PERF_EVENT_MAX_MPX_COUNTERS];
   long long counts[PERF_EVENT_MAX_MPX_COUNTERS];
 } pe_control_t;
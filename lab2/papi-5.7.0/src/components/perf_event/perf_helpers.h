@@ -288,3 +288,174 @@ mmap_read( int cidx, ThreadInfo_t **thr, pe_event_info_t *pe,
 }
 
 
+
+/* Copy len bytes starting at ring position pos, following the wrap */
+/* from the end of the data pages back to their start.              */
+static void
+mmap_ring_copy( pe_event_info_t *pe, uint64_t pos, void *dst, size_t len )
+{
+	unsigned char *data = ((unsigned char*)pe->mmap_buf) + getpagesize();
+	size_t offset = pos & pe->mask;
+	size_t first = min( pe->mask + 1 - offset, len );
+
+	memcpy( dst, &data[offset], first );
+	if ( len > first ) {
+		memcpy( ((unsigned char*)dst) + first, data, len - first );
+	}
+}
+
+static uint64_t
+mmap_ring_u64( pe_event_info_t *pe, uint64_t *pos )
+{
+	uint64_t value;
+
+	mmap_ring_copy( pe, *pos, &value, sizeof ( value ) );
+	*pos += sizeof ( value );
+
+	return value;
+}
+
+/* Decode one PERF_RECORD_SAMPLE body at pos into a PAPI_sample_t.    */
+/* Fields appear in the order of include/uapi/linux/perf_event.h, and */
+/* only the ones requested in attr.sample_type are present.           */
+static void
+mmap_decode_sample( pe_event_info_t *pe, uint64_t pos, PAPI_sample_t *s )
+{
+	uint64_t type = pe->attr.sample_type;
+	uint64_t nr, ip, i;
+
+	s->type = 0;
+	s->nr_callchain = 0;
+
+	if ( type & PERF_SAMPLE_IP ) {
+		s->ip = ( long long ) mmap_ring_u64( pe, &pos );
+		s->type |= PAPI_SAMPLE_IP;
+	}
+	if ( type & PERF_SAMPLE_TID ) {
+		uint32_t ids[2];
+
+		mmap_ring_copy( pe, pos, ids, sizeof ( ids ) );
+		pos += sizeof ( ids );
+		s->pid = ( int ) ids[0];
+		s->tid = ( int ) ids[1];
+		s->type |= PAPI_SAMPLE_TID;
+	}
+	if ( type & PERF_SAMPLE_TIME ) {
+		s->time = ( long long ) mmap_ring_u64( pe, &pos );
+		s->type |= PAPI_SAMPLE_TIME;
+	}
+	if ( type & PERF_SAMPLE_ADDR ) {
+		s->addr = ( long long ) mmap_ring_u64( pe, &pos );
+		s->type |= PAPI_SAMPLE_ADDR;
+	}
+	if ( type & PERF_SAMPLE_READ ) {
+		uint64_t format = pe->attr.read_format;
+
+		/* Only group leaders read with PERF_FORMAT_GROUP, so in */
+		/* either layout the first value is the sampled event.   */
+		nr = ( format & PERF_FORMAT_GROUP ) ? mmap_ring_u64( pe, &pos ) : 1;
+		if ( format & PERF_FORMAT_GROUP ) {
+			if ( format & PERF_FORMAT_TOTAL_TIME_ENABLED ) {
+				pos += sizeof ( uint64_t );
+			}
+			if ( format & PERF_FORMAT_TOTAL_TIME_RUNNING ) {
+				pos += sizeof ( uint64_t );
+			}
+		}
+		s->value = ( long long ) mmap_ring_u64( pe, &pos );
+		if ( !( format & PERF_FORMAT_GROUP ) ) {
+			if ( format & PERF_FORMAT_TOTAL_TIME_ENABLED ) {
+				pos += sizeof ( uint64_t );
+			}
+			if ( format & PERF_FORMAT_TOTAL_TIME_RUNNING ) {
+				pos += sizeof ( uint64_t );
+			}
+		}
+		/* PAPI never sets PERF_FORMAT_ID */
+		pos += ( nr - 1 ) * sizeof ( uint64_t );
+		s->type |= PAPI_SAMPLE_READ;
+	}
+	if ( type & PERF_SAMPLE_CALLCHAIN ) {
+		nr = mmap_ring_u64( pe, &pos );
+		for ( i = 0; i < nr; i++ ) {
+			ip = mmap_ring_u64( pe, &pos );
+			/* Skip the PERF_CONTEXT_* markers between kernel and user */
+			if ( ip >= ( uint64_t ) PERF_CONTEXT_MAX ) {
+				continue;
+			}
+			if ( s->nr_callchain < PAPI_MAX_SAMPLE_CALLCHAIN ) {
+				s->callchain[s->nr_callchain++] = ( long long ) ip;
+			}
+		}
+		s->type |= PAPI_SAMPLE_CALLCHAIN;
+	}
+}
+
+/* Move up to max records from a streaming ring into samples and hand */
+/* the space back to the kernel.  Unlike mmap_read() this walks every */
+/* record from the tail, so nothing is skipped, and it never touches  */
+/* the event itself: there is no DISABLE/REFRESH round trip.          */
+static int
+mmap_read_samples( pe_event_info_t *pe, int event_index,
+		   PAPI_sample_t *samples, int max )
+{
+	struct perf_event_mmap_page *pc = pe->mmap_buf;
+	struct perf_event_header header;
+	uint64_t head, body, pos = pe->tail;
+	int count = 0;
+
+	if ( pc == NULL ) {
+		return 0;
+	}
+
+	head = pc->data_head;
+	rmb();
+
+	while ( pos != head && count < max ) {
+		mmap_ring_copy( pe, pos, &header, sizeof ( header ) );
+
+		/* A corrupt header would send us wandering; resync at head */
+		if ( header.size < sizeof ( header ) ||
+		     header.size > head - pos ) {
+			SUBDBG( "bad record size %d, discarding ring\n",
+				header.size );
+			pos = head;
+			break;
+		}
+
+		switch ( header.type ) {
+			case PERF_RECORD_SAMPLE:
+				mmap_decode_sample( pe, pos + sizeof ( header ),
+						    &samples[count] );
+				samples[count].event_index = event_index;
+				count++;
+				break;
+
+			case PERF_RECORD_LOST:
+				samples[count].event_index = event_index;
+				samples[count].type = PAPI_SAMPLE_LOST;
+				samples[count].nr_callchain = 0;
+				/* The body is { u64 id; u64 lost; } */
+				body = pos + sizeof ( header ) + sizeof ( uint64_t );
+				samples[count].value =
+					( long long ) mmap_ring_u64( pe, &body );
+				count++;
+				break;
+
+			default:
+				SUBDBG( "skipping record type %d\n", header.type );
+				break;
+		}
+
+		pos += header.size;
+	}
+
+	pe->tail = pos;
+
+	/* All reads of the records must complete before the kernel may */
+	/* reuse their space.                                           */
+	__sync_synchronize();
+	pc->data_tail = pos;
+
+	return count;
+}
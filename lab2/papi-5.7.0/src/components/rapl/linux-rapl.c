@@ -13,10 +13,25 @@
  *  (https://github.com/scalability-llnl/msr-safe), or
  *  the x86 generic MSR driver must be installed
  *    (CONFIG_X86_MSR) and the /dev/cpu/?/<msr_safe | msr> files must have read permissions
+ *
+ *  The energy status MSRs are only 32 bits wide and wrap in minutes on a
+ *  busy socket.  Once an energy event is started a background thread
+ *  sweeps them, package by package, often enough that no counter can
+ *  wrap twice between two sweeps, and keeps a 64-bit total for each.
+ *  Start, read and stop work on those totals.
+ *
+ *  PAPI_RAPL_MSR_DIR replaces /dev/cpu, so the component can be pointed
+ *  at a tree of fake <cpu>/msr files for testing.
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/timerfd.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <string.h>
@@ -110,9 +125,20 @@ typedef struct _rapl_native_event_entry
   int msr;
   int type;
   int return_type;
+  int slot;		/* energy slot it is read from, -1 if none */
   _rapl_register_t resources;
 } _rapl_native_event_entry_t;
 
+/* One 32-bit energy status MSR, extended to 64 bits by the accumulator */
+typedef struct _rapl_energy_slot
+{
+  int fd_offset;
+  unsigned int msr;
+  unsigned int last;		/* raw value at the last update */
+  long long total;		/* counts since the first update */
+  unsigned int sweep;		/* sweep that last updated it */
+} _rapl_energy_slot_t;
+
 typedef struct _rapl_reg_alloc
 {
 	_rapl_register_t ra_bits;
@@ -132,7 +158,7 @@ typedef struct _rapl_control_state
 
 typedef struct _rapl_context
 {
-  long long start_value[RAPL_MAX_COUNTERS];
+  long long start_value[RAPL_MAX_COUNTERS];	/* slot totals at start */
   _rapl_control_state_t state;
 } _rapl_context_t;
 
@@ -153,6 +179,32 @@ int power_divisor,time_divisor;
 int cpu_energy_divisor,dram_energy_divisor;
 unsigned int msr_rapl_power_unit;
 
+static char msr_dir[PATH_MAX];
+
+/* Energy accumulator; slots are grouped by package */
+static _rapl_energy_slot_t *energy_slots=NULL;
+static int num_slots=0;
+static unsigned int rapl_sweep=0;
+static long long accum_interval_ns=0;
+
+/* accum_ctl_lock serializes starting and stopping the thread, so */
+/* it can be joined without holding accum_lock, which guards the   */
+/* slots the thread updates.                                       */
+static pthread_mutex_t accum_ctl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t accum_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t accum_thread;
+static pid_t accum_pid;
+static int accum_running=0;
+static int accum_users=0;
+static int accum_timer=-1;
+static int accum_wake[2] = { -1, -1 };
+
+/* Bounds on the sweep interval, and the power assumed when the */
+/* package does not report a maximum                            */
+#define RAPL_MIN_INTERVAL_NS	1000000LL
+#define RAPL_MAX_INTERVAL_NS	60000000000LL
+#define RAPL_DEFAULT_MAX_POWER	500.0
+
 #define PACKAGE_ENERGY      	0
 #define PACKAGE_THERMAL     	1
 #define PACKAGE_MINIMUM     	2
@@ -190,10 +242,10 @@ static int open_fd(int offset) {
   char filename[BUFSIZ];
 
   if (fd_array[offset].open==0) {
-	  sprintf(filename,"/dev/cpu/%d/msr_safe",offset);
+	  sprintf(filename,"%s/%d/msr_safe",msr_dir,offset);
       fd = open(filename, O_RDONLY);
 	  if (fd<0) {
-		  sprintf(filename,"/dev/cpu/%d/msr",offset);
+		  sprintf(filename,"%s/%d/msr",msr_dir,offset);
           fd = open(filename, O_RDONLY);
 	  }
 	  if (fd>=0) {
@@ -217,6 +269,241 @@ static long long read_rapl_value(int index) {
 
 }
 
+/* Fold the current value of an energy MSR into its 64-bit total.   */
+/* Unsigned 32-bit subtraction absorbs one wrap, and the sweeps come */
+/* often enough that there is never more than one.                  */
+/* Called with accum_lock held.                                     */
+static void update_slot(_rapl_energy_slot_t *slot) {
+
+   unsigned int now;
+
+   now=(unsigned int)read_msr(fd_array[slot->fd_offset].fd,slot->msr);
+   slot->total+=(unsigned int)(now-slot->last);
+   slot->last=now;
+   slot->sweep=rapl_sweep;
+}
+
+/* Bring the slots of the measured events up to date, reading */
+/* each MSR once even if several events share it.             */
+/* Called with accum_lock held.                               */
+static void update_measured_slots(_rapl_control_state_t *control) {
+
+   int i, slot;
+
+   rapl_sweep++;
+   for(i=0;i<num_events && i<RAPL_MAX_COUNTERS;i++) {
+      slot=rapl_native_events[i].slot;
+      if (control->being_measured[i] && slot>=0 &&
+          energy_slots[slot].sweep!=rapl_sweep) {
+         update_slot(&energy_slots[slot]);
+      }
+   }
+}
+
+static void *accum_main(void *arg) {
+
+   struct pollfd fds[2];
+   uint64_t expired;
+   int i;
+
+   (void) arg;
+
+   fds[0].fd=accum_wake[0];
+   fds[0].events=POLLIN;
+   fds[1].fd=accum_timer;
+   fds[1].events=POLLIN;
+
+   for(;;) {
+      if (poll(fds,2,-1)<0) {
+         if (errno==EINTR) continue;
+         PAPIERROR("rapl accumulator poll() failed: %s",strerror(errno));
+         break;
+      }
+
+      /* Anything on the wakeup pipe means shut down */
+      if (fds[0].revents & POLLIN) break;
+
+      if (read(accum_timer,&expired,sizeof(expired))!=sizeof(expired)) {
+         continue;
+      }
+
+      /* Slots are grouped by package, so each package's */
+      /* MSRs are read back to back on its own fd.       */
+      pthread_mutex_lock(&accum_lock);
+      rapl_sweep++;
+      for(i=0;i<num_slots;i++) {
+         update_slot(&energy_slots[i]);
+      }
+      pthread_mutex_unlock(&accum_lock);
+   }
+
+   return NULL;
+}
+
+/* Start the accumulator for the first running EventSet.  Called */
+/* with accum_ctl_lock and accum_lock held.                       */
+static int accum_start(void) {
+
+   struct itimerspec its;
+   sigset_t all, old;
+   int i, ret;
+
+   /* Baseline for the sweeps to come */
+   rapl_sweep++;
+   for(i=0;i<num_slots;i++) {
+      energy_slots[i].last=(unsigned int)
+         read_msr(fd_array[energy_slots[i].fd_offset].fd,energy_slots[i].msr);
+      energy_slots[i].sweep=rapl_sweep;
+   }
+
+   accum_timer=timerfd_create(CLOCK_MONOTONIC,TFD_NONBLOCK|TFD_CLOEXEC);
+   if (accum_timer<0) return PAPI_ESYS;
+
+   its.it_interval.tv_sec=accum_interval_ns/1000000000LL;
+   its.it_interval.tv_nsec=accum_interval_ns%1000000000LL;
+   its.it_value=its.it_interval;
+   if ((timerfd_settime(accum_timer,0,&its,NULL)<0) ||
+       (pipe(accum_wake)<0)) {
+      close(accum_timer);
+      accum_timer=-1;
+      return PAPI_ESYS;
+   }
+
+   /* Keep PAPI's overflow and multiplex signals away from the thread */
+   sigfillset(&all);
+   pthread_sigmask(SIG_SETMASK,&all,&old);
+   ret=pthread_create(&accum_thread,NULL,accum_main,NULL);
+   pthread_sigmask(SIG_SETMASK,&old,NULL);
+
+   if (ret!=0) {
+      close(accum_timer);
+      close(accum_wake[0]);
+      close(accum_wake[1]);
+      accum_timer=accum_wake[0]=accum_wake[1]=-1;
+      return PAPI_ESYS;
+   }
+
+   accum_pid=getpid();
+   accum_running=1;
+   SUBDBG("RAPL accumulator sweeping %d MSRs every %lld ns\n",
+          num_slots,accum_interval_ns);
+
+   return PAPI_OK;
+}
+
+/* Stop the accumulator once no EventSet is running.  Called with */
+/* accum_ctl_lock held and accum_lock released, as the thread      */
+/* takes it on every sweep.                                        */
+static void accum_stop(void) {
+
+   char c=0;
+
+   if (!accum_running) return;
+
+   if (write(accum_wake[1],&c,1)!=1) {
+      PAPIERROR("rapl accumulator wakeup failed: %s",strerror(errno));
+   }
+   pthread_join(accum_thread,NULL);
+   close(accum_timer);
+   close(accum_wake[0]);
+   close(accum_wake[1]);
+   accum_timer=accum_wake[0]=accum_wake[1]=-1;
+   accum_running=0;
+}
+
+/* A child of fork() inherits the accumulator's state but not its */
+/* thread; waking or joining it from here would stop the parent's */
+/* thread.  Drop the child's copies and let it start its own.     */
+/* Called with accum_ctl_lock and accum_lock held.                */
+static void accum_forget_forked(void) {
+
+   if (!accum_running || accum_pid==getpid()) return;
+
+   close(accum_timer);
+   close(accum_wake[0]);
+   close(accum_wake[1]);
+   accum_timer=accum_wake[0]=accum_wake[1]=-1;
+   accum_running=0;
+   accum_users=0;
+}
+
+/* Give every energy MSR a slot, grouped by package, and derive the */
+/* sweep interval: a quarter of the time the smallest energy unit   */
+/* takes to wrap 32 bits at the package's maximum power.            */
+static int setup_energy_slots(int *cpu_to_use, int intel) {
+
+   int i, j, k;
+   long long info;
+   double max_power=0.0, power, wrap;
+   int divisor;
+
+   energy_slots=papi_calloc(num_events, sizeof(_rapl_energy_slot_t));
+   if (energy_slots==NULL) return PAPI_ENOMEM;
+
+   for(i=0;i<num_events;i++) {
+      rapl_native_events[i].slot=-1;
+   }
+
+   for(j=0;j<num_packages;j++) {
+      for(i=0;i<num_events;i++) {
+         if (rapl_native_events[i].fd_offset!=cpu_to_use[j]) continue;
+         if (rapl_native_events[i].type!=PACKAGE_ENERGY &&
+             rapl_native_events[i].type!=DRAM_ENERGY &&
+             rapl_native_events[i].type!=PLATFORM_ENERGY &&
+             rapl_native_events[i].type!=PACKAGE_ENERGY_CNT) continue;
+
+         for(k=0;k<num_slots;k++) {
+            if (energy_slots[k].fd_offset==cpu_to_use[j] &&
+                energy_slots[k].msr==(unsigned int)rapl_native_events[i].msr) {
+               break;
+            }
+         }
+         if (k==num_slots) {
+            energy_slots[k].fd_offset=cpu_to_use[j];
+            energy_slots[k].msr=rapl_native_events[i].msr;
+            num_slots++;
+         }
+         rapl_native_events[i].slot=k;
+      }
+
+      if (open_fd(cpu_to_use[j])<0) {
+         sprintf(_rapl_vector.cmp_info.disabled_reason,
+                 "Can't open fd for cpu%d: %s",cpu_to_use[j],strerror(errno));
+         return PAPI_ESYS;
+      }
+
+      /* Fall back to twice the thermal spec when no maximum is given */
+      if (intel &&
+          pread(fd_array[cpu_to_use[j]].fd, &info, sizeof info,
+                MSR_PKG_POWER_INFO) == sizeof info) {
+         power=(double)((info>>MAXIMUM_POWER_SHIFT)&POWER_INFO_UNIT_MASK);
+         if (power==0.0) {
+            power=2.0*(double)((info>>THERMAL_SHIFT)&POWER_INFO_UNIT_MASK);
+         }
+         power/=power_divisor;
+         if (power>max_power) max_power=power;
+      }
+   }
+
+   if (max_power==0.0) max_power=RAPL_DEFAULT_MAX_POWER;
+
+   divisor=(cpu_energy_divisor>dram_energy_divisor)?
+           cpu_energy_divisor:dram_energy_divisor;
+   wrap=4294967296.0/divisor/max_power;
+   accum_interval_ns=(long long)(wrap/4.0*1e9);
+   if (accum_interval_ns<RAPL_MIN_INTERVAL_NS) {
+      accum_interval_ns=RAPL_MIN_INTERVAL_NS;
+   }
+   if (accum_interval_ns>RAPL_MAX_INTERVAL_NS) {
+      accum_interval_ns=RAPL_MAX_INTERVAL_NS;
+   }
+
+   SUBDBG("%d energy MSRs, max power %.1fW, wrap %.1fs\n",
+          num_slots,max_power,wrap);
+
+   return PAPI_OK;
+}
+
 static long long convert_rapl_energy(int index, long long value) {
 
    union {
@@ -320,7 +607,7 @@ _rapl_init_thread( hwd_context_t *ctx )
 static int
 _rapl_init_component( int cidx )
 {
-     int i,j,k,fd;
+     int i,j,k,fd,retval;
      FILE *fff;
      char filename[BUFSIZ];
 
@@ -331,6 +618,7 @@ _rapl_init_component( int cidx )
      int package;
 
      const PAPI_hw_info_t *hw_info;
+     char *env;
 
      int nr_cpus = get_kernel_nr_cpus();
      int packages[nr_cpus];
@@ -346,6 +634,9 @@ _rapl_init_component( int cidx )
      }
 
 
+	env=getenv("PAPI_RAPL_MSR_DIR");
+	snprintf(msr_dir,sizeof(msr_dir),"%s",env?env:"/dev/cpu");
+
 	/* check if supported processor */
 	hw_info=&(_papi_hwi_system_info.hw_info);
 
@@ -858,6 +1149,10 @@ _rapl_init_component( int cidx )
 		}
      }
 
+     retval=setup_energy_slots(cpu_to_use,
+                               hw_info->vendor==PAPI_VENDOR_INTEL);
+     if (retval!=PAPI_OK) return retval;
+
      /* Export the total number of events available */
      _rapl_vector.cmp_info.num_native_events = num_events;
 
@@ -896,21 +1191,35 @@ _rapl_start( hwd_context_t *ctx, hwd_control_state_t *ctl)
   _rapl_context_t* context = (_rapl_context_t*) ctx;
   _rapl_control_state_t* control = (_rapl_control_state_t*) ctl;
   long long now = PAPI_get_real_usec();
-  int i;
+  int i, ret = PAPI_OK;
 
-  for( i = 0; i < RAPL_MAX_COUNTERS; i++ ) {
-     if ((control->being_measured[i]) && (control->need_difference[i])) {
-        context->start_value[i]=read_rapl_value(i);
+  pthread_mutex_lock(&accum_ctl_lock);
+  pthread_mutex_lock(&accum_lock);
+  accum_forget_forked();
+  if (!accum_running && num_slots>0) {
+     ret = accum_start();
+  }
+  if (ret == PAPI_OK) {
+     if (accum_running) accum_users++;
+     update_measured_slots(control);
+     for( i = 0; i < RAPL_MAX_COUNTERS; i++ ) {
+        if ((control->being_measured[i]) && (control->need_difference[i])) {
+           context->start_value[i]=
+              energy_slots[rapl_native_events[i].slot].total;
+        }
      }
   }
+  pthread_mutex_unlock(&accum_lock);
+  pthread_mutex_unlock(&accum_ctl_lock);
 
   control->lastupdate = now;
 
-  return PAPI_OK;
+  return ret;
 }
 
-static int
-_rapl_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
+/* Bring the counts of a running EventSet up to date */
+static void
+rapl_update( hwd_context_t *ctx, hwd_control_state_t *ctl )
 {
 
     /* read values */
@@ -920,25 +1229,46 @@ _rapl_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
     int i;
     long long temp;
 
+    /* Energy comes from the 64-bit totals, so no wrap to correct for */
+    pthread_mutex_lock(&accum_lock);
+    update_measured_slots(control);
+    for ( i = 0; i < RAPL_MAX_COUNTERS; i++ ) {
+		if (control->being_measured[i] && control->need_difference[i]) {
+			control->count[i] =
+				energy_slots[rapl_native_events[i].slot].total -
+				context->start_value[i];
+		}
+    }
+    pthread_mutex_unlock(&accum_lock);
+
     for ( i = 0; i < RAPL_MAX_COUNTERS; i++ ) {
 		if (control->being_measured[i]) {
-			temp = read_rapl_value(i);
-			if (context->start_value[i])
 			if (control->need_difference[i]) {
-				/* test for wrap around */
-				if (temp < context->start_value[i] ) {
-	        		SUBDBG("Wraparound!\nstart:\t%#016x\ttemp:\t%#016x",
-	        			(unsigned)context->start_value[i], (unsigned)temp);
-	           		temp += (0x100000000 - context->start_value[i]);
-	           		SUBDBG("\tresult:\t%#016x\n", (unsigned)temp);
-		  		} else {
-					temp -= context->start_value[i];
-		  		}
+				temp = control->count[i];
+			} else {
+				temp = read_rapl_value(i);
 			}
 			control->count[i] = convert_rapl_energy( i, temp );
 		}
     }
     control->lastupdate = now;
+}
+
+static int
+_rapl_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
+{
+    int last;
+
+    rapl_update( ctx, ctl );
+
+    pthread_mutex_lock(&accum_ctl_lock);
+    pthread_mutex_lock(&accum_lock);
+    accum_forget_forked();
+    last = accum_running && (--accum_users == 0);
+    pthread_mutex_unlock(&accum_lock);
+    if (last) accum_stop();
+    pthread_mutex_unlock(&accum_ctl_lock);
+
     return PAPI_OK;
 }
 
@@ -956,7 +1286,7 @@ _rapl_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
 {
     (void) flags;
 
-    _rapl_stop( ctx, ctl );
+    rapl_update( ctx, ctl );
 
     /* Pass back a pointer to our results */
     *events = ((_rapl_control_state_t*) ctl)->count;
@@ -973,6 +1303,17 @@ _rapl_shutdown_component( void )
 {
     int i;
 
+    pthread_mutex_lock(&accum_ctl_lock);
+    pthread_mutex_lock(&accum_lock);
+    accum_forget_forked();
+    accum_users=0;
+    pthread_mutex_unlock(&accum_lock);
+    accum_stop();
+    pthread_mutex_unlock(&accum_ctl_lock);
+    if (energy_slots) papi_free(energy_slots);
+    energy_slots=NULL;
+    num_slots=0;
+
     if (rapl_native_events) papi_free(rapl_native_events);
     if (fd_array) {
        for(i=0;i<num_cpus;i++) {
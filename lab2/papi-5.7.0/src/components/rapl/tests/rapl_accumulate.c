@@ -0,0 +1,225 @@
+/****************************/
+/* THIS IS OPEN SOURCE CODE */
+/****************************/
+
+/**
+ * test case for the RAPL energy accumulator
+ *
+ * @brief
+ *   Points the RAPL component at a tree of fake MSR files through
+ *   PAPI_RAPL_MSR_DIR and advances the package energy counter in
+ *   steps, wrapping it several times during one measurement.  The
+ *   total must come out exact, which it only does if the accumulator
+ *   catches every wrap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+/* Registers the component reads, Intel and AMD */
+static const unsigned int energy_msrs[] = {
+	0x611, 0x619, 0x639, 0x641, 0x64d, 0xc001029A, 0xc001029B
+};
+
+#define NUM_ENERGY_MSRS (int)(sizeof(energy_msrs)/sizeof(energy_msrs[0]))
+
+/* 2^-26 J units and a 32767 W maximum power: the counter wraps every */
+/* 64 J, in well under a second, so the sweeps are milliseconds apart */
+#define ENERGY_UNIT	26
+#define UNIT_VALUE	((10ULL<<16)|((unsigned long long)ENERGY_UNIT<<8))
+#define POWER_INFO	(0x7fffULL<<32)
+
+#define STEP		0x60000000ULL	/* 3/8 of a wrap */
+#define NUM_STEPS	16
+
+static char msr_dir[] = "/tmp/papi_raplXXXXXX";
+static int num_cpus = 0;
+
+static void write_msr(int cpu, unsigned int msr, unsigned long long value) {
+
+	char filename[PATH_MAX];
+	int fd;
+
+	snprintf(filename,sizeof(filename),"%s/%d/msr",msr_dir,cpu);
+	fd=open(filename,O_WRONLY|O_CREAT,0600);
+	if (fd<0 || pwrite(fd,&value,sizeof(value),msr)!=sizeof(value)) {
+		test_fail(__FILE__,__LINE__,"Writing fake MSR",0);
+	}
+	close(fd);
+}
+
+static void set_energy(unsigned long long value) {
+
+	int cpu, i;
+
+	for(cpu=0;cpu<num_cpus;cpu++) {
+		for(i=0;i<NUM_ENERGY_MSRS;i++) {
+			write_msr(cpu,energy_msrs[i],value&0xffffffffULL);
+		}
+	}
+}
+
+static void make_tree(void) {
+
+	char filename[PATH_MAX];
+	int cpu;
+
+	if (mkdtemp(msr_dir)==NULL) {
+		test_skip(__FILE__,__LINE__,"mkdtemp",PAPI_ESYS);
+	}
+
+	/* One msr file per cpu the component may pick for a package */
+	for(cpu=0;;cpu++) {
+		snprintf(filename,sizeof(filename),
+			"/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+			cpu);
+		if (access(filename,R_OK)!=0) break;
+
+		snprintf(filename,sizeof(filename),"%s/%d",msr_dir,cpu);
+		mkdir(filename,0700);
+		write_msr(cpu,0x606,UNIT_VALUE);
+		write_msr(cpu,0xc0010299,UNIT_VALUE);
+		write_msr(cpu,0x614,POWER_INFO);
+	}
+	num_cpus=cpu;
+}
+
+static void remove_tree(void) {
+
+	char filename[PATH_MAX];
+	int cpu;
+
+	for(cpu=0;cpu<num_cpus;cpu++) {
+		snprintf(filename,sizeof(filename),"%s/%d/msr",msr_dir,cpu);
+		unlink(filename);
+		snprintf(filename,sizeof(filename),"%s/%d",msr_dir,cpu);
+		rmdir(filename);
+	}
+	rmdir(msr_dir);
+}
+
+int main (int argc, char **argv)
+{
+	int retval, cid, numcmp, i;
+	int EventSet = PAPI_NULL;
+	long long values[2], expected;
+	unsigned long long energy;
+	const PAPI_component_info_t *cmpinfo = NULL;
+	double joules;
+
+	tests_quiet( argc, argv );
+
+	make_tree();
+	energy=0xfff00000ULL;		/* just short of the first wrap */
+	set_energy(energy);
+	setenv("PAPI_RAPL_MSR_DIR",msr_dir,1);
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail(__FILE__, __LINE__,"PAPI_library_init failed\n",retval);
+	}
+
+	numcmp = PAPI_num_components();
+	for(cid=0; cid<numcmp; cid++) {
+		cmpinfo = PAPI_get_component_info(cid);
+		if (cmpinfo && strstr(cmpinfo->name,"rapl")) break;
+	}
+
+	if (cid==numcmp) {
+		remove_tree();
+		test_skip(__FILE__,__LINE__,"No rapl component found\n",0);
+	}
+	if (cmpinfo->disabled) {
+		if (!TESTS_QUIET) {
+			printf("RAPL component disabled: %s\n",
+				cmpinfo->disabled_reason);
+		}
+		remove_tree();
+		test_skip(__FILE__,__LINE__,"RAPL component disabled",0);
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if (retval != PAPI_OK) {
+		test_fail(__FILE__, __LINE__,"PAPI_create_eventset()",retval);
+	}
+
+	retval = PAPI_add_named_event( EventSet, "PACKAGE_ENERGY_CNT:PACKAGE0" );
+	if (retval != PAPI_OK) {
+		test_fail(__FILE__, __LINE__,"PAPI_add_named_event()",retval);
+	}
+	retval = PAPI_add_named_event( EventSet, "PACKAGE_ENERGY:PACKAGE0" );
+	if (retval != PAPI_OK) {
+		test_fail(__FILE__, __LINE__,"PAPI_add_named_event()",retval);
+	}
+
+	retval = PAPI_start( EventSet );
+	if (retval != PAPI_OK) {
+		test_fail(__FILE__, __LINE__, "PAPI_start()",retval);
+	}
+
+	/* Each step is less than a wrap, and the pause lets several */
+	/* sweeps see it; between two reads the counter wraps often.  */
+	for(i=1;i<=NUM_STEPS;i++) {
+		energy+=STEP;
+		set_energy(energy);
+		usleep(100000);
+
+		if (i==NUM_STEPS/2) {
+			retval = PAPI_read( EventSet, values );
+			if (retval != PAPI_OK) {
+				test_fail(__FILE__, __LINE__, "PAPI_read()",retval);
+			}
+			if (values[0]!=(long long)(i*STEP)) {
+				if (!TESTS_QUIET) {
+					printf("Read %lld counts, expected %lld\n",
+						values[0],(long long)(i*STEP));
+				}
+				test_fail(__FILE__, __LINE__, "Energy at read",0);
+			}
+		}
+	}
+
+	retval = PAPI_stop( EventSet, values );
+	if (retval != PAPI_OK) {
+		test_fail(__FILE__, __LINE__, "PAPI_stop()",retval);
+	}
+
+	expected=(long long)(NUM_STEPS*STEP);
+	joules=(double)expected/(1ULL<<ENERGY_UNIT);
+
+	if (!TESTS_QUIET) {
+		printf("Fake MSRs in %s, advanced %d times by %#llx\n",
+			msr_dir,NUM_STEPS,STEP);
+		printf("PACKAGE_ENERGY_CNT:PACKAGE0 %lld (expected %lld)\n",
+			values[0],expected);
+		printf("PACKAGE_ENERGY:PACKAGE0     %lld nJ (expected %.0f)\n",
+			values[1],joules*1e9);
+	}
+
+	if (values[0]!=expected) {
+		test_fail(__FILE__, __LINE__, "Energy counts lost a wrap",0);
+	}
+	if (values[1]<(long long)(joules*1e9)-1 ||
+	    values[1]>(long long)(joules*1e9)+1) {
+		test_fail(__FILE__, __LINE__, "Energy in nJ",0);
+	}
+
+	PAPI_cleanup_eventset( EventSet );
+	PAPI_destroy_eventset( &EventSet );
+	PAPI_shutdown();
+
+	remove_tree();
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
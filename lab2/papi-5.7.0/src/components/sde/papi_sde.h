@@ -0,0 +1,56 @@
+/**
+ * @file    papi_sde.h
+ *
+ * @ingroup papi_components
+ *
+ * @brief
+ *  Registration interface of the sde (software-defined events) component.
+ *  An application or library exports its own counters with it, and they
+ *  are then measured through EventSets like any other native event, as
+ *  sde:::<library>::<name>.
+ *
+ *  A counter is a 64-bit value the library adds to with papi_sde_add();
+ *  every thread adds to a slot of its own, and the slots of all threads
+ *  are summed when the counter is read.  A gauge is read by calling back
+ *  into the library, and reports the value at the time of the read rather
+ *  than a difference from PAPI_start.
+ *
+ *  Registration may happen before PAPI_library_init and survives
+ *  PAPI_shutdown.  Registering a name again returns the same id.
+ */
+
+#ifndef _PAPI_SDE_H
+#define _PAPI_SDE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma GCC visibility push(default)
+
+/** Callback that reads a gauge; arg is the pointer given at registration */
+typedef long long ( *papi_sde_gauge_fn_t ) ( void *arg );
+
+/** Register a counter; returns its id, or a negative PAPI error code */
+int papi_sde_register_counter( const char *library, const char *name,
+			       const char *description );
+
+/** Register a gauge; returns its id, or a negative PAPI error code */
+int papi_sde_register_gauge( const char *library, const char *name,
+			     const char *description, papi_sde_gauge_fn_t fn,
+			     void *arg );
+
+/** Stop calling a gauge back, before the library providing it goes away;
+    it reports the last value read from then on */
+int papi_sde_unregister( int id );
+
+/** Add value to a counter for the calling thread */
+void papi_sde_add( int id, long long value );
+
+#pragma GCC visibility pop
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PAPI_SDE_H */
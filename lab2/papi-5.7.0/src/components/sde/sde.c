@@ -0,0 +1,598 @@
+/**
+ * @file    sde.c
+ *
+ * @ingroup papi_components
+ *
+ * @brief
+ *	Software-defined events: counters and gauges that an application or
+ *  a library registers through papi_sde.h, measured in EventSets next to
+ *  the hardware events.
+ *
+ *  Counters are kept in per-thread blocks of slots, each block aligned
+ *  to and padded out to whole cache lines, so an increment is a plain
+ *  add to memory no other thread writes.  A read sums the slot of every
+ *  block.  The block of a thread that exits is handed to the next thread
+ *  that needs one, counts and all, so the sums never go backwards and
+ *  the number of blocks is bounded by the number of live threads.
+ *
+ *  Values are for the whole process, whichever thread reads them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Headers required by PAPI */
+#include "papi.h"
+#include "papi_internal.h"
+#include "papi_vector.h"
+#include "papi_memory.h"
+
+#include "papi_sde.h"
+
+/* Events that can be registered, and measured in one EventSet */
+#define SDE_MAX_EVENTS   256
+#define SDE_MAX_COUNTERS 64
+
+#define SDE_CACHE_LINE   64
+
+#define SDE_COUNTER      0
+#define SDE_GAUGE        1
+
+papi_vector_t _sde_vector;
+
+typedef struct sde_register
+{
+	unsigned int selector;
+} sde_register_t;
+
+typedef struct sde_native_event_entry
+{
+	char name[PAPI_MAX_STR_LEN];	    /**< <library>::<name>           */
+	char description[PAPI_MAX_STR_LEN];
+	int type;			    /**< SDE_COUNTER or SDE_GAUGE    */
+	papi_sde_gauge_fn_t fn;		    /**< NULL once unregistered      */
+	void *arg;
+	long long last;			    /**< Last value read from fn     */
+} sde_native_event_entry_t;
+
+typedef struct sde_reg_alloc
+{
+	sde_register_t ra_bits;
+} sde_reg_alloc_t;
+
+/** Counter values at start, subtracted at read time */
+typedef struct sde_control_state
+{
+	int num_events;
+	int which_counter[SDE_MAX_COUNTERS];
+	long long start[SDE_MAX_COUNTERS];
+	long long counter[SDE_MAX_COUNTERS];
+} sde_control_state_t;
+
+typedef struct sde_context
+{
+	int unused;
+} sde_context_t;
+
+/** One thread's slots, written only by the thread that holds it */
+typedef struct sde_block
+{
+	long long counts[SDE_MAX_EVENTS];
+	struct sde_block *next;
+	int in_use;
+} __attribute__ ( ( aligned( SDE_CACHE_LINE ) ) ) sde_block_t;
+
+/* The registry lives outside the component's init and shutdown, since */
+/* libraries may register before PAPI_library_init.                    */
+static sde_native_event_entry_t sde_native_table[SDE_MAX_EVENTS];
+static volatile int num_events = 0;
+static pthread_mutex_t sde_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static sde_block_t *volatile sde_blocks = NULL;
+static __thread sde_block_t *sde_thread_block = NULL;
+static pthread_key_t sde_key;
+static pthread_once_t sde_key_once = PTHREAD_ONCE_INIT;
+
+
+/*************************************************************************/
+/* Per-thread slots                                                      */
+/*************************************************************************/
+
+/* At thread exit, leave the block and its counts to the next thread */
+static void
+sde_release_block( void *arg )
+{
+	sde_block_t *b = ( sde_block_t * ) arg;
+
+	__sync_synchronize(  );
+	b->in_use = 0;
+}
+
+static void
+sde_key_create( void )
+{
+	pthread_key_create( &sde_key, sde_release_block );
+}
+
+static sde_block_t *
+sde_claim_block( void )
+{
+	sde_block_t *b;
+
+	for ( b = sde_blocks; b != NULL; b = b->next ) {
+		if ( b->in_use == 0 &&
+		     __sync_bool_compare_and_swap( &b->in_use, 0, 1 ) )
+			break;
+	}
+
+	if ( b == NULL ) {
+		/* Never freed: a reader may be walking the list at any time, */
+		/* and the counts must outlive the thread and PAPI_shutdown   */
+		if ( posix_memalign( ( void ** ) &b, SDE_CACHE_LINE,
+				     sizeof ( sde_block_t ) ) != 0 )
+			return NULL;
+		memset( b, 0, sizeof ( sde_block_t ) );
+		b->in_use = 1;
+		do {
+			b->next = sde_blocks;
+		} while ( !__sync_bool_compare_and_swap( &sde_blocks, b->next, b ) );
+	}
+
+	pthread_once( &sde_key_once, sde_key_create );
+	pthread_setspecific( sde_key, b );
+	sde_thread_block = b;
+
+	return b;
+}
+
+static long long
+sde_counter_sum( int id )
+{
+	sde_block_t *b;
+	long long sum = 0;
+
+	for ( b = sde_blocks; b != NULL; b = b->next )
+		sum += b->counts[id];
+
+	return sum;
+}
+
+/* Current value of an event: the sum of a counter, or a gauge's reading */
+static long long
+sde_value( int id )
+{
+	sde_native_event_entry_t *e = &sde_native_table[id];
+	long long value;
+
+	if ( e->type == SDE_COUNTER )
+		return sde_counter_sum( id );
+
+	/* The lock keeps the callback from being unregistered under us */
+	pthread_mutex_lock( &sde_lock );
+	if ( e->fn != NULL )
+		e->last = e->fn( e->arg );
+	value = e->last;
+	pthread_mutex_unlock( &sde_lock );
+
+	return value;
+}
+
+
+/*************************************************************************/
+/* Registration interface, see papi_sde.h                                */
+/*************************************************************************/
+
+static int
+sde_register( const char *library, const char *name, const char *description,
+	      int type, papi_sde_gauge_fn_t fn, void *arg )
+{
+	char full_name[PAPI_MAX_STR_LEN];
+	sde_native_event_entry_t *e;
+	int i, n;
+
+	if ( library == NULL || name == NULL || *library == '\0' || *name == '\0' )
+		return PAPI_EINVAL;
+	if ( snprintf( full_name, sizeof ( full_name ), "%s::%s", library,
+		       name ) >= ( int ) sizeof ( full_name ) )
+		return PAPI_EINVAL;
+
+	pthread_mutex_lock( &sde_lock );
+
+	n = num_events;
+	for ( i = 0; i < n; i++ ) {
+		e = &sde_native_table[i];
+		if ( strcmp( e->name, full_name ) != 0 )
+			continue;
+		if ( e->type != type ) {
+			pthread_mutex_unlock( &sde_lock );
+			return PAPI_ECNFLCT;
+		}
+		/* A library loaded again brings a new callback */
+		if ( type == SDE_GAUGE ) {
+			e->fn = fn;
+			e->arg = arg;
+		}
+		pthread_mutex_unlock( &sde_lock );
+		return i;
+	}
+
+	if ( n == SDE_MAX_EVENTS ) {
+		pthread_mutex_unlock( &sde_lock );
+		return PAPI_ECOUNT;
+	}
+
+	e = &sde_native_table[n];
+	strcpy( e->name, full_name );
+	strncpy( e->description, description ? description : "",
+		 sizeof ( e->description ) - 1 );
+	e->type = type;
+	e->fn = fn;
+	e->arg = arg;
+	e->last = 0;
+
+	/* The entry is complete before enumeration can see it */
+	__sync_synchronize(  );
+	num_events = n + 1;
+	_sde_vector.cmp_info.num_native_events = n + 1;
+
+	pthread_mutex_unlock( &sde_lock );
+
+	SUBDBG( "sde: registered %s as %d\n", full_name, n );
+
+	return n;
+}
+
+#pragma GCC visibility push(default)
+
+int
+papi_sde_register_counter( const char *library, const char *name,
+			   const char *description )
+{
+	return sde_register( library, name, description, SDE_COUNTER, NULL, NULL );
+}
+
+int
+papi_sde_register_gauge( const char *library, const char *name,
+			 const char *description, papi_sde_gauge_fn_t fn,
+			 void *arg )
+{
+	if ( fn == NULL )
+		return PAPI_EINVAL;
+	return sde_register( library, name, description, SDE_GAUGE, fn, arg );
+}
+
+int
+papi_sde_unregister( int id )
+{
+	sde_native_event_entry_t *e;
+
+	if ( id < 0 || id >= num_events )
+		return PAPI_ENOEVNT;
+
+	e = &sde_native_table[id];
+	pthread_mutex_lock( &sde_lock );
+	if ( e->type == SDE_GAUGE && e->fn != NULL ) {
+		e->last = e->fn( e->arg );
+		e->fn = NULL;
+	}
+	pthread_mutex_unlock( &sde_lock );
+
+	return PAPI_OK;
+}
+
+void
+papi_sde_add( int id, long long value )
+{
+	sde_block_t *b = sde_thread_block;
+
+	if ( b == NULL && ( b = sde_claim_block(  ) ) == NULL )
+		return;
+	if ( ( unsigned int ) id < SDE_MAX_EVENTS )
+		b->counts[id] += value;
+}
+
+#pragma GCC visibility pop
+
+
+/********************************************************************/
+/* Below are the functions required by the PAPI component interface */
+/********************************************************************/
+
+static int
+_sde_init_component( int cidx )
+{
+	SUBDBG( "_sde_init_component..." );
+
+	/* Events registered so far; more may follow at any time */
+	_sde_vector.cmp_info.num_native_events = num_events;
+	_sde_vector.cmp_info.CmpIdx = cidx;
+
+	return PAPI_OK;
+}
+
+static int
+_sde_init_thread( hwd_context_t *ctx )
+{
+	( void ) ctx;
+
+	return PAPI_OK;
+}
+
+static int
+_sde_init_control_state( hwd_control_state_t *ctl )
+{
+	sde_control_state_t *sde_ctl = ( sde_control_state_t * ) ctl;
+
+	memset( sde_ctl, 0, sizeof ( sde_control_state_t ) );
+
+	return PAPI_OK;
+}
+
+static int
+_sde_update_control_state( hwd_control_state_t *ctl, NativeInfo_t *native,
+			   int count, hwd_context_t *ctx )
+{
+	( void ) ctx;
+	int i, index;
+
+	sde_control_state_t *sde_ctl = ( sde_control_state_t * ) ctl;
+
+	for ( i = 0; i < count; i++ ) {
+		index = native[i].ni_event;
+		if ( index < 0 || index >= num_events )
+			return PAPI_ENOEVNT;
+		sde_ctl->which_counter[i] = index;
+		native[i].ni_position = i;
+	}
+
+	sde_ctl->num_events = count;
+
+	return PAPI_OK;
+}
+
+/* Counters report what was added since start; gauges report their value */
+static int
+_sde_start( hwd_context_t *ctx, hwd_control_state_t *ctl )
+{
+	( void ) ctx;
+	int i, id;
+
+	sde_control_state_t *sde_ctl = ( sde_control_state_t * ) ctl;
+
+	for ( i = 0; i < sde_ctl->num_events; i++ ) {
+		id = sde_ctl->which_counter[i];
+		sde_ctl->start[i] = ( sde_native_table[id].type == SDE_COUNTER ) ?
+			sde_counter_sum( id ) : 0;
+	}
+
+	return PAPI_OK;
+}
+
+static int
+_sde_read( hwd_context_t *ctx, hwd_control_state_t *ctl,
+	   long long **events, int flags )
+{
+	( void ) ctx;
+	( void ) flags;
+	int i;
+
+	sde_control_state_t *sde_ctl = ( sde_control_state_t * ) ctl;
+
+	for ( i = 0; i < sde_ctl->num_events; i++ ) {
+		sde_ctl->counter[i] =
+			sde_value( sde_ctl->which_counter[i] ) - sde_ctl->start[i];
+	}
+
+	*events = sde_ctl->counter;
+
+	return PAPI_OK;
+}
+
+static int
+_sde_stop( hwd_context_t *ctx, hwd_control_state_t *ctl )
+{
+	long long *events;
+
+	/* Leave the final values in the control state */
+	return _sde_read( ctx, ctl, &events, 0 );
+}
+
+static int
+_sde_reset( hwd_context_t *ctx, hwd_control_state_t *ctl )
+{
+	return _sde_start( ctx, ctl );
+}
+
+/* Counters continue from the values written; gauges cannot be written */
+static int
+_sde_write( hwd_context_t *ctx, hwd_control_state_t *ctl, long long *events )
+{
+	( void ) ctx;
+	int i, id;
+
+	sde_control_state_t *sde_ctl = ( sde_control_state_t * ) ctl;
+
+	for ( i = 0; i < sde_ctl->num_events; i++ ) {
+		id = sde_ctl->which_counter[i];
+		if ( sde_native_table[id].type == SDE_COUNTER )
+			sde_ctl->start[i] = sde_counter_sum( id ) - events[i];
+	}
+
+	return PAPI_OK;
+}
+
+static int
+_sde_shutdown_component( void )
+{
+	/* The registry and the slots belong to the libraries, not to PAPI */
+	return PAPI_OK;
+}
+
+static int
+_sde_shutdown_thread( hwd_context_t *ctx )
+{
+	( void ) ctx;
+
+	return PAPI_OK;
+}
+
+static int
+_sde_ctl( hwd_context_t *ctx, int code, _papi_int_option_t *option )
+{
+	( void ) ctx;
+	( void ) code;
+	( void ) option;
+
+	return PAPI_OK;
+}
+
+static int
+_sde_set_domain( hwd_control_state_t *ctl, int domain )
+{
+	( void ) ctl;
+
+	if ( PAPI_DOM_USER != domain )
+		return PAPI_EINVAL;
+
+	return PAPI_OK;
+}
+
+
+/**************************************************************/
+/* Naming functions, used to translate event numbers to names */
+/**************************************************************/
+
+static int
+_sde_ntv_enum_events( unsigned int *EventCode, int modifier )
+{
+	int index;
+
+	switch ( modifier ) {
+
+	case PAPI_ENUM_FIRST:
+		if ( num_events == 0 )
+			return PAPI_ENOEVNT;
+		*EventCode = 0;
+		return PAPI_OK;
+
+	case PAPI_ENUM_EVENTS:
+		index = *EventCode;
+		if ( index < num_events - 1 ) {
+			*EventCode = *EventCode + 1;
+			return PAPI_OK;
+		}
+		return PAPI_ENOEVNT;
+
+	default:
+		return PAPI_EINVAL;
+	}
+}
+
+/* Takes <library>::<name>, the framework has stripped the sde::: */
+static int
+_sde_ntv_name_to_code( const char *name, unsigned int *EventCode )
+{
+	int i, n = num_events;
+
+	for ( i = 0; i < n; i++ ) {
+		if ( strcmp( name, sde_native_table[i].name ) == 0 ) {
+			*EventCode = i;
+			return PAPI_OK;
+		}
+	}
+
+	return PAPI_ENOEVNT;
+}
+
+static int
+_sde_ntv_code_to_name( unsigned int EventCode, char *name, int len )
+{
+	int index = EventCode;
+
+	if ( index >= 0 && index < num_events ) {
+		strncpy( name, sde_native_table[index].name, len );
+		return PAPI_OK;
+	}
+
+	return PAPI_ENOEVNT;
+}
+
+static int
+_sde_ntv_code_to_descr( unsigned int EventCode, char *descr, int len )
+{
+	int index = EventCode;
+
+	if ( index >= 0 && index < num_events ) {
+		strncpy( descr, sde_native_table[index].description, len );
+		return PAPI_OK;
+	}
+
+	return PAPI_ENOEVNT;
+}
+
+static int
+_sde_ntv_code_to_info( unsigned int EventCode, PAPI_event_info_t *info )
+{
+	int index = EventCode;
+
+	if ( index < 0 || index >= num_events )
+		return PAPI_ENOEVNT;
+
+	strncpy( info->symbol, sde_native_table[index].name,
+		 sizeof ( info->symbol ) - 1 );
+	strncpy( info->long_descr, sde_native_table[index].description,
+		 sizeof ( info->long_descr ) - 1 );
+	info->data_type = PAPI_DATATYPE_INT64;
+	info->value_type = ( sde_native_table[index].type == SDE_COUNTER ) ?
+		PAPI_VALUETYPE_RUNNING_SUM : PAPI_VALUETYPE_ABSOLUTE;
+
+	return PAPI_OK;
+}
+
+papi_vector_t _sde_vector = {
+	.cmp_info = {
+		.name = "sde",
+		.short_name = "sde",
+		.description = "Software-defined events registered by applications and libraries",
+		.version = "1.0",
+		.support_version = "n/a",
+		.kernel_version = "n/a",
+		.num_cntrs =               SDE_MAX_COUNTERS,
+		.num_mpx_cntrs =           SDE_MAX_COUNTERS,
+		.default_domain =          PAPI_DOM_USER,
+		.available_domains =       PAPI_DOM_USER,
+		.default_granularity =     PAPI_GRN_THR,
+		.available_granularities = PAPI_GRN_THR,
+		.hardware_intr_sig =       PAPI_INT_SIGNAL,
+		.dynamic_events =          1,
+	},
+
+	.size = {
+		.context = sizeof ( sde_context_t ),
+		.control_state = sizeof ( sde_control_state_t ),
+		.reg_value = sizeof ( sde_register_t ),
+		.reg_alloc = sizeof ( sde_reg_alloc_t ),
+	},
+
+	.start =                _sde_start,
+	.stop =                 _sde_stop,
+	.read =                 _sde_read,
+	.reset =                _sde_reset,
+	.write =                _sde_write,
+	.init_component =       _sde_init_component,
+	.init_thread =          _sde_init_thread,
+	.init_control_state =   _sde_init_control_state,
+	.update_control_state = _sde_update_control_state,
+	.ctl =                  _sde_ctl,
+	.shutdown_thread =      _sde_shutdown_thread,
+	.shutdown_component =   _sde_shutdown_component,
+	.set_domain =           _sde_set_domain,
+
+	.ntv_enum_events =   _sde_ntv_enum_events,
+	.ntv_name_to_code =  _sde_ntv_name_to_code,
+	.ntv_code_to_name =  _sde_ntv_code_to_name,
+	.ntv_code_to_descr = _sde_ntv_code_to_descr,
+	.ntv_code_to_info =  _sde_ntv_code_to_info,
+};
@@ -0,0 +1,151 @@
+/**
+ * test case for the sde component
+ *
+ * @brief
+ *   A counter is registered before PAPI_library_init and a gauge after
+ *   it.  Several threads add to the counter, which must read back as the
+ *   sum of every thread's adds, including threads that have exited; the
+ *   gauge must read back what its callback returns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+#include "papi_sde.h"
+
+#define NUM_THREADS 4
+#define NUM_ADDS    100000
+
+static int items;
+static long long depth = 0;
+
+static long long
+read_depth( void *arg )
+{
+	return *( long long * ) arg;
+}
+
+static void *
+worker( void *arg )
+{
+	int i;
+
+	( void ) arg;
+	for ( i = 0; i < NUM_ADDS; i++ )
+		papi_sde_add( items, 1 );
+	return NULL;
+}
+
+int
+main( int argc, char **argv )
+{
+	const char *names[2] = { "sde:::sde_test::items", "sde:::sde_test::depth" };
+	pthread_t threads[NUM_THREADS];
+	long long values[2];
+	int EventSet = PAPI_NULL;
+	int retval, gauge, i, code, found = 0;
+	char name[PAPI_MAX_STR_LEN];
+
+	tests_quiet( argc, argv );
+
+	items = papi_sde_register_counter( "sde_test", "items", "Items processed" );
+	if ( items < 0 ) {
+		test_fail( __FILE__, __LINE__, "papi_sde_register_counter", items );
+	}
+	/* Counted before anyone measures, and not part of the measurement */
+	papi_sde_add( items, 5 );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	gauge = papi_sde_register_gauge( "sde_test", "depth", "Queue depth",
+					 read_depth, &depth );
+	if ( gauge < 0 ) {
+		test_fail( __FILE__, __LINE__, "papi_sde_register_gauge", gauge );
+	}
+	if ( papi_sde_register_counter( "sde_test", "items", NULL ) != items ) {
+		test_fail( __FILE__, __LINE__, "Registering again", 0 );
+	}
+
+	/* Both are listed, the gauge although it came after initialization */
+	code = PAPI_NATIVE_MASK;
+	retval = PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST,
+				      PAPI_get_component_index( "sde" ) );
+	while ( retval == PAPI_OK ) {
+		if ( PAPI_event_code_to_name( code, name ) == PAPI_OK &&
+		     strncmp( name, "sde:::sde_test::", 16 ) == 0 )
+			found++;
+		retval = PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS,
+					      PAPI_get_component_index( "sde" ) );
+	}
+	if ( found != 2 ) {
+		test_fail( __FILE__, __LINE__, "Enumerating sde events", found );
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+	for ( i = 0; i < 2; i++ ) {
+		retval = PAPI_add_named_event( EventSet, ( char * ) names[i] );
+		if ( retval != PAPI_OK ) {
+			test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+		}
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	for ( i = 0; i < NUM_THREADS; i++ )
+		pthread_create( &threads[i], NULL, worker, NULL );
+	for ( i = 0; i < NUM_THREADS; i++ )
+		pthread_join( threads[i], NULL );
+	papi_sde_add( items, 3 );
+	depth = 42;
+
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	if ( !TESTS_QUIET ) {
+		printf( "%s: %lld (expected %d)\n", names[0], values[0],
+			NUM_THREADS * NUM_ADDS + 3 );
+		printf( "%s: %lld (expected 42)\n", names[1], values[1] );
+	}
+
+	if ( values[0] != NUM_THREADS * NUM_ADDS + 3 ) {
+		test_fail( __FILE__, __LINE__, "Counter summed over threads", 0 );
+	}
+	if ( values[1] != 42 ) {
+		test_fail( __FILE__, __LINE__, "Gauge value", 0 );
+	}
+
+	/* An unregistered gauge keeps its last value */
+	papi_sde_unregister( gauge );
+	depth = 7;
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK || values[0] != 0 || values[1] != 42 ) {
+		test_fail( __FILE__, __LINE__, "Unregistered gauge", retval );
+	}
+
+	PAPI_cleanup_eventset( EventSet );
+	PAPI_destroy_eventset( &EventSet );
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -17,6 +17,7 @@
 #include "papi_internal.h"
 #include "papi_vector.h"
 #include "papi_memory.h"
+#include "linux-common.h"
 
 struct counter_info
 {
@@ -44,11 +45,19 @@ struct STEALTIME_context
   long long *start_count;
   long long *current_count;
   long long *value;
+  char *buffer;         /* this thread's copy of the cpu lines */
+  int buffer_size;
 };
 
 
 static int num_events = 0;
 
+/* /proc/stat, kept open from init_component to shutdown_component */
+static int stat_fd = -1;
+
+/* room for one "cpuN" line of /proc/stat */
+#define STEALTIME_LINE_LEN 256
+
 static struct counter_info *event_info=NULL;
 
 /* Advance declaration of buffer */
@@ -58,66 +67,55 @@ papi_vector_t _stealtime_vector;
  ********  BEGIN FUNCTIONS  USED INTERNALLY SPECIFIC TO THIS COMPONENT ********
  *****************************************************************************/
 
-struct statinfo {
-  long long user;
-  long long nice;
-  long long system;
-  long long idle;
-  long long iowait;
-  long long irq;
-  long long softirq;
-  long long steal;
-  long long guest;
-};
+/* steal is the 8th number on a cpu line, after user nice system */
+/* idle iowait irq softirq                                       */
+#define STEAL_FIELD 8
 
 static int
 read_stealtime( struct STEALTIME_context *context, int starting) {
 
-  FILE *fff;
-  char buffer[BUFSIZ],*result;
-  int i,count;
-  struct statinfo our_stat;
+  char *line,*p;
+  long long value;
+  int i,field;
 
   int hz=sysconf(_SC_CLK_TCK);
 
 
-  fff=fopen("/proc/stat","r");
-  if (fff==NULL) {
+  /* The cpu lines come first, so a buffer sized for them is enough */
+  if (_linux_sysfile_read(stat_fd,context->buffer,context->buffer_size)<0) {
      return PAPI_ESYS; 
   }
 
+  line=context->buffer;
   for(i=0;i<num_events;i++) {
-    result=fgets(buffer,BUFSIZ,fff);
-    if (result==NULL) break;
-
-    count=sscanf(buffer,"%*s %lld %lld %lld %lld %lld %lld %lld %lld %lld",
-		 &our_stat.user,
-		 &our_stat.nice,
-		 &our_stat.system,
-		 &our_stat.idle,
-		 &our_stat.iowait,
-		 &our_stat.irq,
-		 &our_stat.softirq,
-		 &our_stat.steal,
-		 &our_stat.guest);
-    if (count<=7) {
-       fclose(fff);
-       return PAPI_ESYS;
+    if (strncmp(line,"cpu",3)) break;
+
+    /* skip the cpuN name, whose digits are not a field */
+    p=line+3;
+    while((*p>='0')&&(*p<='9')) p++;
+
+    for(field=0;field<STEAL_FIELD;field++) {
+       p=_linux_sysfile_ll(p,&value);
+       if (p==NULL) {
+          return PAPI_ESYS;
+       }
     }
 
     if (starting) {
-       context->start_count[i]=our_stat.steal;
+       context->start_count[i]=value;
     }
-    context->current_count[i]=our_stat.steal;
+    context->current_count[i]=value;
 
     /* convert to us */
     context->value[i]=(context->current_count[i]-context->start_count[i])*
       (1000000/hz);
+
+    line=strchr(p,'\n');
+    if (line==NULL) break;
+    line++;
   }
   
 
-  fclose(fff);
-
   return PAPI_OK;
 
 }
@@ -200,6 +198,15 @@ _stealtime_init_component( int cidx )
 
 	//	printf("Found %d CPUs\n",num_events-1);
 
+	/* Keep /proc/stat open; every read is a pread from offset 0 */
+	stat_fd=_linux_sysfile_open("/proc/stat");
+	if (stat_fd<0) {
+	   strncpy(_stealtime_vector.cmp_info.disabled_reason,
+		   "Cannot open /proc/stat",PAPI_MAX_STR_LEN);
+       _stealtime_shutdown_component();
+	   return PAPI_ESYS;
+	}
+
 	_stealtime_vector.cmp_info.num_native_events=num_events;
 	_stealtime_vector.cmp_info.num_cntrs=num_events;
 	_stealtime_vector.cmp_info.num_mpx_cntrs=num_events;
@@ -228,6 +235,10 @@ _stealtime_init_thread( hwd_context_t * ctx )
   context->value=calloc(num_events,sizeof(long long));
   if (context->value==NULL) return PAPI_ENOMEM;
 
+  context->buffer_size=num_events*STEALTIME_LINE_LEN;
+  context->buffer=malloc(context->buffer_size);
+  if (context->buffer==NULL) return PAPI_ENOMEM;
+
   return PAPI_OK;
 }
 
@@ -247,6 +258,12 @@ _stealtime_shutdown_component( void )
                        free(event_info[i].units);
                }
                free(event_info);
+               event_info=NULL;
+       }
+
+       if (stat_fd>=0) {
+               close(stat_fd);
+               stat_fd=-1;
        }
 
    return PAPI_OK;
@@ -264,6 +281,7 @@ _stealtime_shutdown_thread( hwd_context_t * ctx )
   if (context->start_count!=NULL) free(context->start_count);
   if (context->current_count!=NULL) free(context->current_count);
   if (context->value!=NULL) free(context->value);
+  if (context->buffer!=NULL) free(context->buffer);
 
   return PAPI_OK;
 }
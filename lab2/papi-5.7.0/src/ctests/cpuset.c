@@ -0,0 +1,169 @@
+/*
+* File:    cpuset.c
+*/
+
+/* This file performs the following test: one event set counts
+   PAPI_TOT_INS on every online cpu with PAPI_cpuset_set.
+
+   - Check PAPI_cpuset_set is refused while running
+   - Start, do flops, stop
+   - Read every cpu with PAPI_cpuset_read and check the counts add up
+     to at least what PAPI_stop returned, which reads before it stops
+     the counters, and that the flops show up in them
+   - Narrow the set to the first cpu and check only it is returned
+   - Remove the only event and add it back: the set is kept
+   - Clean up and add the event again: the set is gone
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#define MAX_CPUS 1024
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	unsigned int cpus[MAX_CPUS];
+	long long values[MAX_CPUS], total, sum;
+	int retval, count, i;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+
+	retval = PAPI_add_named_event( EventSet, "PAPI_TOT_INS" );
+	if ( retval != PAPI_OK ) {
+		if ( !quiet ) printf( "Trouble adding PAPI_TOT_INS\n" );
+		test_skip( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+	}
+
+	/* Counting other processes may not be allowed */
+	retval = PAPI_cpuset_set( EventSet, NULL, 0 );
+	if ( retval == PAPI_ECMP || retval == PAPI_EPERM ) {
+		if ( !quiet ) printf( "Can't count on every cpu: %s\n",
+				      PAPI_strerror( retval ) );
+		test_skip( __FILE__, __LINE__, "PAPI_cpuset_set", retval );
+	}
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_set", retval );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	retval = PAPI_cpuset_set( EventSet, NULL, 0 );
+	if ( retval != PAPI_EISRUN ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_set while running",
+			   retval );
+	}
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_stop( EventSet, &total );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	retval = PAPI_cpuset_read( EventSet, cpus, values, MAX_CPUS, &count );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_read", retval );
+	}
+	if ( count < 1 || count > MAX_CPUS ) {
+		test_fail( __FILE__, __LINE__, "cpu count", count );
+	}
+
+	sum = 0;
+	for ( i = 0; i < count; i++ ) {
+		if ( !quiet ) printf( "PAPI_TOT_INS: %12lld on cpu %u\n",
+				      values[i], cpus[i] );
+		sum += values[i];
+	}
+	if ( !quiet ) printf( "PAPI_TOT_INS: %12lld on %d cpus, "
+			      "%lld from PAPI_stop\n", sum, count, total );
+
+	if ( sum < total ) {
+		test_fail( __FILE__, __LINE__, "cpus do not add up", 1 );
+	}
+	if ( total < NUM_FLOPS ) {
+		test_fail( __FILE__, __LINE__, "flops not counted", 1 );
+	}
+
+	/* Just the first cpu now */
+	retval = PAPI_cpuset_set( EventSet, cpus, 1 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_set", retval );
+	}
+
+	retval = PAPI_cpuset_read( EventSet, cpus + 1, values, MAX_CPUS, &count );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_read", retval );
+	}
+	if ( count != 1 || cpus[1] != cpus[0] ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_read one cpu", count );
+	}
+
+	/* The set lasts until cleanup, not just while there are events */
+	retval = PAPI_remove_named_event( EventSet, "PAPI_TOT_INS" );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_remove_named_event", retval );
+	}
+	retval = PAPI_add_named_event( EventSet, "PAPI_TOT_INS" );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+	}
+	retval = PAPI_cpuset_read( EventSet, cpus + 1, values, MAX_CPUS, &count );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cpuset_read after re-add",
+			   retval );
+	}
+	if ( count != 1 || cpus[1] != cpus[0] ) {
+		test_fail( __FILE__, __LINE__, "cpu set lost with the last event",
+			   count );
+	}
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	}
+
+	retval = PAPI_add_named_event( EventSet, "PAPI_TOT_INS" );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_add_named_event", retval );
+	}
+	retval = PAPI_cpuset_read( EventSet, cpus + 1, values, MAX_CPUS, &count );
+	if ( retval == PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "cpu set kept after cleanup", count );
+	}
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	}
+
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", retval );
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+* File:    event_cache.c
+*/
+
+/* This file performs the following test: native events are enumerated
+   with PAPI_EVENT_CACHE pointing at an empty directory, so the first
+   enumeration writes a catalog per component and the second, after a
+   PAPI_shutdown and a new PAPI_library_init, is served from it.
+
+   - Check a catalog file is written for every active component whose
+     events are fixed at initialization
+   - Check the second enumeration reports the same events and info
+   - Check every event name maps back to the code it was listed with
+   - Check an event listed from the catalog can still be added
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define MAX_EVENTS 65536
+
+static char **names;
+static unsigned int *hashes;
+
+/* Enough of the event info to notice a change */
+static unsigned int
+info_hash( const PAPI_event_info_t *info )
+{
+	const char *s;
+	unsigned int h = 2166136261U;
+
+	for ( s = info->symbol; *s; s++ )
+		h = ( h ^ ( unsigned char ) *s ) * 16777619U;
+	for ( s = info->long_descr; *s; s++ )
+		h = ( h ^ ( unsigned char ) *s ) * 16777619U;
+	for ( s = info->units; *s; s++ )
+		h = ( h ^ ( unsigned char ) *s ) * 16777619U;
+	return h ^ ( unsigned int ) info->data_type;
+}
+
+/* Enumerate every event and umask; record them on the first pass, */
+/* compare on the second.                                          */
+static int
+enumerate( int pass, int *first_code )
+{
+	PAPI_event_info_t info;
+	int cid, code, umask, n = 0;
+
+	*first_code = 0;
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		code = PAPI_NATIVE_MASK;
+		if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK )
+			continue;
+		if ( cid == 0 )
+			*first_code = code;
+		do {
+			umask = code;
+			do {
+				if ( PAPI_get_event_info( umask, &info ) != PAPI_OK )
+					continue;
+				if ( n >= MAX_EVENTS )
+					return n;
+				if ( pass == 0 ) {
+					names[n] = strdup( info.symbol );
+					hashes[n] = info_hash( &info );
+				} else if ( strcmp( names[n], info.symbol ) != 0 ||
+					    hashes[n] != info_hash( &info ) ) {
+					test_fail( __FILE__, __LINE__, "Cached event info", n );
+				}
+				n++;
+			} while ( PAPI_enum_cmp_event( &umask, PAPI_NTV_ENUM_UMASKS,
+						       cid ) == PAPI_OK );
+		} while ( PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+	}
+	return n;
+}
+
+int
+main( int argc, char **argv )
+{
+	const PAPI_component_info_t *cmpinfo;
+	char dir[] = "/tmp/papi_event_cacheXXXXXX";
+	char path[PATH_MAX], name[PAPI_MAX_STR_LEN];
+	int retval, cid, i, first, second, code, mismatched = 0;
+	int EventSet = PAPI_NULL, first_code;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	if ( mkdtemp( dir ) == NULL ) {
+		test_skip( __FILE__, __LINE__, "mkdtemp", PAPI_ESYS );
+	}
+	setenv( "PAPI_EVENT_CACHE", dir, 1 );
+
+	names = calloc( MAX_EVENTS, sizeof ( char * ) );
+	hashes = calloc( MAX_EVENTS, sizeof ( unsigned int ) );
+	if ( names == NULL || hashes == NULL ) {
+		test_fail( __FILE__, __LINE__, "calloc", PAPI_ENOMEM );
+	}
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	first = enumerate( 0, &first_code );
+	if ( first == 0 ) {
+		test_skip( __FILE__, __LINE__, "No native events", 0 );
+	}
+
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo->disabled || cmpinfo->dynamic_events )
+			continue;
+		snprintf( path, sizeof ( path ), "%s/%s.events", dir, cmpinfo->name );
+		if ( access( path, R_OK ) != 0 ) {
+			test_fail( __FILE__, __LINE__, "Catalog not written", cid );
+		}
+	}
+
+	PAPI_shutdown(  );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	second = enumerate( 1, &first_code );
+
+	for ( i = 0; i < second; i++ ) {
+		retval = PAPI_event_name_to_code( names[i], &code );
+		if ( retval != PAPI_OK ||
+		     PAPI_event_code_to_name( code, name ) != PAPI_OK ||
+		     strcmp( name, names[i] ) != 0 ) {
+			if ( !quiet )
+				printf( "Lookup of %s failed\n", names[i] );
+			mismatched++;
+		}
+	}
+
+	if ( !quiet ) {
+		printf( "Test case: Native events served from %s.\n", dir );
+		printf( "-----------------------------------------------\n" );
+		printf( "Enumerated       : %d, then %d from the cache\n", first,
+			second );
+		printf( "Lookups failed   : %d\n", mismatched );
+	}
+
+	if ( second != first ) {
+		test_fail( __FILE__, __LINE__, "Cached event count", second );
+	}
+	if ( mismatched ) {
+		test_fail( __FILE__, __LINE__, "Cached name lookups", mismatched );
+	}
+
+	/* A listed code is bound to the component when it is first used */
+	if ( first_code != 0 ) {
+		retval = PAPI_create_eventset( &EventSet );
+		if ( retval != PAPI_OK ) {
+			test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+		}
+		retval = PAPI_add_event( EventSet, first_code );
+		if ( retval != PAPI_OK && retval != PAPI_ECNFLCT &&
+		     retval != PAPI_ENOEVNT && retval != PAPI_EPERM ) {
+			test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+		}
+		PAPI_cleanup_eventset( EventSet );
+		PAPI_destroy_eventset( &EventSet );
+	}
+
+	PAPI_shutdown(  );
+
+	for ( cid = 0; cid < PAPI_num_components(  ); cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		snprintf( path, sizeof ( path ), "%s/%s.events", dir, cmpinfo->name );
+		unlink( path );
+	}
+	rmdir( dir );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
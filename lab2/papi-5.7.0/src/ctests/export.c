@@ -0,0 +1,233 @@
+/*
+* File:    export.c
+*/
+
+/* This file performs the following test: an event set is published to
+   shared memory with PAPI_export_set and read back the way an outside
+   agent would, through a read-only mapping of the segment.
+
+   - Map the segment and unlink it, and check it is gone
+   - Check the segment header
+   - Start, do flops, and check the slot follows the counts
+   - Stop and check the slot holds the final counts
+   - Fork a child that relabels and stops exporting the set, and check
+     the parent's slot is left as it was
+   - Stop exporting and check the slot is freed
+   - Shut down and check no segment was left behind
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#define LABEL "export_test"
+
+/* Copy a slot the way a reader in another process has to */
+static void
+read_slot( PAPI_export_slot_t *slot, PAPI_export_slot_t *copy )
+{
+	unsigned int seq;
+
+	do {
+		seq = slot->seq;
+		__sync_synchronize(  );
+		memcpy( copy, slot, sizeof ( *copy ) );
+		__sync_synchronize(  );
+	} while ( ( seq & 1 ) || seq != slot->seq );
+}
+
+static PAPI_export_slot_t *
+find_slot( PAPI_export_header_t *hdr )
+{
+	PAPI_export_slot_t *slots = ( PAPI_export_slot_t * ) ( hdr + 1 );
+	PAPI_export_slot_t copy;
+	unsigned int i;
+
+	for ( i = 0; i < hdr->nslots; i++ ) {
+		read_slot( &slots[i], &copy );
+		if ( copy.tid != 0 && strcmp( copy.label, LABEL ) == 0 )
+			return &slots[i];
+	}
+	return NULL;
+}
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	PAPI_export_header_t *hdr;
+	PAPI_export_slot_t *slot, running, stopped, forked, freed;
+	char path[PATH_MAX], child_path[PATH_MAX];
+	size_t size;
+	long long value;
+	int retval, PAPI_event, fd, tid, status;
+	pid_t child;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	PAPI_event = find_nonderived_event( );
+	if ( PAPI_event == 0 ) {
+		if ( !quiet ) printf( "Trouble adding event\n" );
+		test_skip( __FILE__, __LINE__, "Event trouble", 1 );
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+
+	retval = PAPI_add_event( EventSet, PAPI_event );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+	}
+
+	retval = PAPI_export_set( EventSet, LABEL, 1000000 );
+	if ( retval == PAPI_ECMP ) {
+		test_skip( __FILE__, __LINE__, "PAPI_export_set", retval );
+	}
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_export_set", retval );
+	}
+
+	snprintf( path, sizeof ( path ), PAPI_EXPORT_PATH, ( int ) getpid(  ) );
+	size = sizeof ( PAPI_export_header_t ) +
+		PAPI_EXPORT_SLOTS * sizeof ( PAPI_export_slot_t );
+	fd = open( path, O_RDONLY );
+	if ( fd < 0 ) {
+		test_fail( __FILE__, __LINE__, "open of the export segment", PAPI_ESYS );
+	}
+	hdr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if ( hdr == MAP_FAILED ) {
+		test_fail( __FILE__, __LINE__, "mmap of the export segment", PAPI_ESYS );
+	}
+
+	/* Attached: a crash from here on must not leave the segment behind */
+	if ( unlink( path ) != 0 || access( path, F_OK ) == 0 ) {
+		test_fail( __FILE__, __LINE__, "unlink of the export segment", PAPI_ESYS );
+	}
+
+	if ( hdr->magic != PAPI_EXPORT_MAGIC ||
+	     hdr->version != PAPI_EXPORT_VERSION ||
+	     hdr->slot_size != sizeof ( PAPI_export_slot_t ) ||
+	     hdr->nslots != PAPI_EXPORT_SLOTS || hdr->pid != ( int ) getpid(  ) ) {
+		test_fail( __FILE__, __LINE__, "Segment header", 1 );
+	}
+
+	slot = find_slot( hdr );
+	if ( slot == NULL ) {
+		test_fail( __FILE__, __LINE__, "Exported slot", 1 );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	do_flops( NUM_FLOPS * 5 );
+	read_slot( slot, &running );
+	do_flops( NUM_FLOPS * 5 );
+
+	retval = PAPI_stop( EventSet, &value );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+	read_slot( slot, &stopped );
+
+	tid = ( int ) syscall( SYS_gettid );
+
+	if ( !quiet ) {
+		printf( "Test case: Counts exported to %s.\n", path );
+		printf( "-----------------------------------------------\n" );
+		printf( "Slot             : %d (tid %d, %d events)\n",
+			( int ) ( slot - ( PAPI_export_slot_t * ) ( hdr + 1 ) ),
+			stopped.tid, stopped.num_events );
+		printf( "While running    : %lld\n", running.values[0] );
+		printf( "After stop       : %lld\n", stopped.values[0] );
+		printf( "PAPI_stop        : %lld\n", value );
+	}
+
+	if ( running.tid != tid || running.num_events != 1 ||
+	     running.events[0] != PAPI_event || running.eventset != EventSet ) {
+		test_fail( __FILE__, __LINE__, "Slot description", 1 );
+	}
+
+	if ( running.values[0] <= 0 || running.values[0] >= stopped.values[0] ||
+	     running.time >= stopped.time ) {
+		test_fail( __FILE__, __LINE__, "Values while running", 1 );
+	}
+
+	/* PAPI_stop reads just before the final export */
+	if ( stopped.values[0] < value ||
+	     stopped.values[0] > value + value / 100 ) {
+		test_fail( __FILE__, __LINE__, "Values after stop", 1 );
+	}
+
+	/* The child inherits the slot; it must get its own, not touch ours */
+	child = fork(  );
+	if ( child < 0 ) {
+		test_fail( __FILE__, __LINE__, "fork", PAPI_ESYS );
+	}
+	if ( child == 0 ) {
+		if ( PAPI_export_set( EventSet, "child", 1000000 ) != PAPI_OK ||
+		     PAPI_export_set( EventSet, NULL, 0 ) != PAPI_OK ) {
+			_exit( 1 );
+		}
+		_exit( 0 );
+	}
+	if ( waitpid( child, &status, 0 ) != child || !WIFEXITED( status ) ||
+	     WEXITSTATUS( status ) != 0 ) {
+		test_fail( __FILE__, __LINE__, "PAPI_export_set in a child", 1 );
+	}
+	read_slot( slot, &forked );
+	if ( forked.tid != stopped.tid || strcmp( forked.label, LABEL ) != 0 ||
+	     forked.values[0] != stopped.values[0] ) {
+		test_fail( __FILE__, __LINE__, "Child wrote the parent's slot", 1 );
+	}
+	snprintf( child_path, sizeof ( child_path ), PAPI_EXPORT_PATH,
+		  ( int ) child );
+	unlink( child_path );
+
+	retval = PAPI_export_set( EventSet, NULL, 0 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_export_set(NULL)", retval );
+	}
+	read_slot( slot, &freed );
+	if ( freed.tid != 0 ) {
+		test_fail( __FILE__, __LINE__, "Slot not freed", 1 );
+	}
+
+	munmap( hdr, size );
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+	}
+
+	PAPI_shutdown(  );
+
+	if ( access( path, F_OK ) == 0 ) {
+		test_fail( __FILE__, __LINE__, "Segment left after shutdown", 1 );
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,222 @@
+/*
+* File:    hl_regions.c
+*/
+
+/* This file performs the following test: named regions are counted with
+   PAPI_hl_region_begin/end in the main thread and two pthreads, and the
+   merged statistics are checked.
+
+   - Check the calls refuse bad names and unbalanced ends
+   - Each thread runs an inner region nested in an outer one
+   - Check visits and threads, that the outer region includes the inner
+     one, and that min <= mean <= max
+   - Time empty begin/end pairs
+   - Shut down and check the report was written
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#define VISITS 20
+#define PAIRS 10000
+
+static void
+run_regions( void )
+{
+	int retval, i;
+
+	for ( i = 0; i < VISITS; i++ ) {
+		retval = PAPI_hl_region_begin( "outer" );
+		if ( retval != PAPI_OK ) {
+			test_fail( __FILE__, __LINE__, "PAPI_hl_region_begin", retval );
+		}
+		do_flops( NUM_FLOPS / 10 );
+
+		retval = PAPI_hl_region_begin( "inner" );
+		if ( retval != PAPI_OK ) {
+			test_fail( __FILE__, __LINE__, "PAPI_hl_region_begin", retval );
+		}
+		do_flops( NUM_FLOPS / 10 );
+		retval = PAPI_hl_region_end( "inner" );
+		if ( retval != PAPI_OK ) {
+			test_fail( __FILE__, __LINE__, "PAPI_hl_region_end", retval );
+		}
+
+		retval = PAPI_hl_region_end( "outer" );
+		if ( retval != PAPI_OK ) {
+			test_fail( __FILE__, __LINE__, "PAPI_hl_region_end", retval );
+		}
+	}
+}
+
+static void *
+Thread( void *arg )
+{
+	int retval;
+
+	( void ) arg;
+
+	retval = PAPI_register_thread(  );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_register_thread", retval );
+	}
+
+	run_regions(  );
+
+	return NULL;
+}
+
+static void
+check_region( const char *name, PAPI_hl_region_info_t *info, int quiet )
+{
+	int retval, j;
+
+	retval = PAPI_hl_region_read( name, info );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_hl_region_read", retval );
+	}
+
+	if ( !quiet ) {
+		printf( "Region %-6s   : %lld visits, %d threads\n",
+			info->name, info->count, info->threads );
+		for ( j = 0; j <= info->num_events; j++ ) {
+			printf( "  column %d      : total %lld min %lld mean %.0f max %lld\n",
+				j, info->total[j], info->min[j], info->mean[j],
+				info->max[j] );
+		}
+	}
+
+	/* The main thread adds one visit in the unbalanced end check */
+	if ( info->count != 3 * VISITS + 1 || info->threads != 3 ||
+	     info->num_events != 1 ) {
+		test_fail( __FILE__, __LINE__, "Region visits", 1 );
+	}
+
+	for ( j = 0; j <= info->num_events; j++ ) {
+		if ( info->min[j] <= 0 || info->min[j] > info->mean[j] ||
+		     info->mean[j] > info->max[j] ) {
+			test_fail( __FILE__, __LINE__, "Region statistics", 1 );
+		}
+	}
+}
+
+int
+main( int argc, char **argv )
+{
+	PAPI_hl_region_info_t outer, inner;
+	pthread_t threads[2];
+	char event_name[PAPI_MAX_STR_LEN], report[PAPI_MAX_STR_LEN];
+	long long elapsed;
+	int retval, PAPI_event, i, j;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	retval = PAPI_thread_init( ( unsigned long ( * )( void ) )
+				   ( pthread_self ) );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_thread_init", retval );
+	}
+
+	PAPI_event = find_nonderived_event( );
+	if ( PAPI_event == 0 ) {
+		if ( !quiet ) printf( "Trouble adding event\n" );
+		test_skip( __FILE__, __LINE__, "Event trouble", 1 );
+	}
+
+	retval = PAPI_event_code_to_name( PAPI_event, event_name );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_event_code_to_name", retval );
+	}
+
+	snprintf( report, sizeof ( report ), "/tmp/papi_hl_regions.%d",
+		  ( int ) getpid(  ) );
+	setenv( "PAPI_HL_REGION_EVENTS", event_name, 1 );
+	setenv( "PAPI_HL_REGION_REPORT", report, 1 );
+
+	if ( PAPI_hl_region_begin( NULL ) != PAPI_EINVAL ||
+	     PAPI_hl_region_end( "outer" ) != PAPI_EINVAL ) {
+		test_fail( __FILE__, __LINE__, "Bad arguments accepted", 1 );
+	}
+
+	retval = PAPI_hl_region_begin( "outer" );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_hl_region_begin", retval );
+	}
+	retval = PAPI_hl_region_begin( "inner" );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_hl_region_begin", retval );
+	}
+	if ( PAPI_hl_region_end( "outer" ) != PAPI_EINVAL ) {
+		test_fail( __FILE__, __LINE__, "Unbalanced end accepted", 1 );
+	}
+	/* Close them again so these visits count too */
+	if ( PAPI_hl_region_end( "inner" ) != PAPI_OK ||
+	     PAPI_hl_region_end( "outer" ) != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_hl_region_end", 1 );
+	}
+
+	for ( i = 0; i < 2; i++ ) {
+		if ( pthread_create( &threads[i], NULL, Thread, NULL ) ) {
+			test_fail( __FILE__, __LINE__, "pthread_create", PAPI_ESYS );
+		}
+	}
+	run_regions(  );
+	for ( i = 0; i < 2; i++ ) {
+		pthread_join( threads[i], NULL );
+	}
+
+	elapsed = PAPI_get_real_nsec(  );
+	for ( i = 0; i < PAIRS; i++ ) {
+		PAPI_hl_region_begin( "empty" );
+		PAPI_hl_region_end( "empty" );
+	}
+	elapsed = PAPI_get_real_nsec(  ) - elapsed;
+
+	if ( !quiet ) {
+		printf( "Test case: Nested regions in 3 threads, counting %s.\n",
+			event_name );
+		printf( "-----------------------------------------------\n" );
+	}
+
+	check_region( "inner", &inner, quiet );
+	check_region( "outer", &outer, quiet );
+
+	for ( j = 0; j <= outer.num_events; j++ ) {
+		if ( outer.total[j] <= inner.total[j] ) {
+			test_fail( __FILE__, __LINE__, "Outer does not include inner", 1 );
+		}
+	}
+
+	if ( PAPI_hl_region_read( "missing", &inner ) != PAPI_ENOEVNT ) {
+		test_fail( __FILE__, __LINE__, "Missing region found", 1 );
+	}
+
+	if ( !quiet ) {
+		printf( "Begin/end pair   : %lld ns\n", elapsed / PAIRS );
+	}
+
+	PAPI_shutdown(  );
+
+	if ( access( report, R_OK ) != 0 ) {
+		test_fail( __FILE__, __LINE__, "Report not written", 1 );
+	}
+	unlink( report );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
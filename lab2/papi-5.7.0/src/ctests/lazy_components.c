@@ -0,0 +1,105 @@
+/*
+* File:    lazy_components.c
+*/
+
+/* This file performs the following test: the library is initialized
+   with PAPI_LAZY_COMPONENTS set, so only the CPU component starts.
+
+   - Check every other component reports PAPI_EDELAY_INIT
+   - Enumerate the first of them and check it is initialized
+   - Check the ones after it are still delayed
+   - Name an event of another one and check only that one starts
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+int
+main( int argc, char **argv )
+{
+	const PAPI_component_info_t *cmpinfo;
+	char name[PAPI_HUGE_STR_LEN];
+	int retval, numcmp, cid, first = -1, second = -1;
+	int code, event;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	setenv( "PAPI_LAZY_COMPONENTS", "1", 1 );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	numcmp = PAPI_num_components(  );
+	for ( cid = 1; cid < numcmp; cid++ ) {
+		cmpinfo = PAPI_get_component_info( cid );
+		if ( cmpinfo->disabled != PAPI_EDELAY_INIT ) {
+			test_fail( __FILE__, __LINE__, "Component not delayed", 1 );
+		}
+		if ( first < 0 )
+			first = cid;
+		else if ( second < 0 )
+			second = cid;
+	}
+
+	if ( first < 0 ) {
+		test_skip( __FILE__, __LINE__, "Only one component", 0 );
+	}
+
+	code = PAPI_NATIVE_MASK;
+	retval = PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, first );
+
+	cmpinfo = PAPI_get_component_info( first );
+	if ( !quiet ) {
+		printf( "Test case: Components initialized on first use.\n" );
+		printf( "-----------------------------------------------\n" );
+		printf( "Enumerated %-10s: disabled %d (%s)\n", cmpinfo->name,
+			cmpinfo->disabled, cmpinfo->disabled_reason );
+	}
+	if ( cmpinfo->disabled == PAPI_EDELAY_INIT ) {
+		test_fail( __FILE__, __LINE__, "Enumeration did not initialize", 1 );
+	}
+	if ( ( retval == PAPI_OK ) != ( cmpinfo->disabled == PAPI_OK ) ) {
+		test_fail( __FILE__, __LINE__, "PAPI_enum_cmp_event", retval );
+	}
+
+	if ( second < 0 ) {
+		test_pass( __FILE__ );
+	}
+
+	cmpinfo = PAPI_get_component_info( second );
+	if ( cmpinfo->disabled != PAPI_EDELAY_INIT ) {
+		test_fail( __FILE__, __LINE__, "Later component initialized", 1 );
+	}
+
+	/* An unknown event with a component prefix starts only that one */
+	snprintf( name, sizeof ( name ), "%s:::NO_SUCH_EVENT", cmpinfo->name );
+	retval = PAPI_event_name_to_code( name, &event );
+	if ( retval == PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_event_name_to_code", retval );
+	}
+
+	if ( !quiet ) {
+		printf( "Named %-15s: disabled %d (%s)\n", cmpinfo->name,
+			cmpinfo->disabled, cmpinfo->disabled_reason );
+	}
+	if ( cmpinfo->disabled == PAPI_EDELAY_INIT ) {
+		test_fail( __FILE__, __LINE__, "Naming did not initialize", 1 );
+	}
+	for ( cid = second + 1; cid < numcmp; cid++ ) {
+		if ( PAPI_get_component_info( cid )->disabled != PAPI_EDELAY_INIT ) {
+			test_fail( __FILE__, __LINE__, "Other component initialized", 1 );
+		}
+	}
+
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+/*
+* File:    mpx_thread_timers.c
+*/
+
+/* This file performs the following test: software multiplexing driven
+   by per-thread timers
+
+   - Several threads each multiplex the same events in software, so
+     every thread needs its own timer to rotate its events
+   - Every event must have been counted in every thread
+   - The threads run again after PAPI_DEF_ITIMER switches to the real
+     time itimer and SIGALRM, which the thread timers must follow
+   - PAPI_shutdown deletes the timers while records are still listed
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_THREADS 4
+#define MAX_EVENTS 4
+
+static const char *candidates[] = {
+	"PAPI_TOT_INS", "PAPI_BR_INS", "PAPI_LD_INS", "PAPI_SR_INS",
+	"perf::TASK-CLOCK", "perf::CPU-CLOCK", NULL
+};
+
+static int events[MAX_EVENTS];
+static int num_events;
+static volatile int failures;
+
+static double
+work( long n )
+{
+	long i;
+	double a = 0.0012;
+
+	for ( i = 0; i < n; i++ )
+		a += 0.01 * ( double ) ( i & 7 );
+	return a;
+}
+
+static void *
+thread( void *arg )
+{
+	int EventSet = PAPI_NULL;
+	long long values[MAX_EVENTS];
+	PAPI_option_t opt;
+	int retval, i;
+
+	( void ) arg;
+
+	retval = PAPI_register_thread(  );
+	if ( retval != PAPI_OK )
+		goto fail;
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		goto fail;
+	retval = PAPI_assign_eventset_component( EventSet, 0 );
+	if ( retval != PAPI_OK )
+		goto fail;
+
+	memset( &opt, 0, sizeof ( opt ) );
+	opt.multiplex.eventset = EventSet;
+	opt.multiplex.flags = PAPI_MULTIPLEX_FORCE_SW;
+	retval = PAPI_set_opt( PAPI_MULTIPLEX, &opt );
+	if ( retval != PAPI_OK )
+		goto fail;
+
+	retval = PAPI_add_events( EventSet, events, num_events );
+	if ( retval != PAPI_OK )
+		goto fail;
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		goto fail;
+
+	if ( work( 50000000 ) < 0.0 )
+		printf( "unreachable\n" );
+
+	retval = PAPI_stop( EventSet, values );
+	if ( retval != PAPI_OK )
+		goto fail;
+
+	for ( i = 0; i < num_events; i++ ) {
+		if ( values[i] <= 0 ) {
+			fprintf( stderr, "event %#x was never counted\n", events[i] );
+			__sync_fetch_and_add( &failures, 1 );
+		}
+	}
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		goto fail;
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		goto fail;
+	PAPI_unregister_thread(  );
+	return NULL;
+
+  fail:
+	fprintf( stderr, "%s: %s\n", __FILE__, PAPI_strerror( retval ) );
+	__sync_fetch_and_add( &failures, 1 );
+	return NULL;
+}
+
+static void
+run_threads( void )
+{
+	pthread_t threads[NUM_THREADS];
+	int i;
+
+	for ( i = 0; i < NUM_THREADS; i++ ) {
+		if ( pthread_create( &threads[i], NULL, thread, NULL ) != 0 )
+			test_fail( __FILE__, __LINE__, "pthread_create", PAPI_ESYS );
+	}
+	for ( i = 0; i < NUM_THREADS; i++ )
+		pthread_join( threads[i], NULL );
+}
+
+int
+main( int argc, char **argv )
+{
+	PAPI_option_t opt;
+	int retval, code, i;
+	int EventSet = PAPI_NULL;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	retval = PAPI_thread_init( ( unsigned long ( * )( void ) ) pthread_self );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_thread_init", retval );
+
+	retval = PAPI_multiplex_init(  );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_multiplex_init", retval );
+
+	/* software multiplexing scales everything by PAPI_TOT_CYC */
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	if ( PAPI_add_event( EventSet, PAPI_TOT_CYC ) != PAPI_OK )
+		test_skip( __FILE__, __LINE__, "PAPI_TOT_CYC", PAPI_ENOEVNT );
+
+	for ( i = 0; ( candidates[i] != NULL ) && ( num_events < MAX_EVENTS ); i++ ) {
+		if ( PAPI_event_name_to_code( ( char * ) candidates[i], &code ) != PAPI_OK )
+			continue;
+		if ( PAPI_add_event( EventSet, code ) != PAPI_OK )
+			continue;
+		PAPI_remove_event( EventSet, code );
+		events[num_events++] = code;
+		if ( !quiet )
+			printf( "multiplexing %s\n", candidates[i] );
+	}
+	PAPI_cleanup_eventset( EventSet );
+	PAPI_destroy_eventset( &EventSet );
+	if ( num_events < 2 )
+		test_skip( __FILE__, __LINE__, "Not enough events", num_events );
+
+	run_threads(  );
+	if ( failures )
+		test_fail( __FILE__, __LINE__, "thread CPU time timers", failures );
+
+	memset( &opt, 0, sizeof ( opt ) );
+	opt.itimer.itimer_num = ITIMER_REAL;
+	opt.itimer.itimer_sig = SIGALRM;
+	opt.itimer.ns = 0;
+	retval = PAPI_set_opt( PAPI_DEF_ITIMER, &opt );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_set_opt PAPI_DEF_ITIMER", retval );
+
+	run_threads(  );
+	if ( failures )
+		test_fail( __FILE__, __LINE__, "real time timers", failures );
+
+	PAPI_shutdown(  );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
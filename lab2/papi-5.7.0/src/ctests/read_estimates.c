@@ -0,0 +1,303 @@
+/*
+* File:    read_estimates.c
+*/
+
+/* This file performs the following test: PAPI_read_estimates
+
+   - On a plain EventSet the values match PAPI_read and every estimate
+     is exact: std_error 0, no slices and low == high == value
+   - On a multiplexed EventSet with no events yet it succeeds and
+     writes nothing
+   - On an EventSet multiplexed by the kernel the values are the
+     extrapolated counts and std_error is -1
+   - On an EventSet multiplexed by PAPI, with or without adaptive
+     slices, each value lies in its own interval
+   - The intervals narrow, relative to the value, as slices accumulate:
+     after sixteen times the slices an interval is narrower than the
+     widest it was at the doublings on the way there
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#define MAX_EVENTS 4
+#define MIN_SLICES 8			/* before the first width is taken */
+#define DOUBLINGS 4			/* of the slices after that */
+#define MAX_ROUNDS 2000			/* of do_flops( NUM_FLOPS ) per doubling */
+#define ATTEMPTS 3
+
+static const char *candidates[] = {
+	"PAPI_TOT_CYC", "PAPI_TOT_INS", "PAPI_BR_INS",
+	"perf::TASK-CLOCK", "perf::CPU-CLOCK", NULL
+};
+
+static int events[MAX_EVENTS];
+static int num_events;
+
+/* An EventSet on component 0, multiplexed as flags ask, or not at all
+   if flags is -1; returns PAPI_NULL if that is not supported. */
+static int
+make_eventset( int flags, int add )
+{
+	int EventSet = PAPI_NULL;
+	PAPI_option_t opt;
+	int retval;
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	retval = PAPI_assign_eventset_component( EventSet, 0 );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_assign_eventset_component",
+			   retval );
+
+	if ( flags >= 0 ) {
+		memset( &opt, 0, sizeof ( opt ) );
+		opt.multiplex.eventset = EventSet;
+		opt.multiplex.flags = flags;
+		if ( PAPI_set_opt( PAPI_MULTIPLEX, &opt ) != PAPI_OK )
+			goto unsupported;
+	}
+
+	if ( add && ( PAPI_add_events( EventSet, events, num_events ) != PAPI_OK ) )
+		goto unsupported;
+
+	return EventSet;
+
+  unsupported:
+	PAPI_cleanup_eventset( EventSet );
+	PAPI_destroy_eventset( &EventSet );
+	return PAPI_NULL;
+}
+
+static void
+run( int EventSet, long long *values, PAPI_estimate_t *est )
+{
+	long long check[MAX_EVENTS];
+	int retval;
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+	do_flops( NUM_FLOPS * 5 );
+
+	retval = PAPI_read_estimates( EventSet, values, est );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_read_estimates", retval );
+
+	retval = PAPI_stop( EventSet, check );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+}
+
+/* A multiplexed estimate must bracket its value */
+static void
+check_software( const char *what, long long *values, PAPI_estimate_t *est,
+		int quiet )
+{
+	int i;
+
+	for ( i = 0; i < num_events; i++ ) {
+		if ( !quiet )
+			printf( "%s %#x: %lld [%lld, %lld] std_error %lld, %d slices\n",
+				what, events[i], values[i], est[i].low, est[i].high,
+				est[i].std_error, est[i].slices );
+		if ( ( est[i].value != values[i] ) ||
+		     ( est[i].low > values[i] ) || ( est[i].high < values[i] ) ||
+		     ( est[i].std_error < -1 ) || ( est[i].slices < 0 ) )
+			test_fail( __FILE__, __LINE__, what, i );
+	}
+}
+
+/* Width of the interval relative to the value */
+static double
+width( PAPI_estimate_t *est )
+{
+	return ( double ) ( est->high - est->low ) / ( double ) est->value;
+}
+
+/* Work until every event has run in at least min slices */
+static void
+read_after( int EventSet, int min, long long *values, PAPI_estimate_t *est )
+{
+	int retval, round, i;
+
+	for ( round = 0; round < MAX_ROUNDS; round++ ) {
+		do_flops( NUM_FLOPS );
+		retval = PAPI_read_estimates( EventSet, values, est );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_read_estimates", retval );
+		for ( i = 0; ( i < num_events ) && ( est[i].slices >= min ); i++ )
+			;
+		if ( i == num_events )
+			return;
+	}
+}
+
+static void
+destroy( int *EventSet )
+{
+	PAPI_cleanup_eventset( *EventSet );
+	PAPI_destroy_eventset( EventSet );
+}
+
+/* The standard error falls as one over the square root of the slices,
+   but a rare noisy slice can widen any one interval, so each interval
+   is compared with the widest it was on the way.  Returns the first
+   event whose interval did not narrow, or -1. */
+static int
+narrows( int quiet )
+{
+	long long values[MAX_EVENTS];
+	PAPI_estimate_t est[MAX_EVENTS];
+	double widest[MAX_EVENTS];
+	int EventSet, retval, i, d, min, failed = -1;
+
+	EventSet = make_eventset( PAPI_MULTIPLEX_FORCE_SW, 1 );
+	if ( EventSet == PAPI_NULL )
+		return -1;
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	for ( i = 0; i < num_events; i++ )
+		widest[i] = -1.0;
+	for ( d = 0, min = MIN_SLICES; d < DOUBLINGS; d++, min *= 2 ) {
+		read_after( EventSet, min, values, est );
+		for ( i = 0; i < num_events; i++ ) {
+			if ( ( est[i].std_error > 0 ) && ( width( &est[i] ) > widest[i] ) )
+				widest[i] = width( &est[i] );
+		}
+	}
+	read_after( EventSet, min, values, est );
+	retval = PAPI_stop( EventSet, NULL );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+	for ( i = 0; i < num_events; i++ ) {
+		if ( ( widest[i] <= 0.0 ) || ( est[i].std_error <= 0 ) ||
+		     ( est[i].slices < min ) )
+			continue;
+		if ( !quiet )
+			printf( "%#x: width %f after %d slices, at most %f before\n",
+				events[i], width( &est[i] ), est[i].slices, widest[i] );
+		if ( ( width( &est[i] ) >= widest[i] ) && ( failed < 0 ) )
+			failed = i;
+	}
+	destroy( &EventSet );
+	return failed;
+}
+
+int
+main( int argc, char **argv )
+{
+	long long values[MAX_EVENTS];
+	PAPI_estimate_t est[MAX_EVENTS];
+	PAPI_option_t opt;
+	int EventSet, retval, code, i, d;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	retval = PAPI_multiplex_init(  );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_multiplex_init", retval );
+
+	EventSet = make_eventset( -1, 0 );
+	for ( i = 0; ( candidates[i] != NULL ) && ( num_events < MAX_EVENTS ); i++ ) {
+		if ( PAPI_event_name_to_code( ( char * ) candidates[i], &code ) != PAPI_OK )
+			continue;
+		if ( PAPI_add_event( EventSet, code ) != PAPI_OK )
+			continue;
+		events[num_events++] = code;
+	}
+	if ( num_events == 0 )
+		test_skip( __FILE__, __LINE__, "No events", PAPI_ENOEVNT );
+
+	/* not multiplexed: every estimate is exact */
+	run( EventSet, values, est );
+	for ( i = 0; i < num_events; i++ ) {
+		if ( ( values[i] <= 0 ) || ( est[i].value != values[i] ) ||
+		     ( est[i].low != values[i] ) || ( est[i].high != values[i] ) ||
+		     ( est[i].std_error != 0 ) || ( est[i].slices != 0 ) )
+			test_fail( __FILE__, __LINE__, "plain estimate", i );
+	}
+	destroy( &EventSet );
+
+	/* multiplexed by PAPI but still empty: nothing to write */
+	EventSet = make_eventset( PAPI_MULTIPLEX_FORCE_SW, 0 );
+	if ( EventSet != PAPI_NULL ) {
+		memset( est, 0x5a, sizeof ( est ) );
+		retval = PAPI_read_estimates( EventSet, values, est );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_read_estimates empty",
+				   retval );
+		if ( est[0].slices != 0x5a5a5a5a )
+			test_fail( __FILE__, __LINE__, "empty set wrote estimates", 1 );
+		destroy( &EventSet );
+	}
+
+	/* multiplexed by the kernel: PAPI cannot see the slices */
+	EventSet = make_eventset( PAPI_MULTIPLEX_DEFAULT, 1 );
+	if ( EventSet != PAPI_NULL ) {
+		run( EventSet, values, est );
+		for ( i = 0; i < num_events; i++ ) {
+			if ( ( est[i].value != values[i] ) || ( est[i].std_error != -1 ) )
+				test_fail( __FILE__, __LINE__, "kernel estimate", i );
+		}
+		destroy( &EventSet );
+	} else if ( !quiet ) {
+		printf( "kernel multiplexing not available\n" );
+	}
+
+	/* multiplexed by PAPI */
+	EventSet = make_eventset( PAPI_MULTIPLEX_FORCE_SW, 1 );
+	if ( EventSet != PAPI_NULL ) {
+		run( EventSet, values, est );
+		check_software( "software estimate", values, est, quiet );
+		destroy( &EventSet );
+	} else if ( !quiet ) {
+		printf( "software multiplexing not available\n" );
+	}
+
+	/* multiplexed by PAPI with slices sized to the noise */
+	EventSet = make_eventset( PAPI_MULTIPLEX_ADAPTIVE, 1 );
+	if ( EventSet != PAPI_NULL ) {
+		PAPI_multiplex_option_t *mpx = &opt.multiplex;
+
+		memset( &opt, 0, sizeof ( opt ) );
+		mpx->eventset = EventSet;
+		retval = PAPI_get_opt( PAPI_MULTIPLEX, &opt );
+		if ( ( retval != 1 ) || !( mpx->flags & PAPI_MULTIPLEX_ADAPTIVE ) )
+			test_fail( __FILE__, __LINE__, "adaptive flag", retval );
+		run( EventSet, values, est );
+		check_software( "adaptive estimate", values, est, quiet );
+		destroy( &EventSet );
+	} else if ( !quiet ) {
+		printf( "adaptive multiplexing not available\n" );
+	}
+
+	/* a noisy slice late in the run can still widen the last
+	   interval, so only fail if it does so every time */
+	for ( d = 0; d < ATTEMPTS; d++ ) {
+		if ( ( i = narrows( quiet ) ) < 0 )
+			break;
+	}
+	if ( i >= 0 )
+		test_fail( __FILE__, __LINE__, "width did not shrink", i );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
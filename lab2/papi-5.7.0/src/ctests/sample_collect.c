@@ -0,0 +1,162 @@
+/*
+* File:    sample_collect.c
+*/
+
+/* This file performs the following test: streamed samples are drained by
+   the background collector thread set up with PAPI_sample_collect.
+
+   - Set up streaming with IP and TIME on one event
+   - Hand the EventSet to the collector with a small batch
+   - Start, do flops, stop
+   - Check the handler got the samples, mostly from another thread,
+     and that no signal was delivered to this thread
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+struct collect_check {
+	pthread_t measured;
+	int samples;
+	int batches;
+	int foreign_batches;
+};
+
+static volatile int signals = 0;
+
+static void
+count_signal( int sig )
+{
+	( void ) sig;
+	signals++;
+}
+
+static void
+sample_handler( int EventSet, PAPI_sample_t *samples, int count, void *context )
+{
+	struct collect_check *check = context;
+
+	( void ) EventSet;
+	( void ) samples;
+
+	check->samples += count;
+	check->batches++;
+	if ( !pthread_equal( check->measured, pthread_self(  ) ) ) {
+		check->foreign_batches++;
+	}
+}
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	long long value;
+	int retval, PAPI_event, period, sig;
+	struct collect_check check;
+	const PAPI_hw_info_t *hw_info;
+	const PAPI_component_info_t *cmpinfo;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	hw_info = PAPI_get_hardware_info(  );
+	if ( hw_info == NULL )
+		test_fail( __FILE__, __LINE__, "PAPI_get_hardware_info", 2 );
+
+	PAPI_event = find_nonderived_event( );
+	if ( PAPI_event == 0 ) {
+		if ( !quiet ) printf( "Trouble adding event\n" );
+		test_skip( __FILE__, __LINE__, "Event trouble", 1 );
+	}
+
+	/* Catch the signal hardware overflow would have used */
+	cmpinfo = PAPI_get_component_info( PAPI_get_event_component( PAPI_event ) );
+	sig = cmpinfo->hardware_intr_sig ? cmpinfo->hardware_intr_sig : SIGIO;
+	signal( sig, count_signal );
+	signal( SIGIO, count_signal );
+
+	period = ( int ) hw_info->cpu_max_mhz * 20000;
+	if ( period <= 0 ) period = THRESHOLD * 2;
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+
+	retval = PAPI_add_event( EventSet, PAPI_event );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+	}
+
+	retval = PAPI_sample_set( EventSet, PAPI_event, period,
+				  PAPI_SAMPLE_IP | PAPI_SAMPLE_TIME, 16 );
+	if ( retval == PAPI_ECMP ) {
+		test_skip( __FILE__, __LINE__, "PAPI_sample_set", retval );
+	}
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_sample_set", retval );
+	}
+
+	memset( &check, 0, sizeof ( check ) );
+	check.measured = pthread_self(  );
+	retval = PAPI_sample_collect( EventSet, sample_handler, &check, 8 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_sample_collect", retval );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	do_flops( NUM_FLOPS * 10 );
+
+	retval = PAPI_stop( EventSet, &value );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	if ( !quiet ) {
+		printf( "Test case: Collector thread drains sample rings.\n" );
+		printf( "-----------------------------------------------\n" );
+		printf( "Sample period    : %d\n", period );
+		printf( "Count            : %lld\n", value );
+		printf( "Samples          : %d in %d batches (%d from collector)\n",
+			check.samples, check.batches, check.foreign_batches );
+		printf( "Signals          : %d\n", signals );
+	}
+
+	if ( signals ) {
+		test_fail( __FILE__, __LINE__, "Measured thread was signalled", signals );
+	}
+
+	if ( value / period > 16 && check.foreign_batches == 0 ) {
+		test_fail( __FILE__, __LINE__, "No batch came from the collector", 1 );
+	}
+
+	if ( value / period > 0 && check.samples == 0 ) {
+		test_fail( __FILE__, __LINE__, "No samples collected", 1 );
+	}
+
+	retval = PAPI_sample_collect( EventSet, NULL, NULL, 0 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_sample_collect(NULL)", retval );
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,189 @@
+/*
+* File:    sample_stream.c
+*/
+
+/* This file performs the following test: samples are streamed through
+   the kernel ring buffer with PAPI_sample_set, without any signals.
+
+   - Count the event once to learn its rate
+   - Set up streaming with IP, TID and TIME on the event
+   - Check PAPI_overflow refuses the same event
+   - Start, do flops, stop
+   - Drain the ring and check sample count, thread id and timestamps
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+struct stream_check {
+	int samples;
+	int lost;
+	int bad_tid;
+	int backwards;
+	long long last_time;
+};
+
+static void
+overflow_handler( int EventSet, void *address, long long overflow_vector,
+		  void *context )
+{
+	( void ) EventSet;
+	( void ) address;
+	( void ) overflow_vector;
+	( void ) context;
+}
+
+static void
+sample_handler( int EventSet, PAPI_sample_t *samples, int count, void *context )
+{
+	struct stream_check *check = context;
+	int tid = ( int ) syscall( SYS_gettid );
+	int i;
+
+	( void ) EventSet;
+
+	for ( i = 0; i < count; i++ ) {
+		if ( samples[i].type & PAPI_SAMPLE_LOST ) {
+			check->lost += ( int ) samples[i].value;
+			continue;
+		}
+		check->samples++;
+		if ( samples[i].tid != tid ) check->bad_tid++;
+		if ( samples[i].time < check->last_time ) check->backwards++;
+		check->last_time = samples[i].time;
+	}
+}
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	long long values[2] = { 0, 0 };
+	long long min, max;
+	int retval, PAPI_event, period;
+	struct stream_check check;
+	const PAPI_hw_info_t *hw_info;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	hw_info = PAPI_get_hardware_info(  );
+	if ( hw_info == NULL )
+		test_fail( __FILE__, __LINE__, "PAPI_get_hardware_info", 2 );
+
+	PAPI_event = find_nonderived_event( );
+	if ( PAPI_event == 0 ) {
+		if ( !quiet ) printf( "Trouble adding event\n" );
+		test_skip( __FILE__, __LINE__, "Event trouble", 1 );
+	}
+
+	if (( PAPI_event == PAPI_FP_OPS ) || ( PAPI_event == PAPI_FP_INS )) {
+		period = THRESHOLD;
+	}
+	else {
+		period = ( int ) hw_info->cpu_max_mhz * 20000;
+	}
+	if ( period <= 0 ) period = THRESHOLD * 2;
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+
+	retval = PAPI_add_event( EventSet, PAPI_event );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_stop( EventSet, &values[0] );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	retval = PAPI_sample_set( EventSet, PAPI_event, period,
+				  PAPI_SAMPLE_IP | PAPI_SAMPLE_TID |
+				  PAPI_SAMPLE_TIME, 16 );
+	if ( retval == PAPI_ECMP ) {
+		test_skip( __FILE__, __LINE__, "PAPI_sample_set", retval );
+	}
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_sample_set", retval );
+	}
+
+	retval = PAPI_overflow( EventSet, PAPI_event, period, 0,
+				overflow_handler );
+	if ( retval != PAPI_ECNFLCT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_overflow on a streaming event",
+			   retval );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_stop( EventSet, &values[1] );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	memset( &check, 0, sizeof ( check ) );
+	retval = PAPI_sample_drain( EventSet, sample_handler, &check );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_sample_drain", retval );
+	}
+
+	if ( !quiet ) {
+		printf( "Test case: Streaming samples without signals.\n" );
+		printf( "-----------------------------------------------\n" );
+		printf( "Sample period    : %d\n", period );
+		printf( "Counts           : %16lld%16lld\n", values[0], values[1] );
+		printf( "Samples          : %d (lost %d)\n", check.samples, check.lost );
+		printf( "Bad tids         : %d\n", check.bad_tid );
+		printf( "Time reversals   : %d\n", check.backwards );
+	}
+
+	if ( check.bad_tid || check.backwards ) {
+		test_fail( __FILE__, __LINE__, "Sample contents", 1 );
+	}
+
+	min = ( long long ) ( ( ( double ) values[1] * ( 1.0 - OVR_TOLERANCE ) ) /
+			      ( double ) period );
+	max = ( long long ) ( ( ( double ) values[1] * ( 1.0 + OVR_TOLERANCE ) ) /
+			      ( double ) period );
+	if ( check.samples + check.lost > max ||
+	     check.samples + check.lost < min ) {
+		test_fail( __FILE__, __LINE__, "Samples", 1 );
+	}
+
+	retval = PAPI_sample_set( EventSet, PAPI_event, 0, 0, 0 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_sample_set(0)", retval );
+	}
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+/*
+* File:    sparse_profile.c
+*/
+
+/* This file performs the following test: PAPI_PROFIL_SPARSE
+
+   - The executable is profiled at 2 bytes per bucket into a sparse
+     table that PAPI_PROFIL_HASH_SLOTS makes much smaller than the
+     buckets a long block of straight-line code will hit
+   - Samples that find no slot are reported with region -1, and the
+     table grows at each PAPI_stop until it holds them
+   - The hits stay sorted with no bucket listed twice, and counts
+     only ever grow from one stop to the next
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define SPARSE_SLOTS "16"
+#define SPARSE_THRESHOLD 100000
+#define NUM_ROUNDS 8
+
+static volatile unsigned long sink;
+
+#define STEP  sink = sink * 31 + 7;
+#define STEP8  STEP STEP STEP STEP STEP STEP STEP STEP
+#define STEP64  STEP8 STEP8 STEP8 STEP8 STEP8 STEP8 STEP8 STEP8
+#define STEP512  STEP64 STEP64 STEP64 STEP64 STEP64 STEP64 STEP64 STEP64
+
+/* a few kilobytes of code so the samples spread over many buckets */
+static void
+straight_line( int n )
+{
+	int i;
+
+	for ( i = 0; i < n; i++ ) {
+		STEP512 STEP512
+	}
+}
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	int EventCode, retval, round, count, i, buckets;
+	PAPI_sprofil_t sprof[1];
+	PAPI_sprofil_hit_t *hits;
+	const PAPI_exe_info_t *exeinfo;
+	unsigned long long total, last_total = 0, dropped = 0;
+	long long value;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	setenv( "PAPI_PROFIL_HASH_SLOTS", SPARSE_SLOTS, 1 );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+	EventCode = PAPI_TOT_CYC;
+	retval = PAPI_add_event( EventSet, EventCode );
+	if ( retval != PAPI_OK ) {
+		retval = PAPI_event_name_to_code( "perf::TASK-CLOCK", &EventCode );
+		if ( retval == PAPI_OK )
+			retval = PAPI_add_event( EventSet, EventCode );
+		if ( retval != PAPI_OK )
+			test_skip( __FILE__, __LINE__, "No event to profile", retval );
+	}
+
+	exeinfo = PAPI_get_executable_info(  );
+	if ( exeinfo == NULL )
+		test_fail( __FILE__, __LINE__, "PAPI_get_executable_info", PAPI_ESYS );
+
+	sprof[0].pr_base = NULL;
+	sprof[0].pr_size = ( unsigned int ) ( exeinfo->address_info.text_end -
+					      exeinfo->address_info.text_start );
+	sprof[0].pr_off = exeinfo->address_info.text_start;
+	sprof[0].pr_scale = 65536;
+
+	retval = PAPI_sprofil( sprof, 1, EventSet, EventCode, SPARSE_THRESHOLD,
+			       PAPI_PROFIL_POSIX | PAPI_PROFIL_SPARSE );
+	if ( retval != PAPI_OK ) {
+		if ( ( retval == PAPI_ENOEVNT ) || ( retval == PAPI_ECMP ) )
+			test_skip( __FILE__, __LINE__, "PAPI_sprofil", retval );
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil", retval );
+	}
+
+	for ( round = 0; round < NUM_ROUNDS; round++ ) {
+		retval = PAPI_start( EventSet );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+		straight_line( 20000 );
+
+		retval = PAPI_stop( EventSet, &value );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+		retval = PAPI_sprofil_hits( EventSet, EventCode, NULL, 0, &count );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_sprofil_hits", retval );
+		hits = malloc( ( size_t ) ( count + 1 ) * sizeof ( PAPI_sprofil_hit_t ) );
+		if ( hits == NULL )
+			test_fail( __FILE__, __LINE__, "malloc", PAPI_ENOMEM );
+		retval = PAPI_sprofil_hits( EventSet, EventCode, hits, count, &count );
+		if ( retval != PAPI_OK )
+			test_fail( __FILE__, __LINE__, "PAPI_sprofil_hits", retval );
+
+		total = 0;
+		buckets = 0;
+		for ( i = 0; i < count; i++ ) {
+			total += hits[i].count;
+			if ( hits[i].region == -1 ) {
+				if ( i != count - 1 )
+					test_fail( __FILE__, __LINE__, "dropped entry not last", i );
+				dropped = hits[i].count;
+				continue;
+			}
+			buckets++;
+			if ( ( i > 0 ) && ( hits[i - 1].region == hits[i].region ) &&
+			     ( hits[i - 1].bucket >= hits[i].bucket ) )
+				test_fail( __FILE__, __LINE__, "hits out of order", i );
+		}
+		if ( total < last_total )
+			test_fail( __FILE__, __LINE__, "counts went down", round );
+		last_total = total;
+
+		if ( !quiet )
+			printf( "round %d: %d buckets, %llu samples, %llu dropped\n",
+				round, buckets, total, dropped );
+		free( hits );
+	}
+
+	if ( last_total < 4 * ( unsigned long long ) atoi( SPARSE_SLOTS ) )
+		test_skip( __FILE__, __LINE__, "too few samples", 0 );
+	if ( buckets <= atoi( SPARSE_SLOTS ) )
+		test_fail( __FILE__, __LINE__, "table did not grow", buckets );
+
+	retval = PAPI_sprofil( NULL, 0, EventSet, EventCode, 0, 0 );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil off", retval );
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", retval );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
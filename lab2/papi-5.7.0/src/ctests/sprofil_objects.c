@@ -0,0 +1,178 @@
+/*
+* File:    sprofil_objects.c
+*/
+
+/* This file performs the following test: PAPI_sprofil_objects
+
+   - Profiling is turned on over every loaded object and a second
+     request for the same event is refused
+   - Turning it off while the EventSet runs fails with PAPI_EISRUN
+     and leaves the regions usable
+   - Once stopped, turning it off succeeds, and a second time fails
+   - Regions the caller handed to PAPI_sprofil are turned off by
+     PAPI_sprofil_objects but never freed by PAPI
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#define OBJ_THRESHOLD 1000000
+#define OBJ_SCALE 65536
+
+static unsigned long
+count_hits( PAPI_sprofil_t *prof, int count )
+{
+	unsigned long hits = 0;
+	unsigned short *buckets;
+	unsigned int i;
+	int j;
+
+	for ( j = 0; j < count; j++ ) {
+		buckets = ( unsigned short * ) prof[j].pr_base;
+		for ( i = 0; i < prof[j].pr_size / sizeof ( unsigned short ); i++ )
+			hits += buckets[i];
+	}
+	return hits;
+}
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	int EventCode, retval, count, other;
+	PAPI_sprofil_t *prof, *again, mine[1];
+	unsigned short *buckets;
+	const PAPI_exe_info_t *exeinfo;
+	const PAPI_shlib_info_t *shinfo;
+	long long value;
+	unsigned long length;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+
+	/* any event that can overflow will do */
+	EventCode = PAPI_TOT_CYC;
+	retval = PAPI_add_event( EventSet, EventCode );
+	if ( retval != PAPI_OK ) {
+		retval = PAPI_event_name_to_code( "perf::TASK-CLOCK", &EventCode );
+		if ( retval == PAPI_OK )
+			retval = PAPI_add_event( EventSet, EventCode );
+		if ( retval != PAPI_OK )
+			test_skip( __FILE__, __LINE__, "No event to profile", retval );
+	}
+
+	exeinfo = PAPI_get_executable_info(  );
+	shinfo = PAPI_get_shared_lib_info(  );
+	if ( ( exeinfo == NULL ) || ( shinfo == NULL ) )
+		test_fail( __FILE__, __LINE__, "PAPI_get_executable_info", PAPI_ESYS );
+
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode,
+				       OBJ_THRESHOLD, PAPI_PROFIL_POSIX,
+				       &prof, &count );
+	if ( retval != PAPI_OK ) {
+		if ( ( retval == PAPI_ENOEVNT ) || ( retval == PAPI_ECMP ) )
+			test_skip( __FILE__, __LINE__, "PAPI_sprofil_objects", retval );
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil_objects", retval );
+	}
+	if ( count != shinfo->count + 1 )
+		test_fail( __FILE__, __LINE__, "region count", count );
+
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode,
+				       OBJ_THRESHOLD, PAPI_PROFIL_POSIX,
+				       &again, &other );
+	if ( retval != PAPI_ECNFLCT )
+		test_fail( __FILE__, __LINE__, "second PAPI_sprofil_objects", retval );
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode, 0, 0,
+				       NULL, NULL );
+	if ( retval != PAPI_EISRUN )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil_objects while running",
+			   retval );
+
+	/* still profiling into the same buffers */
+	do_flops( NUM_FLOPS );
+
+	retval = PAPI_stop( EventSet, &value );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+
+	if ( !quiet )
+		printf( "%d objects, %lu samples in their text\n", count,
+			count_hits( prof, count ) );
+
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode, 0, 0,
+				       NULL, NULL );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil_objects off", retval );
+
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode, 0, 0,
+				       NULL, NULL );
+	if ( retval != PAPI_EINVAL )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil_objects off twice",
+			   retval );
+
+	/* a profile the caller set up is turned off but left alone */
+	length = ( unsigned long ) ( exeinfo->address_info.text_end -
+				     exeinfo->address_info.text_start );
+	buckets = ( unsigned short * ) calloc( 1, length / 2 + 2 );
+	if ( buckets == NULL )
+		test_fail( __FILE__, __LINE__, "calloc", PAPI_ENOMEM );
+	mine[0].pr_base = buckets;
+	mine[0].pr_size = ( unsigned int ) ( length / 2 + 2 );
+	mine[0].pr_off = exeinfo->address_info.text_start;
+	mine[0].pr_scale = 32768;
+
+	retval = PAPI_sprofil( mine, 1, EventSet, EventCode, OBJ_THRESHOLD,
+			       PAPI_PROFIL_POSIX );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil", retval );
+
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode, 0, 0,
+				       NULL, NULL );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil_objects off", retval );
+
+	if ( ( mine[0].pr_base != buckets ) ||
+	     ( mine[0].pr_size != ( unsigned int ) ( length / 2 + 2 ) ) )
+		test_fail( __FILE__, __LINE__, "caller's region changed", 1 );
+	free( buckets );
+
+	/* regions still handed out go away with the EventSet */
+	retval = PAPI_sprofil_objects( OBJ_SCALE, EventSet, EventCode,
+				       OBJ_THRESHOLD, PAPI_PROFIL_POSIX,
+				       &prof, &count );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_sprofil_objects", retval );
+
+	retval = PAPI_cleanup_eventset( EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_cleanup_eventset", retval );
+
+	retval = PAPI_destroy_eventset( &EventSet );
+	if ( retval != PAPI_OK )
+		test_fail( __FILE__, __LINE__, "PAPI_destroy_eventset", retval );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
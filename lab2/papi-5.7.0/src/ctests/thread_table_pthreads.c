@@ -0,0 +1,190 @@
+/*
+* File:    thread_table_pthreads.c
+*/
+
+/* This file performs the following test: the lock-free thread table and
+   native event table are used from several threads at once.
+
+   - PAPI_thread_init with an id function that gives the master thread
+     tid 0, as omp_get_thread_num would
+   - Worker threads register and unregister over and over, under a new
+     custom tid each round, so slots are filled, removed and probed
+     through while the others look themselves up
+   - Every lookup must return the caller's own descriptor, checked
+     through PAPI_set_thr_specific/PAPI_get_thr_specific
+   - The master keeps looking itself up and listing the threads, and
+     tid 0 must always be found
+   - Every thread also translates the same native event names and must
+     get the same codes back
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define NUM_WORKERS 8
+#define NUM_ROUNDS 500
+#define NUM_NAMES 16
+
+static __thread unsigned long my_id;
+
+static char names[NUM_NAMES][PAPI_MAX_STR_LEN];
+static int codes[NUM_NAMES];
+static int num_names;
+
+static volatile int running;
+static volatile int failures;
+
+static unsigned long
+get_id( void )
+{
+	return my_id;
+}
+
+static void
+fail( const char *why )
+{
+	fprintf( stderr, "%s\n", why );
+	__sync_fetch_and_add( &failures, 1 );
+}
+
+static void
+check_names( void )
+{
+	int i, code;
+
+	for ( i = 0; i < num_names; i++ ) {
+		if ( PAPI_event_name_to_code( names[i], &code ) != PAPI_OK ||
+			 code != codes[i] )
+			fail( "PAPI_event_name_to_code gave another code" );
+	}
+}
+
+static void *
+worker( void *arg )
+{
+	long k = ( long ) arg;
+	void *ptr;
+	int round, retval;
+
+	for ( round = 0; round < NUM_ROUNDS; round++ ) {
+		/* Unique over all rounds and workers, and never 0 */
+		my_id = ( unsigned long ) ( round * NUM_WORKERS + k + 1 );
+
+		retval = PAPI_register_thread(  );
+		if ( retval != PAPI_OK ) {
+			fail( "PAPI_register_thread" );
+			break;
+		}
+
+		/* Any other thread's descriptor would hold another pointer */
+		if ( PAPI_set_thr_specific( PAPI_USR1_TLS, &my_id ) != PAPI_OK ||
+			 PAPI_get_thr_specific( PAPI_USR1_TLS, &ptr ) != PAPI_OK ||
+			 ptr != &my_id )
+			fail( "worker found another thread's descriptor" );
+
+		if ( round % 50 == 0 )
+			check_names(  );
+
+		retval = PAPI_unregister_thread(  );
+		if ( retval != PAPI_OK ) {
+			fail( "PAPI_unregister_thread" );
+			break;
+		}
+	}
+
+	__sync_fetch_and_sub( &running, 1 );
+	return NULL;
+}
+
+int
+main( int argc, char **argv )
+{
+	pthread_t threads[NUM_WORKERS];
+	unsigned long tids[NUM_WORKERS + 1];
+	void *ptr;
+	int retval, i, n, found, lookups = 0;
+	int quiet, code, cid;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	/* The master thread becomes tid 0 */
+	my_id = 0;
+	retval = PAPI_thread_init( get_id );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_thread_init", retval );
+	}
+
+	retval = PAPI_set_thr_specific( PAPI_USR1_TLS, &my_id );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_set_thr_specific", retval );
+	}
+
+	/* Some native names for everyone to translate */
+	for ( cid = 0; cid < PAPI_num_components(  ) && num_names < NUM_NAMES; cid++ ) {
+		code = PAPI_NATIVE_MASK;
+		if ( PAPI_enum_cmp_event( &code, PAPI_ENUM_FIRST, cid ) != PAPI_OK )
+			continue;
+		do {
+			/* Keep the names that translate back to their code */
+			if ( PAPI_event_code_to_name( code, names[num_names] ) ==
+				 PAPI_OK &&
+				 PAPI_event_name_to_code( names[num_names], &codes[num_names] ) ==
+				 PAPI_OK )
+				num_names++;
+		} while ( num_names < NUM_NAMES &&
+				  PAPI_enum_cmp_event( &code, PAPI_ENUM_EVENTS, cid ) == PAPI_OK );
+	}
+	if ( !quiet )
+		printf( "Translating %d native event names\n", num_names );
+
+	running = NUM_WORKERS;
+	for ( i = 0; i < NUM_WORKERS; i++ ) {
+		if ( pthread_create( &threads[i], NULL, worker, ( void * ) ( long ) i ) )
+			test_fail( __FILE__, __LINE__, "pthread_create", PAPI_ESYS );
+	}
+
+	while ( running ) {
+		if ( PAPI_get_thr_specific( PAPI_USR1_TLS, &ptr ) != PAPI_OK ||
+			 ptr != &my_id )
+			fail( "master found another thread's descriptor" );
+
+		n = NUM_WORKERS + 1;
+		if ( PAPI_list_threads( tids, &n ) != PAPI_OK ) {
+			fail( "PAPI_list_threads" );
+		}
+		else {
+			for ( i = 0, found = 0; i < n; i++ )
+				if ( tids[i] == 0 )
+					found = 1;
+			if ( !found )
+				fail( "tid 0 missing from PAPI_list_threads" );
+		}
+
+		check_names(  );
+		lookups++;
+	}
+
+	for ( i = 0; i < NUM_WORKERS; i++ )
+		pthread_join( threads[i], NULL );
+
+	if ( !quiet )
+		printf( "%d workers x %d rounds, %d master passes, %d failures\n",
+				NUM_WORKERS, NUM_ROUNDS, lookups, failures );
+
+	if ( failures )
+		test_fail( __FILE__, __LINE__, "concurrent lookups", failures );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
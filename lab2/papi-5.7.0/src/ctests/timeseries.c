@@ -0,0 +1,148 @@
+/*
+* File:    timeseries.c
+*/
+
+/* This file performs the following test: an event set is snapshotted
+   every millisecond by PAPI's background thread with PAPI_timeseries_set.
+
+   - Check PAPI_timeseries_set is refused while running
+   - Start, do flops, stop
+   - Read the series back and check the snapshot count against the
+     elapsed time, that times and counts never go backwards, and that
+     the last snapshot matches what PAPI_stop returned
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#include "do_loops.h"
+
+#define PERIOD_NS 1000000
+#define MAX_RECORDS 16384
+
+int
+main( int argc, char **argv )
+{
+	int EventSet = PAPI_NULL;
+	long long value, dropped, elapsed, expected;
+	long long *times, *counts;
+	int retval, PAPI_event, count, i, backwards = 0;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT ) {
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+	}
+
+	PAPI_event = find_nonderived_event( );
+	if ( PAPI_event == 0 ) {
+		if ( !quiet ) printf( "Trouble adding event\n" );
+		test_skip( __FILE__, __LINE__, "Event trouble", 1 );
+	}
+
+	retval = PAPI_create_eventset( &EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_create_eventset", retval );
+	}
+
+	retval = PAPI_add_event( EventSet, PAPI_event );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_add_event", retval );
+	}
+
+	retval = PAPI_timeseries_set( EventSet, PERIOD_NS, MAX_RECORDS );
+	if ( retval == PAPI_ECMP ) {
+		test_skip( __FILE__, __LINE__, "PAPI_timeseries_set", retval );
+	}
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_timeseries_set", retval );
+	}
+
+	retval = PAPI_start( EventSet );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_start", retval );
+	}
+
+	retval = PAPI_timeseries_set( EventSet, PERIOD_NS, MAX_RECORDS );
+	if ( retval != PAPI_EISRUN ) {
+		test_fail( __FILE__, __LINE__, "PAPI_timeseries_set while running",
+			   retval );
+	}
+
+	elapsed = PAPI_get_real_nsec(  );
+	do_flops( NUM_FLOPS * 10 );
+	elapsed = PAPI_get_real_nsec(  ) - elapsed;
+
+	retval = PAPI_stop( EventSet, &value );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_stop", retval );
+	}
+
+	times = malloc( MAX_RECORDS * sizeof ( long long ) );
+	counts = malloc( MAX_RECORDS * sizeof ( long long ) );
+	if ( times == NULL || counts == NULL ) {
+		test_fail( __FILE__, __LINE__, "malloc", PAPI_ENOMEM );
+	}
+
+	retval = PAPI_timeseries_read( EventSet, times, counts, MAX_RECORDS,
+				       &count, &dropped );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_timeseries_read", retval );
+	}
+
+	for ( i = 1; i < count; i++ ) {
+		if ( times[i] < times[i - 1] || counts[i] < counts[i - 1] )
+			backwards++;
+	}
+
+	/* one snapshot per period, plus the ones at start and stop */
+	expected = elapsed / PERIOD_NS + 2;
+
+	if ( !quiet ) {
+		printf( "Test case: Time series of counts every %d ns.\n",
+			PERIOD_NS );
+		printf( "-----------------------------------------------\n" );
+		printf( "Elapsed          : %lld ns\n", elapsed );
+		printf( "Snapshots        : %d (dropped %lld, expected ~%lld)\n",
+			count, dropped, expected );
+		printf( "Stop count       : %lld\n", value );
+		if ( count > 0 )
+			printf( "Last snapshot    : %lld\n", counts[count - 1] );
+		printf( "Went backwards   : %d\n", backwards );
+	}
+
+	if ( backwards ) {
+		test_fail( __FILE__, __LINE__, "Snapshot order", 1 );
+	}
+
+	/* Timer ticks can coalesce on a loaded machine, so only demand */
+	/* a fraction of them, but never more than could have fired.    */
+	if ( count + dropped < 2 || count + dropped > expected + 1 ||
+	     count + dropped < expected / 4 ) {
+		test_fail( __FILE__, __LINE__, "Snapshots", 1 );
+	}
+
+	/* PAPI_stop reads just before the final snapshot */
+	if ( counts[count - 1] < value ||
+	     counts[count - 1] > value + value / 100 ) {
+		test_fail( __FILE__, __LINE__, "Last snapshot", 1 );
+	}
+
+	retval = PAPI_timeseries_set( EventSet, 0, 0 );
+	if ( retval != PAPI_OK ) {
+		test_fail( __FILE__, __LINE__, "PAPI_timeseries_set(0)", retval );
+	}
+
+	free( times );
+	free( counts );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
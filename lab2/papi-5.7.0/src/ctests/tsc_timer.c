@@ -0,0 +1,98 @@
+/*
+* File:    tsc_timer.c
+*/
+
+/* This file performs the following test: the real time timers
+
+   - PAPI_get_real_nsec never goes backwards while it is read in a
+     tight loop, across the switch from clock_gettime to a calibrated
+     TSC where the machine has one
+   - It agrees with clock_gettime( CLOCK_REALTIME ) afterwards, both in
+     absolute time and over a sleep
+   - PAPI_get_real_usec agrees with PAPI_get_real_nsec
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "papi.h"
+#include "papi_test.h"
+
+#define SPIN_NS		100000000LL	/* long enough to calibrate */
+#define SLEEP_US	200000
+#define MAX_OFFSET_NS	1000000LL
+#define MAX_ERROR_PPM	1000
+
+static long long
+realtime_nsec( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_REALTIME, &ts );
+	return ( long long ) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long
+abs_ll( long long x )
+{
+	return x < 0 ? -x : x;
+}
+
+int
+main( int argc, char **argv )
+{
+	long long start, last, now, reads = 0;
+	long long papi0, papi1, sys0, sys1, usec, offset;
+	int retval;
+	int quiet;
+
+	quiet = tests_quiet( argc, argv );
+
+	retval = PAPI_library_init( PAPI_VER_CURRENT );
+	if ( retval != PAPI_VER_CURRENT )
+		test_fail( __FILE__, __LINE__, "PAPI_library_init", retval );
+
+	start = last = PAPI_get_real_nsec(  );
+	do {
+		now = PAPI_get_real_nsec(  );
+		if ( now < last ) {
+			if ( !quiet )
+				printf( "went back %lld ns after %lld reads\n",
+					last - now, reads );
+			test_fail( __FILE__, __LINE__, "PAPI_get_real_nsec not monotonic",
+				   1 );
+		}
+		last = now;
+		reads++;
+	} while ( now - start < SPIN_NS );
+
+	offset = PAPI_get_real_nsec(  ) - realtime_nsec(  );
+	if ( !quiet )
+		printf( "%lld reads in %lld ns, %lld ns from CLOCK_REALTIME\n",
+			reads, now - start, offset );
+	if ( abs_ll( offset ) > MAX_OFFSET_NS )
+		test_fail( __FILE__, __LINE__, "PAPI_get_real_nsec offset", 1 );
+
+	papi0 = PAPI_get_real_nsec(  );
+	sys0 = realtime_nsec(  );
+	usleep( SLEEP_US );
+	papi1 = PAPI_get_real_nsec(  );
+	sys1 = realtime_nsec(  );
+	if ( !quiet )
+		printf( "slept %lld ns by PAPI, %lld ns by CLOCK_REALTIME\n",
+			papi1 - papi0, sys1 - sys0 );
+	if ( abs_ll( ( papi1 - papi0 ) - ( sys1 - sys0 ) ) * 1000000LL >
+	     ( sys1 - sys0 ) * MAX_ERROR_PPM )
+		test_fail( __FILE__, __LINE__, "PAPI_get_real_nsec rate", 1 );
+
+	now = PAPI_get_real_nsec(  );
+	usec = PAPI_get_real_usec(  );
+	if ( abs_ll( usec - now / 1000 ) > MAX_OFFSET_NS / 1000 )
+		test_fail( __FILE__, __LINE__, "PAPI_get_real_usec", 1 );
+
+	test_pass( __FILE__ );
+
+	return 0;
+}
@@ -25,6 +25,7 @@ vendors did in the kernel extensions or performance libraries. */
 #include "papi_memory.h"
 #include "extras.h"
 #include "threads.h"
+#include <stdlib.h>
 
 #if (!defined(HAVE_FFSLL) || defined(__bgp__))
 int ffsll( long long lli );
@@ -161,36 +162,395 @@ posix_profil( caddr_t address, PAPI_sprofil_t * prof,
 	}
 }
 
+static int
+compare_profile_regions( const void *a, const void *b )
+{
+	const ProfileRegion_t *ra = a, *rb = b;
+
+	if ( ra->start != rb->start )
+		return ( ra->start < rb->start ) ? -1 : 1;
+	/* Of regions with the same pr_off the first given wins, so it */
+	/* sorts last, where the lookup for the last start <= pc lands */
+	if ( ra->prof != rb->prof )
+		return ( ra->prof > rb->prof ) ? -1 : 1;
+	return 0;
+}
+
+/* size in bytes of one dense histogram bucket for the given flags */
+int
+_papi_hwi_profile_bucket_bytes( int flags )
+{
+	switch ( flags & PAPI_PROFIL_BUCKETS ) {
+	case 0:
+	case PAPI_PROFIL_BUCKET_16:
+		return sizeof ( unsigned short );
+	case PAPI_PROFIL_BUCKET_32:
+		return sizeof ( unsigned int );
+	case PAPI_PROFIL_BUCKET_64:
+		return sizeof ( unsigned long long );
+	default:
+		return PAPI_EINVAL;
+	}
+}
+
+static ProfileHash_t *
+alloc_profile_hash( unsigned int slots )
+{
+	ProfileHash_t *hash;
+
+	hash = papi_calloc( 1, sizeof ( ProfileHash_t ) +
+			    ( size_t ) ( slots - 1 ) * sizeof ( ProfileHashSlot_t ) );
+	if ( hash != NULL )
+		hash->mask = slots - 1;
+	return hash;
+}
+
+static void
+free_profile_hash( ProfileHash_t * hash )
+{
+	if ( hash == NULL )
+		return;
+	papi_free( hash->hits );
+	papi_free( hash );
+}
+
+void
+_papi_hwi_free_profile_regions( ProfileRegionTable_t * table )
+{
+	if ( table == NULL )
+		return;
+	free_profile_hash( table->hash );
+	papi_free( table );
+}
+
+/* A sparse table starts with twice the slots needed for every bucket
+   of its regions to be hit, within PAPI_PROFIL_HASH_MIN_SLOTS and
+   PAPI_PROFIL_HASH_MAX_SLOTS; larger profiles grow at PAPI_stop.
+   PAPI_PROFIL_HASH_SLOTS in the environment overrides the size. */
+static unsigned int
+profile_hash_slots( ProfileRegionTable_t * table )
+{
+	unsigned long long buckets = 1;	/* the catch-all */
+	unsigned int slots = PAPI_PROFIL_HASH_MIN_SLOTS;
+	char *env;
+	int i;
+
+	env = getenv( "PAPI_PROFIL_HASH_SLOTS" );
+	if ( ( env != NULL ) && ( atoi( env ) > 0 ) ) {
+		buckets = ( unsigned long long ) atoi( env );
+		for ( slots = 2; ( slots < buckets ) &&
+			      ( slots < PAPI_PROFIL_HASH_MAX_SLOTS ); slots <<= 1 );
+		return slots;
+	}
+
+	for ( i = 0; i < table->count; i++ ) {
+		buckets += ( ( ( unsigned long long )
+			       ( table->region[i].end - table->region[i].start ) *
+			       table->region[i].prof->pr_scale ) >> 17 ) + 1;
+	}
+
+	while ( ( slots < PAPI_PROFIL_HASH_MAX_SLOTS ) &&
+		( slots < buckets * 2 ) )
+		slots <<= 1;
+
+	return slots;
+}
+
+/* Turn a PAPI_sprofil_t array into an interval table for dispatch.
+   Each region covers the addresses whose bucket index falls inside
+   its buffer, or the pr_size bytes at pr_off for a sparse profile.
+   Regions may overlap: as always, a pc belongs to the region with the
+   largest pr_off at or below it, so each interval is cut short where
+   the next one starts.  The pr_off 0 / pr_scale 2 single bucket is
+   kept aside as the catch-all for samples outside every other region.
+*/
+int
+_papi_hwi_build_profile_regions( PAPI_sprofil_t * prof, int count,
+				 int flags, ProfileRegionTable_t ** table )
+{
+	ProfileRegionTable_t *t;
+	unsigned long long buckets, span;
+	int i, j, n = 0, bucket_bytes;
+
+	bucket_bytes = _papi_hwi_profile_bucket_bytes( flags );
+	if ( bucket_bytes < 0 )
+		return bucket_bytes;
+
+	t = papi_malloc( sizeof ( ProfileRegionTable_t ) +
+			 ( size_t ) count * sizeof ( ProfileRegion_t ) );
+	if ( t == NULL )
+		return PAPI_ENOMEM;
+	t->catchall = NULL;
+	t->base = prof;
+	t->hash = NULL;
+
+	for ( i = 0; i < count; i++ ) {
+		if ( ( prof[i].pr_off == 0 ) && ( prof[i].pr_scale == 0x2 ) ) {
+			if ( t->catchall != NULL ) {
+				PRFDBG( "more than one catch-all region\n" );
+				papi_free( t );
+				return PAPI_EINVAL;
+			}
+			t->catchall = &prof[i];
+			continue;
+		}
+
+		if ( flags & PAPI_PROFIL_SPARSE ) {
+			span = prof[i].pr_size;
+		} else {
+			/* posix_profil() uses bucket (pc - pr_off) * pr_scale >> 17 */
+			buckets = prof[i].pr_size / ( unsigned ) bucket_bytes;
+			span = ( ( buckets << 17 ) + prof[i].pr_scale - 1 ) /
+				prof[i].pr_scale;
+		}
+		if ( span == 0 )
+			continue;
+
+		t->region[n].start = prof[i].pr_off;
+		t->region[n].end = prof[i].pr_off + span;
+		t->region[n].prof = &prof[i];
+		n++;
+	}
+	t->count = n;
+
+	qsort( t->region, ( size_t ) n, sizeof ( ProfileRegion_t ),
+	       compare_profile_regions );
+
+	/* Split overlaps; a region left with nothing to cover is dropped */
+	for ( i = 0, j = 0; i < n; i++ ) {
+		if ( ( i + 1 < n ) && ( t->region[i + 1].start < t->region[i].end ) ) {
+			PRFDBG( "region at %p overlaps region at %p\n",
+				t->region[i + 1].start, t->region[i].start );
+			t->region[i].end = t->region[i + 1].start;
+		}
+		if ( t->region[i].end > t->region[i].start )
+			t->region[j++] = t->region[i];
+	}
+	t->count = j;
+
+	if ( flags & PAPI_PROFIL_SPARSE ) {
+		t->hash = alloc_profile_hash( profile_hash_slots( t ) );
+		if ( t->hash == NULL ) {
+			papi_free( t );
+			return PAPI_ENOMEM;
+		}
+	}
+
+	*table = t;
+
+	return PAPI_OK;
+}
+
+static inline unsigned int
+profile_hash_index( unsigned long long key )
+{
+	/* Fibonacci hashing spreads neighbouring buckets over the table */
+	return ( unsigned int ) ( ( key * 0x9E3779B97F4A7C15ULL ) >> 32 );
+}
+
+/* Count a sample in a sparse profile.  Runs in signal context (or in
+   the collector thread), so it neither locks nor allocates: a free
+   slot is claimed with compare and swap and counts are added
+   atomically.  A sample that finds neither its bucket nor a free slot
+   within PAPI_PROFIL_HASH_PROBES slots is only counted as dropped;
+   the table grows the next time the EventSet is stopped.
+*/
+static void
+sparse_profil( caddr_t address, PAPI_sprofil_t * prof, int region,
+	       ProfileHash_t * hash, int flags, long long excess,
+	       long long threshold )
+{
+	ProfileHashSlot_t *slot;
+	unsigned long long key, old;
+	unsigned long indx;
+	unsigned int i, probe;
+	int increment;
+
+	if ( ( prof->pr_off == 0 ) && ( prof->pr_scale == 0x2 ) )
+		indx = 0;
+	else
+		indx = ( unsigned long ) ( ( ( unsigned long long )
+					     ( address - prof->pr_off ) *
+					     prof->pr_scale ) >> 17 );
+
+	key = ( ( unsigned long long ) ( region + 1 ) << 48 ) | indx;
+	i = profile_hash_index( key );
+
+	for ( probe = 0; ( probe < PAPI_PROFIL_HASH_PROBES ) &&
+	      ( probe <= hash->mask ); probe++, i++ ) {
+		slot = &hash->slot[i & hash->mask];
+		old = slot->key;
+		if ( old == 0 ) {
+			old = __sync_val_compare_and_swap( &slot->key, 0, key );
+			if ( old == 0 ) {
+				__sync_fetch_and_add( &hash->used, 1 );
+				old = key;
+			}
+		}
+		if ( old == key ) {
+			increment = profil_increment( ( long long ) slot->count,
+						      flags, excess, threshold );
+			__sync_fetch_and_add( &slot->count,
+					      ( unsigned long long ) increment );
+			PRFDBG( "sparse_profil() region %d bucket %lu = %llu\n",
+				region, indx, slot->count );
+			return;
+		}
+	}
+
+	__sync_fetch_and_add( &hash->dropped, 1 );
+	hash->crowded = 1;
+}
+
 void
 _papi_hwi_dispatch_profile( EventSetInfo_t * ESI, caddr_t pc,
 							long long over, int profile_index )
 {
 	EventSetProfileInfo_t *profile = &ESI->profile;
-	PAPI_sprofil_t *sprof;
-	caddr_t offset = 0;
-	caddr_t best_offset = 0;
-	int count;
-	int best_index = -1;
-	int i;
+	ProfileRegionTable_t *table = profile->regions[profile_index];
+	PAPI_sprofil_t *sprof = NULL;
+	int lo, hi, mid;
 
 	PRFDBG( "handled IP %p\n", pc );
 
-	sprof = profile->prof[profile_index];
-	count = profile->count[profile_index];
+	if ( table == NULL )
+		return;
+
+	/* find the last region starting at or below pc */
+	lo = 0;
+	hi = table->count;
+	while ( lo < hi ) {
+		mid = ( lo + hi ) / 2;
+		if ( table->region[mid].start <= pc )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if ( ( lo > 0 ) && ( pc < table->region[lo - 1].end ) )
+		sprof = table->region[lo - 1].prof;
+	else
+		sprof = table->catchall;
 
-	for ( i = 0; i < count; i++ ) {
-		offset = sprof[i].pr_off;
-		if ( ( offset < pc ) && ( offset > best_offset ) ) {
-			best_index = i;
-			best_offset = offset;
+	if ( sprof == NULL )
+		return;
+
+	if ( table->hash != NULL ) {
+		sparse_profil( pc, sprof, ( int ) ( sprof - table->base ),
+			       table->hash, profile->flags, over,
+			       profile->threshold[profile_index] );
+		return;
+	}
+
+	posix_profil( pc, sprof, profile->flags, over,
+				  profile->threshold[profile_index] );
+}
+
+static int
+compare_profile_hits( const void *a, const void *b )
+{
+	const PAPI_sprofil_hit_t *ha = a, *hb = b;
+
+	if ( ha->region != hb->region )
+		return ( ha->region < hb->region ) ? -1 : 1;
+	if ( ha->bucket != hb->bucket )
+		return ( ha->bucket < hb->bucket ) ? -1 : 1;
+	return 0;
+}
+
+/* Rehash a sparse profile into a table twice its size. */
+static ProfileHash_t *
+grow_profile_hash( ProfileHash_t * hash )
+{
+	ProfileHash_t *bigger;
+	ProfileHashSlot_t *slot;
+	unsigned int i, j;
+
+	bigger = alloc_profile_hash( ( hash->mask + 1 ) * 2 );
+	if ( bigger == NULL )
+		return hash;
+
+	for ( i = 0; i <= hash->mask; i++ ) {
+		if ( hash->slot[i].key == 0 )
+			continue;
+		j = profile_hash_index( hash->slot[i].key );
+		for ( ;; j++ ) {
+			slot = &bigger->slot[j & bigger->mask];
+			if ( slot->key == 0 )
+				break;
 		}
+		*slot = hash->slot[i];
 	}
+	bigger->used = hash->used;
+	bigger->dropped = hash->dropped;
 
-	if ( best_index == -1 )
-		best_index = 0;
+	free_profile_hash( hash );
+	return bigger;
+}
 
-	posix_profil( pc, &sprof[best_index], profile->flags, over,
-				  profile->threshold[profile_index] );
+/* Called from PAPI_stop, when no handler can touch the tables: grow
+   every sparse profile that is over half full or dropped samples, then
+   dump its buckets into a sorted array for PAPI_sprofil_hits.  Rehashing
+   is not bound by PAPI_PROFIL_HASH_PROBES, so a bucket can end up in two
+   slots; the dump adds those together.
+*/
+void
+_papi_hwi_collect_profile_hits( EventSetInfo_t * ESI )
+{
+	ProfileRegionTable_t *table;
+	ProfileHash_t *hash;
+	PAPI_sprofil_hit_t *hits;
+	unsigned int i;
+	int e, m, n;
+
+	for ( e = 0; e < ESI->profile.event_counter; e++ ) {
+		table = ESI->profile.regions[e];
+		if ( ( table == NULL ) || ( table->hash == NULL ) )
+			continue;
+
+		hash = table->hash;
+		if ( ( hash->used * 2 > hash->mask + 1 ) || hash->crowded )
+			table->hash = hash = grow_profile_hash( hash );
+
+		hits = papi_malloc( ( hash->used + 1 ) *
+				    sizeof ( PAPI_sprofil_hit_t ) );
+		if ( hits == NULL )
+			continue;
+
+		n = 0;
+		for ( i = 0; i <= hash->mask; i++ ) {
+			if ( hash->slot[i].key == 0 )
+				continue;
+			hits[n].region = ( int ) ( hash->slot[i].key >> 48 ) - 1;
+			hits[n].bucket = ( unsigned long )
+				( hash->slot[i].key & 0xffffffffffffULL );
+			hits[n].count = hash->slot[i].count;
+			n++;
+		}
+		qsort( hits, ( size_t ) n, sizeof ( PAPI_sprofil_hit_t ),
+		       compare_profile_hits );
+
+		for ( i = 1, m = 0; i < ( unsigned int ) n; i++ ) {
+			if ( compare_profile_hits( &hits[m], &hits[i] ) == 0 )
+				hits[m].count += hits[i].count;
+			else
+				hits[++m] = hits[i];
+		}
+		if ( n > 0 )
+			n = m + 1;
+
+		/* samples lost to a full table are reported last */
+		if ( hash->dropped ) {
+			hits[n].region = -1;
+			hits[n].bucket = 0;
+			hits[n].count = hash->dropped;
+			n++;
+		}
+
+		papi_free( hash->hits );
+		hash->hits = hits;
+		hash->nhits = n;
+	}
 }
 
 /* if isHardware is true, then the processor is using hardware overflow,
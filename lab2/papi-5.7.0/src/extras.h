@@ -11,6 +11,11 @@ int _papi_hwi_dispatch_overflow_signal( void *papiContext, caddr_t address,
 					ThreadInfo_t ** master, int cidx );
 void _papi_hwi_dispatch_profile( EventSetInfo_t * ESI, caddr_t address,
 				 long long over, int profile_index );
+int _papi_hwi_profile_bucket_bytes( int flags );
+int _papi_hwi_build_profile_regions( PAPI_sprofil_t * prof, int count,
+				     int flags, ProfileRegionTable_t ** table );
+void _papi_hwi_free_profile_regions( ProfileRegionTable_t * table );
+void _papi_hwi_collect_profile_hits( EventSetInfo_t * ESI );
 
 
 #endif /* EXTRAS_H */
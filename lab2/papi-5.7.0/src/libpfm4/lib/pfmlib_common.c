@@ -873,6 +873,115 @@ pfmlib_build_fstr(pfmlib_event_desc_t *e, char **fstr)
 	return *fstr ? PFM_SUCCESS : PFM_ERR_NOMEM;
 }
 
+/*
+ * per-PMU event name index
+ *
+ * open addressing table of (case-insensitive hash, private event index).
+ * It only narrows down the candidates: a hit is always confirmed with
+ * get_event_info() and the regular match function, so PMUs whose event
+ * tables cannot be indexed (custom match_event) or have grown since the
+ * index was built (pme_count changed) fall back to the linear scan.
+ */
+typedef struct {
+	unsigned int	hash;
+	int		pidx;	/* -1: empty slot */
+} pfmlib_event_slot_t;
+
+struct pfmlib_event_index {
+	int			pme_count;	/* pme_count when index was built */
+	unsigned int		mask;		/* number of slots - 1 */
+	pfmlib_event_slot_t	slots[];
+};
+
+static unsigned int
+pfmlib_hash_event_name(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	while (*s) {
+		h ^= (unsigned char)tolower((unsigned char)*s++);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static struct pfmlib_event_index *
+pfmlib_build_event_index(pfmlib_pmu_t *pmu)
+{
+	struct pfmlib_event_index *idx;
+	pfm_event_info_t einfo;
+	unsigned int h, k, nslots = 16;
+	int i, n = 0;
+
+	if (pmu->match_event)
+		return NULL;
+
+	pfmlib_for_each_pmu_event(pmu, i)
+		n++;
+
+	/* keep load factor under 1/2 */
+	while (nslots < 2 * (unsigned int)n)
+		nslots <<= 1;
+
+	idx = malloc(sizeof(*idx) + nslots * sizeof(pfmlib_event_slot_t));
+	if (!idx)
+		return NULL;
+
+	idx->pme_count = pmu->pme_count;
+	idx->mask = nslots - 1;
+	for (k = 0; k < nslots; k++)
+		idx->slots[k].pidx = -1;
+
+	/*
+	 * events are inserted in enumeration order, so for duplicate names
+	 * the first event in the table is also the first one probed
+	 */
+	pfmlib_for_each_pmu_event(pmu, i) {
+		memset(&einfo, 0, sizeof(einfo));
+		if (pmu->get_event_info(pmu, i, &einfo) != PFM_SUCCESS || !einfo.name) {
+			free(idx);
+			return NULL;
+		}
+		h = pfmlib_hash_event_name(einfo.name);
+		for (k = h & idx->mask; idx->slots[k].pidx != -1; k = (k + 1) & idx->mask)
+			;
+		idx->slots[k].hash = h;
+		idx->slots[k].pidx = i;
+	}
+	DPRINT("%s: indexed %d events in %u slots\n", pmu->name, n, nslots);
+
+	return idx;
+}
+
+static struct pfmlib_event_index *
+pfmlib_get_event_index(pfmlib_pmu_t *pmu)
+{
+	struct pfmlib_event_index *idx, *old = NULL;
+
+	if (pmu->match_event)
+		return NULL;
+
+	idx = __atomic_load_n(&pmu->event_index, __ATOMIC_ACQUIRE);
+	if (!idx) {
+		/*
+		 * inactive PMUs named explicitly are indexed on first use,
+		 * racing builders agree on a single published index
+		 */
+		idx = pfmlib_build_event_index(pmu);
+		if (!idx)
+			return NULL;
+		if (!__atomic_compare_exchange_n(&pmu->event_index, &old, idx, 0,
+						 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			free(idx);
+			idx = old;
+		}
+	}
+	if (idx->pme_count != pmu->pme_count)
+		return NULL;
+
+	return idx;
+}
+
 static int
 pfmlib_pmu_activate(pfmlib_pmu_t *p)
 {
@@ -994,8 +1103,10 @@ pfmlib_init_pmus(void)
 		}
 
 		ret = pfmlib_pmu_activate(p);
-		if (ret == PFM_SUCCESS)
+		if (ret == PFM_SUCCESS) {
 			nsuccess++;
+			p->event_index = pfmlib_build_event_index(p);
+		}
 
 		if (pfm_cfg.forced_pmu) {
 			__pfm_vbprintf("PMU forced to %s (%s) : %s\n",
@@ -1077,6 +1188,8 @@ pfm_terminate(void)
 
 	pfmlib_for_each_pmu(i) {
 		pmu = pfmlib_pmus[i];
+		free(pmu->event_index);
+		pmu->event_index = NULL;
 		if (!pfmlib_pmu_active(pmu))
 			continue;
 		if (pmu->pmu_terminate)
@@ -1378,12 +1491,52 @@ match_event(void *this, pfmlib_event_desc_t *d, const char *e, const char *s)
 	return strcasecmp(e, s);
 }
 
+/*
+ * return the private index of the event called s on pmu, PFM_ERR_NOTFOUND
+ * if there is none, or the error from get_event_info(). einfo is left
+ * describing the event found
+ */
+static int
+pfmlib_find_pmu_event(pfmlib_pmu_t *pmu, pfmlib_event_desc_t *d, const char *s, pfm_event_info_t *einfo)
+{
+	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
+	struct pfmlib_event_index *idx;
+	unsigned int h, k;
+	int i, ret;
+
+	idx = pfmlib_get_event_index(pmu);
+	if (idx) {
+		h = pfmlib_hash_event_name(s);
+		for (k = h & idx->mask; idx->slots[k].pidx != -1; k = (k + 1) & idx->mask) {
+			if (idx->slots[k].hash != h)
+				continue;
+			i = idx->slots[k].pidx;
+			ret = pmu->get_event_info(pmu, i, einfo);
+			if (ret != PFM_SUCCESS)
+				return ret;
+			if (!match_event(pmu, d, einfo->name, s))
+				return i;
+		}
+		return PFM_ERR_NOTFOUND;
+	}
+
+	match = pmu->match_event ? pmu->match_event : match_event;
+
+	pfmlib_for_each_pmu_event(pmu, i) {
+		ret = pmu->get_event_info(pmu, i, einfo);
+		if (ret != PFM_SUCCESS)
+			return ret;
+		if (!match(pmu, d, einfo->name, s))
+			return i;
+	}
+	return PFM_ERR_NOTFOUND;
+}
+
 static int
 pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 {
 	pfmlib_pmu_t *pmu = d->pmu;
 	pfm_event_info_t einfo;
-	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
 	char *str, *s, *p;
 	int i;
 	int ret;
@@ -1400,18 +1553,15 @@ pfmlib_parse_equiv_event(const char *event, pfmlib_event_desc_t *d)
 	/* if (p)
 	 *p++ = '\0'; */
 
-	match = pmu->match_event ? pmu->match_event : match_event;
-
-	pfmlib_for_each_pmu_event(pmu, i) {
-		ret = pmu->get_event_info(pmu, i, &einfo);
-		if (ret != PFM_SUCCESS)
-			goto error;
-		if (!match(pmu, d, einfo.name, s))
-			goto found;
+	i = pfmlib_find_pmu_event(pmu, d, s, &einfo);
+	if (i == PFM_ERR_NOTFOUND) {
+		free(str);
+		return PFM_ERR_NOTFOUND;
+	}
+	if (i < 0) {
+		ret = i;
+		goto error;
 	}
-	free(str);
-	return PFM_ERR_NOTFOUND;
-found:
 	d->pmu = pmu;
 	d->event = i; /* private index */
 
@@ -1442,7 +1592,6 @@ pfmlib_parse_event(const char *event, pfmlib_event_desc_t *d)
 	pfm_event_info_t einfo;
 	char *str, *s, *p;
 	pfmlib_pmu_t *pmu;
-	int (*match)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
 	const char *pname = NULL;
 	int i, j, ret;
 
@@ -1495,16 +1644,12 @@ pfmlib_parse_event(const char *event, pfmlib_event_desc_t *d)
 		if (pname && !pfmlib_pmu_active(pmu) && !pfm_cfg.inactive)
 			continue;
 
-		match = pmu->match_event ? pmu->match_event : match_event;
-		/*
-		 * for each event
-		 */
-		pfmlib_for_each_pmu_event(pmu, i) {
-			ret = pmu->get_event_info(pmu, i, &einfo);
-			if (ret != PFM_SUCCESS)
-				goto error;
-			if (!match(pmu, d, einfo.name, s))
-				goto found;
+		i = pfmlib_find_pmu_event(pmu, d, s, &einfo);
+		if (i >= 0)
+			goto found;
+		if (i != PFM_ERR_NOTFOUND) {
+			ret = i;
+			goto error;
 		}
 	}
 	free(str);
@@ -102,6 +102,7 @@ typedef struct {
 #define PFMLIB_MAX_PATTRS	(PFMLIB_MAX_ATTRS+1)
 
 struct pfmlib_pmu;
+struct pfmlib_event_index;
 typedef struct {
 	struct pfmlib_pmu	*pmu;				/* pmu */
 	int			dfl_plm;			/* default priv level mask */
@@ -163,6 +164,8 @@ typedef struct pfmlib_pmu {
 	int 		 (*get_num_events)(void *this);
 	void		 (*display_reg)(void *this, pfmlib_event_desc_t *e, void *val);
 	int 		 (*match_event)(void *this, pfmlib_event_desc_t *d, const char *e, const char *s);
+
+	struct pfmlib_event_index *event_index;	/* event name hash, private to pfmlib_common.c */
 } pfmlib_pmu_t;
 
 typedef struct {
@@ -13,6 +13,7 @@
 #include <syscall.h>
 #include <sys/utsname.h>
 #include <sys/time.h>
+#include <fcntl.h>
 
 #include "papi.h"
 #include "papi_internal.h"
@@ -711,6 +712,9 @@ _papi_hwi_init_os(void) {
    /* Get Linux-specific system info */
    _linux_get_system_info( &_papi_hwi_system_info );
 
+   /* Switch wall clock timers to the TSC where it can be trusted */
+   _linux_init_tsc_timer(  );
+
    return PAPI_OK;
 }
 
@@ -732,6 +736,73 @@ int _linux_detect_nmi_watchdog() {
   return watchdog_detected;
 }
 
+/* Helpers for components that sample sysfs and procfs files.  The    */
+/* file is opened once and re-read from offset 0 with pread, which   */
+/* makes the kernel regenerate its contents, so a read costs one      */
+/* system call instead of an open/read/close triple.                  */
+
+int
+_linux_sysfile_open( const char *path )
+{
+	return open( path, O_RDONLY | O_CLOEXEC );
+}
+
+/* Read the whole file into buf, NUL terminated; a file longer than */
+/* size-1 bytes is truncated.  Returns the length or PAPI_ESYS.      */
+int
+_linux_sysfile_read( int fd, char *buf, int size )
+{
+	ssize_t ret;
+	int len = 0;
+
+	while ( len < size - 1 ) {
+		ret = pread( fd, buf + len, size - 1 - len, len );
+		if ( ret < 0 ) {
+			if ( errno == EINTR )
+				continue;
+			SUBDBG( "pread of fd %d failed: %s\n", fd, strerror( errno ) );
+			buf[len] = '\0';
+			return PAPI_ESYS;
+		}
+		if ( ret == 0 )
+			break;
+		len += ret;
+	}
+	buf[len] = '\0';
+
+	return len;
+}
+
+/* Parse the next decimal integer at or after p, stopping at the end */
+/* of the line.  Returns the character after it, or NULL if the line */
+/* has no more numbers.                                              */
+char *
+_linux_sysfile_ll( char *p, long long *value )
+{
+	unsigned long long v = 0;
+	int neg = 0;
+
+	while ( *p && *p != '\n' ) {
+		if ( *p >= '0' && *p <= '9' )
+			break;
+		if ( *p == '-' && p[1] >= '0' && p[1] <= '9' ) {
+			neg = 1;
+			p++;
+			break;
+		}
+		p++;
+	}
+	if ( *p < '0' || *p > '9' )
+		return NULL;
+
+	while ( *p >= '0' && *p <= '9' )
+		v = v * 10 + ( unsigned long long ) ( *p++ - '0' );
+
+	*value = neg ? -( long long ) v : ( long long ) v;
+
+	return p;
+}
+
 papi_os_vector_t _papi_os_vector = {
   .get_memory_info =   _linux_get_memory_info,
   .get_dmem_info =     _linux_get_dmem_info,
@@ -1,6 +1,9 @@
 #ifndef _LINUX_COMMON_H
 #define _LINUX_COMMON_H
 
+#include <unistd.h>
+#include <sys/syscall.h>
+
 #define LINUX_VERSION(a,b,c) ( ((a&0xff)<<24) | ((b&0xff)<<16) | ((c&0xff) << 8))
 
 #define min(x, y) ({				\
@@ -37,6 +40,10 @@ mygettid( void )
 
 int _linux_detect_nmi_watchdog();
 
+int _linux_sysfile_open( const char *path );
+int _linux_sysfile_read( int fd, char *buf, int size );
+char *_linux_sysfile_ll( char *p, long long *value );
+
 #if HAVE_SCHED_GETCPU
 #include <sched.h>
 /* If possible, pick the processors the code is currently running on. */
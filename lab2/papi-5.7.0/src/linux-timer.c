@@ -17,11 +17,13 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <stdio.h>
 
 #include <sys/time.h>
 
 #include <fcntl.h>
 #include "linux-common.h"
+#include "linux-timer.h"
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -29,6 +31,10 @@
 #include <sys/times.h>
 #include <stdint.h>
 
+#if defined(__i386__)||defined(__x86_64__)
+#include "x86_cpuid_info.h"
+#endif
+
 #ifdef __ia64__
 #include "perfmon/pfmlib_itanium2.h"
 #include "perfmon/pfmlib_montecito.h"
@@ -38,6 +44,16 @@
 #include <sys/platform/ppc.h>
 #endif
 
+/* Since glibc 2.17 clock_gettime() lives in libc proper and is served */
+/* from the vDSO; before that it would drag in librt, so older libraries */
+/* keep making the raw system call.                                      */
+#if defined(__GLIBC__) && \
+    ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 17 ) )
+#define papi_clock_gettime( clk, ts ) clock_gettime( clk, ts )
+#else
+#define papi_clock_gettime( clk, ts ) syscall( __NR_clock_gettime, clk, ts )
+#endif
+
 #if defined(HAVE_MMTIMER)
 #include <sys/mman.h>
 #include <linux/mmtimer.h>
@@ -298,6 +314,263 @@ get_cycles( void )
 
 
 
+/********************************************************************
+ * calibrated TSC wall clock                                        *
+ ********************************************************************/
+
+/* With an invariant TSC that the kernel also trusts as its clocksource,
+   wall clock time can be read with a single rdtsc and scaled to
+   nanoseconds by a multiply and shift.  Library init only checks the
+   TSC and takes a first stamp; the scale is then calibrated against
+   CLOCK_MONOTONIC_RAW from the time that passes between the real time
+   reads that follow, which keep going through clock_gettime() until
+   two rounds of at least TSC_CALIBRATION_NS agree.  If they do not, or
+   the kernel has stopped using the TSC by then, clock_gettime() stays. */
+
+#if defined(__x86_64__) && defined(__SIZEOF_INT128__) && !defined(HAVE_MMTIMER)
+#define LINUX_TSC_TIMER
+
+#ifdef CLOCK_MONOTONIC_RAW
+#define TSC_CALIBRATION_CLOCK	CLOCK_MONOTONIC_RAW
+#else
+#define TSC_CALIBRATION_CLOCK	CLOCK_MONOTONIC
+#endif
+
+#define TSC_SHIFT		LINUX_TSC_SHIFT
+#define TSC_CALIBRATION_NS	10000000	/* shortest round        */
+#define TSC_CALIBRATION_ROUNDS	2
+#define TSC_MAX_SKEW_PPM	100		/* allowed round to round */
+#define TSC_CLOCKSOURCE \
+	"/sys/devices/system/clocksource/clocksource0/current_clocksource"
+
+static struct {
+	long long base_ns;		/* CLOCK_REALTIME at base_tsc */
+	long long base_tsc;
+	unsigned long long mult;	/* ns per tick << TSC_SHIFT    */
+	/* calibration clock and TSC where each round starts and ends */
+	long long cal_ns[TSC_CALIBRATION_ROUNDS + 1];
+	long long cal_tsc[TSC_CALIBRATION_ROUNDS + 1];
+	unsigned long long cal_mult[TSC_CALIBRATION_ROUNDS];
+	int rounds;			/* rounds finished             */
+	int busy;			/* a thread is calibrating     */
+	long long ( *fallback_nsec ) ( void );
+	long long ( *fallback_usec ) ( void );
+} tsc_clock;
+
+/* Read clk together with the TSC, keeping the tightest of a few tries */
+static long long
+tsc_read_pair( clockid_t clk, long long *tsc )
+{
+	struct timespec ts;
+	long long before, after, best = -1, ns = 0;
+	int i;
+
+	for ( i = 0; i < 5; i++ ) {
+		before = get_cycles(  );
+		papi_clock_gettime( clk, &ts );
+		after = get_cycles(  );
+		if ( best < 0 || after - before < best ) {
+			best = after - before;
+			*tsc = before + best / 2;
+			ns = ( long long ) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+		}
+	}
+	return ns;
+}
+
+static int
+tsc_kernel_clocksource( void )
+{
+	char buf[32];
+	FILE *fff;
+	int ok = 0;
+
+	/* A different clocksource, or none we can read, means the */
+	/* kernel has found the TSC wanting or cannot tell us.      */
+	fff = fopen( TSC_CLOCKSOURCE, "r" );
+	if ( fff != NULL ) {
+		if ( fgets( buf, sizeof ( buf ), fff ) != NULL )
+			ok = ( strncmp( buf, "tsc", 3 ) == 0 ) &&
+				( buf[3] == '\n' || buf[3] == '\0' );
+		fclose( fff );
+	}
+	return ok;
+}
+
+static inline long long
+tsc_get_real_nsec( void )
+{
+	__int128 delta = get_cycles(  ) - tsc_clock.base_tsc;
+
+	return tsc_clock.base_ns +
+		( long long ) ( ( delta * ( __int128 ) tsc_clock.mult ) >> TSC_SHIFT );
+}
+
+long long
+_linux_get_real_nsec_tsc( void )
+{
+	return tsc_get_real_nsec(  );
+}
+
+long long
+_linux_get_real_usec_tsc( void )
+{
+	return tsc_get_real_nsec(  ) / 1000;
+}
+
+/* Settle on the TSC or on clock_gettime() for good */
+static void
+tsc_calibration_done( int use_tsc )
+{
+	if ( use_tsc ) {
+		tsc_clock.mult = tsc_clock.cal_mult[TSC_CALIBRATION_ROUNDS - 1];
+		tsc_clock.base_ns =
+			tsc_read_pair( CLOCK_REALTIME, &tsc_clock.base_tsc );
+
+		SUBDBG( "TSC runs at %.3f MHz, using it for real time\n",
+			( double ) ( 1ULL << TSC_SHIFT ) * 1000.0 /
+			( double ) tsc_clock.mult );
+
+		/* readers must not see the timer before its scale */
+		__sync_synchronize(  );
+		_papi_os_vector.get_real_nsec = _linux_get_real_nsec_tsc;
+		_papi_os_vector.get_real_usec = _linux_get_real_usec_tsc;
+	} else {
+		_papi_os_vector.get_real_nsec = tsc_clock.fallback_nsec;
+		_papi_os_vector.get_real_usec = tsc_clock.fallback_usec;
+	}
+}
+
+/* End the current round if it has run long enough.  Only one thread at
+   a time gets here, the others just read clock_gettime(). */
+static void
+tsc_calibrate_step( void )
+{
+	struct timespec ts;
+	unsigned long long skew;
+	long long ns, tsc;
+	int r = tsc_clock.rounds;
+
+	papi_clock_gettime( TSC_CALIBRATION_CLOCK, &ts );
+	ns = ( long long ) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	if ( ns - tsc_clock.cal_ns[r] < TSC_CALIBRATION_NS )
+		return;
+
+	ns = tsc_read_pair( TSC_CALIBRATION_CLOCK, &tsc );
+	if ( ns <= tsc_clock.cal_ns[r] || tsc <= tsc_clock.cal_tsc[r] ) {
+		SUBDBG( "TSC calibration round %d went backwards\n", r );
+		tsc_calibration_done( 0 );
+		return;
+	}
+	tsc_clock.cal_ns[r + 1] = ns;
+	tsc_clock.cal_tsc[r + 1] = tsc;
+	/* A round lasts until someone reads the clock, which may be long */
+	/* after TSC_CALIBRATION_NS: past about 4 s, ns << TSC_SHIFT would */
+	/* no longer fit in 64 bits.                                       */
+	tsc_clock.cal_mult[r] = ( unsigned long long )
+		( ( ( unsigned __int128 ) ( ns - tsc_clock.cal_ns[r] ) << TSC_SHIFT ) /
+		  ( unsigned long long ) ( tsc - tsc_clock.cal_tsc[r] ) );
+	tsc_clock.rounds = ++r;
+	if ( r < TSC_CALIBRATION_ROUNDS )
+		return;
+
+	for ( r = 1; r < TSC_CALIBRATION_ROUNDS; r++ ) {
+		skew = tsc_clock.cal_mult[r] > tsc_clock.cal_mult[0] ?
+			tsc_clock.cal_mult[r] - tsc_clock.cal_mult[0] :
+			tsc_clock.cal_mult[0] - tsc_clock.cal_mult[r];
+		if ( skew * 1000000ULL > tsc_clock.cal_mult[0] * TSC_MAX_SKEW_PPM ) {
+			SUBDBG( "TSC rate drifted between rounds (%llu vs %llu)\n",
+				tsc_clock.cal_mult[0], tsc_clock.cal_mult[r] );
+			tsc_calibration_done( 0 );
+			return;
+		}
+	}
+
+	/* the kernel drops the TSC as clocksource if it finds it unstable */
+	if ( !tsc_kernel_clocksource(  ) ) {
+		SUBDBG( "Kernel stopped using the TSC, keeping clock_gettime\n" );
+		tsc_calibration_done( 0 );
+		return;
+	}
+
+	tsc_calibration_done( 1 );
+}
+
+static void
+tsc_calibrate( void )
+{
+	if ( __sync_bool_compare_and_swap( &tsc_clock.busy, 0, 1 ) ) {
+		if ( tsc_clock.rounds < TSC_CALIBRATION_ROUNDS )
+			tsc_calibrate_step(  );
+		__sync_lock_release( &tsc_clock.busy );
+	}
+}
+
+static long long
+tsc_calibrating_real_nsec( void )
+{
+	long long ns = tsc_clock.fallback_nsec(  );
+
+	tsc_calibrate(  );
+	return ns;
+}
+
+static long long
+tsc_calibrating_real_usec( void )
+{
+	long long usec = tsc_clock.fallback_usec(  );
+
+	tsc_calibrate(  );
+	return usec;
+}
+
+#endif
+
+/* Nanoseconds per TSC tick << LINUX_TSC_SHIFT, or 0 when real time is
+   not read from the TSC.  Lets a hot path take raw rdtsc stamps and
+   scale only their sum.                                               */
+unsigned long long
+_linux_tsc_mult( void )
+{
+#if defined(LINUX_TSC_TIMER)
+	if ( _papi_os_vector.get_real_nsec == _linux_get_real_nsec_tsc )
+		return tsc_clock.mult;
+#endif
+	return 0;
+}
+
+int
+_linux_init_tsc_timer( void )
+{
+#if defined(LINUX_TSC_TIMER)
+	/* set up by an earlier PAPI_library_init */
+	if ( ( _papi_os_vector.get_real_nsec == _linux_get_real_nsec_tsc ) ||
+	     ( _papi_os_vector.get_real_nsec == tsc_calibrating_real_nsec ) )
+		return PAPI_OK;
+
+	if ( !_x86_detect_invariant_tsc(  ) ) {
+		SUBDBG( "TSC is not invariant, keeping clock_gettime\n" );
+		return PAPI_OK;
+	}
+	if ( !tsc_kernel_clocksource(  ) ) {
+		SUBDBG( "Kernel does not use the TSC, keeping clock_gettime\n" );
+		return PAPI_OK;
+	}
+
+	memset( &tsc_clock, 0, sizeof ( tsc_clock ) );
+	tsc_clock.fallback_nsec = _papi_os_vector.get_real_nsec;
+	tsc_clock.fallback_usec = _papi_os_vector.get_real_usec;
+	tsc_clock.cal_ns[0] =
+		tsc_read_pair( TSC_CALIBRATION_CLOCK, &tsc_clock.cal_tsc[0] );
+
+	_papi_os_vector.get_real_nsec = tsc_calibrating_real_nsec;
+	_papi_os_vector.get_real_usec = tsc_calibrating_real_usec;
+#endif
+	return PAPI_OK;
+}
+
+
+
 long long
 _linux_get_real_cycles( void )
 {
@@ -334,9 +607,9 @@ _linux_get_real_usec_gettime( void )
 
    struct timespec foo;
 #ifdef HAVE_CLOCK_GETTIME_REALTIME_HR
-   syscall( __NR_clock_gettime, CLOCK_REALTIME_HR, &foo );
+   papi_clock_gettime( CLOCK_REALTIME_HR, &foo );
 #else
-   syscall( __NR_clock_gettime, CLOCK_REALTIME, &foo );
+   papi_clock_gettime( CLOCK_REALTIME, &foo );
 #endif
    retval = ( long long ) foo.tv_sec * ( long long ) 1000000;
    retval += ( long long ) ( foo.tv_nsec / 1000 );
@@ -437,7 +710,7 @@ _linux_get_virt_usec_gettime( void )
 
     struct timespec foo;
 
-    syscall( __NR_clock_gettime, CLOCK_THREAD_CPUTIME_ID, &foo );
+    papi_clock_gettime( CLOCK_THREAD_CPUTIME_ID, &foo );
     retval = ( long long ) foo.tv_sec * ( long long ) 1000000;
     retval += ( long long ) foo.tv_nsec / 1000;
 
@@ -527,9 +800,9 @@ _linux_get_real_nsec_gettime( void )
 
    struct timespec foo;
 #ifdef HAVE_CLOCK_GETTIME_REALTIME_HR
-   syscall( __NR_clock_gettime, CLOCK_REALTIME_HR, &foo );
+   papi_clock_gettime( CLOCK_REALTIME_HR, &foo );
 #else
-   syscall( __NR_clock_gettime, CLOCK_REALTIME, &foo );
+   papi_clock_gettime( CLOCK_REALTIME, &foo );
 #endif
    retval = ( long long ) foo.tv_sec * ( long long ) 1000000000;
    retval += ( long long ) ( foo.tv_nsec );
@@ -550,7 +823,7 @@ _linux_get_virt_nsec_gettime( void )
 
     struct timespec foo;
 
-    syscall( __NR_clock_gettime, CLOCK_THREAD_CPUTIME_ID, &foo );
+    papi_clock_gettime( CLOCK_THREAD_CPUTIME_ID, &foo );
     retval = ( long long ) foo.tv_sec * ( long long ) 1000000000;
     retval += ( long long ) foo.tv_nsec ;
 
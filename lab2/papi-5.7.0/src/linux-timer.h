@@ -12,5 +12,12 @@ long long _linux_get_real_usec_cycles( void );
 long long _linux_get_real_nsec_gettime( void );
 long long _linux_get_virt_nsec_gettime( void );
 
+#define LINUX_TSC_SHIFT 32
+
+long long _linux_get_real_nsec_tsc( void );
+long long _linux_get_real_usec_tsc( void );
+int _linux_init_tsc_timer( void );
+unsigned long long _linux_tsc_mult( void );
+
 int mmtimer_setup(void);
 int init_proc_thread_timer( hwd_context_t *thr_ctx );
@@ -480,6 +480,11 @@ PAPI_set_thr_specific( int tag, void *ptr )
  *	It must be called before any low level PAPI functions can be used. 
  *	If your application is making use of threads PAPI_thread_init must also be 
  *	called prior to making any calls to the library other than PAPI_library_init() . 
+ *
+ *	If PAPI_LAZY_COMPONENTS is set in the environment, only the CPU component
+ *	is initialized here.  The others report disabled as PAPI_EDELAY_INIT
+ *	and are initialized the first time one of their events is named with
+ *	PAPI_event_name_to_code() or enumerated with PAPI_enum_cmp_event().
  *	@par Examples:
  *	@code
  *		int retval;
@@ -689,6 +694,7 @@ PAPI_query_event( int EventCode )
 		if ( EventCode < 0 || EventCode >= PAPI_MAX_PRESET_EVENTS )
 			papi_return( PAPI_ENOTPRESET );
 
+		_papi_hwi_resolve_preset( EventCode );
 		if ( _papi_hwi_presets[EventCode].count )
 		        papi_return (PAPI_OK);
 		else
@@ -1177,6 +1183,7 @@ PAPI_enum_event( int *EventCode, int modifier )
 				return ( PAPI_ENOEVNT );	/* NULL pointer terminates list */
 			}
 			if ( modifier & PAPI_PRESET_ENUM_AVAIL ) {
+				_papi_hwi_resolve_preset( i );
 				if ( _papi_hwi_presets[i].count == 0 )
 					continue;
 			}
@@ -1188,6 +1195,13 @@ PAPI_enum_event( int *EventCode, int modifier )
 	}
 
 	if ( IS_NATIVE(i) ) {
+	    /* Served from the event cache when it has this component */
+	    retval = _papi_hwi_catalog_enum( cidx, EventCode, modifier );
+	    if ( retval != PAPI_ECMP ) {
+	       APIDBG("EXIT: *EventCode: %#x, retval: %d\n", *EventCode, retval);
+	       return ( retval == PAPI_OK ) ? PAPI_OK : PAPI_EINVAL;
+	    }
+
 	    // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
 	    _papi_hwi_set_papi_event_code(*EventCode, 0);
 
@@ -1366,6 +1380,11 @@ PAPI_enum_cmp_event( int *EventCode, int modifier, int cidx )
 		return PAPI_ENOCMP;
 	}
 
+	/* Enumerating a delayed component initializes it */
+	if (_papi_hwd[cidx]->cmp_info.disabled == PAPI_EDELAY_INIT) {
+	  _papi_hwi_init_delayed_component( cidx );
+	}
+
 	if (_papi_hwd[cidx]->cmp_info.disabled) {
 	  return PAPI_ENOCMP;
 	}
@@ -1383,6 +1402,7 @@ PAPI_enum_cmp_event( int *EventCode, int modifier, int cidx )
 				return ( PAPI_ENOEVNT );	/* NULL pointer terminates list */
 			}
 			if ( modifier & PAPI_PRESET_ENUM_AVAIL ) {
+				_papi_hwi_resolve_preset( i );
 				if ( _papi_hwi_presets[i].count == 0 )
 					continue;
 			}
@@ -1394,6 +1414,13 @@ PAPI_enum_cmp_event( int *EventCode, int modifier, int cidx )
 	}
 
 	if ( IS_NATIVE(i) ) {
+	    /* Served from the event cache when it has this component */
+	    retval = _papi_hwi_catalog_enum( cidx, EventCode, modifier );
+	    if ( retval != PAPI_ECMP ) {
+	       APIDBG("EXIT: *EventCode: %#x, retval: %d\n", *EventCode, retval);
+	       return ( retval == PAPI_OK ) ? PAPI_OK : PAPI_EINVAL;
+	    }
+
 	    // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
 	    _papi_hwi_set_papi_event_code(*EventCode, 0);
 
@@ -2141,7 +2168,7 @@ PAPI_start( int EventSet )
 	   call John May's code. */
 
 	if ( _papi_hwi_is_sw_multiplex( ESI ) ) {
-	   retval = MPX_start( ESI->multiplex.mpx_evset );
+	   retval = MPX_start( ESI->multiplex.mpx_evset, ESI->multiplex.flags );
 	   if ( retval != PAPI_OK ) {
 	      papi_return( retval );
 	   }
@@ -2368,6 +2395,8 @@ PAPI_stop( int EventSet, long long *values )
 			if ( retval < PAPI_OK )
 				papi_return( retval );
 		}
+		if ( ESI->profile.flags & PAPI_PROFIL_SPARSE )
+			_papi_hwi_collect_profile_hits( ESI );
 	}
 
 	/* If overflowing is enabled, turn it off */
@@ -2693,6 +2722,106 @@ PAPI_read_ts( int EventSet, long long *values, long long *cycles )
 	return PAPI_OK;
 }
 
+/** @class PAPI_read_estimates
+ *  @brief Read counters along with error bounds of multiplexed counts.
+ *
+ *  @par C Interface:
+ *  \#include <papi.h> @n
+ *  int PAPI_read_estimates( int EventSet, long long *values, PAPI_estimate_t *estimates );
+ *
+ *  PAPI_read_estimates() copies the counters of the indicated event set
+ *  into values just as PAPI_read() does, and fills one PAPI_estimate_t
+ *  per event that says how far each value can be trusted.
+ *
+ *  A multiplexed event is only counted during some time slices and its
+ *  value extrapolated from the rate seen in those slices. With PAPI's
+ *  own multiplexing the rate of every slice is kept, so the estimate
+ *  carries the standard error of the value and a 95% confidence
+ *  interval derived from the spread of those rates. Events that are
+ *  counted all the time report a standard error of 0; events whose
+ *  slices are not visible to PAPI, as with kernel multiplexing, or that
+ *  ran in fewer than two slices report -1.
+ *
+ *  Setting PAPI_MULTIPLEX_ADAPTIVE in the flags of PAPI_set_opt(
+ *  PAPI_MULTIPLEX ) selects PAPI's multiplexing and also gives events
+ *  with noisier rates proportionally longer slices, which tightens the
+ *  widest intervals for the same run time.
+ *
+ *  @param[in] EventSet
+ *     -- an integer handle for a PAPI Event Set as created 
+ *        by PAPI_create_eventset()
+ *  @param[out] *values 
+ *     -- an array to hold the counter values of the counting events 
+ *  @param[out] *estimates
+ *     -- an array to hold the error bounds of each value
+ *
+ *  @retval PAPI_EINVAL 
+ *	    One or more of the arguments is invalid.
+ *  @retval PAPI_ESYS 
+ *	    A system or C library call failed inside PAPI, see the 
+ *          errno variable.
+ *  @retval PAPI_ENOEVST 
+ *	    The event set specified does not exist. 
+ *
+ * @par Examples
+ * @code
+ * PAPI_multiplex_option_t mpx = { EventSet, 0, PAPI_MULTIPLEX_ADAPTIVE };
+ * PAPI_estimate_t est[NUM_EVENTS];
+ * long long values[NUM_EVENTS];
+ *
+ * PAPI_set_opt( PAPI_MULTIPLEX, ( PAPI_option_t * ) &mpx );
+ * // ... add events, PAPI_start, do work ...
+ * PAPI_read_estimates( EventSet, values, est );
+ * if ( est[0].std_error > values[0] / 20 )
+ *    printf( "%lld is noise: [%lld, %lld]\n", values[0], est[0].low, est[0].high );
+ * @endcode
+ *
+ * @see PAPI_read 
+ * @see PAPI_set_multiplex
+ * @see PAPI_set_opt
+ */
+int
+PAPI_read_estimates( int EventSet, long long *values,
+		     PAPI_estimate_t *estimates )
+{
+	APIDBG( "Entry: EventSet: %d, values: %p, estimates: %p\n", EventSet, values, estimates);
+	EventSetInfo_t *ESI;
+	int i, cidx, retval;
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ( values == NULL ) || ( estimates == NULL ) )
+		papi_return( PAPI_EINVAL );
+
+	/* a multiplexed set gets its MPX_EventSet with its first event,
+	   until then PAPI_read below handles it like any empty set */
+	if ( _papi_hwi_is_sw_multiplex( ESI ) &&
+	     ( ESI->multiplex.mpx_evset != NULL ) ) {
+		retval = MPX_read_estimates( ESI->multiplex.mpx_evset, values,
+					     estimates );
+		papi_return( retval );
+	}
+
+	retval = PAPI_read( EventSet, values );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	for ( i = 0; i < ESI->NumberOfEvents; i++ ) {
+		estimates[i].value = values[i];
+		estimates[i].low = estimates[i].high = values[i];
+		estimates[i].slices = 0;
+		estimates[i].std_error = ( ESI->state & PAPI_MULTIPLEXING ) ? -1 : 0;
+	}
+
+	return PAPI_OK;
+}
+
 /**	@class PAPI_accum
  *	@brief Accumulate and reset counters in an EventSet.
  *	
@@ -3427,6 +3556,10 @@ PAPI_set_multiplex( int EventSet )
  * PAPI_GRANUL		Set granularity for EventSet specified in ptr->granularity.eventset. 
  *					Will error if eventset is not bound to a component.
  * PAPI_INHERIT		Enable or disable inheritance for specified EventSet.
+ * PAPI_REFRESH_NS	Set how many ns may pass between the kernel reads of the polled
+ *					EventSet specified in ptr->refresh.eventset; a PAPI_read in
+ *					between returns the last values.  0 restores the component's
+ *					default.  Will error if eventset is not bound to a component.
  * PAPI_DATA_ADDRESS	Set data address range to restrict event counting for EventSet specified
  *					in ptr->addr.eventset. Starting and ending addresses are specified in
  *					ptr->addr.start and ptr->addr.end, respectively. If exact addresses
@@ -3451,6 +3584,7 @@ PAPI_set_multiplex( int EventSet )
  * <tr><td>PAPI_DOMAIN</td><td>Set domain for EventSet specified in ptr->domain.eventset. Will error if eventset is not bound to a component.</td></tr>
  * <tr><td>PAPI_GRANUL</td><td>Set granularity for EventSet specified in ptr->granularity.eventset. Will error if eventset is not bound to a component.</td></tr>
  * <tr><td>PAPI_INHERIT</td><td>Enable or disable inheritance for specified EventSet.</td></tr>
+ * <tr><td>PAPI_REFRESH_NS</td><td>Set how many ns may pass between the kernel reads of the polled EventSet specified in ptr->refresh.eventset; a PAPI_read in between returns the last values. 0 restores the component's default. Will error if eventset is not bound to a component.</td></tr>
  * <tr><td>PAPI_DATA_ADDRESS</td><td>Set data address range to restrict event counting for EventSet specified in ptr->addr.eventset. Starting and ending addresses are specified in ptr->addr.start and ptr->addr.end, respectively. If exact addresses cannot be instantiated, offsets are returned in ptr->addr.start_off and ptr->addr.end_off. Currently implemented on Itanium only.</td></tr>
  * <tr><td>PAPI_INSTR_ADDRESS</td><td>Set instruction address range as described above. Itanium only.</td></tr>
  * </table>
@@ -3662,8 +3796,11 @@ PAPI_set_opt( int option, PAPI_option_t * ptr )
 		internal.multiplex.ESI = ESI;
 		internal.multiplex.ns = ( unsigned long ) ptr->multiplex.ns;
 		internal.multiplex.flags = ptr->multiplex.flags;
+		/* only PAPI's own multiplexing sees each time slice */
+		if ( internal.multiplex.flags & PAPI_MULTIPLEX_ADAPTIVE )
+			internal.multiplex.flags |= PAPI_MULTIPLEX_FORCE_SW;
 		if ( ( _papi_hwd[cidx]->cmp_info.kernel_multiplex ) &&
-			 ( ( ptr->multiplex.flags & PAPI_MULTIPLEX_FORCE_SW ) == 0 ) ) {
+			 ( ( internal.multiplex.flags & PAPI_MULTIPLEX_FORCE_SW ) == 0 ) ) {
 			/* get the context we should use for this event set */
 			context = _papi_hwi_get_context( ESI, NULL );
 			retval = _papi_hwd[cidx]->ctl( context, PAPI_MULTIPLEX, &internal );
@@ -3849,6 +3986,34 @@ PAPI_set_opt( int option, PAPI_option_t * ptr )
 		ESI->inherit.inherit = ptr->inherit.inherit;
 		return ( retval );
 	}
+	case PAPI_REFRESH_NS:
+	{
+		EventSetInfo_t *ESI;
+		ESI = _papi_hwi_lookup_EventSet( ptr->refresh.eventset );
+		if ( ESI == NULL )
+			papi_return( PAPI_ENOEVST );
+
+		cidx = valid_ESI_component( ESI );
+		if ( cidx < 0 )
+			papi_return( cidx );
+
+		if ( _papi_hwd[cidx]->cmp_info.refresh == 0 )
+			papi_return( PAPI_ECMP );
+
+		if ( ptr->refresh.ns < 0 )
+			papi_return( PAPI_EINVAL );
+
+		internal.refresh.ESI = ESI;
+		internal.refresh.ns = ptr->refresh.ns;
+
+		context = _papi_hwi_get_context( ESI, NULL );
+		retval = _papi_hwd[cidx]->ctl( context, PAPI_REFRESH_NS, &internal );
+		if ( retval < PAPI_OK )
+			papi_return( retval );
+
+		ESI->refresh.ns = ptr->refresh.ns;
+		return ( retval );
+	}
 	case PAPI_DATA_ADDRESS:
 	case PAPI_INSTR_ADDRESS:
 	{
@@ -4093,6 +4258,7 @@ PAPI_get_multiplex( int EventSet )
  * PAPI_DOMAIN		Get domain for EventSet specified in ptr->domain.eventset. Will error if eventset is not bound to a component.
  * PAPI_GRANUL		Get granularity for EventSet specified in ptr->granularity.eventset. Will error if eventset is not bound to a component.
  * PAPI_INHERIT		Get current inheritance state for specified EventSet.
+ * PAPI_REFRESH_NS	Get the refresh interval set for specified EventSet, 0 for the component default.
  * PAPI_PRELOAD		Get LD_PRELOAD environment equivalent.
  * PAPI_CLOCKRATE	Get clockrate in MHz.
  * PAPI_MAX_CPUS	Get number of CPUs.
@@ -4121,6 +4287,7 @@ PAPI_get_multiplex( int EventSet )
  * <tr><td>PAPI_DOMAIN</td><td>Get domain for EventSet specified in ptr->domain.eventset. Will error if eventset is not bound to a component.</td></tr>
  * <tr><td>PAPI_GRANUL</td><td>Get granularity for EventSet specified in ptr->granularity.eventset. Will error if eventset is not bound to a component.</td></tr>
  * <tr><td>PAPI_INHERIT</td><td>Get current inheritance state for specified EventSet.</td></tr>
+ * <tr><td>PAPI_REFRESH_NS</td><td>Get the refresh interval set for specified EventSet, 0 for the component default.</td></tr>
  * <tr><td>PAPI_PRELOAD</td><td>Get LD_PRELOAD environment equivalent.</td></tr>
  * <tr><td>PAPI_CLOCKRATE</td><td>Get clockrate in MHz.</td></tr>
  * <tr><td>PAPI_MAX_CPUS</td><td>Get number of CPUs.</td></tr>
@@ -4246,6 +4413,16 @@ PAPI_get_opt( int option, PAPI_option_t * ptr )
 		ptr->inherit.inherit = ESI->inherit.inherit;
 		return ( PAPI_OK );
 	}
+	case PAPI_REFRESH_NS:
+	{
+		if ( ptr == NULL )
+			papi_return( PAPI_EINVAL );
+		ESI = _papi_hwi_lookup_EventSet( ptr->refresh.eventset );
+		if ( ESI == NULL )
+			papi_return( PAPI_ENOEVST );
+		ptr->refresh.ns = ESI->refresh.ns;
+		return ( PAPI_OK );
+	}
 	case PAPI_GRANUL:
 		if ( ptr == NULL )
 			papi_return( PAPI_EINVAL );
@@ -4944,6 +5121,691 @@ PAPI_overflow( int EventSet, int EventCode, int threshold, int flags,
 	return PAPI_OK;
 }
 
+/** @class PAPI_sample_set
+ *	@brief Set up an event to stream samples into a kernel ring buffer.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_sample_set( int EventSet, int EventCode, long long period, int sample_type, int ring_pages );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param EventCode
+ *	the preset or native event code to be sampled
+ * @param period
+ *	the number of events between samples; 0 turns sampling off for EventCode
+ * @param sample_type
+ *	a bitwise OR of PAPI_SAMPLE_IP, PAPI_SAMPLE_TID, PAPI_SAMPLE_TIME,
+ *	PAPI_SAMPLE_ADDR, PAPI_SAMPLE_CALLCHAIN and PAPI_SAMPLE_READ
+ * @param ring_pages
+ *	size of the sample ring in pages, a power of two; 0 selects a default
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL One or more of the arguments is invalid.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_EISRUN The EventSet is currently counting events.
+ * @retval PAPI_ECNFLCT The EventSet is already overflowing or profiling.
+ * @retval PAPI_ENOEVNT The event is not a member of the EventSet.
+ * @retval PAPI_ECMP The component does not support sample streaming.
+ *
+ * @details
+ * Unlike PAPI_overflow(), no signal is delivered when the period elapses.
+ * The kernel appends a complete record for every sample to a ring buffer
+ * that the caller empties with PAPI_sample_read() or PAPI_sample_drain(),
+ * either while the EventSet runs or after PAPI_stop().  If the ring fills
+ * up, the kernel drops samples and reports how many with a record whose
+ * type is PAPI_SAMPLE_LOST.  Call this after all events have been added.
+ *
+ * @par Example
+ * @code
+ * retval = PAPI_sample_set(EventSet, PAPI_TOT_CYC, 1000000,
+ *                          PAPI_SAMPLE_IP | PAPI_SAMPLE_TIME, 16);
+ * @endcode
+ *
+ * @see PAPI_sample_read PAPI_sample_drain PAPI_overflow
+ */
+int
+PAPI_sample_set( int EventSet, int EventCode, long long period,
+		 int sample_type, int ring_pages )
+{
+	APIDBG( "Entry: EventSet: %d, EventCode: %#x, period: %lld, sample_type: %#x, ring_pages: %d\n", EventSet, EventCode, period, sample_type, ring_pages);
+	int cidx, index;
+	EventSetInfo_t *ESI;
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+		papi_return( PAPI_EISRUN );
+
+	if ( ESI->state & ( PAPI_OVERFLOWING | PAPI_PROFILING ) )
+		papi_return( PAPI_ECNFLCT );
+
+	if ( ( index = _papi_hwi_lookup_EventCodeIndex( ESI,
+						( unsigned int ) EventCode ) ) < 0 )
+		papi_return( PAPI_ENOEVNT );
+
+	if ( period < 0 )
+		papi_return( PAPI_EINVAL );
+
+	if ( sample_type & ~( PAPI_SAMPLE_IP | PAPI_SAMPLE_TID |
+			      PAPI_SAMPLE_TIME | PAPI_SAMPLE_ADDR |
+			      PAPI_SAMPLE_CALLCHAIN | PAPI_SAMPLE_READ ) )
+		papi_return( PAPI_EINVAL );
+
+	/* The ring must be a power of two so the kernel can wrap it with a mask */
+	if ( ring_pages < 0 || ( ring_pages & ( ring_pages - 1 ) ) )
+		papi_return( PAPI_EINVAL );
+
+	/* Like overflow, samples can only come from a single native event */
+	if ( ESI->EventInfoArray[index].derived &&
+	     ESI->EventInfoArray[index].derived != DERIVED_CMPD )
+		papi_return( PAPI_EINVAL );
+
+	papi_return( _papi_hwd[cidx]->set_sampling( ESI, index, period,
+						     sample_type, ring_pages ) );
+}
+
+/** @class PAPI_sample_read
+ *	@brief Copy buffered samples of an event set into a user buffer.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_sample_read( int EventSet, PAPI_sample_t *samples, int max, int *count );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param samples
+ *	array receiving up to max samples
+ * @param max
+ *	number of entries in samples
+ * @param count
+ *	[OUT] number of samples copied; fewer than max means the rings are empty
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL One or more of the arguments is invalid.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_ECMP The component does not support sample streaming.
+ *
+ * @details
+ * Samples are consumed: the ring space they used is handed back to the
+ * kernel.  Records of different events are returned event by event, each
+ * in the order the kernel wrote them.
+ *
+ * @see PAPI_sample_set PAPI_sample_drain
+ */
+int
+PAPI_sample_read( int EventSet, PAPI_sample_t *samples, int max, int *count )
+{
+	APIDBG( "Entry: EventSet: %d, samples: %p, max: %d, count: %p\n", EventSet, samples, max, count);
+	int cidx, retval;
+	EventSetInfo_t *ESI;
+
+	if ( samples == NULL || count == NULL || max <= 0 )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	retval = _papi_hwd[cidx]->read_samples( ESI, samples, max );
+	if ( retval < 0 )
+		papi_return( retval );
+
+	*count = retval;
+	return PAPI_OK;
+}
+
+/** @class PAPI_sample_collect
+ *	@brief Have a background thread pass the samples of an event set to a handler.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_sample_collect( int EventSet, PAPI_sample_handler_t handler, void *context, int batch );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param handler
+ *	called from the collector thread with each batch of samples;
+ *	NULL stops collecting
+ * @param context
+ *	passed through to handler untouched
+ * @param batch
+ *	number of samples the kernel buffers before waking the collector;
+ *	0 selects a default
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL batch is negative.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_EISRUN The EventSet is currently counting events.
+ * @retval PAPI_ECNFLCT The EventSet is profiling.
+ * @retval PAPI_ECMP The component does not support sample collection.
+ *
+ * @details
+ * While the EventSet runs, a single collector thread per process sleeps
+ * in poll() on the rings of all events set up with PAPI_sample_set().
+ * The kernel wakes it once every batch samples and it hands them to the
+ * handler, so the measured thread never sees a signal.  PAPI_stop()
+ * passes any samples still buffered to the handler before returning.
+ * The handler must not call PAPI_start() or PAPI_stop() and should not
+ * call PAPI_sample_read() or PAPI_sample_drain() on the same EventSet.
+ *
+ * @see PAPI_sample_set PAPI_sample_drain
+ */
+int
+PAPI_sample_collect( int EventSet, PAPI_sample_handler_t handler,
+		     void *context, int batch )
+{
+	APIDBG( "Entry: EventSet: %d, handler: %p, context: %p, batch: %d\n", EventSet, handler, context, batch);
+	int cidx;
+	EventSetInfo_t *ESI;
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+		papi_return( PAPI_EISRUN );
+
+	if ( ESI->state & PAPI_PROFILING )
+		papi_return( PAPI_ECNFLCT );
+
+	if ( batch < 0 )
+		papi_return( PAPI_EINVAL );
+
+	papi_return( _papi_hwd[cidx]->set_collector( ESI, handler, context,
+						      batch ) );
+}
+
+/** @class PAPI_sample_drain
+ *	@brief Pass all buffered samples of an event set to a handler.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_sample_drain( int EventSet, PAPI_sample_handler_t handler, void *context );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param handler
+ *	called with batches of samples until the rings are empty
+ * @param context
+ *	passed through to handler untouched
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL The handler is NULL.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_ECMP The component does not support sample streaming.
+ *
+ * @details
+ * The handler runs in the calling thread, not in signal context, so it may
+ * do anything a normal function can.  The batch passed to it is only valid
+ * for the duration of the call.
+ *
+ * @see PAPI_sample_set PAPI_sample_read
+ */
+int
+PAPI_sample_drain( int EventSet, PAPI_sample_handler_t handler, void *context )
+{
+	APIDBG( "Entry: EventSet: %d, handler: %p, context: %p\n", EventSet, handler, context);
+	PAPI_sample_t batch[PAPI_SAMPLE_BATCH];
+	int cidx, retval;
+	EventSetInfo_t *ESI;
+
+	if ( handler == NULL )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	do {
+		retval = _papi_hwd[cidx]->read_samples( ESI, batch,
+							PAPI_SAMPLE_BATCH );
+		if ( retval < 0 )
+			papi_return( retval );
+		if ( retval > 0 )
+			handler( EventSet, batch, retval, context );
+	} while ( retval == PAPI_SAMPLE_BATCH );
+
+	return PAPI_OK;
+}
+
+/** @class PAPI_timeseries_set
+ *	@brief Have a background thread snapshot an event set periodically.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_timeseries_set( int EventSet, long long period_ns, int records );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param period_ns
+ *	nanoseconds between snapshots; 0 turns the time series off and
+ *	discards any snapshots not yet read
+ * @param records
+ *	number of snapshots buffered before new ones are dropped, rounded
+ *	up to a power of two; 0 selects a default
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL period_ns or records is negative.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_EISRUN The EventSet is currently counting events.
+ * @retval PAPI_ECNFLCT The EventSet uses PAPI's software multiplexing.
+ * @retval PAPI_ECMP The component does not support time series.
+ *
+ * @details
+ * While the EventSet runs, the same background thread that serves
+ * PAPI_sample_collect() wakes up every period_ns from a timerfd, reads
+ * the counters and stores a timestamp from PAPI_get_real_nsec() along
+ * with the counts in a ring preallocated by PAPI_start().  The measured
+ * thread runs no PAPI code in between.  PAPI_start() also records the
+ * starting counts, and PAPI_stop() the final ones.  Counts are
+ * cumulative since PAPI_start(), as PAPI_read() would return them.
+ * Each PAPI_start() begins a new series.
+ *
+ * @see PAPI_timeseries_read PAPI_sample_collect
+ */
+int
+PAPI_timeseries_set( int EventSet, long long period_ns, int records )
+{
+	APIDBG( "Entry: EventSet: %d, period_ns: %lld, records: %d\n", EventSet, period_ns, records);
+	int cidx;
+	EventSetInfo_t *ESI;
+
+	if ( period_ns < 0 || records < 0 )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+		papi_return( PAPI_EISRUN );
+
+	if ( _papi_hwi_is_sw_multiplex( ESI ) )
+		papi_return( PAPI_ECNFLCT );
+
+	if ( records == 0 )
+		records = PAPI_TIMESERIES_DEF_RECORDS;
+
+	papi_return( _papi_hwd[cidx]->set_timeseries( ESI, period_ns,
+						       records ) );
+}
+
+/** @class PAPI_timeseries_read
+ *	@brief Copy periodic snapshots of an event set into user buffers.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_timeseries_read( int EventSet, long long *times, long long *values, int max, int *count, long long *dropped );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param times
+ *	array receiving up to max snapshot times, in PAPI_get_real_nsec() units
+ * @param values
+ *	array of max times the number of events in the EventSet; snapshot i
+ *	is stored from values[i * PAPI_num_events( EventSet )] on, in the
+ *	order the events were added
+ * @param max
+ *	number of snapshots that fit in times and values
+ * @param count
+ *	[OUT] number of snapshots copied; fewer than max means the ring is empty
+ * @param dropped
+ *	[OUT] if not NULL, snapshots lost since PAPI_start() because the
+ *	ring was full
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL One or more of the arguments is invalid.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_ECMP The component does not support time series.
+ *
+ * @details
+ * Snapshots are consumed oldest first and their ring slots handed back
+ * to the background thread.  It may be called while the EventSet runs
+ * or after it stopped, from any thread, but only from one thread at a
+ * time.
+ *
+ * @par Example:
+ * @code
+ * long long t[64], v[64 * 2], dropped;
+ * int i, n;
+ *
+ * PAPI_timeseries_set( EventSet, 1000000, 0 );
+ * PAPI_start( EventSet );
+ * ...
+ * PAPI_timeseries_read( EventSet, t, v, 64, &n, &dropped );
+ * for ( i = 1; i < n; i++ )
+ *	printf( "%lld ns: %lld\n", t[i] - t[0], v[i * 2] - v[( i - 1 ) * 2] );
+ * @endcode
+ *
+ * @see PAPI_timeseries_set
+ */
+int
+PAPI_timeseries_read( int EventSet, long long *times, long long *values,
+		      int max, int *count, long long *dropped )
+{
+	APIDBG( "Entry: EventSet: %d, times: %p, values: %p, max: %d, count: %p, dropped: %p\n", EventSet, times, values, max, count, dropped);
+	long long native[PAPI_TIMESERIES_COUNTS];
+	long long lost = 0;
+	int cidx, retval, batch, want, i, done = 0;
+	EventSetInfo_t *ESI;
+
+	if ( times == NULL || values == NULL || count == NULL || max <= 0 )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ESI->NativeCount <= 0 || ESI->NativeCount > PAPI_TIMESERIES_COUNTS )
+		papi_return( PAPI_EINVAL );
+
+	/* Snapshots come out as native counts; map them to the user's */
+	/* events a batch at a time.                                   */
+	batch = PAPI_TIMESERIES_COUNTS / ESI->NativeCount;
+	while ( done < max ) {
+		want = max - done < batch ? max - done : batch;
+		retval = _papi_hwd[cidx]->read_timeseries( ESI, times + done,
+							   native, want, &lost );
+		if ( retval < 0 )
+			papi_return( retval );
+
+		for ( i = 0; i < retval; i++ ) {
+			_papi_hwi_map_counts( ESI, native + i * ESI->NativeCount,
+					      values + ( done + i ) *
+					      ESI->NumberOfEvents );
+		}
+		done += retval;
+		if ( retval < want )
+			break;
+	}
+
+	*count = done;
+	if ( dropped )
+		*dropped = lost;
+	return PAPI_OK;
+}
+
+/** @class PAPI_export_set
+ *	@brief Publish the counts of an event set to shared memory periodically.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_export_set( int EventSet, const char *label, long long period_ns );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param label
+ *	name readers see for this EventSet, truncated to PAPI_MIN_STR_LEN - 1
+ *	characters; NULL stops exporting and frees the slot
+ * @param period_ns
+ *	nanoseconds between updates; 0 selects a default of 10 ms
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL period_ns is negative, or the EventSet has more
+ *	than PAPI_EXPORT_MAX_EVENTS events.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_EISRUN The EventSet is currently counting events.
+ * @retval PAPI_ECNFLCT The EventSet uses PAPI's software multiplexing.
+ * @retval PAPI_ENOMEM All PAPI_EXPORT_SLOTS slots of the process are in use.
+ * @retval PAPI_ESYS The shared memory segment could not be created.
+ * @retval PAPI_ECMP The component does not support exporting.
+ *
+ * @details
+ * Each process that exports has one segment, named by PAPI_EXPORT_PATH
+ * and its pid, laid out as a PAPI_export_header_t followed by nslots
+ * PAPI_export_slot_t.  While the EventSet runs, the background thread
+ * that serves PAPI_sample_collect() reads its counters every period_ns
+ * and stores them with a PAPI_get_real_nsec() timestamp in the slot.
+ * The slot also records the counting thread's id, the event codes and
+ * the label.  PAPI_start() and PAPI_stop() publish the first and last
+ * values, and the slot keeps the last ones until exporting stops or
+ * the EventSet is cleaned up.  The counted threads never run any PAPI
+ * code to publish values.
+ *
+ * A slot is written under a sequence lock, so an agent in another
+ * process can map the segment read-only and copy any slot at any time
+ * without a system call.  It must check magic and version first and
+ * retry a copy that raced with an update.  The reader should unlink
+ * the segment as soon as it has mapped it: the mapping stays valid, and
+ * nothing is left behind in /dev/shm if the process dies without
+ * calling PAPI_shutdown(), which otherwise removes it.  A segment whose
+ * pid no longer exists is stale.
+ *
+ * @par Example reader:
+ * @code
+ * int fd = open( path, O_RDONLY );
+ * PAPI_export_header_t *hdr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+ * close( fd );
+ * unlink( path );
+ * PAPI_export_slot_t *slots = ( PAPI_export_slot_t * ) ( hdr + 1 ), copy;
+ * unsigned int seq;
+ *
+ * if ( hdr->magic != PAPI_EXPORT_MAGIC || hdr->version != PAPI_EXPORT_VERSION )
+ *	return;
+ * for ( i = 0; i < hdr->nslots; i++ ) {
+ *	do {
+ *		seq = slots[i].seq;
+ *		__sync_synchronize(  );
+ *		copy = slots[i];
+ *		__sync_synchronize(  );
+ *	} while ( ( seq & 1 ) || seq != slots[i].seq );
+ *	if ( copy.tid > 0 )
+ *		printf( "%s %d: %lld\n", copy.label, copy.tid, copy.values[0] );
+ * }
+ * @endcode
+ *
+ * @see PAPI_timeseries_set PAPI_sample_collect
+ */
+int
+PAPI_export_set( int EventSet, const char *label, long long period_ns )
+{
+	APIDBG( "Entry: EventSet: %d, label: %s, period_ns: %lld\n", EventSet, label ? label : "(null)", period_ns);
+	int cidx;
+	EventSetInfo_t *ESI;
+
+	if ( period_ns < 0 )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+		papi_return( PAPI_EISRUN );
+
+	if ( _papi_hwi_is_sw_multiplex( ESI ) )
+		papi_return( PAPI_ECNFLCT );
+
+	if ( ESI->NumberOfEvents > PAPI_EXPORT_MAX_EVENTS )
+		papi_return( PAPI_EINVAL );
+
+	if ( period_ns == 0 )
+		period_ns = PAPI_EXPORT_DEF_PERIOD;
+
+	papi_return( _papi_hwd[cidx]->set_export( ESI, label, period_ns ) );
+}
+
+/** @class PAPI_cpuset_set
+ *	@brief Count an event set on every process of a set of cpus.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_cpuset_set( int EventSet, const unsigned int *cpus, int num_cpus );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set as created by PAPI_create_eventset
+ * @param cpus
+ *	array of num_cpus cpu numbers, or NULL for every online cpu
+ * @param num_cpus
+ *	number of cpus in cpus; 0 when cpus is NULL
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL cpus and num_cpus do not agree.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_EISRUN The EventSet is currently counting events.
+ * @retval PAPI_ECNFLCT The EventSet uses PAPI's software multiplexing,
+ *	is attached to a thread, inherits, or overflows or samples.
+ * @retval PAPI_EPERM System-wide counting is not permitted.
+ * @retval PAPI_ECMP The component does not support cpu sets.
+ *
+ * @details
+ * The events of the EventSet are opened once on each cpu of the set and
+ * count every process running there, as an EventSet per cpu with
+ * PAPI_CPU_ATTACH and PAPI_GRN_SYS would.  PAPI_start(), PAPI_stop()
+ * and PAPI_reset() act on all cpus, PAPI_read() returns the sum over
+ * the cpus, and PAPI_cpuset_read() the count of each.  Every cpu is
+ * read with a single grouped read unless the EventSet is multiplexed.
+ * The cpu set lasts until the EventSet is cleaned up.
+ *
+ * @see PAPI_cpuset_read PAPI_set_opt
+ */
+int
+PAPI_cpuset_set( int EventSet, const unsigned int *cpus, int num_cpus )
+{
+	APIDBG( "Entry: EventSet: %d, cpus: %p, num_cpus: %d\n", EventSet, cpus, num_cpus);
+	int cidx;
+	EventSetInfo_t *ESI;
+
+	if ( num_cpus < 0 || ( cpus == NULL ) != ( num_cpus == 0 ) )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+		papi_return( PAPI_EISRUN );
+
+	if ( _papi_hwi_is_sw_multiplex( ESI ) )
+		papi_return( PAPI_ECNFLCT );
+
+	papi_return( _papi_hwd[cidx]->set_cpuset( ESI, cpus, num_cpus ) );
+}
+
+/** @class PAPI_cpuset_read
+ *	@brief Read an event set on each cpu of its cpu set.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_cpuset_read( int EventSet, unsigned int *cpus, long long *values, int max, int *count );
+ *
+ * @param EventSet
+ *	an integer handle to a PAPI event set given a cpu set by PAPI_cpuset_set
+ * @param cpus
+ *	if not NULL, array receiving up to max cpu numbers, in the order
+ *	the cpus were given
+ * @param values
+ *	array of max times the number of events in the EventSet; the
+ *	counts of cpu i are stored from values[i * PAPI_num_events( EventSet )]
+ *	on, in the order the events were added
+ * @param max
+ *	number of cpus that fit in cpus and values
+ * @param count
+ *	[OUT] number of cpus in the cpu set; only the first max are copied
+ *
+ * @retval PAPI_OK
+ * @retval PAPI_EINVAL One or more of the arguments is invalid, or the
+ *	EventSet has no cpu set.
+ * @retval PAPI_ENOEVST The EventSet specified does not exist.
+ * @retval PAPI_ESYS A cpu could not be read.
+ * @retval PAPI_ECMP The component does not support cpu sets.
+ *
+ * @details
+ * All cpus are read in one pass, which also refreshes the sum that
+ * PAPI_read() returns.  Counts are cumulative since PAPI_start(); after
+ * PAPI_stop() the final counts are returned.
+ *
+ * @par Example:
+ * @code
+ * unsigned int cpus[256];
+ * long long v[256 * 2];
+ * int i, n;
+ *
+ * PAPI_cpuset_set( EventSet, NULL, 0 );
+ * PAPI_start( EventSet );
+ * ...
+ * PAPI_cpuset_read( EventSet, cpus, v, 256, &n );
+ * for ( i = 0; i < n && i < 256; i++ )
+ *	printf( "cpu %u: %lld %lld\n", cpus[i], v[i * 2], v[i * 2 + 1] );
+ * @endcode
+ *
+ * @see PAPI_cpuset_set PAPI_read
+ */
+int
+PAPI_cpuset_read( int EventSet, unsigned int *cpus, long long *values,
+		  int max, int *count )
+{
+	APIDBG( "Entry: EventSet: %d, cpus: %p, values: %p, max: %d, count: %p\n", EventSet, cpus, values, max, count);
+	unsigned int *ids;
+	long long *native;
+	int cidx, num_cpus, i;
+	EventSetInfo_t *ESI;
+
+	if ( values == NULL || count == NULL || max <= 0 )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	cidx = valid_ESI_component( ESI );
+	if ( cidx < 0 )
+		papi_return( cidx );
+
+	if ( ESI->NativeCount <= 0 )
+		papi_return( PAPI_EINVAL );
+
+	/* The component hands back one row of native counts per cpu */
+	num_cpus = _papi_hwd[cidx]->read_cpuset( ESI, &ids, &native );
+	if ( num_cpus < 0 )
+		papi_return( num_cpus );
+
+	for ( i = 0; i < num_cpus && i < max; i++ ) {
+		_papi_hwi_map_counts( ESI, native + i * ESI->NativeCount,
+				      values + i * ESI->NumberOfEvents );
+		if ( cpus )
+			cpus[i] = ids[i];
+	}
+
+	*count = num_cpus;
+	return PAPI_OK;
+}
+
 /** @class PAPI_sprofil
  *	@brief Generate PC histogram data from multiple code regions where hardware counter overflow occurs.
  *
@@ -4994,6 +5856,16 @@ PAPI_overflow( int EventSet, int EventCode, int threshold, int flags,
  *	Each structure in the array defines the profiling parameters that are 
  *	normally passed to PAPI_profil(). 
  *	For more information on profiling, @ref PAPI_profil
+ *
+ *	The regions are sorted by start address when PAPI_sprofil() is called,
+ *	so each sample is matched in logarithmic time however many regions there
+ *	are. Regions may be given in any order and may overlap: a sample goes to
+ *	the region with the largest offset at or below its address, the first
+ *	one given if several share that offset. A sample that this region's
+ *	buffer does not cover, or that falls below every region, is counted in
+ *	the catch-all region (offset 0, scale 2), if one is given, and dropped
+ *	otherwise.
+ *	To get one region per loaded object see PAPI_sprofil_objects().
  *	@manonly
  *
  *	@endmanonly
@@ -5039,6 +5911,8 @@ PAPI_overflow( int EventSet, int EventCode, int threshold, int flags,
  *	@see PAPI_overflow
  *	@see PAPI_get_executable_info
  *	@see PAPI_profil
+ *	@see PAPI_sprofil_objects
+ *	@see PAPI_sprofil_hits
  */
 int
 PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
@@ -5046,6 +5920,8 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
 {
 	APIDBG( "Entry: prof: %p, profcnt: %d, EventSet: %d, EventCode: %#x, threshold: %d, flags: %#x\n", prof, profcnt, EventSet, EventCode, threshold, flags);
    EventSetInfo_t *ESI;
+   ProfileRegionTable_t *regions = NULL;
+   PAPI_sprofil_t *owned_prof = NULL;
    int retval, index, i, buckets;
    int forceSW = 0;
    int cidx;
@@ -5130,6 +6006,16 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
       papi_return( PAPI_ECNFLCT );
    }
 
+   /* Sort the regions once here so that dispatch, which runs for   */
+   /* every sample, can binary search them.  Overlaps are rejected. */
+   if ( threshold > 0 ) {
+      retval = _papi_hwi_build_profile_regions( prof, profcnt, flags,
+						&regions );
+      if ( retval != PAPI_OK ) {
+	 papi_return( retval );
+      }
+   }
+
    if ( threshold == 0 ) {
       for( i = 0; i < ESI->profile.event_counter; i++ ) {
 	 if ( ESI->profile.EventCode[i] == EventCode ) {
@@ -5142,29 +6028,42 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
 	 papi_return( PAPI_EINVAL );
       }
 
+      _papi_hwi_free_profile_regions( ESI->profile.regions[i] );
+
+      /* buffers PAPI allocated go once profiling is off below */
+      if ( ESI->profile.owned[i] ) {
+	 owned_prof = ESI->profile.prof[i];
+      }
+
       /* compact these arrays */
       while ( i < ESI->profile.event_counter - 1 ) {
          ESI->profile.prof[i] = ESI->profile.prof[i + 1];
+         ESI->profile.regions[i] = ESI->profile.regions[i + 1];
 	 ESI->profile.count[i] = ESI->profile.count[i + 1];
 	 ESI->profile.threshold[i] = ESI->profile.threshold[i + 1];
 	 ESI->profile.EventIndex[i] = ESI->profile.EventIndex[i + 1];
 	 ESI->profile.EventCode[i] = ESI->profile.EventCode[i + 1];
+	 ESI->profile.owned[i] = ESI->profile.owned[i + 1];
 	 i++;
       }
       ESI->profile.prof[i] = NULL;
+      ESI->profile.regions[i] = NULL;
       ESI->profile.count[i] = 0;
       ESI->profile.threshold[i] = 0;
       ESI->profile.EventIndex[i] = 0;
       ESI->profile.EventCode[i] = 0;
+      ESI->profile.owned[i] = 0;
       ESI->profile.event_counter--;
    } else {
       if ( ESI->profile.event_counter > 0 ) {
 	 if ( ( flags & PAPI_PROFIL_FORCE_SW ) &&
 	      !( ESI->profile.flags & PAPI_PROFIL_FORCE_SW ) ) {
+	    _papi_hwi_free_profile_regions( regions );
 	    papi_return( PAPI_ECNFLCT );
 	 }
 	 if ( !( flags & PAPI_PROFIL_FORCE_SW ) &&
 	      ( ESI->profile.flags & PAPI_PROFIL_FORCE_SW ) ) {
+	    _papi_hwi_free_profile_regions( regions );
 	    papi_return( PAPI_ECNFLCT );
 	 }
       }
@@ -5179,7 +6078,17 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
 	 i = ESI->profile.event_counter;
 	 ESI->profile.event_counter++;
 	 ESI->profile.EventCode[i] = EventCode;
+	 ESI->profile.regions[i] = NULL;
+	 ESI->profile.prof[i] = NULL;
+	 ESI->profile.owned[i] = 0;
       }
+      _papi_hwi_free_profile_regions( ESI->profile.regions[i] );
+      /* the caller's buffers replace ones PAPI allocated */
+      if ( ESI->profile.owned[i] && ( ESI->profile.prof[i] != prof ) ) {
+	 papi_free( ESI->profile.prof[i] );
+	 ESI->profile.owned[i] = 0;
+      }
+      ESI->profile.regions[i] = regions;
       ESI->profile.prof[i] = prof;
       ESI->profile.count[i] = profcnt;
       ESI->profile.threshold[i] = threshold;
@@ -5197,10 +6106,19 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
    if ( flags &
 	~( PAPI_PROFIL_POSIX | PAPI_PROFIL_RANDOM | PAPI_PROFIL_WEIGHTED |
 	   PAPI_PROFIL_COMPRESS | PAPI_PROFIL_BUCKETS | PAPI_PROFIL_FORCE_SW |
-	   PAPI_PROFIL_INST_EAR | PAPI_PROFIL_DATA_EAR ) ) {
+	   PAPI_PROFIL_INST_EAR | PAPI_PROFIL_DATA_EAR |
+	   PAPI_PROFIL_COLLECTOR | PAPI_PROFIL_SPARSE ) ) {
       papi_return( PAPI_EINVAL );
    }
 
+   /* collecting means the kernel buffers samples for a background */
+   /* thread, which only a kernel-based profiler can do            */
+   if ( ( flags & PAPI_PROFIL_COLLECTOR ) &&
+	( ( flags & PAPI_PROFIL_FORCE_SW ) ||
+	  ( _papi_hwd[cidx]->cmp_info.kernel_profile == 0 ) ) ) {
+      papi_return( PAPI_ECMP );
+   }
+
    /* if we have kernel-based profiling, then we're just asking for 
       signals on interrupt. */
    /* if we don't have kernel-based profiling, then we're asking for 
@@ -5244,6 +6162,10 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
       papi_return( retval );	/* We should undo stuff here */
    }
 
+   if ( owned_prof ) {
+      papi_free( owned_prof );
+   }
+
    /* Toggle the profiling flags and ESI state */
 
    if ( ESI->profile.event_counter >= 1 ) {
@@ -5401,6 +6323,8 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
  * @arg PAPI_PROFIL_BUCKET_32	Use unsigned int (32 bit) buckets.@n
  * @arg PAPI_PROFIL_BUCKET_64	Use unsigned long long (64 bit) buckets.@n
  * @arg PAPI_PROFIL_FORCE_SW	Force software overflow in profiling. @n
+ * @arg PAPI_PROFIL_COLLECTOR	Fill the buckets from a background thread woken once per batch of samples, so the profiled thread takes no signals. Needs kernel profiling support. @n
+ * @arg PAPI_PROFIL_SPARSE	Count samples in a hash of the buckets actually hit instead of in buf, so memory follows the hot code rather than the region size. bufsiz is then the length of the region in bytes and buf is unused; read the counts with PAPI_sprofil_hits() after PAPI_stop(). @n
  *
  * @par Example
  * @code
@@ -5425,10 +6349,8 @@ PAPI_sprofil( PAPI_sprofil_t *prof, int profcnt, int EventSet,
  *    handle_error(retval);
  * @endcode
  *
- * @bug If you call PAPI_profil, PAPI allocates buffer space that will not be 
- *      freed if you call PAPI_shutdown or PAPI_cleanup_eventset. 
- *      To clean all memory, you must call PAPI_profil on the Events with 
- *      a 0 threshold. 
+ * The region descriptor PAPI allocates for the buffer is freed when 
+ * profiling of the Event is turned off or the EventSet is destroyed.
  *
  * @see PAPI_overflow 
  * @see PAPI_sprofil
@@ -5472,6 +6394,8 @@ PAPI_profil( void *buf, unsigned bufsiz, caddr_t offset,
 
 			if ( retval != PAPI_OK )
 				papi_free( prof );
+			else
+				ESI->profile.owned[ESI->profile.event_counter - 1] = 1;
 		} else {
 			prof = ESI->profile.prof[i];
 			prof->pr_base = buf;
@@ -5492,12 +6416,282 @@ PAPI_profil( void *buf, unsigned bufsiz, caddr_t offset,
 	if ( i == ESI->profile.event_counter )
 		papi_return( PAPI_EINVAL );
 
-	papi_free( ESI->profile.prof[i] );
-	ESI->profile.prof[i] = NULL;
-
+	/* PAPI_sprofil frees prof once profiling is really off */
 	papi_return( PAPI_sprofil( NULL, 0, EventSet, EventCode, 0, flags ) );
 }
 
+/** @class PAPI_sprofil_objects
+ *	@brief Generate PC histograms for every object loaded in the process.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_sprofil_objects( unsigned scale, int EventSet, int EventCode, int threshold, int flags, PAPI_sprofil_t **prof, int *profcnt );
+ *
+ *	@param scale
+ *		scale factor applied to every region, as for PAPI_profil().
+ *	@param EventSet
+ *		The PAPI EventSet to profile.
+ *	@param EventCode
+ *		Code of the Event in the EventSet to profile.
+ *	@param threshold
+ *		minimum number of events that must occur before the PC is sampled.
+ *		If the value of threshold is 0, profiling is disabled for this event
+ *		and the regions handed out earlier are freed.
+ *	@param flags
+ *		bit pattern to control profiling behavior, as for PAPI_profil().
+ *	@param *prof
+ *		receives the region array allocated by PAPI; may be NULL when
+ *		threshold is 0.
+ *	@param *profcnt
+ *		receives the number of entries in *prof; may be NULL when
+ *		threshold is 0.
+ *
+ *	@retval PAPI_ENOMEM
+ *		The histogram buffers could not be allocated.
+ *	@retval PAPI_ESYS
+ *		The executable or the list of loaded objects could not be read.
+ *	@retval PAPI_ECNFLCT
+ *		The event is already being profiled.
+ *	@retval PAPI_EISRUN
+ *		threshold is 0 and the EventSet is running; nothing is freed.
+ *	@retval
+ *		Any other return value of PAPI_sprofil().
+ *
+ *	PAPI_sprofil_objects() builds one PAPI_sprofil_t region covering the
+ *	text segment of the executable and of every object in 
+ *	PAPI_get_shared_lib_info(), with zeroed histogram buffers sized for the
+ *	given scale and bucket size, and passes them to PAPI_sprofil(). 
+ *	Entry 0 of *prof describes the executable and entry i + 1 describes
+ *	map[i] of the shared library info; objects without a text segment get
+ *	an empty region.
+ *	The regions and their buffers belong to PAPI and stay valid until
+ *	profiling of the event is turned off, by PAPI_sprofil_objects() or
+ *	PAPI_sprofil() with a 0 threshold or by removing the event, or the
+ *	EventSet is destroyed. Regions the caller passed to PAPI_sprofil()
+ *	are never freed by PAPI.
+ *	With PAPI_PROFIL_SPARSE no buffers are allocated and the counts are
+ *	read with PAPI_sprofil_hits(), which makes it practical to profile
+ *	every object at the finest scale.
+ *
+ * @par Example:
+ * @code
+ * PAPI_sprofil_t *prof;
+ * const PAPI_shlib_info_t *shinfo;
+ * const char *name;
+ * int i, j, count;
+ *
+ * retval = PAPI_sprofil_objects( 65536, EventSet, PAPI_TOT_CYC, 1000000,
+ *                                PAPI_PROFIL_POSIX, &prof, &count );
+ * if ( retval != PAPI_OK ) handle_error( retval );
+ * // ... run and stop the EventSet ...
+ * shinfo = PAPI_get_shared_lib_info(  );
+ * for ( i = 0; i < count; i++ ) {
+ *    name = i ? shinfo->map[i - 1].name : PAPI_get_executable_info(  )->fullname;
+ *    for ( j = 0; j < prof[i].pr_size / 2; j++ )
+ *       if ( ( ( unsigned short * ) prof[i].pr_base )[j] )
+ *          printf( "%s+%#x\n", name, j * 2 );
+ * }
+ * PAPI_sprofil_objects( 65536, EventSet, PAPI_TOT_CYC, 0, 0, NULL, NULL );
+ * @endcode
+ *
+ *	@see PAPI_sprofil
+ *	@see PAPI_get_shared_lib_info
+ */
+int
+PAPI_sprofil_objects( unsigned scale, int EventSet, int EventCode,
+		      int threshold, int flags, PAPI_sprofil_t **prof,
+		      int *profcnt )
+{
+	APIDBG( "Entry: scale: %u, EventSet: %d, EventCode: %#x, threshold: %d, flags: %#x\n", scale, EventSet, EventCode, threshold, flags);
+	EventSetInfo_t *ESI;
+	const PAPI_exe_info_t *exeinfo;
+	const PAPI_shlib_info_t *shinfo;
+	const PAPI_address_map_t *map;
+	PAPI_sprofil_t *regions;
+	unsigned long long len, size, total;
+	char *buf;
+	int i, count, bucket_bytes, retval;
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	for ( i = 0; i < ESI->profile.event_counter; i++ ) {
+		if ( ESI->profile.EventCode[i] == EventCode )
+			break;
+	}
+
+	if ( threshold == 0 ) {
+		/* EventCode not found */
+		if ( i == ESI->profile.event_counter )
+			papi_return( PAPI_EINVAL );
+
+		if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+			papi_return( PAPI_EISRUN );
+
+		/* only regions we handed out are freed, and only once 
+		   PAPI_sprofil has turned profiling off */
+		papi_return( PAPI_sprofil( NULL, 0, EventSet, EventCode, 0, flags ) );
+	}
+
+	if ( ( prof == NULL ) || ( profcnt == NULL ) || ( threshold < 0 ) )
+		papi_return( PAPI_EINVAL );
+
+	/* the buffers we would hand out cannot replace the caller's own */
+	if ( i != ESI->profile.event_counter )
+		papi_return( PAPI_ECNFLCT );
+
+	bucket_bytes = _papi_hwi_profile_bucket_bytes( flags );
+	if ( bucket_bytes < 0 )
+		papi_return( bucket_bytes );
+
+	exeinfo = PAPI_get_executable_info(  );
+	shinfo = PAPI_get_shared_lib_info(  );
+	if ( ( exeinfo == NULL ) || ( shinfo == NULL ) )
+		papi_return( PAPI_ESYS );
+	count = shinfo->count + 1;
+
+	/* one block holds the regions followed by all of their buckets */
+	total = sizeof ( PAPI_sprofil_t ) * ( unsigned long long ) count;
+	for ( i = 0; i < count; i++ ) {
+		map = i ? &shinfo->map[i - 1] : &exeinfo->address_info;
+		if ( map->text_end <= map->text_start )
+			continue;
+		len = ( unsigned long long ) ( map->text_end - map->text_start );
+		if ( !( flags & PAPI_PROFIL_SPARSE ) )
+			total += ( ( ( len * scale ) >> 17 ) + 1 ) * bucket_bytes;
+	}
+
+	regions = ( PAPI_sprofil_t * ) papi_calloc( 1, ( size_t ) total );
+	if ( regions == NULL )
+		papi_return( PAPI_ENOMEM );
+
+	buf = ( char * ) ( regions + count );
+	for ( i = 0; i < count; i++ ) {
+		map = i ? &shinfo->map[i - 1] : &exeinfo->address_info;
+		regions[i].pr_off = map->text_start;
+		regions[i].pr_scale = scale;
+		if ( map->text_end <= map->text_start )
+			continue;
+		len = ( unsigned long long ) ( map->text_end - map->text_start );
+		if ( flags & PAPI_PROFIL_SPARSE ) {
+			regions[i].pr_size = ( unsigned ) len;
+			continue;
+		}
+		size = ( ( ( len * scale ) >> 17 ) + 1 ) * bucket_bytes;
+		regions[i].pr_base = buf;
+		regions[i].pr_size = ( unsigned ) size;
+		buf += size;
+	}
+
+	retval = PAPI_sprofil( regions, count, EventSet, EventCode,
+			       threshold, flags );
+	if ( retval != PAPI_OK ) {
+		papi_free( regions );
+		papi_return( retval );
+	}
+
+	ESI->profile.owned[ESI->profile.event_counter - 1] = 1;
+	*prof = regions;
+	*profcnt = count;
+
+	papi_return( PAPI_OK );
+}
+
+/** @class PAPI_sprofil_hits
+ *	@brief Copy the buckets counted by a sparse profile.
+ *
+ * @par C Interface:
+ * \#include <papi.h> @n
+ * int PAPI_sprofil_hits( int EventSet, int EventCode, PAPI_sprofil_hit_t *hits, int max, int *count );
+ *
+ *	@param EventSet
+ *		The PAPI EventSet being profiled.
+ *	@param EventCode
+ *		The event profiled with PAPI_PROFIL_SPARSE.
+ *	@param *hits
+ *		array receiving up to max buckets; may be NULL if max is 0.
+ *	@param max
+ *		number of entries in hits.
+ *	@param *count
+ *		receives the number of buckets available, which may exceed max.
+ *
+ *	@retval PAPI_EINVAL
+ *		The event is not profiled with PAPI_PROFIL_SPARSE, or an argument
+ *		is invalid.
+ *	@retval PAPI_ENOEVST
+ *		The EventSet specified does not exist.
+ *	@retval PAPI_EISRUN
+ *		The EventSet is currently counting events.
+ *
+ *	A PAPI_PROFIL_SPARSE profile counts samples in a hash table holding
+ *	only the buckets that were hit. Each PAPI_stop() dumps that table
+ *	into a list sorted by region, the index into the PAPI_sprofil_t
+ *	array, and bucket, the index a dense buffer of the same scale would
+ *	have used; counts accumulate over every start and stop since the
+ *	profile was set up. The table starts with room for twice the buckets
+ *	the regions span, up to a fixed limit, or with the number of slots
+ *	given by the PAPI_PROFIL_HASH_SLOTS environment variable, rounded
+ *	up to a power of 2. Samples that found no free
+ *	slot near their bucket are reported in a last entry with region -1;
+ *	the table is grown at the next PAPI_stop() so later runs keep them.
+ *
+ * @par Example:
+ * @code
+ * PAPI_sprofil_hit_t *hits;
+ * int i, count;
+ *
+ * // ... profile with PAPI_PROFIL_SPARSE, run, PAPI_stop ...
+ * PAPI_sprofil_hits( EventSet, PAPI_TOT_CYC, NULL, 0, &count );
+ * hits = malloc( count * sizeof ( PAPI_sprofil_hit_t ) );
+ * PAPI_sprofil_hits( EventSet, PAPI_TOT_CYC, hits, count, &count );
+ * for ( i = 0; i < count; i++ )
+ *    printf( "%d %lu %llu\n", hits[i].region, hits[i].bucket, hits[i].count );
+ * @endcode
+ *
+ *	@see PAPI_sprofil
+ *	@see PAPI_profil
+ */
+int
+PAPI_sprofil_hits( int EventSet, int EventCode, PAPI_sprofil_hit_t *hits,
+		   int max, int *count )
+{
+	APIDBG( "Entry: EventSet: %d, EventCode: %#x, hits: %p, max: %d, count: %p\n", EventSet, EventCode, hits, max, count);
+	EventSetInfo_t *ESI;
+	ProfileRegionTable_t *table;
+	int i;
+
+	if ( ( count == NULL ) || ( max < 0 ) || ( ( hits == NULL ) && max ) )
+		papi_return( PAPI_EINVAL );
+
+	ESI = _papi_hwi_lookup_EventSet( EventSet );
+	if ( ESI == NULL )
+		papi_return( PAPI_ENOEVST );
+
+	if ( ( ESI->state & PAPI_STOPPED ) != PAPI_STOPPED )
+		papi_return( PAPI_EISRUN );
+
+	for ( i = 0; i < ESI->profile.event_counter; i++ ) {
+		if ( ESI->profile.EventCode[i] == EventCode )
+			break;
+	}
+	if ( i == ESI->profile.event_counter )
+		papi_return( PAPI_EINVAL );
+
+	table = ESI->profile.regions[i];
+	if ( ( table == NULL ) || ( table->hash == NULL ) )
+		papi_return( PAPI_EINVAL );
+
+	*count = table->hash->nhits;
+	if ( max > table->hash->nhits )
+		max = table->hash->nhits;
+	if ( max > 0 )
+		memcpy( hits, table->hash->hits,
+			( size_t ) max * sizeof ( PAPI_sprofil_hit_t ) );
+
+	return PAPI_OK;
+}
+
 /* This function sets the low level default granularity
    for all newly manufactured eventsets. The first function
    preserves API compatibility and assumes component 0;
@@ -6227,6 +7421,12 @@ PAPI_get_real_cyc( void )
  *	The time is returned in nanoseconds. 
  *	This call is equivalent to wall clock time.
  *
+ *	On x86_64 Linux with an invariant TSC that the kernel also uses
+ *	as its clocksource, the time is read straight from the TSC and
+ *	scaled by a factor calibrated over the first few tens of 
+ *	milliseconds after PAPI_library_init(), so no system call is made.
+ *	Until then, and elsewhere, clock_gettime() is used.
+ *
  *	@see PAPI_get_virt_usec 
  *	@see PAPI_get_virt_cyc 
  *	@see PAPI_library_init
@@ -276,7 +276,8 @@ failure.
 #define PAPI_ECOUNT		-23    /**< Too many events or attributes */
 #define PAPI_ECOMBO		-24    /**< Bad combination of features */
 #define PAPI_ECMP_DISABLED	-25    /**< Component containing event is disabled */
-#define PAPI_NUM_ERRORS	 26    /**< Number of error messages specified in this API */
+#define PAPI_EDELAY_INIT	-26    /**< Delayed initialization component */
+#define PAPI_NUM_ERRORS	 27    /**< Number of error messages specified in this API */
 
 #define PAPI_NOT_INITED		0
 #define PAPI_LOW_LEVEL_INITED 	1       /* Low level has called library init */
@@ -402,6 +403,8 @@ All of the functions in the PerfAPI should use the following set of constants.
 #define PAPI_PROFIL_FORCE_SW  0x40       /**< Force Software overflow in profiling */
 #define PAPI_PROFIL_DATA_EAR  0x80       /**< Use data address register profiling */
 #define PAPI_PROFIL_INST_EAR  0x100      /**< Use instruction address register profiling */
+#define PAPI_PROFIL_COLLECTOR 0x200      /**< Fill buckets from a collector thread, never signal the measured thread */
+#define PAPI_PROFIL_SPARSE    0x400      /**< Count samples in a hash of the buckets hit instead of dense buffers */
 #define PAPI_PROFIL_BUCKETS   (PAPI_PROFIL_BUCKET_16 | PAPI_PROFIL_BUCKET_32 | PAPI_PROFIL_BUCKET_64)
 /** @} */
 
@@ -411,11 +414,39 @@ All of the functions in the PerfAPI should use the following set of constants.
 #define PAPI_OVERFLOW_HARDWARE 0x80	/**< Using Hardware */
 /** @} */
 
+/* @defgroup sample_defns Sample streaming definitions
+   @{ */
+#define PAPI_SAMPLE_IP        0x01   /**< Record the instruction pointer */
+#define PAPI_SAMPLE_TID       0x02   /**< Record the process and thread id */
+#define PAPI_SAMPLE_TIME      0x04   /**< Record a timestamp (ns) */
+#define PAPI_SAMPLE_ADDR      0x08   /**< Record the data address, if the event provides one */
+#define PAPI_SAMPLE_CALLCHAIN 0x10   /**< Record the call chain */
+#define PAPI_SAMPLE_READ      0x20   /**< Record the count of the sampled event */
+#define PAPI_SAMPLE_LOST      0x80000000 /**< Not a sample: value holds the number of samples the kernel dropped */
+#define PAPI_MAX_SAMPLE_CALLCHAIN 32 /**< Call chain entries kept per sample */
+/** @} */
+
+/* @defgroup export_defns Counter export definitions
+   Layout of the shared memory segment filled by PAPI_export_set()
+   @{ */
+#define PAPI_EXPORT_PATH     "/dev/shm/papi_export.%d" /**< Segment of a process, by pid */
+#define PAPI_EXPORT_MAGIC    0x50415058 /**< First word of every segment */
+#define PAPI_EXPORT_VERSION  1       /**< Bumped whenever the layout changes */
+#define PAPI_EXPORT_SLOTS    64      /**< Exported EventSets per process */
+#define PAPI_EXPORT_MAX_EVENTS 16    /**< Events per exported EventSet */
+/** @} */
+
+/* @defgroup hl_region_defns High level region definitions
+   @{ */
+#define PAPI_HL_REGION_EVENTS 4      /**< Events counted by PAPI_hl_region_begin() */
+/** @} */
+
 /** @internal 
   *	@defgroup mpx_defns Multiplex flags definitions 
   * @{ */
 #define PAPI_MULTIPLEX_DEFAULT	0x0	/**< Use whatever method is available, prefer kernel of course. */
 #define PAPI_MULTIPLEX_FORCE_SW 0x1	/**< Force PAPI multiplexing instead of kernel */
+#define PAPI_MULTIPLEX_ADAPTIVE 0x2	/**< PAPI multiplexing that gives noisier events longer slices */
 /** @} */
 
 /** @internal 
@@ -456,6 +487,7 @@ All of the functions in the PerfAPI should use the following set of constants.
 #define PAPI_CPU_ATTACH		27      /**< Specify a cpu number the event set should be tied to */
 #define PAPI_INHERIT		28      /**< Option to set counter inheritance flag */
 #define PAPI_USER_EVENTS_FILE 29	/**< Option to set file from where to parse user defined events */
+#define PAPI_REFRESH_NS     30      /**< Minimum interval in ns between kernel reads of a polled eventset */
 
 #define PAPI_INIT_SLOTS    64     /*Number of initialized slots in
                                    DynamicArray of EventSets */
@@ -565,6 +597,63 @@ read the documentation carefully.  */
   typedef void (*PAPI_overflow_handler_t) (int EventSet, void *address,
                                 long long overflow_vector, void *context);
 
+	/** @ingroup papi_data_structures */
+   typedef struct _papi_sample {
+      int event_index;        /**< index in the EventSet of the sampled event */
+      unsigned int type;      /**< PAPI_SAMPLE_* bits valid in this record */
+      long long ip;           /**< instruction pointer */
+      int pid;                /**< process id */
+      int tid;                /**< thread id */
+      long long time;         /**< timestamp in ns */
+      long long addr;         /**< data address */
+      long long value;        /**< event count, or dropped samples for PAPI_SAMPLE_LOST */
+      int nr_callchain;       /**< valid entries in callchain */
+      long long callchain[PAPI_MAX_SAMPLE_CALLCHAIN]; /**< return addresses, innermost first */
+   } PAPI_sample_t;
+
+  typedef void (*PAPI_sample_handler_t) (int EventSet, PAPI_sample_t *samples,
+                                int count, void *context);
+
+	/** @ingroup papi_data_structures
+	 *  @brief header of a PAPI_export_set() segment, followed by nslots slots */
+   typedef struct _papi_export_header {
+      unsigned int magic;     /**< PAPI_EXPORT_MAGIC */
+      unsigned int version;   /**< PAPI_EXPORT_VERSION */
+      unsigned int slot_size; /**< sizeof(PAPI_export_slot_t) */
+      unsigned int nslots;    /**< number of slots after the header */
+      int pid;                /**< process publishing the values */
+      int reserved[3];
+   } PAPI_export_header_t;
+
+	/** @ingroup papi_data_structures
+	 *  @brief one exported EventSet; see PAPI_export_set() for reading it */
+   typedef struct _papi_export_slot {
+      volatile unsigned int seq; /**< odd while the slot is being written */
+      int tid;                /**< thread counted, 0 for a free slot */
+      int eventset;           /**< EventSet handle in the publishing process */
+      int num_events;         /**< valid entries in events and values */
+      char label[PAPI_MIN_STR_LEN]; /**< name given to PAPI_export_set */
+      int events[PAPI_EXPORT_MAX_EVENTS]; /**< event codes, as added */
+      long long time;         /**< PAPI_get_real_nsec() of the values */
+      long long values[PAPI_EXPORT_MAX_EVENTS]; /**< counts since PAPI_start */
+   } PAPI_export_slot_t;
+
+	/** @ingroup papi_data_structures
+	 *  @brief statistics of one region, merged over all threads;
+	 *  column 0 of the arrays is real time in ns, columns 1 to
+	 *  num_events the events */
+   typedef struct _papi_hl_region_info {
+      char name[PAPI_MAX_STR_LEN]; /**< region name */
+      int threads;            /**< threads that completed the region */
+      int num_events;         /**< valid entries in events */
+      long long count;        /**< completed visits, all threads */
+      int events[PAPI_HL_REGION_EVENTS]; /**< event codes of columns 1 to num_events */
+      long long total[PAPI_HL_REGION_EVENTS + 1]; /**< sum over all visits */
+      long long min[PAPI_HL_REGION_EVENTS + 1];   /**< smallest visit */
+      long long max[PAPI_HL_REGION_EVENTS + 1];   /**< largest visit */
+      double mean[PAPI_HL_REGION_EVENTS + 1];     /**< total / count */
+   } PAPI_hl_region_info_t;
+
         /* Handle C99 and more recent compilation */
 	/* caddr_t was never approved by POSIX and is obsolete */
 	/* We should probably switch all caddr_t to void * or long */
@@ -587,6 +676,14 @@ read the documentation carefully.  */
                                  also, two extensions 0x1000 == 1, 0x2000 == 2 */
    } PAPI_sprofil_t;
 
+	/** @ingroup papi_data_structures
+	  @brief one bucket of a PAPI_PROFIL_SPARSE profile */
+   typedef struct _papi_sprofil_hit {
+      int region;             /**< index into the PAPI_sprofil_t array, -1 for dropped samples */
+      unsigned long bucket;   /**< bucket within the region, as for a dense buffer */
+      unsigned long long count; /**< samples counted in this bucket */
+   } PAPI_sprofil_hit_t;
+
 /** @ingroup papi_data_structures */
    typedef struct _papi_itimer_option {
      int itimer_num;
@@ -601,6 +698,13 @@ read the documentation carefully.  */
       int inherit;
    } PAPI_inherit_option_t;
 
+/** @ingroup papi_data_structures
+  * @brief how stale the values of a polled eventset may get; 0 is the component default */
+   typedef struct _papi_refresh_option {
+      int eventset;
+      long long ns;
+   } PAPI_refresh_option_t;
+
 /** @ingroup papi_data_structures */
    typedef struct _papi_domain_option {
       int def_cidx; /**< this structure requires a component index to set default domains */
@@ -671,7 +775,9 @@ read the documentation carefully.  */
      /* This should be a granularity option */
      unsigned int cpu:1;                   /**< Supports specifying cpu number to use with event set */
      unsigned int inherit:1;               /**< Supports child processes inheriting parents counters */
-     unsigned int reserved_bits:12;
+     unsigned int refresh:1;               /**< Supports setting the refresh interval with PAPI_REFRESH_NS */
+     unsigned int dynamic_events:1;        /**< Events can be added after initialization, so they are never cached */
+     unsigned int reserved_bits:10;
    } PAPI_component_info_t;
 
 /**  @ingroup papi_data_structures*/
@@ -830,6 +936,16 @@ typedef char* PAPI_user_defined_events_file_t;
       int flags;
    } PAPI_multiplex_option_t;
 
+/** @ingroup papi_data_structures
+  @brief a multiplexed count with its error bounds, from PAPI_read_estimates */
+   typedef struct _papi_estimate {
+      long long value;     /**< estimated count, as PAPI_read returns it */
+      long long std_error; /**< standard error of value; 0 if counted all the time, -1 if unknown */
+      long long low;       /**< lower end of the 95% confidence interval */
+      long long high;      /**< upper end of the 95% confidence interval */
+      int slices;          /**< time slices the estimate is based on */
+   } PAPI_estimate_t;
+
    /** @ingroup papi_data_structures 
 	 *  @brief address range specification for range restricted counting if both are zero, range is disabled  */
    typedef struct _papi_addr_range_option { 
@@ -849,6 +965,7 @@ typedef char* PAPI_user_defined_events_file_t;
 		PAPI_preload_info_t preload;
 		PAPI_debug_option_t debug;
 		PAPI_inherit_option_t inherit;
+		PAPI_refresh_option_t refresh;
 		PAPI_granularity_option_t granularity;
 		PAPI_granularity_option_t defgranularity;
 		PAPI_domain_option_t domain;
@@ -1029,6 +1146,8 @@ enum {
    int   PAPI_assign_eventset_component(int EventSet, int cidx); /**< assign a component index to an existing but empty eventset */
    int   PAPI_attach(int EventSet, unsigned long tid); /**< attach specified event set to a specific process or thread id */
    int   PAPI_cleanup_eventset(int EventSet); /**< remove all PAPI events from an event set */
+   int   PAPI_cpuset_read(int EventSet, unsigned int *cpus, long long *values, int max, int *count); /**< read an event set on each cpu of its cpu set */
+   int   PAPI_cpuset_set(int EventSet, const unsigned int *cpus, int num_cpus); /**< count an event set on every process of a set of cpus */
    int   PAPI_create_eventset(int *EventSet); /**< create a new empty PAPI event set */
    int   PAPI_detach(int EventSet); /**< detach specified event set from a previously specified process or thread id */
    int   PAPI_destroy_eventset(int *EventSet); /**< deallocates memory associated with an empty PAPI event set */
@@ -1036,6 +1155,7 @@ enum {
    int   PAPI_enum_cmp_event(int *EventCode, int modifier, int cidx); /**< return the event code for the next available component event */
    int   PAPI_event_code_to_name(int EventCode, char *out); /**< translate an integer PAPI event code into an ASCII PAPI preset or native name */
    int   PAPI_event_name_to_code(const char *in, int *out); /**< translate an ASCII PAPI preset or native name into an integer PAPI event code */
+   int   PAPI_export_set(int EventSet, const char *label, long long period_ns); /**< publish the counts of an event set to shared memory periodically */
    int  PAPI_get_dmem_info(PAPI_dmem_info_t *dest); /**< get dynamic memory usage information */
    int   PAPI_get_event_info(int EventCode, PAPI_event_info_t * info); /**< get the name and descriptions for a given preset or native event code */
    const PAPI_exe_info_t *PAPI_get_executable_info(void); /**< get the executable's address space information */
@@ -1071,11 +1191,16 @@ enum {
    int   PAPI_query_named_event(const char *EventName); /**< query if a named PAPI event exists */
    int   PAPI_read(int EventSet, long long * values); /**< read hardware events from an event set with no reset */
    int   PAPI_read_ts(int EventSet, long long * values, long long *cyc); /**< read from an eventset with a real-time cycle timestamp */
+   int   PAPI_read_estimates(int EventSet, long long * values, PAPI_estimate_t *estimates); /**< read an eventset along with error bounds of multiplexed counts */
    int   PAPI_register_thread(void); /**< inform PAPI of the existence of a new thread */
    int   PAPI_remove_event(int EventSet, int EventCode); /**< remove a hardware event from a PAPI event set */
    int   PAPI_remove_named_event(int EventSet, const char *EventName); /**< remove a named event from a PAPI event set */
    int   PAPI_remove_events(int EventSet, int *Events, int number); /**< remove an array of hardware events from a PAPI event set */
    int   PAPI_reset(int EventSet); /**< reset the hardware event counts in an event set */
+   int   PAPI_sample_collect(int EventSet, PAPI_sample_handler_t handler, void *context, int batch); /**< have a background thread pass samples of an event set to a handler */
+   int   PAPI_sample_drain(int EventSet, PAPI_sample_handler_t handler, void *context); /**< pass all buffered samples of an event set to a handler */
+   int   PAPI_sample_read(int EventSet, PAPI_sample_t *samples, int max, int *count); /**< copy buffered samples of an event set into a user buffer */
+   int   PAPI_sample_set(int EventSet, int EventCode, long long period, int sample_type, int ring_pages); /**< set up an event to stream samples without signals */
    int   PAPI_set_debug(int level); /**< set the current debug level for PAPI */
    int   PAPI_set_cmp_domain(int domain, int cidx); /**< set the component specific default execution domain for new event sets */
    int   PAPI_set_domain(int domain); /**< set the default execution domain for new event sets  */
@@ -1086,10 +1211,14 @@ enum {
    int   PAPI_set_thr_specific(int tag, void *ptr); /**< save a pointer as a thread specific stored data structure */
    void  PAPI_shutdown(void); /**< finish using PAPI and free all related resources */
    int   PAPI_sprofil(PAPI_sprofil_t * prof, int profcnt, int EventSet, int EventCode, int threshold, int flags); /**< generate hardware counter profiles from multiple code regions */
+   int   PAPI_sprofil_hits(int EventSet, int EventCode, PAPI_sprofil_hit_t *hits, int max, int *count); /**< copy the buckets hit by a sparse profile */
+   int   PAPI_sprofil_objects(unsigned scale, int EventSet, int EventCode, int threshold, int flags, PAPI_sprofil_t **prof, int *profcnt); /**< generate hardware counter profiles for every loaded object */
    int   PAPI_start(int EventSet); /**< start counting hardware events in an event set */
    int   PAPI_state(int EventSet, int *status); /**< return the counting state of an event set */
    int   PAPI_stop(int EventSet, long long * values); /**< stop counting hardware events in an event set and return current events */
    char *PAPI_strerror(int); /**< return a pointer to the error name corresponding to a specified error code */
+   int   PAPI_timeseries_read(int EventSet, long long *times, long long *values, int max, int *count, long long *dropped); /**< copy periodic snapshots of an event set into user buffers */
+   int   PAPI_timeseries_set(int EventSet, long long period_ns, int records); /**< have a background thread snapshot an event set periodically */
    unsigned long PAPI_thread_id(void); /**< get the thread identifier of the current thread */
    int   PAPI_thread_init(unsigned long (*id_fn) (void)); /**< initialize thread support in the PAPI library */
    int   PAPI_unlock(int); /**< unlock one of two PAPI internal user mutex variables */
@@ -1123,6 +1252,9 @@ enum {
    int PAPI_flops(float *rtime, float *ptime, long long * flpops, float *mflops); /**< simplified call to get Mflops/s (floating point operation rate), real and processor time */
    int PAPI_ipc(float *rtime, float *ptime, long long * ins, float *ipc); /**< gets instructions per cycle, real and processor time */
    int PAPI_epc(int event, float *rtime, float *ptime, long long *ref, long long *core, long long *evt, float *epc); /**< gets (named) events per cycle, real and processor time, reference and core cycles */
+   int PAPI_hl_region_begin(const char *name); /**< start attributing counts to a named region */
+   int PAPI_hl_region_end(const char *name); /**< stop attributing counts to the innermost region */
+   int PAPI_hl_region_read(const char *name, PAPI_hl_region_info_t *info); /**< get the statistics of a region, merged over all threads */
 /** @} */
 
 
@@ -0,0 +1,653 @@
+/*
+* File:    papi_catalog.c
+*
+* On-disk cache of the native events each component enumerates.
+*
+* When PAPI_EVENT_CACHE names a directory, the first full enumeration of
+* a component (PAPI_ENUM_FIRST) walks the component once and writes every
+* event and umask it reports, with the PAPI_event_info_t text and scalar
+* fields, to <dir>/<component>.events.  Later runs mmap that file and serve
+* enumeration, event info and name lookups from it without calling the
+* component.  The file is keyed by the kernel, the CPU, the PAPI version
+* and the component's own versions (for perf_event that includes the
+* libpfm4 version), and is rebuilt whenever the key does not match.
+*
+* Event codes handed out from a catalog are bound to the component lazily,
+* by name, the first time the component itself is needed (papi_internal.c).
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+
+#include "papi.h"
+#include "papi_internal.h"
+#include "papi_vector.h"
+#include "papi_memory.h"
+#include "papi_catalog.h"
+
+#define CATALOG_UNKNOWN 0	/* not looked at yet */
+#define CATALOG_MISSING 1	/* no valid file, may still be built */
+#define CATALOG_READY   2
+#define CATALOG_OFF     3	/* disabled or failed, use the component */
+
+#define CATALOG_NO_REC  0xffffffffU
+
+typedef struct catalog {
+	int state;
+	hwi_catalog_header_t *hdr;
+	size_t size;
+	int mapped;		/* hdr is mmap'd rather than malloc'd */
+	hwi_catalog_rec_t *recs;
+	unsigned int *buckets;
+	const char *strings;
+	int *codes;		/* PAPI event code handed out per record, 0 if none */
+} catalog_t;
+
+static catalog_t *catalogs = NULL;
+
+/* FNV-1a, the same hash the perf_event layer uses for event names */
+static unsigned int
+hash_name( const char *name, unsigned int num_buckets )
+{
+	unsigned int hash = 2166136261U;
+
+	while ( *name ) {
+		hash ^= ( unsigned char ) *name++;
+		hash *= 16777619U;
+	}
+	return hash & ( num_buckets - 1 );
+}
+
+static void
+catalog_key( int cidx, char *key, int len )
+{
+	struct utsname u;
+	const PAPI_hw_info_t *hw = &_papi_hwi_system_info.hw_info;
+	const PAPI_component_info_t *cmp = &_papi_hwd[cidx]->cmp_info;
+
+	if ( uname( &u ) < 0 )
+		memset( &u, 0, sizeof ( u ) );
+
+	snprintf( key, len, "PAPI %#x|%s %s %s %s|%s %d/%d/%d %s|%s %s %s %s %d",
+		  PAPI_VERSION, u.sysname, u.release, u.version, u.machine,
+		  hw->vendor_string, hw->cpuid_family, hw->cpuid_model,
+		  hw->cpuid_stepping, hw->model_string, cmp->name, cmp->version,
+		  cmp->support_version, cmp->kernel_version,
+		  cmp->num_native_events );
+}
+
+/* Point the catalog at an image, checking it can be trusted */
+static int
+catalog_attach( catalog_t *cat, hwi_catalog_header_t *hdr, size_t size,
+		const char *key )
+{
+	unsigned int i, n, nb, strings;
+	hwi_catalog_rec_t *recs;
+	unsigned int *buckets;
+
+	if ( size < sizeof ( *hdr ) || hdr->magic != PAPI_CATALOG_MAGIC ||
+	     hdr->version != PAPI_CATALOG_VERSION || hdr->size != size ||
+	     strncmp( hdr->key, key, sizeof ( hdr->key ) ) != 0 )
+		return PAPI_EINVAL;
+
+	n = hdr->num_records;
+	nb = hdr->num_buckets;
+	strings = hdr->strings;
+	if ( nb == 0 || ( nb & ( nb - 1 ) ) || strings >= size ||
+	     strings != sizeof ( *hdr ) + n * sizeof ( *recs ) +
+	     2 * nb * sizeof ( *buckets ) || ( ( char * ) hdr )[size - 1] != '\0' )
+		return PAPI_EINVAL;
+
+	recs = ( hwi_catalog_rec_t * ) ( hdr + 1 );
+	buckets = ( unsigned int * ) ( recs + n );
+	for ( i = 0; i < n; i++ ) {
+		if ( recs[i].name >= size - strings ||
+		     recs[i].symbol >= size - strings ||
+		     recs[i].short_descr >= size - strings ||
+		     recs[i].long_descr >= size - strings ||
+		     recs[i].units >= size - strings ||
+		     recs[i].note >= size - strings ||
+		     recs[i].parent >= ( int ) i ||
+		     ( recs[i].next != CATALOG_NO_REC && recs[i].next >= n ) ||
+		     ( recs[i].next_name != CATALOG_NO_REC && recs[i].next_name >= n ) )
+			return PAPI_EINVAL;
+	}
+	for ( i = 0; i < 2 * nb; i++ ) {
+		if ( buckets[i] != CATALOG_NO_REC && buckets[i] >= n )
+			return PAPI_EINVAL;
+	}
+
+	cat->codes = papi_calloc( n ? n : 1, sizeof ( int ) );
+	if ( cat->codes == NULL )
+		return PAPI_ENOMEM;
+
+	cat->hdr = hdr;
+	cat->size = size;
+	cat->recs = recs;
+	cat->buckets = buckets;
+	cat->strings = ( const char * ) hdr + strings;
+	return PAPI_OK;
+}
+
+static int
+catalog_load( catalog_t *cat, const char *path, const char *key )
+{
+	struct stat st;
+	void *image;
+	int fd, retval;
+
+	fd = open( path, O_RDONLY );
+	if ( fd < 0 )
+		return PAPI_ESYS;
+	if ( fstat( fd, &st ) < 0 || st.st_size <= 0 ) {
+		close( fd );
+		return PAPI_ESYS;
+	}
+	image = mmap( NULL, ( size_t ) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if ( image == MAP_FAILED )
+		return PAPI_ESYS;
+
+	retval = catalog_attach( cat, image, ( size_t ) st.st_size, key );
+	if ( retval != PAPI_OK ) {
+		SUBDBG( "Catalog %s is stale or damaged\n", path );
+		munmap( image, ( size_t ) st.st_size );
+		return retval;
+	}
+	cat->mapped = 1;
+	return PAPI_OK;
+}
+
+/* Growable record and string areas used while building */
+typedef struct catalog_build {
+	hwi_catalog_rec_t *recs;
+	unsigned int num_recs, max_recs;
+	char *strings;
+	unsigned int len, max_len;
+} catalog_build_t;
+
+static unsigned int
+add_string( catalog_build_t *b, const char *s )
+{
+	unsigned int off;
+	size_t n;
+	char *tmp;
+
+	if ( s == NULL || *s == '\0' )
+		return 0;	/* offset 0 is the empty string */
+
+	n = strlen( s ) + 1;
+	if ( b->len + n > b->max_len ) {
+		unsigned int max = b->max_len * 2 + ( unsigned int ) n;
+		tmp = papi_realloc( b->strings, max );
+		if ( tmp == NULL )
+			return CATALOG_NO_REC;
+		b->strings = tmp;
+		b->max_len = max;
+	}
+	off = b->len;
+	memcpy( b->strings + off, s, n );
+	b->len += ( unsigned int ) n;
+	return off;
+}
+
+static int
+add_record( catalog_build_t *b, const char *name, int parent,
+	    const PAPI_event_info_t *info )
+{
+	hwi_catalog_rec_t *rec;
+
+	if ( b->num_recs == b->max_recs ) {
+		unsigned int max = b->max_recs ? b->max_recs * 2 : 256;
+		rec = papi_realloc( b->recs, max * sizeof ( *rec ) );
+		if ( rec == NULL )
+			return PAPI_ENOMEM;
+		b->recs = rec;
+		b->max_recs = max;
+	}
+
+	rec = &b->recs[b->num_recs];
+	memset( rec, 0, sizeof ( *rec ) );
+	if ( name == NULL )
+		name = _papi_hwi_strip_component_prefix( info->symbol );
+	rec->name = add_string( b, name );
+	rec->symbol = add_string( b, info->symbol );
+	rec->short_descr = add_string( b, info->short_descr );
+	rec->long_descr = add_string( b, info->long_descr );
+	rec->units = add_string( b, info->units );
+	rec->note = add_string( b, info->note );
+	if ( rec->name == CATALOG_NO_REC || rec->symbol == CATALOG_NO_REC ||
+	     rec->short_descr == CATALOG_NO_REC ||
+	     rec->long_descr == CATALOG_NO_REC || rec->units == CATALOG_NO_REC ||
+	     rec->note == CATALOG_NO_REC )
+		return PAPI_ENOMEM;
+	rec->parent = parent;
+	rec->next = CATALOG_NO_REC;
+	rec->next_name = CATALOG_NO_REC;
+	rec->location = info->location;
+	rec->data_type = info->data_type;
+	rec->value_type = info->value_type;
+	rec->timescope = info->timescope;
+	rec->update_type = info->update_type;
+	rec->update_freq = info->update_freq;
+
+	return ( int ) b->num_recs++;
+}
+
+/* The native path of PAPI_enum_cmp_event, straight to the component */
+static int
+enum_native( int cidx, int *code, int modifier, char **name )
+{
+	int event_code = 0;
+	int retval;
+	char *evt_name;
+
+	_papi_hwi_set_papi_event_code( ( unsigned int ) *code, 0 );
+	if ( modifier != PAPI_ENUM_FIRST )
+		event_code = _papi_hwi_eventcode_to_native( *code );
+	retval = _papi_hwd[cidx]->ntv_enum_events( ( unsigned int * ) &event_code,
+						   modifier );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	evt_name = _papi_hwi_get_papi_event_string(  );
+	*name = ( evt_name != NULL ) ? strdup( evt_name ) : NULL;
+	*code = _papi_hwi_native_to_eventcode( cidx, event_code, -1, evt_name );
+	_papi_hwi_free_papi_event_string(  );
+
+	return ( *code < 0 ) ? *code : PAPI_OK;
+}
+
+static int
+add_event( catalog_build_t *b, int code, char *name, int parent,
+	   PAPI_event_info_t *info, int **codes, unsigned int *max_codes )
+{
+	int rec, *tmp;
+
+	if ( _papi_hwi_get_native_event_info( ( unsigned int ) code, info ) != PAPI_OK ) {
+		free( name );
+		return PAPI_ENOEVNT;
+	}
+	rec = add_record( b, name, parent, info );
+	free( name );
+	if ( rec < 0 )
+		return rec;
+
+	if ( ( unsigned int ) rec >= *max_codes ) {
+		tmp = papi_realloc( *codes, b->max_recs * sizeof ( int ) );
+		if ( tmp == NULL )
+			return PAPI_ENOMEM;
+		*codes = tmp;
+		*max_codes = b->max_recs;
+	}
+	( *codes )[rec] = code;
+	return rec;
+}
+
+/* Enumerate a component once through its own vector into an image */
+static int
+catalog_build( catalog_t *cat, int cidx, const char *key )
+{
+	catalog_build_t b;
+	PAPI_event_info_t *info;
+	hwi_catalog_header_t *hdr;
+	hwi_catalog_rec_t *recs;
+	unsigned int *buckets, nb, i, h;
+	const char *symbol, *key_name;
+	int *codes = NULL;
+	unsigned int max_codes = 0;
+	size_t size;
+	int code, ucode, rec, retval;
+	char *name;
+
+	memset( &b, 0, sizeof ( b ) );
+	info = papi_malloc( sizeof ( *info ) );
+	b.strings = papi_malloc( 4096 );
+	if ( info == NULL || b.strings == NULL ) {
+		papi_free( info );
+		papi_free( b.strings );
+		return PAPI_ENOMEM;
+	}
+	b.strings[0] = '\0';	/* offset 0 is the empty string */
+	b.len = 1;
+	b.max_len = 4096;
+
+	code = PAPI_NATIVE_MASK;
+	retval = enum_native( cidx, &code, PAPI_ENUM_FIRST, &name );
+	while ( retval == PAPI_OK ) {
+		rec = add_event( &b, code, name, -1, info, &codes, &max_codes );
+		if ( rec == PAPI_ENOMEM ) {
+			retval = rec;
+			break;
+		}
+		if ( rec >= 0 ) {
+			ucode = code;
+			while ( enum_native( cidx, &ucode, PAPI_NTV_ENUM_UMASKS,
+					     &name ) == PAPI_OK ) {
+				if ( add_event( &b, ucode, name, rec, info,
+						&codes, &max_codes ) == PAPI_ENOMEM ) {
+					retval = PAPI_ENOMEM;
+					break;
+				}
+			}
+			if ( retval != PAPI_OK )
+				break;
+		}
+		retval = enum_native( cidx, &code, PAPI_ENUM_EVENTS, &name );
+	}
+	papi_free( info );
+	if ( retval == PAPI_ENOMEM )
+		goto build_fail;
+
+	/* Lay out header, records, buckets and strings in one image */
+	for ( nb = 64; nb < b.num_recs; nb <<= 1 );
+	size = sizeof ( *hdr ) + b.num_recs * sizeof ( *recs ) +
+		2 * nb * sizeof ( *buckets ) + b.len;
+	hdr = papi_calloc( 1, size );
+	if ( hdr == NULL )
+		goto build_fail;
+
+	hdr->magic = PAPI_CATALOG_MAGIC;
+	hdr->version = PAPI_CATALOG_VERSION;
+	hdr->size = ( unsigned int ) size;
+	hdr->num_records = b.num_recs;
+	hdr->num_buckets = nb;
+	hdr->strings = ( unsigned int ) ( size - b.len );
+	memcpy( hdr->key, key, sizeof ( hdr->key ) );
+
+	recs = ( hwi_catalog_rec_t * ) ( hdr + 1 );
+	buckets = ( unsigned int * ) ( recs + b.num_recs );
+	memcpy( recs, b.recs, b.num_recs * sizeof ( *recs ) );
+	memcpy( ( char * ) hdr + hdr->strings, b.strings, b.len );
+	for ( i = 0; i < 2 * nb; i++ )
+		buckets[i] = CATALOG_NO_REC;
+	/* insert backwards so a chain lists records in enumeration order; */
+	/* the name index only holds names that differ from the symbol    */
+	for ( i = b.num_recs; i-- > 0; ) {
+		symbol = _papi_hwi_strip_component_prefix( b.strings + recs[i].symbol );
+		key_name = b.strings + recs[i].name;
+		h = hash_name( symbol, nb );
+		recs[i].next = buckets[h];
+		buckets[h] = i;
+		if ( strcmp( symbol, key_name ) != 0 ) {
+			h = nb + hash_name( key_name, nb );
+			recs[i].next_name = buckets[h];
+			buckets[h] = i;
+		}
+	}
+	papi_free( b.recs );
+	papi_free( b.strings );
+
+	retval = catalog_attach( cat, hdr, size, key );
+	if ( retval != PAPI_OK ) {
+		papi_free( hdr );
+		papi_free( codes );
+		return retval;
+	}
+	/* the events are known to the component already, keep their codes */
+	if ( b.num_recs )
+		memcpy( cat->codes, codes, b.num_recs * sizeof ( int ) );
+	papi_free( codes );
+	cat->mapped = 0;
+	return PAPI_OK;
+
+  build_fail:
+	papi_free( b.recs );
+	papi_free( b.strings );
+	papi_free( codes );
+	return PAPI_ENOMEM;
+}
+
+/* Write a built image next to its final name and rename it into place */
+static void
+catalog_save( const catalog_t *cat, const char *path )
+{
+	char tmp[PATH_MAX + 16];
+	size_t done = 0;
+	ssize_t n;
+	int fd;
+
+	snprintf( tmp, sizeof ( tmp ), "%s.%d", path, ( int ) getpid(  ) );
+	fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if ( fd < 0 ) {
+		SUBDBG( "Cannot create %s: %s\n", tmp, strerror( errno ) );
+		return;
+	}
+	while ( done < cat->size ) {
+		n = write( fd, ( char * ) cat->hdr + done, cat->size - done );
+		if ( n <= 0 ) {
+			if ( n < 0 && errno == EINTR )
+				continue;
+			break;
+		}
+		done += ( size_t ) n;
+	}
+	if ( close( fd ) < 0 || done != cat->size || rename( tmp, path ) < 0 ) {
+		SUBDBG( "Cannot write %s\n", path );
+		unlink( tmp );
+	}
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_open
+ *  @brief Make the catalog of a component available, if there is one
+ *
+ *  @param cidx
+ *    an initialized component
+ *  @param build
+ *    build and save the catalog if there is no valid file; only done
+ *    when enumeration starts, since building walks every event
+ *
+ *  @retval PAPI_OK the catalog can be used
+ *  @retval PAPI_ECMP use the component instead
+ */
+int
+_papi_hwi_catalog_open( int cidx, int build )
+{
+	char key[PAPI_CATALOG_KEY_LEN];
+	char path[PATH_MAX];
+	const char *dir;
+	catalog_t *cat;
+	int retval;
+
+	if ( catalogs != NULL ) {
+		if ( catalogs[cidx].state == CATALOG_READY )
+			return PAPI_OK;
+		if ( catalogs[cidx].state == CATALOG_OFF ||
+		     ( catalogs[cidx].state == CATALOG_MISSING && !build ) )
+			return PAPI_ECMP;
+	}
+
+	dir = getenv( "PAPI_EVENT_CACHE" );
+	if ( dir == NULL || *dir == '\0' || _papi_hwd[cidx]->cmp_info.disabled ||
+	     _papi_hwd[cidx]->cmp_info.dynamic_events )
+		return PAPI_ECMP;
+
+	_papi_hwi_lock( CMPINIT_LOCK );
+
+	if ( catalogs == NULL ) {
+		catalogs = papi_calloc( ( size_t ) papi_num_components,
+					sizeof ( catalog_t ) );
+		if ( catalogs == NULL ) {
+			_papi_hwi_unlock( CMPINIT_LOCK );
+			return PAPI_ECMP;
+		}
+	}
+	cat = &catalogs[cidx];
+
+	catalog_key( cidx, key, sizeof ( key ) );
+	snprintf( path, sizeof ( path ), "%s/%s.events", dir,
+		  _papi_hwd[cidx]->cmp_info.name );
+
+	if ( cat->state == CATALOG_UNKNOWN ) {
+		cat->state = ( catalog_load( cat, path, key ) == PAPI_OK ) ?
+			CATALOG_READY : CATALOG_MISSING;
+	}
+	if ( cat->state == CATALOG_MISSING && build ) {
+		retval = catalog_build( cat, cidx, key );
+		if ( retval == PAPI_OK ) {
+			catalog_save( cat, path );
+			cat->state = CATALOG_READY;
+		} else {
+			cat->state = CATALOG_OFF;
+		}
+	}
+	retval = ( cat->state == CATALOG_READY ) ? PAPI_OK : PAPI_ECMP;
+
+	_papi_hwi_unlock( CMPINIT_LOCK );
+
+	return retval;
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_find
+ *  @brief Look up an event by name, without any component prefix
+ *
+ *  Both the symbol PAPI_get_event_info reports and the name the
+ *  component enumerated it under (e.g. with its PMU prefix) are found.
+ *
+ *  @returns its record, or PAPI_ENOEVNT
+ */
+int
+_papi_hwi_catalog_find( int cidx, const char *name )
+{
+	catalog_t *cat = &catalogs[cidx];
+	unsigned int nb = cat->hdr->num_buckets;
+	unsigned int h = hash_name( name, nb );
+	unsigned int i;
+
+	for ( i = cat->buckets[h]; i != CATALOG_NO_REC; i = cat->recs[i].next ) {
+		if ( strcmp( name, _papi_hwi_strip_component_prefix(
+				     cat->strings + cat->recs[i].symbol ) ) == 0 )
+			return ( int ) i;
+	}
+	for ( i = cat->buckets[nb + h]; i != CATALOG_NO_REC;
+	      i = cat->recs[i].next_name ) {
+		if ( strcmp( name, cat->strings + cat->recs[i].name ) == 0 )
+			return ( int ) i;
+	}
+	return PAPI_ENOEVNT;
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_next
+ *  @brief Step through the records the way the component enumerates
+ *
+ *  @param rec
+ *    current record, ignored for PAPI_ENUM_FIRST
+ *  @param modifier
+ *    PAPI_ENUM_FIRST, PAPI_ENUM_EVENTS or PAPI_NTV_ENUM_UMASKS
+ *
+ *  @returns the next record, PAPI_ENOEVNT at the end, or PAPI_ENOIMPL
+ *    for a modifier the catalog does not record
+ */
+int
+_papi_hwi_catalog_next( int cidx, int rec, int modifier )
+{
+	catalog_t *cat = &catalogs[cidx];
+	int n = ( int ) cat->hdr->num_records;
+	int event;
+
+	switch ( modifier ) {
+	case PAPI_ENUM_FIRST:
+		return ( n > 0 ) ? 0 : PAPI_ENOEVNT;
+	case PAPI_ENUM_EVENTS:
+		while ( ++rec < n ) {
+			if ( cat->recs[rec].parent < 0 )
+				return rec;
+		}
+		return PAPI_ENOEVNT;
+	case PAPI_NTV_ENUM_UMASKS:
+		event = ( cat->recs[rec].parent < 0 ) ? rec : cat->recs[rec].parent;
+		if ( rec + 1 < n && cat->recs[rec + 1].parent == event )
+			return rec + 1;
+		return PAPI_ENOEVNT;
+	default:
+		return PAPI_ENOIMPL;
+	}
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_name
+ *  @brief The name to give the component's ntv_name_to_code for a record
+ */
+const char *
+_papi_hwi_catalog_name( int cidx, int rec )
+{
+	catalog_t *cat = &catalogs[cidx];
+
+	return cat->strings + cat->recs[rec].name;
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_info
+ *  @brief Fill in the event info of a record as it was enumerated
+ */
+int
+_papi_hwi_catalog_info( int cidx, int rec, PAPI_event_info_t *info )
+{
+	catalog_t *cat = &catalogs[cidx];
+	hwi_catalog_rec_t *r = &cat->recs[rec];
+
+	memset( info, 0, sizeof ( *info ) );
+	strncpy( info->symbol, cat->strings + r->symbol, sizeof ( info->symbol ) - 1 );
+	strncpy( info->short_descr, cat->strings + r->short_descr,
+		 sizeof ( info->short_descr ) - 1 );
+	strncpy( info->long_descr, cat->strings + r->long_descr,
+		 sizeof ( info->long_descr ) - 1 );
+	strncpy( info->units, cat->strings + r->units, sizeof ( info->units ) - 1 );
+	strncpy( info->note, cat->strings + r->note, sizeof ( info->note ) - 1 );
+	info->component_index = cidx;
+	info->location = r->location;
+	info->data_type = r->data_type;
+	info->value_type = r->value_type;
+	info->timescope = r->timescope;
+	info->update_type = r->update_type;
+	info->update_freq = r->update_freq;
+
+	return PAPI_OK;
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_code
+ *  @brief The PAPI event code handed out for a record, 0 if none yet
+ */
+int
+_papi_hwi_catalog_code( int cidx, int rec )
+{
+	return catalogs[cidx].codes[rec];
+}
+
+void
+_papi_hwi_catalog_set_code( int cidx, int rec, int code )
+{
+	__sync_bool_compare_and_swap( &catalogs[cidx].codes[rec], 0, code );
+}
+
+void
+_papi_hwi_catalog_shutdown( void )
+{
+	int i;
+
+	if ( catalogs == NULL )
+		return;
+
+	for ( i = 0; i < papi_num_components; i++ ) {
+		if ( catalogs[i].hdr != NULL ) {
+			if ( catalogs[i].mapped )
+				munmap( catalogs[i].hdr, catalogs[i].size );
+			else
+				papi_free( catalogs[i].hdr );
+		}
+		papi_free( catalogs[i].codes );
+	}
+	papi_free( catalogs );
+	catalogs = NULL;
+}
@@ -0,0 +1,57 @@
+/**
+* @file    papi_catalog.h
+*
+* On-disk cache of the native events a component enumerates.
+*/
+
+#ifndef _PAPI_CATALOG
+#define _PAPI_CATALOG
+
+#define PAPI_CATALOG_MAGIC   0x43495041	/* "APIC" */
+#define PAPI_CATALOG_VERSION 1
+#define PAPI_CATALOG_KEY_LEN 1024
+
+/** header of a catalog file, followed by the records, the hash buckets
+ *  of the symbol index and of the name index, and the strings the
+ *  records point into
+ *	@internal */
+typedef struct hwi_catalog_header {
+   unsigned int magic;
+   unsigned int version;
+   unsigned int size;          /**< size of the whole file */
+   unsigned int num_records;
+   unsigned int num_buckets;   /**< per index */
+   unsigned int strings;       /**< offset of the string area */
+   char key[PAPI_CATALOG_KEY_LEN]; /**< kernel, CPU, library and component versions */
+} hwi_catalog_header_t;
+
+/** one enumerated event or umask; strings are offsets into the string area
+ *	@internal */
+typedef struct hwi_catalog_rec {
+   unsigned int name;          /**< name handed to the component's ntv_name_to_code */
+   unsigned int symbol;        /**< PAPI_event_info_t fields as enumerated */
+   unsigned int short_descr;
+   unsigned int long_descr;
+   unsigned int units;
+   unsigned int note;
+   int parent;                 /**< event record of an umask, -1 for an event */
+   unsigned int next;          /**< next record in the same symbol bucket */
+   unsigned int next_name;     /**< next record in the same name bucket */
+   int location;
+   int data_type;
+   int value_type;
+   int timescope;
+   int update_type;
+   int update_freq;
+} hwi_catalog_rec_t;
+
+int _papi_hwi_catalog_open( int cidx, int build );
+int _papi_hwi_catalog_find( int cidx, const char *name );
+int _papi_hwi_catalog_next( int cidx, int rec, int modifier );
+const char *_papi_hwi_catalog_name( int cidx, int rec );
+int _papi_hwi_catalog_info( int cidx, int rec, PAPI_event_info_t *info );
+int _papi_hwi_catalog_code( int cidx, int rec );
+void _papi_hwi_catalog_set_code( int cidx, int rec, int code );
+void _papi_hwi_catalog_shutdown( void );
+
+#endif /* _PAPI_CATALOG */
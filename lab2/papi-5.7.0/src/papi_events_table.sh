@@ -1,19 +1,216 @@
 #!/bin/sh
 #
-#	Transform the papi_events.csv file into a static table.
+#	Compile the papi_events.csv file into static tables.
 #
 #	tr "\r" "\n" |		# convert CR to LF
 #	tr -s "\n" |		# convert LFLF to LF
 #	tr "\"" "'" |		# convert " to '
-#	sed 's/^/"/' | \	# insert " at beginning of line
-#	sed 's/$/\\n\"/'	# insert LF" at end of line
+#	awk			# split the lines into hwi_preset_def_t entries
+#
+# Every PRESET (or EVENT) line becomes one papi_preset_defs entry, split
+# into fields the way papi_load_derived_events() splits them, with
+# DERIVED_INFIX formulas already converted to postfix.  Every CPU line
+# becomes one papi_preset_pmus entry naming the range of definitions that
+# follows its group of CPU lines.  papi_preset.c selects the ranges of the
+# running PMU at init and resolves each definition on first use.
 #
-# print "#define STATIC_PAPI_EVENTS_TABLE 1"
-echo "static char *papi_events_table ="
 cat $1 | \
 	tr "\r" "\n" |
 	tr -s "\n" |
 	tr "\"" "'" |
-	sed 's/^/"/' | \
-	sed 's/$/\\n\"/'
-echo ";"
+	awk -v terms=8 '	# terms is PAPI_EVENTS_IN_DERIVED_EVENT
+function trim(s) {
+	sub(/^[ \t]+/, "", s)
+	sub(/[ \t]+$/, "", s)
+	return s
+}
+# same as trim_note() in papi_preset.c
+function trim_note(s,   a, b) {
+	s = trim(s)
+	if (s ~ /^[[:punct:]]/) {
+		a = substr(s, 1, 1)
+		b = substr(s, length(s), 1)
+		if (a == b || (a == "(" && b == ")") || (a == "<" && b == ">") ||
+		    (a == "{" && b == "}") || (a == "[" && b == "]"))
+			s = substr(s, 2, length(s) - 2)
+	}
+	return s
+}
+function cstr(s) {
+	if (s == "")
+		return "NULL"
+	gsub(/\\/, "\\\\", s)
+	gsub(/"/, "\\\"", s)
+	return "\"" s "\""
+}
+function priority(c) {
+	if (c == "@") return -1
+	if (c == "+" || c == "-") return 1
+	if (c == "*" || c == "/" || c == "%") return 2
+	return 0
+}
+# same as infix_to_postfix() in papi_preset.c
+function infix_to_postfix(s,   out, stack, top, i, c) {
+	out = ""
+	top = 0
+	stack[0] = "#"
+	for (i = 1; i <= length(s); i++) {
+		c = substr(s, i, 1)
+		if (c == "(") {
+			stack[++top] = c
+		} else if (c == ")") {
+			if (substr(out, length(out), 1) != "|") out = out "|"
+			while (top > 0 && stack[top] != "(")
+				out = out stack[top--] "|"
+			top--
+		} else if (index("+-*/%^", c)) {
+			if (substr(out, length(out), 1) != "|") out = out "|"
+			while (priority(stack[top]) > priority(c))
+				out = out stack[top--] "|"
+			stack[++top] = c
+		} else {
+			out = out c
+		}
+	}
+	if (substr(out, length(out), 1) != "|") out = out "|"
+	while (top > 0)
+		out = out stack[top--] "|"
+	return out
+}
+function warn(msg) {
+	printf("papi_events_table.sh: line %d: %s -- ignoring\n", NR, msg) > "/dev/stderr"
+}
+# give the CPU lines of the current group the definitions that followed them
+function close_group(   i) {
+	for (i = group; i < npmus; i++)
+		pmu_count[i] = ndefs - pmu_first[i]
+	group = npmus
+	found = 0
+}
+BEGIN {
+	split("NOT_DERIVED DERIVED_ADD DERIVED_PS DERIVED_ADD_PS DERIVED_CMPD DERIVED_SUB DERIVED_POSTFIX DERIVED_INFIX", names, " ")
+	for (i in names)
+		derived_names[names[i]] = 1
+	ndefs = 0
+	npmus = 0
+	group = 0
+	found = 0
+}
+{
+	# strtok() skips empty fields
+	n = 0
+	nf = split($0, raw, ",")
+	for (i = 1; i <= nf; i++)
+		if (raw[i] != "")
+			tok[++n] = raw[i]
+	tok[n + 1] = ""
+
+	t = trim(tok[1])
+	if (t == "" || substr(t, 1, 1) == "#")
+		next
+
+	if (toupper(t) == "CPU") {
+		if (found)
+			close_group()
+		t = trim(tok[2])
+		if (t == "") {
+			warn("expected name after CPU token")
+			next
+		}
+		type = -1
+		q = trim(tok[3])
+		if (q != "") {
+			if (q !~ /^-?[0-9]+/) {
+				warn("CPU qualifier " q " is not a number")
+				next
+			}
+			type = q + 0
+		}
+		pmu_name[npmus] = t
+		pmu_type[npmus] = type
+		pmu_first[npmus] = ndefs
+		npmus++
+		next
+	}
+
+	if (toupper(t) != "PRESET" && toupper(t) != "EVENT") {
+		warn("unrecognized token " t)
+		next
+	}
+	# definitions before the first CPU line belong to no PMU
+	if (group == npmus)
+		next
+	found = 1
+
+	symbol = trim(tok[2])
+	if (symbol == "") {
+		warn("expected name after PRESET token")
+		next
+	}
+	derived = toupper(trim(tok[3]))
+	if (!(derived in derived_names)) {
+		warn("invalid derived type " derived " for " symbol)
+		next
+	}
+	k = 4
+	postfix = ""
+	if (derived == "DERIVED_POSTFIX" || derived == "DERIVED_INFIX") {
+		postfix = trim(tok[k++])
+		if (postfix == "") {
+			warn("expected operation string for " symbol)
+			next
+		}
+		if (derived == "DERIVED_INFIX") {
+			postfix = infix_to_postfix(postfix)
+			derived = "DERIVED_POSTFIX"
+		}
+	}
+
+	nterms = 0
+	list = ""
+	while (nterms < terms) {
+		t = trim(tok[k++])
+		if (t == "" || toupper(t) == "NOTE" || toupper(t) == "LDESC" || toupper(t) == "SDESC")
+			break
+		list = list cstr(t) ", "
+		nterms++
+	}
+	if (nterms == 0) {
+		warn("expected events for " symbol)
+		next
+	}
+	if (nterms == terms)
+		t = trim(tok[k++])
+
+	sdesc = ""
+	ldesc = ""
+	note = ""
+	while (t != "") {
+		v = trim_note(tok[k++])
+		if (v == "")
+			break
+		if (toupper(t) == "SDESC") sdesc = v
+		if (toupper(t) == "LDESC") ldesc = v
+		if (toupper(t) == "NOTE") note = v
+		t = trim(tok[k++])
+	}
+
+	defs[ndefs++] = sprintf("\t{%s, %s, %s, {%sNULL}, %s, %s, %s},",
+		cstr(symbol), derived, cstr(postfix), list, cstr(sdesc), cstr(ldesc), cstr(note))
+}
+END {
+	close_group()
+	print "/* Generated from papi_events.csv by papi_events_table.sh; do not edit. */"
+	print ""
+	print "static const hwi_preset_def_t papi_preset_defs[] = {"
+	for (i = 0; i < ndefs; i++)
+		print defs[i]
+	print "\t{NULL, 0, NULL, {NULL}, NULL, NULL, NULL}"
+	print "};"
+	print ""
+	print "static const hwi_preset_pmu_t papi_preset_pmus[] = {"
+	for (i = 0; i < npmus; i++)
+		printf("\t{%s, %d, %d, %d},\n", cstr(pmu_name[i]), pmu_type[i], pmu_first[i], pmu_count[i])
+	print "\t{NULL, -1, 0, 0}"
+	print "};"
+}'
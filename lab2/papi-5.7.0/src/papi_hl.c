@@ -17,6 +17,7 @@
 #include "papi_internal.h"
 #include "papi_memory.h"
 #include <string.h>
+#include <limits.h>
 
 /* high level papi functions*/
 
@@ -31,6 +32,9 @@
 #define HL_EPC		5
 #define HL_READ		6
 #define HL_ACCUM	7
+#define HL_REGION	8
+
+struct _HighLevelRegions;
 
 /** \internal 
  * This is stored per thread
@@ -45,6 +49,7 @@ typedef struct _HighLevelInfo
 	long long last_real_time;		/**< Previous value of real time */
 	long long last_proc_time;		/**< Previous value of processor time */
 	long long total_ins;			/**< Total instructions */
+	struct _HighLevelRegions *regions;	/**< Region table, see PAPI_hl_region_begin */
 } HighLevelInfo;
 
 int _hl_rate_calls( float *real_time, float *proc_time, int *events, 
@@ -824,7 +829,7 @@ PAPI_stop_counters( long long *values, int array_len )
 	}
 
 	if ( state->running > HL_START ) {
-		long long tmp_values[3];
+		long long tmp_values[PAPI_HL_REGION_EVENTS];
 		retval = PAPI_stop( state->EventSet, tmp_values );
 	}
 	
@@ -836,11 +841,549 @@ PAPI_stop_counters( long long *values, int array_len )
 	return retval;
 }
 
+/*
+ * Region markers
+ *
+ * Each thread owns a region table, an open addressed hash keyed by the
+ * name pointer, and a stack of open regions.  Only the owning thread
+ * writes either, so begin and end take no locks and call no allocator;
+ * the tables of all threads are chained together, outlive their threads,
+ * and are merged by name for PAPI_hl_region_read() and the report.
+ */
+
+#define HL_REGION_SLOTS		256		/**< regions per thread, a power of two */
+#define HL_REGION_DEPTH		64		/**< deepest nesting of open regions */
+#define HL_REGION_COLS		( PAPI_HL_REGION_EVENTS + 1 )
+#define HL_REGION_DEF_EVENTS	"PAPI_TOT_CYC,PAPI_TOT_INS"
+
+/** \internal
+ * One region as seen by one thread; column 0 is real time
+ */
+typedef struct _HighLevelRegion
+{
+	const char *name;				/**< name passed to begin, NULL if free */
+	long long count;				/**< completed visits */
+	long long total[HL_REGION_COLS];
+	long long min[HL_REGION_COLS];
+	long long max[HL_REGION_COLS];
+} HighLevelRegion;
+
+/** \internal
+ * An open region and the counts when it was entered
+ */
+typedef struct _HighLevelFrame
+{
+	HighLevelRegion *region;
+	long long start[HL_REGION_COLS];
+} HighLevelFrame;
+
+/** \internal
+ * Region state of one thread
+ */
+typedef struct _HighLevelRegions
+{
+	struct _HighLevelRegions *next;	/**< next thread, under HIGHLEVEL_LOCK */
+	int generation;					/**< _hl_region_generation when allocated */
+	int num_evts;					/**< events counted, columns 1 to num_evts */
+	EventSetInfo_t *ESI;			/**< cached so reads skip PAPI_read's checks */
+	hwd_context_t *context;
+	int depth;						/**< open regions on the stack */
+	HighLevelFrame stack[HL_REGION_DEPTH];
+	HighLevelRegion table[HL_REGION_SLOTS];
+} HighLevelRegions;
+
+static HighLevelRegions *_hl_regions = NULL;
+static int _hl_region_generation = 1;	/**< bumped by PAPI_shutdown */
+static int _hl_region_events[PAPI_HL_REGION_EVENTS];
+static int _hl_region_num_events = -1;	/**< -1 until the first thread resolves them */
+static int _hl_region_atexit = 0;
+#ifdef HAVE_THREAD_LOCAL_STORAGE
+static THREAD_LOCAL_STORAGE_KEYWORD HighLevelRegions *_hl_my_regions;
+static THREAD_LOCAL_STORAGE_KEYWORD int _hl_my_generation;
+#endif
+
+static void _hl_region_report( void );
+
+static void
+_hl_region_exit( void )
+{
+	/* Other threads may still be inside regions, so only report */
+	if ( init_level != PAPI_NOT_INITED )
+		_hl_region_report(  );
+}
+
+/** @internal
+ * Add the region events to an EventSet.  The first thread resolves
+ * PAPI_HL_REGION_EVENTS and keeps the events it could add; every later
+ * thread counts the same ones so their tables can be merged.
+ * Called with HIGHLEVEL_LOCK held.
+ */
+static int
+_hl_region_add_events( int EventSet )
+{
+	char *list, *name, *save = NULL;
+	int code;
+
+	if ( _hl_region_num_events == 0 )
+		return PAPI_OK;
+	if ( _hl_region_num_events > 0 )
+		return PAPI_add_events( EventSet, _hl_region_events,
+								_hl_region_num_events );
+
+	name = getenv( "PAPI_HL_REGION_EVENTS" );
+	list = papi_strdup( name ? name : HL_REGION_DEF_EVENTS );
+	if ( list == NULL )
+		return PAPI_ENOMEM;
+
+	_hl_region_num_events = 0;
+	for ( name = strtok_r( list, ",", &save );
+		  name != NULL && _hl_region_num_events < PAPI_HL_REGION_EVENTS;
+		  name = strtok_r( NULL, ",", &save ) ) {
+		if ( PAPI_event_name_to_code( name, &code ) != PAPI_OK ||
+			 PAPI_add_event( EventSet, code ) != PAPI_OK ) {
+			SUBDBG( "Region event %s not available, skipping\n", name );
+			continue;
+		}
+		_hl_region_events[_hl_region_num_events++] = code;
+	}
+	papi_free( list );
+	return PAPI_OK;
+}
+
+/** @internal
+ * Find or create the region state of the calling thread.  The first
+ * call starts the thread's high level EventSet on the region events.
+ */
+static int
+_hl_region_setup( HighLevelRegions ** outgoing )
+{
+	HighLevelInfo *state = NULL;
+	HighLevelRegions *regions;
+	int retval;
+
+	if ( ( retval = _internal_check_state( &state ) ) != PAPI_OK )
+		return ( retval );
+
+	regions = state->regions;
+	if ( regions == NULL || regions->generation != _hl_region_generation ) {
+		/* The counters already belong to another high level call */
+		if ( state->running != HL_STOP )
+			return ( PAPI_EINVAL );
+
+		regions = papi_calloc( 1, sizeof ( HighLevelRegions ) );
+		if ( regions == NULL )
+			return ( PAPI_ENOMEM );
+
+		_papi_hwi_lock( HIGHLEVEL_LOCK );
+		retval = _hl_region_add_events( state->EventSet );
+		regions->num_evts = _hl_region_num_events;
+		_papi_hwi_unlock( HIGHLEVEL_LOCK );
+
+		if ( retval == PAPI_OK && regions->num_evts > 0 )
+			retval = PAPI_start( state->EventSet );
+		if ( retval != PAPI_OK ) {
+			PAPI_cleanup_eventset( state->EventSet );
+			papi_free( regions );
+			return ( retval );
+		}
+
+		if ( regions->num_evts > 0 ) {
+			regions->ESI = _papi_hwi_lookup_EventSet( state->EventSet );
+			regions->context = _papi_hwi_get_context( regions->ESI, NULL );
+		}
+		state->num_evts = ( short ) regions->num_evts;
+		state->running = HL_REGION;
+		state->regions = regions;
+
+		_papi_hwi_lock( HIGHLEVEL_LOCK );
+		regions->generation = _hl_region_generation;
+		regions->next = _hl_regions;
+		_hl_regions = regions;
+		if ( !_hl_region_atexit ) {
+			atexit( _hl_region_exit );
+			_hl_region_atexit = 1;
+		}
+		_papi_hwi_unlock( HIGHLEVEL_LOCK );
+	}
+
+#ifdef HAVE_THREAD_LOCAL_STORAGE
+	_hl_my_regions = regions;
+	_hl_my_generation = regions->generation;
+#endif
+	*outgoing = regions;
+	return ( PAPI_OK );
+}
+
+inline_static int
+_hl_region_state( HighLevelRegions ** regions )
+{
+#ifdef HAVE_THREAD_LOCAL_STORAGE
+	if ( _hl_my_generation == _hl_region_generation ) {
+		*regions = _hl_my_regions;
+		return ( PAPI_OK );
+	}
+#endif
+	return ( _hl_region_setup( regions ) );
+}
+
+inline_static int
+_hl_region_counts( HighLevelRegions * regions, long long *values )
+{
+	values[0] = PAPI_get_real_nsec(  );
+	if ( regions->num_evts == 0 )
+		return ( PAPI_OK );
+	/* PAPI_stop_counters ends region counting */
+	if ( !( regions->ESI->state & PAPI_RUNNING ) )
+		return ( PAPI_ENOTRUN );
+	return ( _papi_hwi_read( regions->context, regions->ESI, values + 1 ) );
+}
+
+inline_static HighLevelRegion *
+_hl_region_lookup( HighLevelRegions * regions, const char *name )
+{
+	HighLevelRegion *region;
+	unsigned int hash, i, j;
+
+	hash = ( unsigned int ) ( ( unsigned long ) name >> 3 ) * 2654435761U;
+	for ( i = 0; i < HL_REGION_SLOTS; i++ ) {
+		region = &regions->table[( hash + i ) & ( HL_REGION_SLOTS - 1 )];
+		if ( region->name == name )
+			return ( region );
+		if ( region->name == NULL ) {
+			for ( j = 0; j < HL_REGION_COLS; j++ )
+				region->min[j] = LLONG_MAX;
+			/* a concurrent PAPI_hl_region_read may see the slot now */
+			__sync_synchronize(  );
+			region->name = name;
+			return ( region );
+		}
+	}
+	return ( NULL );
+}
+
+/** @class PAPI_hl_region_begin
+ *	@brief Start attributing counts to a named region.
+ *
+ *	@par C Interface:
+ *	\#include <papi.h> @n
+ *	int PAPI_hl_region_begin( const char *name );
+ *
+ * @param *name
+ *		name of the region; the string must stay valid until the report
+ *
+ *	@retval PAPI_EINVAL
+ *		The name is NULL, or the counters were already started by another
+ *		high level call.
+ *	@retval PAPI_ENOMEM
+ *		Regions are nested too deep, or the thread has too many regions.
+ *	@retval PAPI_ENOTRUN
+ *		The counters were stopped with PAPI_stop_counters().
+ *
+ * The first call in a thread starts the thread's high level counters on
+ * the events listed in the PAPI_HL_REGION_EVENTS environment variable,
+ * separated by commas (PAPI_TOT_CYC and PAPI_TOT_INS by default); events
+ * that cannot be added are skipped.  Every region then reports real time
+ * in ns followed by those events.
+ *
+ * Regions may nest; a region's counts include those of the regions it
+ * encloses.  Each thread keeps its own region table, keyed by the name
+ * pointer, so neither PAPI_hl_region_begin() nor PAPI_hl_region_end()
+ * takes a lock, and pairs can be left in production code.
+ *
+ * At exit, or at PAPI_shutdown(), the regions of all threads are merged
+ * by name and a report of the visits and the total, minimum, mean and
+ * maximum of every column is written to the file named by
+ * PAPI_HL_REGION_REPORT, or to stderr.
+ *
+ *	@code
+if ( PAPI_hl_region_begin( "solve" ) != PAPI_OK )
+	handle_error( 1 );
+solve(  );
+if ( PAPI_hl_region_end( "solve" ) != PAPI_OK )
+	handle_error( 1 );
+ *	@endcode
+ *
+ * @see PAPI_hl_region_end()
+ * @see PAPI_hl_region_read()
+ */
+int
+PAPI_hl_region_begin( const char *name )
+{
+	HighLevelRegions *regions;
+	HighLevelFrame *frame;
+	int retval;
+
+	if ( name == NULL )
+		return ( PAPI_EINVAL );
+
+	if ( ( retval = _hl_region_state( &regions ) ) != PAPI_OK )
+		return ( retval );
+
+	if ( regions->depth == HL_REGION_DEPTH )
+		return ( PAPI_ENOMEM );
+
+	frame = &regions->stack[regions->depth];
+	if ( ( frame->region = _hl_region_lookup( regions, name ) ) == NULL )
+		return ( PAPI_ENOMEM );
+
+	if ( ( retval = _hl_region_counts( regions, frame->start ) ) != PAPI_OK )
+		return ( retval );
+
+	regions->depth++;
+	return ( PAPI_OK );
+}
+
+/** @class PAPI_hl_region_end
+ *	@brief Stop attributing counts to the innermost region.
+ *
+ *	@par C Interface:
+ *	\#include <papi.h> @n
+ *	int PAPI_hl_region_end( const char *name );
+ *
+ * @param *name
+ *		name of the region, as passed to PAPI_hl_region_begin()
+ *
+ *	@retval PAPI_EINVAL
+ *		The name is NULL, no region is open, or the innermost open region
+ *		has another name.
+ *	@retval PAPI_ENOTRUN
+ *		The counters were stopped with PAPI_stop_counters(); the region
+ *		is closed without recording the visit.
+ *
+ * PAPI_hl_region_end() closes the innermost open region of the calling
+ * thread and adds the counts since the matching PAPI_hl_region_begin()
+ * to the region's statistics.
+ *
+ * @see PAPI_hl_region_begin()
+ * @see PAPI_hl_region_read()
+ */
+int
+PAPI_hl_region_end( const char *name )
+{
+	HighLevelRegions *regions;
+	HighLevelRegion *region;
+	HighLevelFrame *frame;
+	long long now[HL_REGION_COLS], delta;
+	int retval, i;
+
+	if ( name == NULL )
+		return ( PAPI_EINVAL );
+
+	if ( ( retval = _hl_region_state( &regions ) ) != PAPI_OK )
+		return ( retval );
+
+	if ( regions->depth == 0 )
+		return ( PAPI_EINVAL );
+
+	frame = &regions->stack[regions->depth - 1];
+	region = frame->region;
+	if ( region->name != name && strcmp( region->name, name ) != 0 )
+		return ( PAPI_EINVAL );
+
+	retval = _hl_region_counts( regions, now );
+	regions->depth--;
+	if ( retval != PAPI_OK )
+		return ( retval );
+
+	for ( i = 0; i <= regions->num_evts; i++ ) {
+		delta = now[i] - frame->start[i];
+		region->total[i] += delta;
+		if ( delta < region->min[i] )
+			region->min[i] = delta;
+		if ( delta > region->max[i] )
+			region->max[i] = delta;
+	}
+	region->count++;
+
+	return ( PAPI_OK );
+}
+
+/** @internal
+ * Merge the visits to one region name over all threads.
+ * Called with HIGHLEVEL_LOCK held.
+ */
+static void
+_hl_region_merge( const char *name, PAPI_hl_region_info_t * info )
+{
+	HighLevelRegions *regions;
+	HighLevelRegion *region;
+	int i, j, found;
+
+	memset( info, 0, sizeof ( *info ) );
+	strncpy( info->name, name, sizeof ( info->name ) - 1 );
+	info->num_events = _hl_region_num_events < 0 ? 0 : _hl_region_num_events;
+	memcpy( info->events, _hl_region_events,
+			( size_t ) info->num_events * sizeof ( int ) );
+
+	for ( regions = _hl_regions; regions != NULL; regions = regions->next ) {
+		found = 0;
+		for ( i = 0; i < HL_REGION_SLOTS; i++ ) {
+			region = &regions->table[i];
+			if ( region->name == NULL || region->count == 0 ||
+				 strcmp( region->name, name ) != 0 )
+				continue;
+			for ( j = 0; j <= info->num_events; j++ ) {
+				info->total[j] += region->total[j];
+				if ( info->count == 0 || region->min[j] < info->min[j] )
+					info->min[j] = region->min[j];
+				if ( info->count == 0 || region->max[j] > info->max[j] )
+					info->max[j] = region->max[j];
+			}
+			info->count += region->count;
+			found = 1;
+		}
+		info->threads += found;
+	}
+
+	for ( j = 0; j <= info->num_events && info->count > 0; j++ )
+		info->mean[j] = ( double ) info->total[j] / ( double ) info->count;
+}
+
+/** @class PAPI_hl_region_read
+ *	@brief Get the statistics of a region, merged over all threads.
+ *
+ *	@par C Interface:
+ *	\#include <papi.h> @n
+ *	int PAPI_hl_region_read( const char *name, PAPI_hl_region_info_t *info );
+ *
+ * @param *name
+ *		name of the region
+ * @param *info
+ *		filled with the visits and statistics of the region
+ *
+ *	@retval PAPI_EINVAL
+ *		One or more of the arguments is NULL.
+ *	@retval PAPI_ENOEVNT
+ *		No thread has completed a region of that name.
+ *
+ * Column 0 of the statistics is real time in ns; columns 1 to
+ * info->num_events hold the events in info->events.  Visits still open
+ * are not included.
+ *
+ * @see PAPI_hl_region_begin()
+ * @see PAPI_hl_region_end()
+ */
+int
+PAPI_hl_region_read( const char *name, PAPI_hl_region_info_t * info )
+{
+	if ( name == NULL || info == NULL )
+		return ( PAPI_EINVAL );
+
+	_papi_hwi_lock( HIGHLEVEL_LOCK );
+	_hl_region_merge( name, info );
+	_papi_hwi_unlock( HIGHLEVEL_LOCK );
+
+	return ( info->count > 0 ? PAPI_OK : PAPI_ENOEVNT );
+}
+
+/** @internal
+ * Write the merged statistics of every region
+ */
+static void
+_hl_region_report( void )
+{
+	PAPI_hl_region_info_t info;
+	HighLevelRegions *regions, *other;
+	HighLevelRegion *region;
+	char event_name[PAPI_MAX_STR_LEN];
+	const char *path;
+	FILE *fp;
+	int i, j, k, seen, threads = 0;
+
+	_papi_hwi_lock( HIGHLEVEL_LOCK );
+	if ( _hl_regions == NULL ) {
+		_papi_hwi_unlock( HIGHLEVEL_LOCK );
+		return;
+	}
+
+	path = getenv( "PAPI_HL_REGION_REPORT" );
+	fp = path ? fopen( path, "w" ) : stderr;
+	if ( fp == NULL ) {
+		PAPIERROR( "Cannot write the region report to %s", path );
+		_papi_hwi_unlock( HIGHLEVEL_LOCK );
+		return;
+	}
+
+	for ( regions = _hl_regions; regions != NULL; regions = regions->next )
+		threads++;
+	fprintf( fp, "PAPI region report: pid %d, %d threads\n",
+			 ( int ) getpid(  ), threads );
+
+	/* Report each name once, the first time a thread shows it */
+	for ( regions = _hl_regions; regions != NULL; regions = regions->next ) {
+		for ( i = 0; i < HL_REGION_SLOTS; i++ ) {
+			region = &regions->table[i];
+			if ( region->name == NULL || region->count == 0 )
+				continue;
+
+			seen = 0;
+			for ( other = _hl_regions; other != regions && !seen;
+				  other = other->next ) {
+				for ( k = 0; k < HL_REGION_SLOTS && !seen; k++ )
+					seen = other->table[k].name != NULL &&
+						other->table[k].count > 0 &&
+						strcmp( other->table[k].name, region->name ) == 0;
+			}
+			for ( k = 0; k < i && !seen; k++ )
+				seen = regions->table[k].name != NULL &&
+					regions->table[k].count > 0 &&
+					strcmp( regions->table[k].name, region->name ) == 0;
+			if ( seen )
+				continue;
+
+			_hl_region_merge( region->name, &info );
+			fprintf( fp, "\nRegion %s: %lld visits, %d threads\n",
+					 info.name, info.count, info.threads );
+			fprintf( fp, "  %-24s %16s %16s %16s %16s\n", "",
+					 "total", "min", "mean", "max" );
+			for ( j = 0; j <= info.num_events; j++ ) {
+				if ( j == 0 )
+					strcpy( event_name, "real time (ns)" );
+				else if ( PAPI_event_code_to_name( info.events[j - 1],
+												   event_name ) != PAPI_OK )
+					sprintf( event_name, "%#x", info.events[j - 1] );
+				fprintf( fp, "  %-24s %16lld %16lld %16.0f %16lld\n",
+						 event_name, info.total[j], info.min[j],
+						 info.mean[j], info.max[j] );
+			}
+		}
+	}
+
+	if ( fp == stderr )
+		fflush( fp );
+	else
+		fclose( fp );
+	_papi_hwi_unlock( HIGHLEVEL_LOCK );
+}
+
+/** @internal
+ * Report the regions and drop every thread's table
+ */
+static void
+_hl_region_shutdown( void )
+{
+	HighLevelRegions *regions, *next;
+
+	_hl_region_report(  );
+
+	_papi_hwi_lock( HIGHLEVEL_LOCK );
+	for ( regions = _hl_regions; regions != NULL; regions = next ) {
+		next = regions->next;
+		papi_free( regions );
+	}
+	_hl_regions = NULL;
+	_hl_region_num_events = -1;
+	_hl_region_generation++;
+	_papi_hwi_unlock( HIGHLEVEL_LOCK );
+}
+
 void
 _papi_hwi_shutdown_highlevel(  )
 {
 	HighLevelInfo *state = NULL;
 
+	_hl_region_shutdown(  );
+
 	if ( PAPI_get_thr_specific( PAPI_HIGH_LEVEL_TLS, ( void ** ) &state ) ==
 		 PAPI_OK ) {
 		if ( state )
@@ -41,6 +41,7 @@
 #include "sw_multiplex.h"
 #include "extras.h"
 #include "papi_preset.h"
+#include "papi_catalog.h"
 #include "cpus.h"
 
 #include "papi_common_strings.h"
@@ -65,11 +66,17 @@ int user_defined_events_count = 0;
 
 #define NATIVE_EVENT_CHUNKSIZE 1024
 
+// component_event of a code handed out from a catalog (papi_catalog.c)
+// before the component has been asked for it; evt_name is then the name
+// that binds it
+#define NATIVE_EVENT_UNRESOLVED -1
+
 struct native_event_info {
   int cidx;
   int component_event;
   int ntv_idx;
   char *evt_name;
+  int cat_rec;          // catalog record this code was enumerated from, or -1
 };
 
 
@@ -78,6 +85,8 @@ static struct native_event_info *_papi_native_events=NULL;
 static int num_native_events=0;
 static int num_native_chunks=0;
 
+static int resolve_native_event(int event_index);
+
 char **_papi_errlist= NULL;
 static int num_error_chunks = 0;
 
@@ -156,6 +165,10 @@ _papi_hwi_get_ntv_idx (unsigned int papi_evt_code) {
 		return PAPI_ENOEVNT;
 	}
 
+	if (_papi_native_events[event_index].component_event == NATIVE_EVENT_UNRESOLVED) {
+		resolve_native_event(event_index);
+	}
+
 	result=_papi_native_events[event_index].ntv_idx;
 
 	INTDBG("EXIT: result: %d\n", result);
@@ -310,8 +323,9 @@ const char *_papi_hwi_strip_component_prefix(const char *event_name)
 }
 
 /* find the papi event code (4000xxx) associated with the specified component, native event, and event name */
+/* a code handed out from a catalog under this name is bound to the native event here */
 static int
-_papi_hwi_find_native_event(int cidx, int event, const char *event_name) {
+_papi_hwi_find_native_event(int cidx, int event, int ntv_idx, const char *event_name) {
   INTDBG("ENTER: cidx: %x, event: %#x, event_name: %s\n", cidx, event, event_name);
 
   int i;
@@ -328,6 +342,15 @@ _papi_hwi_find_native_event(int cidx, int event, const char *event_name) {
   		continue;
   	}
 
+  	if ((_papi_native_events[i].cidx==cidx) &&
+	(_papi_native_events[i].component_event==NATIVE_EVENT_UNRESOLVED) &&
+	(strcmp(event_name, _papi_native_events[i].evt_name) == 0)) {
+		_papi_native_events[i].ntv_idx=ntv_idx;
+		_papi_native_events[i].component_event=event;
+		INTDBG("EXIT: bound catalog event: %#x to component_event: %#x\n", i|PAPI_NATIVE_MASK, event);
+		return i|PAPI_NATIVE_MASK;
+  	}
+
   	// is this entry for the correct component and event code
   	if ((_papi_native_events[i].cidx==cidx) &&
 	(_papi_native_events[i].component_event==event)) {
@@ -371,6 +394,7 @@ _papi_hwi_add_native_event(int cidx, int ntv_event, int ntv_idx, const char *eve
   } else {
 	  _papi_native_events[num_native_events].evt_name=NULL;
   }
+  _papi_native_events[num_native_events].cat_rec=-1;
   new_native_event=num_native_events|PAPI_NATIVE_MASK;
 
   num_native_events++;
@@ -507,6 +531,7 @@ _papi_hwi_init_errors(void) {
 	/* 23 PAPI_ECOUNT */	_papi_hwi_add_error("Too many events or attributes");
 	/* 24 PAPI_ECOMBO */	_papi_hwi_add_error("Bad combination of features");
 	/* 25 PAPI_ECMP_DISABLED */_papi_hwi_add_error("Component containing event is disabled");
+	/* 26 PAPI_EDELAY_INIT */_papi_hwi_add_error("Delayed initialization component");
 }
 
 int
@@ -566,7 +591,7 @@ _papi_hwi_native_to_eventcode(int cidx, int event_code, int ntv_idx, const char
 	  return result;
   }
 
-  result=_papi_hwi_find_native_event(cidx, event_code, event_name);
+  result=_papi_hwi_find_native_event(cidx, event_code, ntv_idx, event_name);
   if (result==PAPI_ENOEVNT) {
      // Need to create one
      result=_papi_hwi_add_native_event(cidx, event_code, ntv_idx, event_name);
@@ -590,6 +615,14 @@ _papi_hwi_eventcode_to_native(int event_code) {
     return PAPI_ENOEVNT;
   }
 
+  if (_papi_native_events[event_index].component_event == NATIVE_EVENT_UNRESOLVED) {
+     result=resolve_native_event(event_index);
+     if (result != PAPI_OK) {
+        INTDBG("EXIT: unresolved catalog event, result: %d\n", result);
+        return result;
+     }
+  }
+
   result=_papi_native_events[event_index].component_event;
 
   INTDBG("EXIT: result: %#x\n", result);
@@ -597,6 +630,142 @@ _papi_hwi_eventcode_to_native(int event_code) {
 
 }
 
+/* Bind a code handed out from a catalog to the component's own event,
+   by giving the component the name the catalog recorded.  Components
+   that allocate papi codes themselves come back through
+   _papi_hwi_native_to_eventcode, which binds the entry by name; for the
+   others the returned native code is filled in here. */
+static int
+resolve_native_event(int event_index) {
+  INTDBG("ENTER: event_index: %d\n", event_index);
+
+  unsigned int saved_code = papi_event_code;
+  int saved_changed = papi_event_code_changed;
+  unsigned int ntv_code = 0;
+  int cidx = _papi_native_events[event_index].cidx;
+  int other, retval;
+
+  // the component may grow the table, so only index it from here on
+  _papi_hwi_set_papi_event_code(-1, -1);
+  retval = _papi_hwd[cidx]->ntv_name_to_code(_papi_native_events[event_index].evt_name, &ntv_code);
+
+  if (retval == PAPI_OK &&
+      _papi_native_events[event_index].component_event == NATIVE_EVENT_UNRESOLVED) {
+     other = (int) (papi_event_code & PAPI_NATIVE_AND_MASK);
+     if (papi_event_code_changed > 0 && other != event_index && other < num_native_events) {
+        // known to the component under another code already
+        _papi_native_events[event_index].ntv_idx=_papi_native_events[other].ntv_idx;
+     } else {
+        _papi_native_events[event_index].ntv_idx=-1;
+     }
+     _papi_native_events[event_index].component_event=(int) ntv_code;
+  }
+
+  _papi_hwi_free_papi_event_string();
+  papi_event_code = saved_code;
+  papi_event_code_changed = saved_changed;
+
+  if (retval != PAPI_OK) {
+     INTDBG("EXIT: %s not known to component %d\n", _papi_native_events[event_index].evt_name, cidx);
+     return PAPI_ENOEVNT;
+  }
+
+  INTDBG("EXIT: component_event: %#x\n", _papi_native_events[event_index].component_event);
+  return PAPI_OK;
+}
+
+/* The catalog record a native event code was enumerated from, or -1 */
+static int
+native_catalog_rec(unsigned int event_code, int *cidx) {
+  int event_index = event_code & PAPI_NATIVE_AND_MASK;
+
+  if (!IS_NATIVE(event_code) || (event_index >= num_native_events) ||
+      (_papi_native_events[event_index].cat_rec < 0)) {
+     return -1;
+  }
+  *cidx = _papi_native_events[event_index].cidx;
+  return _papi_native_events[event_index].cat_rec;
+}
+
+/* The papi event code for a catalog record, created unresolved if needed */
+static int
+catalog_eventcode(int cidx, int rec) {
+  INTDBG("ENTER: cidx: %d, rec: %d\n", cidx, rec);
+
+  const char *name;
+  int code, i;
+
+  code = _papi_hwi_catalog_code(cidx, rec);
+  if (code == 0) {
+     name = _papi_hwi_catalog_name(cidx, rec);
+     code = PAPI_ENOEVNT;
+     // reuse the code of an event the component already reported
+     for (i = 0; i < num_native_events; i++) {
+        if ((_papi_native_events[i].cidx == cidx) &&
+            (_papi_native_events[i].evt_name != NULL) &&
+            (strcmp(name, _papi_native_events[i].evt_name) == 0)) {
+           code = i | PAPI_NATIVE_MASK;
+           break;
+        }
+     }
+     if (code == PAPI_ENOEVNT) {
+        code = _papi_hwi_add_native_event(cidx, NATIVE_EVENT_UNRESOLVED, -1, name);
+        if (code < 0) {
+           return code;
+        }
+     }
+     _papi_hwi_catalog_set_code(cidx, rec, code);
+     code = _papi_hwi_catalog_code(cidx, rec);
+  }
+  _papi_native_events[code & PAPI_NATIVE_AND_MASK].cat_rec = rec;
+
+  INTDBG("EXIT: code: %#x\n", code);
+  return code;
+}
+
+/** @internal
+ *  @class _papi_hwi_catalog_enum
+ *  @brief The native part of PAPI_enum_cmp_event, served from a catalog
+ *
+ *  @retval PAPI_OK *EventCode is the next event
+ *  @retval PAPI_ENOEVNT no more events
+ *  @retval PAPI_ECMP no catalog for this component or modifier, ask the component
+ */
+int
+_papi_hwi_catalog_enum(int cidx, int *EventCode, int modifier) {
+  INTDBG("ENTER: cidx: %d, EventCode: %#x, modifier: %d\n", cidx, *EventCode, modifier);
+
+  int rec = -1, code, ecidx;
+
+  if (_papi_hwi_catalog_open(cidx, modifier == PAPI_ENUM_FIRST) != PAPI_OK) {
+     return PAPI_ECMP;
+  }
+
+  if (modifier != PAPI_ENUM_FIRST) {
+     rec = native_catalog_rec((unsigned int) *EventCode, &ecidx);
+     if (rec < 0 || ecidx != cidx) {
+        return PAPI_ECMP;
+     }
+  }
+
+  rec = _papi_hwi_catalog_next(cidx, rec, modifier);
+  if (rec == PAPI_ENOIMPL) {
+     return PAPI_ECMP;
+  }
+  if (rec < 0) {
+     return PAPI_ENOEVNT;
+  }
+
+  code = catalog_eventcode(cidx, rec);
+  if (code < 0) {
+     return code;
+  }
+  *EventCode = code;
+
+  INTDBG("EXIT: *EventCode: %#x\n", *EventCode);
+  return PAPI_OK;
+}
+
 
 /*********************/
 /* Utility functions */
@@ -803,7 +972,8 @@ _papi_hwi_assign_eventset( EventSetInfo_t *ESI, int cidx )
 
    ESI->profile.prof = ( PAPI_sprofil_t ** )
 		papi_malloc( ( sizeof ( PAPI_sprofil_t * ) * ( size_t ) max_counters +
-					   ( size_t ) max_counters * sizeof ( int ) * 4 ) );
+					   sizeof ( ProfileRegionTable_t * ) * ( size_t ) max_counters +
+					   ( size_t ) max_counters * sizeof ( int ) * 5 ) );
 
    /* If any of these allocations failed, free things up and fail */
 
@@ -841,6 +1011,8 @@ _papi_hwi_assign_eventset( EventSetInfo_t *ESI, int cidx )
    /* Carve up the profile block into separate arrays */
    ptr = ( char * ) ESI->profile.prof +
 		( sizeof ( PAPI_sprofil_t * ) * max_counters );
+   ESI->profile.regions = ( ProfileRegionTable_t ** ) ptr;
+   ptr += sizeof ( ProfileRegionTable_t * ) * max_counters;
    ESI->profile.count = ( int * ) ptr;
    ptr += sizeof ( int ) * max_counters;
    ESI->profile.threshold = ( int * ) ptr;
@@ -848,6 +1020,8 @@ _papi_hwi_assign_eventset( EventSetInfo_t *ESI, int cidx )
    ESI->profile.EventIndex = ( int * ) ptr;
    ptr += sizeof ( int ) * max_counters;
    ESI->profile.EventCode = ( int * ) ptr;
+   ptr += sizeof ( int ) * max_counters;
+   ESI->profile.owned = ( int * ) ptr;
 
    /* initialize_EventInfoArray */
 
@@ -891,6 +1065,11 @@ _papi_hwi_assign_eventset( EventSetInfo_t *ESI, int cidx )
 void
 _papi_hwi_free_EventSet( EventSetInfo_t * ESI )
 {
+	/* Sets freed without PAPI_cleanup_eventset, as at shutdown, */
+	/* still give the component its chance to free what it holds */
+	if ( !_papi_hwi_invalid_cmp( ESI->CmpIdx ) && ESI->ctl_state )
+		_papi_hwd[ESI->CmpIdx]->cleanup_eventset( ESI->ctl_state );
+
 	_papi_hwi_cleanup_eventset( ESI );
 
 #ifdef DEBUG
@@ -1387,6 +1566,7 @@ _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode )
 	  }
 
 	  /* count the number of native events in this preset */
+	  _papi_hwi_resolve_preset( preset_index );
 	  count = ( int ) _papi_hwi_presets[preset_index].count;
 
 	  /* Check if event exists */
@@ -1698,22 +1878,13 @@ _papi_hwi_remove_event( EventSetInfo_t * ESI, int EventCode )
 	return ( PAPI_OK );
 }
 
-int
-_papi_hwi_read( hwd_context_t * context, EventSetInfo_t * ESI,
-				long long *values )
+/* Turn the native counts a component returned into the values of the */
+/* events the user added, in the order they were added.                */
+void
+_papi_hwi_map_counts( EventSetInfo_t * ESI, long long *dp, long long *values )
 {
-	INTDBG("ENTER: context: %p, ESI: %p, values: %p\n", context, ESI, values);
-	int retval;
-	long long *dp = NULL;
 	int i, index;
 
-	retval = _papi_hwd[ESI->CmpIdx]->read( context, ESI->ctl_state,
-					       &dp, ESI->state );
-	if ( retval != PAPI_OK ) {
-		INTDBG("EXIT: retval: %d\n", retval);
-	   return retval;
-	}
-
 	/* This routine distributes hardware counters to software counters in the
 	   order that they were added. Note that the higher level
 	   EventInfoArray[i] entries may not be contiguous because the user
@@ -1746,6 +1917,24 @@ _papi_hwi_read( hwd_context_t * context, EventSetInfo_t * ESI,
 #endif
 		}
 	}
+}
+
+int
+_papi_hwi_read( hwd_context_t * context, EventSetInfo_t * ESI,
+				long long *values )
+{
+	INTDBG("ENTER: context: %p, ESI: %p, values: %p\n", context, ESI, values);
+	int retval;
+	long long *dp = NULL;
+
+	retval = _papi_hwd[ESI->CmpIdx]->read( context, ESI->ctl_state,
+					       &dp, ESI->state );
+	if ( retval != PAPI_OK ) {
+		INTDBG("EXIT: retval: %d\n", retval);
+	   return retval;
+	}
+
+	_papi_hwi_map_counts( ESI, dp, values );
 
 	INTDBG("EXIT: PAPI_OK\n");
 	return PAPI_OK;
@@ -1839,8 +2028,14 @@ _papi_hwi_cleanup_eventset( EventSetInfo_t * ESI )
    if ( ESI->overflow.deadline )
       papi_free( ESI->overflow.deadline );
 
-   if ( ESI->profile.prof )
+   if ( ESI->profile.prof ) {
+      for ( i = 0; i < ESI->profile.event_counter; i++ ) {
+         _papi_hwi_free_profile_regions( ESI->profile.regions[i] );
+         if ( ESI->profile.owned[i] )
+            papi_free( ESI->profile.prof[i] );
+      }
       papi_free( ESI->profile.prof );
+   }
 
    ESI->ctl_state = NULL;
    ESI->sw_stop = NULL;
@@ -1857,6 +2052,7 @@ _papi_hwi_cleanup_eventset( EventSetInfo_t * ESI )
    memset( &ESI->cpu, 0x0, sizeof(EventSetCpuInfo_t) );
    memset( &ESI->profile, 0x0, sizeof(EventSetProfileInfo_t) );
    memset( &ESI->inherit, 0x0, sizeof(EventSetInheritInfo_t) );
+   memset( &ESI->refresh, 0x0, sizeof(EventSetRefreshInfo_t) );
 
    ESI->CpuInfo = NULL;
 
@@ -1915,6 +2111,7 @@ _papi_hwi_convert_eventset_to_multiplex( _papi_int_multiplex_t * mpx )
 	if ( _papi_hwd[ESI->CmpIdx]->cmp_info.kernel_multiplex &&
 		 ( flags & PAPI_MULTIPLEX_FORCE_SW ) )
 		ESI->multiplex.flags = PAPI_MULTIPLEX_FORCE_SW;
+	ESI->multiplex.flags |= flags & PAPI_MULTIPLEX_ADAPTIVE;
 	ESI->multiplex.ns = ( int ) mpx->ns;
 
 	return ( PAPI_OK );
@@ -1924,15 +2121,43 @@ _papi_hwi_convert_eventset_to_multiplex( _papi_int_multiplex_t * mpx )
 
 int papi_num_components = ( sizeof ( _papi_hwd ) / sizeof ( *_papi_hwd ) ) - 1;
 
+/* Run a component's init_component; the caller records the result */
+static int
+init_component( int cidx )
+{
+	int retval;
+
+	retval = _papi_hwd[cidx]->init_component( cidx );
+
+	/* Do some sanity checking */
+	if (retval==PAPI_OK) {
+	   if (_papi_hwd[cidx]->cmp_info.num_cntrs >
+	       _papi_hwd[cidx]->cmp_info.num_mpx_cntrs) {
+	      fprintf(stderr,"Warning!  num_cntrs %d is more than num_mpx_cntrs %d for component %s\n",
+		      _papi_hwd[cidx]->cmp_info.num_cntrs,
+		      _papi_hwd[cidx]->cmp_info.num_mpx_cntrs,
+		      _papi_hwd[cidx]->cmp_info.name);
+	   }
+	}
+
+	return retval;
+}
+
 /*
  * Routine that initializes all available components.
  * A component is available if a pointer to its info vector
  * appears in the NULL terminated_papi_hwd table.
+ *
+ * With PAPI_LAZY_COMPONENTS set in the environment only the first
+ * (CPU) component is initialized here.  The others are marked
+ * PAPI_EDELAY_INIT and initialized by _papi_hwi_init_delayed_component
+ * the first time one of their events is named or enumerated.
  */
 int
 _papi_hwi_init_global( void )
 {
         int retval, i = 0;
+	int lazy = ( getenv( "PAPI_LAZY_COMPONENTS" ) != NULL );
 
 	retval = _papi_hwi_innoculate_os_vector( &_papi_os_vector );
 	if ( retval != PAPI_OK ) {
@@ -1946,21 +2171,19 @@ _papi_hwi_init_global( void )
 	      return retval;
 	   }
 
+	   /* Left delayed by a previous lazy init */
+	   if (_papi_hwd[i]->cmp_info.disabled==PAPI_EDELAY_INIT) {
+	      _papi_hwd[i]->cmp_info.disabled=PAPI_OK;
+	   }
+
 	   /* We can be disabled by user before init */
 	   if (!_papi_hwd[i]->cmp_info.disabled) {
-	      retval = _papi_hwd[i]->init_component( i );
-	      _papi_hwd[i]->cmp_info.disabled=retval;
-
-	      /* Do some sanity checking */
-	      if (retval==PAPI_OK) {
-		if (_papi_hwd[i]->cmp_info.num_cntrs >
-		    _papi_hwd[i]->cmp_info.num_mpx_cntrs) {
-		  fprintf(stderr,"Warning!  num_cntrs %d is more than num_mpx_cntrs %d for component %s\n",
-                        _papi_hwd[i]->cmp_info.num_cntrs,
-                        _papi_hwd[i]->cmp_info.num_mpx_cntrs,
-                        _papi_hwd[i]->cmp_info.name);
-		}
-
+	      if ( lazy && i > 0 ) {
+		 _papi_hwd[i]->cmp_info.disabled=PAPI_EDELAY_INIT;
+		 strcpy(_papi_hwd[i]->cmp_info.disabled_reason,
+			"Initialized on first use (PAPI_LAZY_COMPONENTS)");
+	      } else {
+		 _papi_hwd[i]->cmp_info.disabled=init_component( i );
 	      }
 	   }
 
@@ -1969,6 +2192,46 @@ _papi_hwi_init_global( void )
 	return PAPI_OK;
 }
 
+/*
+ * Initialize a component left delayed by _papi_hwi_init_global, and
+ * every thread PAPI already knows about for it.  Returns PAPI_OK if
+ * the component is (now) usable, or the reason it is disabled.
+ */
+int
+_papi_hwi_init_delayed_component( int cidx )
+{
+	int retval;
+
+	if ( _papi_hwi_invalid_cmp( cidx ) )
+	   return PAPI_ENOCMP;
+
+	/* Fast path: already settled one way or the other */
+	if (_papi_hwd[cidx]->cmp_info.disabled!=PAPI_EDELAY_INIT)
+	   return _papi_hwd[cidx]->cmp_info.disabled;
+
+	_papi_hwi_lock( CMPINIT_LOCK );
+	if (_papi_hwd[cidx]->cmp_info.disabled==PAPI_EDELAY_INIT) {
+	   INTDBG("Delayed init of component %d (%s)\n",
+		  cidx, _papi_hwd[cidx]->cmp_info.name);
+	   _papi_hwd[cidx]->cmp_info.disabled_reason[0]='\0';
+	   retval = init_component( cidx );
+	   if (retval==PAPI_OK) {
+	      retval = _papi_hwi_init_thread_component( cidx );
+	      if (retval!=PAPI_OK) {
+		 _papi_hwd[cidx]->shutdown_component(  );
+		 strcpy(_papi_hwd[cidx]->cmp_info.disabled_reason,
+			"Thread initialization failed");
+	      }
+	   }
+	   /* Publish only once the threads can use it */
+	   __sync_synchronize(  );
+	   _papi_hwd[cidx]->cmp_info.disabled=retval;
+	}
+	_papi_hwi_unlock( CMPINIT_LOCK );
+
+	return _papi_hwd[cidx]->cmp_info.disabled;
+}
+
 /* Machine info struct initialization using defaults */
 /* See _papi_mdi definition in papi_internal.h       */
 
@@ -2017,6 +2280,8 @@ _papi_hwi_shutdown_global_internal( void )
 
     _papi_hwi_free_papi_event_string();
 
+    _papi_hwi_catalog_shutdown();
+
 	papi_free(  _papi_hwi_system_info.global_eventset_map.dataSlotArray );
 	memset(  &_papi_hwi_system_info.global_eventset_map,
 		 0x00, sizeof ( DynamicArray_t ) );
@@ -2290,6 +2555,7 @@ _papi_hwi_get_preset_event_info( int EventCode, PAPI_event_info_t * info )
 	int i = EventCode & PAPI_PRESET_AND_MASK;
 	unsigned int j;
 
+	_papi_hwi_resolve_preset( i );
 	if ( _papi_hwi_presets[i].symbol ) {	/* if the event is in the preset table */
       // since we are setting the whole structure to zero the strncpy calls below will 
       // be leaving NULL terminates strings as long as they copy 1 less byte than the 
@@ -2418,6 +2684,12 @@ _papi_hwi_query_native_event( unsigned int EventCode )
 	   return PAPI_ENOCMP;
    }
 
+   // enumerated from a catalog, so it exists
+   if (native_catalog_rec(EventCode, &cidx) >= 0) {
+	   INTDBG("EXIT: PAPI_OK, catalog event\n");
+	   return PAPI_OK;
+   }
+
    // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
    _papi_hwi_set_papi_event_code(EventCode, 0);
 
@@ -2443,7 +2715,7 @@ _papi_hwi_native_name_to_code( const char *in, int *out )
 	char name[PAPI_HUGE_STR_LEN];	/* make sure it's big enough */
 
 	unsigned int i;
-	int cidx;
+	int cidx, rec;
 	char *full_event_name;
 
 	if (in == NULL) {
@@ -2458,6 +2730,18 @@ _papi_hwi_native_name_to_code( const char *in, int *out )
 	// look in each component
 	for(cidx=0; cidx < papi_num_components; cidx++) {
 
+		// a delayed component is initialized the first time it could
+		// own the event; a component prefix names the owner without
+		// having to initialize the others (their pmu names are not
+		// known until they are)
+		if (_papi_hwd[cidx]->cmp_info.disabled == PAPI_EDELAY_INIT) {
+			if (strstr(full_event_name, ":::") != NULL &&
+			    is_supported_by_component(cidx, full_event_name) == 0) {
+				continue;
+			}
+			_papi_hwi_init_delayed_component(cidx);
+		}
+
 		if (_papi_hwd[cidx]->cmp_info.disabled) continue;
 
 		// if this component does not support the pmu
@@ -2469,6 +2753,19 @@ _papi_hwi_native_name_to_code( const char *in, int *out )
 		INTDBG("cidx: %d, name: %s, event: %s\n",
 			cidx, _papi_hwd[cidx]->cmp_info.name, in);
 
+		// a name the component enumerated before needs no call to it
+		if (_papi_hwi_catalog_open(cidx, 0) == PAPI_OK &&
+		    (rec = _papi_hwi_catalog_find(cidx, in)) >= 0) {
+			*out = catalog_eventcode(cidx, rec);
+			free (full_event_name);
+			if (*out < 0) {
+				INTDBG("EXIT: retval: %d\n", *out);
+				return *out;
+			}
+			INTDBG("EXIT: PAPI_OK  catalog event: %s code: %#x\n", in, *out);
+			return PAPI_OK;
+		}
+
 		// show that we do not have an event code yet
 		// (the component may create one and update this info)
 		// this also clears any values left over from a previous call
@@ -2547,6 +2844,25 @@ _papi_hwi_native_code_to_name( unsigned int EventCode,
   if (cidx<0) return PAPI_ENOEVNT;
 
   if ( EventCode & PAPI_NATIVE_MASK ) {
+	PAPI_event_info_t *info;
+	int rec;
+
+	// enumerated from a catalog, the name is recorded there
+	if ((rec = native_catalog_rec(EventCode, &cidx)) >= 0) {
+		info = papi_malloc(sizeof(PAPI_event_info_t));
+		if (info == NULL) return PAPI_ENOMEM;
+		_papi_hwi_catalog_info(cidx, rec, info);
+		retval = PAPI_OK;
+		if ((int) strlen(info->symbol) >= len) {
+			retval = PAPI_EBUF;
+		} else {
+			strcpy(hwi_name, info->symbol);
+		}
+		papi_free(info);
+		INTDBG("EXIT: retval: %d, catalog event\n", retval);
+		return retval;
+	}
+
 	  // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
 	  _papi_hwi_set_papi_event_code(EventCode, 0);
 
@@ -2587,6 +2903,16 @@ _papi_hwi_get_native_event_info( unsigned int EventCode,
     if (_papi_hwd[cidx]->cmp_info.disabled) return PAPI_ENOCMP;
 
     if ( EventCode & PAPI_NATIVE_MASK ) {
+       int rec;
+
+       // enumerated from a catalog, served from its record
+       if ((rec = native_catalog_rec(EventCode, &cidx)) >= 0) {
+          retval = _papi_hwi_catalog_info(cidx, rec, info);
+          info->event_code = ( unsigned int ) EventCode;
+          INTDBG("EXIT: retval: %d, catalog event\n", retval);
+          return retval;
+       }
+
         // save event code so components can get it with call to: _papi_hwi_get_papi_event_code()
         _papi_hwi_set_papi_event_code(EventCode, 0);
 
@@ -2676,7 +3002,7 @@ _papi_hwi_is_sw_multiplex(EventSetInfo_t *ESI)
    /* Does the component support kernel multiplexing */
    if ( _papi_hwd[ESI->CmpIdx]->cmp_info.kernel_multiplex ) {
       /* Have we forced software multiplexing */
-      if ( ESI->multiplex.flags == PAPI_MULTIPLEX_FORCE_SW ) {
+      if ( ESI->multiplex.flags & PAPI_MULTIPLEX_FORCE_SW ) {
 	 return 1;
       }
       /* Nope, using hardware multiplexing */
@@ -64,6 +64,27 @@ extern char **_papi_errlist;
 
 #define PAPI_INT_MPX_DEF_US 10000	/*Default resolution in us. of mpx handler */
 
+/* Sample streaming definitions */
+
+#define PAPI_SAMPLE_BATCH 16	/* Samples handed to a PAPI_sample_drain handler per call */
+#define PAPI_SAMPLE_DEF_PAGES 8	/* Ring pages used when PAPI_sample_set is given 0 */
+#define PAPI_SAMPLE_COLLECT_BATCH 64	/* Samples per collector thread wakeup by default */
+
+/* Time series definitions */
+
+#define PAPI_TIMESERIES_DEF_RECORDS 4096	/* Snapshots kept when PAPI_timeseries_set is given 0 */
+#define PAPI_TIMESERIES_COUNTS 2048	/* Native counts PAPI_timeseries_read converts per pass */
+
+/* Counter export definitions */
+
+#define PAPI_EXPORT_DEF_PERIOD 10000000	/* ns between exports when PAPI_export_set is given 0 */
+
+/* Profiling definitions */
+
+#define PAPI_PROFIL_HASH_MIN_SLOTS 256	/* Fewest initial buckets of a sparse profile, a power of 2 */
+#define PAPI_PROFIL_HASH_MAX_SLOTS 262144	/* Most initial buckets of a sparse profile, a power of 2 */
+#define PAPI_PROFIL_HASH_PROBES 64	/* Slots a sample tries before it is dropped */
+
 /* Commands used to compute derived events */
 
 #define NOT_DERIVED      0x0    /**< Do nothing */
@@ -92,6 +113,7 @@ extern char **_papi_errlist;
 #define GLOBAL_LOCK          	PAPI_NUM_LOCK+6	/* papi.c for global variable (static and non) initialization/shutdown */
 #define CPUS_LOCK		PAPI_NUM_LOCK+7	/* cpus.c */
 #define NAMELIB_LOCK            PAPI_NUM_LOCK+8 /* papi_pfm4_events.c */
+#define CMPINIT_LOCK            PAPI_NUM_LOCK+9 /* papi_internal.c delayed component init */
 
 /* extras related */
 
@@ -155,13 +177,62 @@ typedef struct _EventSetInheritInfo
 	int inherit;
 } EventSetInheritInfo_t;
 
+typedef struct _EventSetRefreshInfo
+{
+	long long ns;
+} EventSetRefreshInfo_t;
+
+/** One PAPI_sprofil_t region as an address interval
+  @internal */
+typedef struct _profile_region {
+   caddr_t start;               /**< pr_off of the region */
+   caddr_t end;                 /**< first address past its last bucket */
+   PAPI_sprofil_t *prof;
+} ProfileRegion_t;
+
+/** One bucket of a sparse profile; key 0 marks a free slot
+  @internal */
+typedef struct _profile_hash_slot {
+   unsigned long long key;      /**< region + 1 above bit 48, bucket below */
+   unsigned long long count;
+} ProfileHashSlot_t;
+
+/** Open addressing hash of the buckets hit by a PAPI_PROFIL_SPARSE
+  profile.  Signal handlers insert with compare and swap only; the
+  table is resized and dumped to hits while the EventSet is stopped.
+  @internal */
+typedef struct _profile_hash {
+   unsigned int mask;           /**< slots - 1, slots a power of 2 */
+   unsigned int used;           /**< slots holding a key */
+   unsigned long long dropped;  /**< samples that found no free slot */
+   int crowded;                 /**< a sample was dropped since the last grow */
+   PAPI_sprofil_hit_t *hits;    /**< sorted dump taken at PAPI_stop */
+   int nhits;
+   ProfileHashSlot_t slot[1];
+} ProfileHash_t;
+
+/** The regions of one profiled event, sorted by start and disjoint
+  (overlaps are split, the later start winning),
+  so a sample's region is found by binary search.
+  @internal */
+typedef struct _profile_region_table {
+   int count;                   /**< entries in region */
+   PAPI_sprofil_t *catchall;    /**< pr_off 0 / pr_scale 2 bucket, or NULL */
+   PAPI_sprofil_t *base;        /**< the caller's array, for region numbers */
+   ProfileHash_t *hash;         /**< sparse buckets, or NULL when dense */
+   ProfileRegion_t region[1];
+} ProfileRegionTable_t;
+
 /** @internal */
 typedef struct _EventSetProfileInfo {
    PAPI_sprofil_t **prof;
+   ProfileRegionTable_t **regions; /**< lookup table for each prof */
    int *count;     /**< Number of buffers */
    int *threshold;
    int *EventIndex;
    int *EventCode;
+   int *owned;     /**< prof was allocated by PAPI_profil or
+                        PAPI_sprofil_objects, freed when turned off */
    int flags;
    int event_counter;
 } EventSetProfileInfo_t;
@@ -225,6 +296,12 @@ typedef struct _masterevent {
    long long prev_total_c;
    long long count_estimate;
    double rate_estimate;
+   /** Rate samples, one per slice of at least MPX_MINCYC cycles */
+   long long slices;
+   double rate_sum;
+   double rate_sum2;
+   /** Active EventSets that asked for adaptive slices */
+   int adaptive;
    struct _threadlist *mythr;
    struct _masterevent *next;
 } MasterEvent;
@@ -240,8 +317,21 @@ typedef struct _threadlist {
    long long total_c;
    /** Pointer to event in use */
    MasterEvent *cur_event;
+   /** Timer ticks left before cur_event is rotated out */
+   int ticks_left;
    /** List of multiplexing events for this thread */
    MasterEvent *head;
+   /** Kernel id of the thread's CPU time timer */
+   int timer;
+   /** 0 no timer yet, 1 timer created, -1 use the process itimer */
+   int timer_state;
+   /** Signal and clock the timer was created with */
+   int timer_sig;
+   int timer_clock;
+   /** Kernel thread id the timer signals */
+   int ktid;
+   /** MPX_THREAD_MAGIC while the record is on the thread list */
+   unsigned int magic;
    /** Pointer to next thread */
    struct _threadlist *next;
 } Threadlist;
@@ -306,6 +396,7 @@ typedef struct _EventSetInfo {
   EventSetCpuInfo_t cpu;
   EventSetProfileInfo_t profile;
   EventSetInheritInfo_t inherit;
+  EventSetRefreshInfo_t refresh;
 } EventSetInfo_t;
 
 /** @internal */
@@ -373,6 +464,13 @@ typedef struct _papi_int_inherit
 	int inherit;
 } _papi_int_inherit_t;
 
+/** @internal */
+typedef struct _papi_int_refresh
+{
+	EventSetInfo_t *ESI;
+	long long ns;
+} _papi_int_refresh_t;
+
 /** @internal */
 typedef struct _papi_int_addr_range { /* if both are zero, range is disabled */
    EventSetInfo_t *ESI;
@@ -393,6 +491,7 @@ typedef union _papi_int_option_t {
    _papi_int_multiplex_t multiplex;
    _papi_int_itimer_t itimer;
 	_papi_int_inherit_t inherit;
+	_papi_int_refresh_t refresh;
 	_papi_int_granularity_t granularity;
 	_papi_int_addr_range_t address_range;
 } _papi_int_option_t;
@@ -461,11 +560,14 @@ int _papi_hwi_remove_EventSet( EventSetInfo_t * ESI );
 void _papi_hwi_map_events_to_native( EventSetInfo_t *ESI);
 int _papi_hwi_add_event( EventSetInfo_t * ESI, int EventCode );
 int _papi_hwi_remove_event( EventSetInfo_t * ESI, int EventCode );
+void _papi_hwi_map_counts( EventSetInfo_t * ESI, long long *dp,
+			  long long *values );
 int _papi_hwi_read( hwd_context_t * context, EventSetInfo_t * ESI,
 		    long long *values );
 int _papi_hwi_cleanup_eventset( EventSetInfo_t * ESI );
 int _papi_hwi_convert_eventset_to_multiplex( _papi_int_multiplex_t * mpx );
 int _papi_hwi_init_global( void );
+int _papi_hwi_init_delayed_component( int cidx );
 int _papi_hwi_init_global_internal( void );
 int _papi_hwi_init_os(void);
 void _papi_hwi_init_errors(void);
@@ -489,5 +591,7 @@ int _papi_hwi_invalid_cmp( int cidx );
 int _papi_hwi_component_index( int event_code );
 int _papi_hwi_native_to_eventcode(int cidx, int event_code, int ntv_idx, const char *event_name);
 int _papi_hwi_eventcode_to_native(int event_code);
+int _papi_hwi_catalog_enum(int cidx, int *EventCode, int modifier);
+const char *_papi_hwi_strip_component_prefix(const char *event_name);
 
 #endif /* PAPI_INTERNAL_H */
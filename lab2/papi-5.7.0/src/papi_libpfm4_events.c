@@ -4,6 +4,7 @@
 *          based heavily on existing papi_libpfm3_events.c
 */
 
+#include <ctype.h>
 #include <string.h>
 
 #include "papi.h"
@@ -21,6 +22,68 @@
 
 static int libpfm4_users=0;
 
+/* Memoized pfm_get_os_event_encoding() results.  Entries are pushed  */
+/* onto the bucket heads with a CAS and never unlinked until the last */
+/* libpfm4 user shuts down, so lookups take no lock (callers already  */
+/* hold NAMELIB_LOCK while encoding).                                 */
+
+#define ENCODING_HASH_SIZE 1024
+
+struct encoding_cache_t {
+  struct encoding_cache_t *next;
+  char *name;
+  int dfl_plm;
+  pfm_os_t os;
+  int ret;
+  int idx;
+  int cpu;
+  int flags;
+  char *fstr;
+  struct perf_event_attr attr;
+};
+
+static struct encoding_cache_t *encoding_hash[ENCODING_HASH_SIZE];
+
+/* Event, attribute and PMU names are all matched case insensitively */
+/* by libpfm4, so the lowercased string is the normalized key.       */
+static unsigned int
+hash_encoding(const char *name, int dfl_plm, pfm_os_t os) {
+  unsigned int h = 2166136261u;
+
+  while (*name) {
+    h ^= (unsigned char)tolower((unsigned char)*name++);
+    h *= 16777619u;
+  }
+  h ^= (unsigned int)dfl_plm;
+  h *= 16777619u;
+  h ^= (unsigned int)os;
+  h *= 16777619u;
+  return h & (ENCODING_HASH_SIZE-1);
+}
+
+static int
+attr_is_clear(const struct perf_event_attr *attr) {
+  static const struct perf_event_attr zero;
+
+  return !memcmp(attr, &zero, sizeof(zero));
+}
+
+static void
+flush_encoding_cache(void) {
+  struct encoding_cache_t *entry, *next;
+  int i;
+
+  for (i=0; i<ENCODING_HASH_SIZE; i++) {
+    for (entry=encoding_hash[i]; entry!=NULL; entry=next) {
+      next=entry->next;
+      free(entry->name);
+      free(entry->fstr);
+      free(entry);
+    }
+    encoding_hash[i]=NULL;
+  }
+}
+
 /***********************************************************/
 /* Exported functions                                      */
 /***********************************************************/
@@ -79,6 +142,7 @@ _papi_libpfm4_shutdown(papi_vector_t *my_vector) {
 	/* Only free if we're the last user */
 
 	if (!libpfm4_users) {
+		flush_encoding_cache();
 		pfm_terminate();
 	}
 
@@ -155,3 +219,98 @@ _papi_libpfm4_init(papi_vector_t *my_vector) {
 
 	return PAPI_OK;
 }
+
+/** @class  _papi_libpfm4_get_os_event_encoding
+ *  @brief  pfm_get_os_event_encoding() for perf_event, memoized
+ *
+ *  @param[in] name
+ *        -- event string to encode
+ *  @param[in] dfl_plm
+ *        -- default privilege level mask
+ *  @param[in] os
+ *        -- PFM_OS_PERF_EVENT or PFM_OS_PERF_EVENT_EXT
+ *  @param[in,out] arg
+ *        -- perf encode argument, as for pfm_get_os_event_encoding()
+ *
+ *  Only requests made with a cleared perf_event_attr are cached, as
+ *  the encoding of anything else also depends on the attr contents.
+ *  The cache is dropped when the last user calls pfm_terminate().
+ *
+ *  @returns the libpfm4 return code
+ *
+ */
+
+int
+_papi_libpfm4_get_os_event_encoding(const char *name, int dfl_plm,
+				pfm_os_t os, pfm_perf_encode_arg_t *arg) {
+
+	struct encoding_cache_t *entry, *head;
+	unsigned int bucket;
+	int ret;
+
+	if ((arg->attr==NULL) || !attr_is_clear(arg->attr)) {
+		return pfm_get_os_event_encoding(name, dfl_plm, os, arg);
+	}
+
+	bucket = hash_encoding(name, dfl_plm, os);
+
+	for (entry = __atomic_load_n(&encoding_hash[bucket], __ATOMIC_ACQUIRE);
+	     entry != NULL; entry = entry->next) {
+		if ((entry->dfl_plm != dfl_plm) || (entry->os != os) ||
+		    strcasecmp(entry->name, name)) {
+			continue;
+		}
+		SUBDBG("encoding cache hit: %s\n", name);
+		memcpy(arg->attr, &entry->attr, sizeof(struct perf_event_attr));
+		arg->idx = entry->idx;
+		arg->cpu = entry->cpu;
+		arg->flags = entry->flags;
+		if ((arg->fstr != NULL) && (entry->fstr != NULL)) {
+			*arg->fstr = strdup(entry->fstr);
+			if (*arg->fstr == NULL) {
+				return PFM_ERR_NOMEM;
+			}
+		}
+		return entry->ret;
+	}
+
+	ret = pfm_get_os_event_encoding(name, dfl_plm, os, arg);
+
+	/* only remember complete answers; a missing fstr cannot be replayed */
+	if ((ret == PFM_SUCCESS) && ((arg->fstr == NULL) || (*arg->fstr == NULL))) {
+		return ret;
+	}
+
+	entry = calloc(1, sizeof(struct encoding_cache_t));
+	if (entry == NULL) {
+		return ret;
+	}
+	entry->name = strdup(name);
+	if ((ret == PFM_SUCCESS) && (arg->fstr != NULL)) {
+		entry->fstr = strdup(*arg->fstr);
+	}
+	if ((entry->name == NULL) ||
+	    ((ret == PFM_SUCCESS) && (entry->fstr == NULL))) {
+		free(entry->name);
+		free(entry->fstr);
+		free(entry);
+		return ret;
+	}
+	entry->dfl_plm = dfl_plm;
+	entry->os = os;
+	entry->ret = ret;
+	if (ret == PFM_SUCCESS) {
+		memcpy(&entry->attr, arg->attr, sizeof(struct perf_event_attr));
+		entry->idx = arg->idx;
+		entry->cpu = arg->cpu;
+		entry->flags = arg->flags;
+	}
+
+	head = __atomic_load_n(&encoding_hash[bucket], __ATOMIC_RELAXED);
+	do {
+		entry->next = head;
+	} while (!__atomic_compare_exchange_n(&encoding_hash[bucket], &head,
+			entry, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	return ret;
+}
@@ -6,6 +6,7 @@
 */
 
 #include "perfmon/pfmlib.h"
+#include "perfmon/pfmlib_perf_event.h"
 #include PEINCLUDE
 
 struct native_event_t {
@@ -24,6 +25,19 @@ struct native_event_t {
   perf_event_attr_t attr;
 };
 
+/* Name index entry, one per lookup key of a native event.  Entries  */
+/* are immutable once published and only freed at shutdown, so that  */
+/* readers can walk the hash chains without taking NAMELIB_LOCK.      */
+struct native_event_name_t {
+  struct native_event_name_t *next;
+  char *name;
+  int base_form;      /* key is base_name:mask_string, not allocated_name */
+  int event_idx;
+};
+
+/* Must be a power of two */
+#define NATIVE_EVENT_HASH_SIZE 4096
+
 #define PMU_TYPE_CORE   1
 #define PMU_TYPE_UNCORE 2
 #define PMU_TYPE_OS     4
@@ -34,6 +48,7 @@ struct native_event_table_t {
    int allocated_native_events;
    pfm_pmu_info_t default_pmu;
    int pmu_type;
+   struct native_event_name_t **name_hash;
 };
 
 
@@ -42,5 +57,7 @@ struct native_event_table_t {
 int _papi_libpfm4_error( int pfm_error );
 int _papi_libpfm4_shutdown(papi_vector_t *my_vector);
 int _papi_libpfm4_init(papi_vector_t *my_vector);
+int _papi_libpfm4_get_os_event_encoding(const char *name, int dfl_plm,
+		pfm_os_t os, pfm_perf_encode_arg_t *arg);
 
 #endif // _PAPI_LIBPFM4_EVENTS_H
@@ -27,6 +27,12 @@ extern hwi_presets_t user_defined_events[];
 extern int user_defined_events_count;
 
 static int papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag);
+static void resolve_compiled_preset( int preset_index );
+
+// Compiled definitions selected for this PMU but not resolved yet, by preset index
+static const hwi_preset_def_t *preset_pending[PAPI_MAX_PRESET_EVENTS];
+static char preset_resolving[PAPI_MAX_PRESET_EVENTS];
+static int preset_pending_cidx;
 
 
 /* This routine copies values from a dense 'findem' array of events
@@ -135,6 +141,9 @@ _papi_hwi_cleanup_all_presets( void )
 	   _papi_hwd[cidx]->cmp_info.num_preset_events = 0;
 	}
 
+	memset( preset_pending, 0, sizeof ( preset_pending ) );
+	memset( preset_resolving, 0, sizeof ( preset_resolving ) );
+
 #if defined(ITANIUM2) || defined(ITANIUM3)
 	/* NOTE: This memory may need to be freed for BG/P builds as well */
 	if ( preset_search_map != NULL ) {
@@ -267,36 +276,22 @@ open_event_table( char *name )
 	return table;
 }
 
-/* parse a single line from either a file or character table
+/* parse a single line from a file
    Strip trailing <cr>; return 0 if empty */
 static int
-get_event_line( char *line, FILE * table, char **tmp_perfmon_events_table )
+get_event_line( char *line, FILE * table )
 {
 	int i;
 
-	if ( table ) {
-	    if ( fgets( line, LINE_MAX, table ) == NULL)
+	if ( fgets( line, LINE_MAX, table ) == NULL)
 		return 0;
 
-	    i = ( int ) strlen( line );
-	    if (i == 0)
+	i = ( int ) strlen( line );
+	if (i == 0)
 		return 0;
-	    if ( line[i-1] == '\n' )
+	if ( line[i-1] == '\n' )
 		line[i-1] = '\0';
-	    return 1;
-	} else {
-		for ( i = 0;
-			  **tmp_perfmon_events_table && **tmp_perfmon_events_table != '\n';
-			  i++, ( *tmp_perfmon_events_table )++ )
-			line[i] = **tmp_perfmon_events_table;
-		if (i == 0)
-		    return 0;
-		if ( **tmp_perfmon_events_table && **tmp_perfmon_events_table == '\n' ) {
-		    ( *tmp_perfmon_events_table )++;
-		}
-		line[i] = '\0';
-		return 1;
-	}
+	return 1;
 }
 
 // update tokens in formula referring to index "old_index" with tokens referring to index "new_index".
@@ -738,6 +733,16 @@ check_native_events(char *target, hwi_presets_t* results)
 static int
 is_event(char *event_name, int derived_type, hwi_presets_t* results, int token_index) {
 	INTDBG("ENTER: event_name: %p (%s), derived_type: %d, results: %p, token_index: %d\n", event_name, event_name, derived_type, results, token_index);
+	int i;
+
+	/* a compiled preset used as a term has to be resolved first */
+	for ( i = 0; i < PAPI_MAX_PRESET_EVENTS; i++ ) {
+		if ( preset_pending[i] != NULL &&
+			 strcasecmp( event_name, preset_pending[i]->symbol ) == 0 ) {
+			resolve_compiled_preset( i );
+			break;
+		}
+	}
 
 	/* check if its a preset event */
 	if ( check_derived_events(event_name, derived_type, results, &_papi_hwi_presets[0], PAPI_MAX_PRESET_EVENTS, token_index) ) {
@@ -761,19 +766,150 @@ is_event(char *event_name, int derived_type, hwi_presets_t* results, int token_i
 	return 0;
 }
 
-/* Static version of the events file. */
+/* Static version of the events file, compiled by papi_events_table.sh */
 #if defined(STATIC_PAPI_EVENTS_TABLE)
 #include "papi_events_table.h"
-#else
-static char *papi_events_table = NULL;
+
+/*
+ * Select the compiled definitions of a PMU.  Nothing is resolved here;
+ * each preset keeps a pointer to its definition until it is first
+ * queried, enumerated or added, see _papi_hwi_resolve_preset().
+ */
+static int
+papi_load_compiled_presets( char *pmu_str, int pmu_type, int cidx )
+{
+	char pmu_name[PAPI_MIN_STR_LEN];
+	const hwi_preset_pmu_t *pmu;
+	char *tmpn;
+	int i, res_idx;
+
+	/* copy the pmu identifier, stripping commas if found */
+	tmpn = pmu_name;
+	while (*pmu_str && tmpn < pmu_name + sizeof(pmu_name) - 1) {
+		if (*pmu_str != ',')
+			*tmpn++ = *pmu_str;
+		pmu_str++;
+	}
+	*tmpn = '\0';
+
+	preset_pending_cidx = cidx;
+	for ( pmu = papi_preset_pmus; pmu->name != NULL; pmu++ ) {
+		if ( strcasecmp( pmu->name, pmu_name ) != 0 )
+			continue;
+		if ( pmu->type != -1 && pmu->type != pmu_type ) {
+			SUBDBG( "Additional qualifier match failed %d vs %d.\n", pmu_type, pmu->type);
+			continue;
+		}
+		SUBDBG( "Process %d compiled events for PMU %s.\n", pmu->count, pmu->name);
+
+		for ( i = pmu->first; i < pmu->first + pmu->count; i++ ) {
+			res_idx = find_event_index( _papi_hwi_presets, PAPI_MAX_PRESET_EVENTS,
+				( char * ) papi_preset_defs[i].symbol );
+			if ( res_idx < 0 ) {
+				PAPIERROR("No room left for event %s -- ignoring", papi_preset_defs[i].symbol);
+				continue;
+			}
+			/* a later definition replaces an earlier one */
+			preset_pending[res_idx] = &papi_preset_defs[i];
+			_papi_hwd[cidx]->cmp_info.num_preset_events++;
+		}
+	}
+
+	return PAPI_OK;
+}
 #endif
 
+/*
+ * Fill in a preset from its compiled definition, the way
+ * papi_load_derived_events() fills one in from a PRESET line.
+ * Called with GLOBAL_LOCK held, or during init.
+ */
+static void
+resolve_compiled_preset( int preset_index )
+{
+	const hwi_preset_def_t *def = preset_pending[preset_index];
+	hwi_presets_t *result = &_papi_hwi_presets[preset_index];
+	int i, invalid_event = 0;
+	unsigned int j;
+
+	/* a definition naming itself, directly or not, ends here */
+	if ( def == NULL || preset_resolving[preset_index] )
+		return;
+	preset_resolving[preset_index] = 1;
+
+	SUBDBG( "Resolving compiled event %s, derived: %d.\n", def->symbol, def->derived);
+
+	result->derived_int = def->derived;
+	if ( def->postfix != NULL )
+		result->postfix = papi_strdup( def->postfix );
+
+	result->count = 0;
+	for ( i = 0; def->terms[i] != NULL &&
+			result->count < PAPI_EVENTS_IN_DERIVED_EVENT; i++ ) {
+		_papi_hwi_set_papi_event_code(-1, -1);
+		if (is_event((char *) def->terms[i], result->derived_int, result, i) == 0) {
+			invalid_event = 1;
+			PAPIERROR("Missing event %s, used in derived event %s", def->terms[i], result->symbol);
+			break;
+		}
+	}
+
+	/* preset code list must be PAPI_NULL terminated */
+	if (result->count < PAPI_EVENTS_IN_DERIVED_EVENT) {
+		result->code[result->count] = PAPI_NULL;
+	}
+
+	if (invalid_event) {
+		for (j = 0; j < result->count; j++) {
+			if (result->name[j] != NULL) {
+				papi_free( result->name[j] );
+				result->name[j] = NULL;
+			}
+		}
+		result->count = 0;
+		_papi_hwd[preset_pending_cidx]->cmp_info.num_preset_events--;
+	} else {
+		if (def->short_descr != NULL)
+			result->short_descr = papi_strdup(def->short_descr);
+		if (def->long_descr != NULL)
+			result->long_descr = papi_strdup(def->long_descr);
+		if (def->note != NULL)
+			result->note = papi_strdup(def->note);
+	}
+
+	/* unlocked readers may look at the preset once this is NULL */
+	__sync_synchronize(  );
+	preset_pending[preset_index] = NULL;
+	preset_resolving[preset_index] = 0;
+}
+
+/* Resolve a preset selected from the compiled table, if not done yet.
+   Cheap once resolved; callers use it before looking at the count. */
+void
+_papi_hwi_resolve_preset( int preset_index )
+{
+	if ( preset_index < 0 || preset_index >= PAPI_MAX_PRESET_EVENTS ||
+		 preset_pending[preset_index] == NULL )
+		return;
+
+	_papi_hwi_lock( GLOBAL_LOCK );
+	resolve_compiled_preset( preset_index );
+	_papi_hwi_unlock( GLOBAL_LOCK );
+}
+
 int _papi_load_preset_table(char *pmu_str, int pmu_type, int cidx) {
 	SUBDBG("ENTER: pmu_str: %s, pmu_type: %d, cidx: %d\n", pmu_str, pmu_type, cidx);
 
 	int retval;
 
 	// go load papi preset events (last argument tells function if we are loading presets or user events)
+	// the compiled table is used unless PAPI_CSV_EVENT_FILE names another file
+#if defined(STATIC_PAPI_EVENTS_TABLE)
+	char *tmpn = getenv("PAPI_CSV_EVENT_FILE");
+	if ((tmpn == NULL) || (strlen(tmpn) == 0))
+		retval = papi_load_compiled_presets(pmu_str, pmu_type, cidx);
+	else
+#endif
 	retval = papi_load_derived_events(pmu_str, pmu_type, cidx, 1);
 	if (retval != PAPI_OK) {
 		SUBDBG("EXIT: retval: %d\n", retval);
@@ -923,8 +1059,8 @@ infix_to_postfix( char *infix ) {
  *
  * There are three possible sources of input for preset event definitions.  The code will first look for the environment variable
  * "PAPI_CSV_EVENT_FILE".  If found its value will be used as the pathname of where to get the preset information.  If not found,
- * the code will look for a built in table containing preset events.  If the built in table was not created during the build of
- * PAPI then the code will build a pathname of the form "PAPI_DATADIR/PAPI_EVENT_FILE".  Each of these are build variables, the
+ * the table compiled from papi_events.csv at build time is used instead of this function (see papi_load_compiled_presets).  If
+ * that table was not built then the code will build a pathname of the form "PAPI_DATADIR/PAPI_EVENT_FILE".  Each of these are build variables, the
  * PAPI_DATADIR variable can be given a value during the configure of PAPI at build time, and the PAPI_EVENT_FILE variable has a
  * hard coded value of "papi_events.csv".
  *
@@ -949,9 +1085,8 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 
 	char pmu_name[PAPI_MIN_STR_LEN];
 	char line[LINE_MAX];
-	char name[PATH_MAX] = "builtin papi_events_table";
+	char name[PATH_MAX];
 	char *event_file_path=NULL;
-	char *event_table_ptr=NULL;
 	int event_type_bits = 0;
 	char *tmpn;
 	char *tok_save_ptr=NULL;
@@ -976,11 +1111,7 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 		if ((tmpn = getenv("PAPI_CSV_EVENT_FILE")) && (strlen(tmpn) > 0)) {
 			event_file_path = tmpn;
 		}
-		/* if no valid environment variable, look for built-in table */
-		else if (papi_events_table) {
-			event_table_ptr = papi_events_table;
-		}
-		/* if no env var and no built-in, search for default file */
+		/* if no env var, search for default file */
 		else {
 #ifdef PAPI_DATADIR
 			sprintf( path, "%s/%s", PAPI_DATADIR, PAPI_EVENT_FILE );
@@ -1005,20 +1136,14 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 		event_count = &user_defined_events_count;
 	}
 
-	// if we have an event file pathname, open it and read event definitions from the file
-	if (event_file_path != NULL) {
-		if ((event_file = open_event_table(event_file_path)) == NULL) {
-			// if file open fails, return an error
-			SUBDBG("EXIT: Event file open failed.\n");
-			return PAPI_ESYS;
-		}
-		strncpy(name, event_file_path, sizeof(name)-1);
-		name[sizeof(name)-1] = '\0';
-	} else if (event_table_ptr == NULL) {
-		// if we do not have a path name or table pointer, return an error
-		SUBDBG("EXIT: Both event_file_path and event_table_ptr are NULL.\n");
+	// open the event file and read event definitions from it
+	if ((event_file = open_event_table(event_file_path)) == NULL) {
+		// if file open fails, return an error
+		SUBDBG("EXIT: Event file open failed.\n");
 		return PAPI_ESYS;
 	}
+	strncpy(name, event_file_path, sizeof(name)-1);
+	name[sizeof(name)-1] = '\0';
 
 	/* copy the pmu identifier, stripping commas if found */
 	tmpn = pmu_name;
@@ -1029,8 +1154,8 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 	}
 	*tmpn = '\0';
 
-	/* at this point we have either a valid file pointer or built-in table pointer */
-	while (get_event_line(line, event_file, &event_table_ptr)) {
+	/* at this point we have a valid file pointer */
+	while (get_event_line(line, event_file)) {
 		char *t;
 		int i;
 
@@ -1281,9 +1406,7 @@ papi_load_derived_events (char *pmu_str, int pmu_type, int cidx, int preset_flag
 		PAPIERROR("Unrecognized token %s at line %d of %s -- ignoring", t, line_no, name);
 	}
 
-	if (event_file) {
-		fclose(event_file);
-	}
+	fclose(event_file);
 
 	SUBDBG("EXIT: Done processing derived event file.\n");
 	return PAPI_OK;
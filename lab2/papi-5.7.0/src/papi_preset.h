@@ -35,6 +35,27 @@ typedef struct hwi_presets {
 } hwi_presets_t;
 
 
+/** preset definition compiled from papi_events.csv by papi_events_table.sh
+ *	@internal */
+typedef struct hwi_preset_def {
+   const char *symbol;        /**< preset name */
+   int derived;               /**< Derived type code, DERIVED_INFIX already converted */
+   const char *postfix;       /**< postfix formula, or NULL */
+   const char *terms[PAPI_EVENTS_IN_DERIVED_EVENT + 1]; /**< event names, NULL terminated */
+   const char *short_descr;
+   const char *long_descr;
+   const char *note;
+} hwi_preset_def_t;
+
+/** CPU line of papi_events.csv and the definitions that follow it
+ *	@internal */
+typedef struct hwi_preset_pmu {
+   const char *name;          /**< pmu name */
+   int type;                  /**< pmu type qualifier, -1 if none */
+   int first;                 /**< index of its first papi_preset_defs entry */
+   int count;                 /**< number of entries */
+} hwi_preset_pmu_t;
+
 /** This is a general description structure definition for various parameter lists 
  *	@internal */   
 typedef struct hwi_describe {
@@ -49,6 +70,7 @@ int _papi_hwi_setup_all_presets( hwi_search_t * findem, int cidx);
 int _papi_hwi_cleanup_all_presets( void );
 int _xml_papi_hwi_setup_all_presets( char *arch);
 int _papi_load_preset_table( char *name, int type, int cidx );
+void _papi_hwi_resolve_preset( int preset_index );
 
 extern hwi_presets_t _papi_hwi_presets[PAPI_MAX_PRESET_EVENTS];
 
@@ -160,6 +160,40 @@ _papi_hwi_innoculate_vector( papi_vector_t * v )
 	if ( !v->set_profile )
 		v->set_profile =
 			( int ( * )( EventSetInfo_t *, int, int ) ) vec_int_dummy;
+	if ( !v->set_sampling )
+		v->set_sampling =
+			( int ( * )( EventSetInfo_t *, int, long long, int, int ) )
+			vec_int_dummy;
+	if ( !v->read_samples )
+		v->read_samples =
+			( int ( * )( EventSetInfo_t *, PAPI_sample_t *, int ) )
+			vec_int_dummy;
+	if ( !v->set_collector )
+		v->set_collector =
+			( int ( * )
+			  ( EventSetInfo_t *, PAPI_sample_handler_t, void *, int ) )
+			vec_int_dummy;
+	if ( !v->set_timeseries )
+		v->set_timeseries =
+			( int ( * )( EventSetInfo_t *, long long, int ) ) vec_int_dummy;
+	if ( !v->read_timeseries )
+		v->read_timeseries =
+			( int ( * )
+			  ( EventSetInfo_t *, long long *, long long *, int,
+			    long long * ) ) vec_int_dummy;
+	if ( !v->set_export )
+		v->set_export =
+			( int ( * )( EventSetInfo_t *, const char *, long long ) )
+			vec_int_dummy;
+	if ( !v->set_cpuset )
+		v->set_cpuset =
+			( int ( * )( EventSetInfo_t *, const unsigned int *, int ) )
+			vec_int_dummy;
+	if ( !v->read_cpuset )
+		v->read_cpuset =
+			( int ( * )
+			  ( EventSetInfo_t *, unsigned int **, long long ** ) )
+			vec_int_dummy;
 
 	if ( !v->set_domain )
 		v->set_domain =
@@ -322,6 +356,22 @@ vector_print_table( papi_vector_t * v, int print_func )
 						  print_func );
 	vector_print_routine( ( void * ) v->set_profile, "_papi_hwd_set_profile",
 						  print_func );
+	vector_print_routine( ( void * ) v->set_sampling, "_papi_hwd_set_sampling",
+						  print_func );
+	vector_print_routine( ( void * ) v->read_samples, "_papi_hwd_read_samples",
+						  print_func );
+	vector_print_routine( ( void * ) v->set_collector,
+						  "_papi_hwd_set_collector", print_func );
+	vector_print_routine( ( void * ) v->set_timeseries,
+						  "_papi_hwd_set_timeseries", print_func );
+	vector_print_routine( ( void * ) v->read_timeseries,
+						  "_papi_hwd_read_timeseries", print_func );
+	vector_print_routine( ( void * ) v->set_export,
+						  "_papi_hwd_set_export", print_func );
+	vector_print_routine( ( void * ) v->set_cpuset,
+						  "_papi_hwd_set_cpuset", print_func );
+	vector_print_routine( ( void * ) v->read_cpuset,
+						  "_papi_hwd_read_cpuset", print_func );
 	vector_print_routine( ( void * ) v->set_domain, "_papi_hwd_set_domain",
 						  print_func );
 	vector_print_routine( ( void * ) v->ntv_enum_events,
@@ -39,6 +39,14 @@ typedef struct papi_vectors {
     int		(*ctl)			(hwd_context_t *, int , _papi_int_option_t *);	/**< */
     int		(*set_overflow)		(EventSetInfo_t *, int, int);				/**< */
     int		(*set_profile)		(EventSetInfo_t *, int, int);				/**< */
+    int		(*set_sampling)		(EventSetInfo_t *, int, long long, int, int);	/**< */
+    int		(*read_samples)		(EventSetInfo_t *, PAPI_sample_t *, int);	/**< returns samples copied */
+    int		(*set_collector)	(EventSetInfo_t *, PAPI_sample_handler_t, void *, int);	/**< */
+    int		(*set_timeseries)	(EventSetInfo_t *, long long, int);	/**< */
+    int		(*read_timeseries)	(EventSetInfo_t *, long long *, long long *, int, long long *);	/**< returns snapshots copied */
+    int		(*set_export)		(EventSetInfo_t *, const char *, long long);	/**< */
+    int		(*set_cpuset)		(EventSetInfo_t *, const unsigned int *, int);	/**< */
+    int		(*read_cpuset)		(EventSetInfo_t *, unsigned int **, long long **);	/**< returns cpus read */
     int		(*set_domain)		(hwd_control_state_t *, int);				/**< */
     int		(*ntv_enum_events)	(unsigned int *, int);						/**< */
     int		(*ntv_name_to_code)	(const char *, unsigned int *);					/**< */
@@ -132,6 +132,7 @@ for advertising or product endorsement purposes.
 #include "papi_memory.h"
 
 #define MPX_MINCYC 25000
+#define MPX_MAX_TICKS 4			/* Longest adaptive slice, in timer ticks */
 
 /* Globals for this file. */
 
@@ -140,6 +141,8 @@ for advertising or product endorsement purposes.
 static Threadlist *tlist = NULL;
 static unsigned int randomseed;
 
+#define MPX_THREAD_MAGIC 0x4d505854	/* "MPXT", a Threadlist on tlist */
+
 /* Timer stuff */
 
 #include <sys/time.h>
@@ -147,6 +150,27 @@ static unsigned int randomseed;
 #include <errno.h>
 #include <unistd.h> 
 #include <assert.h>
+#include <signal.h>
+#include <time.h>
+
+/* Each multiplexing thread rotates its events off its own timer,
+ * delivered to that thread alone, so no thread has to signal the
+ * others.  The timer uses the signal PAPI_DEF_ITIMER chose and counts
+ * wall time for ITIMER_REAL, the thread's CPU time otherwise, so
+ * threads that are not running are not woken.  The syscalls are used
+ * directly to avoid needing -lrt.  Where they are missing, the process
+ * wide itimer is used instead.
+ */
+#if defined(__linux__) && defined(SIGEV_THREAD_ID)
+#include <sys/syscall.h>
+#if defined(__NR_timer_create) && defined(__NR_timer_settime) && \
+    defined(__NR_timer_delete) && defined(__NR_gettid)
+#define MPX_THREAD_TIMERS
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+#endif
 
 static sigset_t sigreset;
 static struct itimerval itime;
@@ -156,9 +180,6 @@ static struct sigaction oaction;
 /* END Globals */
 
 #ifdef PTHREADS
-/** Number of threads that have been signaled */
-static int threads_responding = 0;
-
 static pthread_once_t mpx_once_control = PTHREAD_ONCE_INIT;
 static pthread_mutex_t tlistlock;
 static pthread_key_t master_events_key;
@@ -174,7 +195,7 @@ static void mpx_delete_events( MPX_EventSet * );
 static void mpx_delete_one_event( MPX_EventSet * mpx_events, int Event );
 static int mpx_insert_events( MPX_EventSet *, int *event_list, int num_events,
 							  int domain, int granularity );
-static void mpx_handler( int signal );
+static void mpx_handler( int signal, siginfo_t * info, void *context );
 
 inline_static void
 mpx_hold( void )
@@ -218,23 +239,93 @@ mpx_init_timers( int interval )
 	sigaddset( &sigreset, _papi_os_info.itimer_sig );
 }
 
+#ifdef MPX_THREAD_TIMERS
+/* Arm the calling thread's timer, creating it on first use.
+ * Must be called by the thread t describes.
+ */
+static int
+mpx_arm_thread_timer( Threadlist * t, const struct itimerval *it )
+{
+	struct sigevent sev;
+	struct itimerspec its;
+	int clock = ( _papi_os_info.itimer_num == ITIMER_REAL ) ?
+		CLOCK_MONOTONIC : CLOCK_THREAD_CPUTIME_ID;
+
+	if ( t->timer_state < 0 )
+		return PAPI_ECMP;
+
+	/* PAPI_DEF_ITIMER changed the signal or clock since it was made */
+	if ( ( t->timer_state > 0 ) && ( it != &itimestop ) &&
+	     ( ( t->timer_sig != _papi_os_info.itimer_sig ) ||
+	       ( t->timer_clock != clock ) ) ) {
+		syscall( __NR_timer_delete, t->timer );
+		t->timer_state = 0;
+	}
+
+	if ( t->timer_state == 0 ) {
+		memset( &sev, 0, sizeof ( sev ) );
+		sev.sigev_notify = SIGEV_THREAD_ID;
+		sev.sigev_signo = _papi_os_info.itimer_sig;
+		sev.sigev_value.sival_ptr = t;
+		t->ktid = ( int ) syscall( __NR_gettid );
+		sev.sigev_notify_thread_id = t->ktid;
+		if ( syscall( __NR_timer_create, clock, &sev, &t->timer ) == -1 ) {
+			MPXDBG( "timer_create errno %d, using the itimer\n", errno );
+			t->timer_state = -1;
+			return PAPI_ECMP;
+		}
+		t->timer_sig = _papi_os_info.itimer_sig;
+		t->timer_clock = clock;
+		t->timer_state = 1;
+	}
+
+	its.it_interval.tv_sec = it->it_interval.tv_sec;
+	its.it_interval.tv_nsec = it->it_interval.tv_usec * 1000;
+	its.it_value.tv_sec = it->it_value.tv_sec;
+	its.it_value.tv_nsec = it->it_value.tv_usec * 1000;
+	if ( syscall( __NR_timer_settime, t->timer, 0, &its, NULL ) == -1 ) {
+		PAPIERROR( "timer_settime errno %d", errno );
+		return PAPI_ESYS;
+	}
+	return PAPI_OK;
+}
+#endif
+
 static int
-mpx_startup_itimer( void )
+mpx_startup_itimer( Threadlist * t )
 {
 	struct sigaction sigact;
 
 	/* Set up the signal handler and the timer that triggers it */
 
 	MPXDBG( "PID %d\n", getpid(  ) );
+
+	/* PAPI_DEF_ITIMER may have picked another signal or time slice
+	 * since mpx_init; we are called with the old signal held */
+	if ( !sigismember( &sigreset, _papi_os_info.itimer_sig ) ) {
+		mpx_release(  );
+		mpx_init_timers( _papi_os_info.itimer_ns / 1000 );
+		mpx_hold(  );
+	} else {
+		mpx_init_timers( _papi_os_info.itimer_ns / 1000 );
+	}
+
 	memset( &sigact, 0, sizeof ( sigact ) );
-	sigact.sa_flags = SA_RESTART;
-	sigact.sa_handler = mpx_handler;
+	sigact.sa_flags = SA_RESTART | SA_SIGINFO;
+	sigact.sa_sigaction = mpx_handler;
 
 	if ( sigaction( _papi_os_info.itimer_sig, &sigact, NULL ) == -1 ) {
 		PAPIERROR( "sigaction start errno %d", errno );
 		return PAPI_ESYS;
 	}
 
+#ifdef MPX_THREAD_TIMERS
+	if ( mpx_arm_thread_timer( t, &itime ) == PAPI_OK )
+		return PAPI_OK;
+#else
+	( void ) t;
+#endif
+
 	if ( setitimer( _papi_os_info.itimer_num, &itime, NULL ) == -1 ) {
 		sigaction( _papi_os_info.itimer_sig, &oaction, NULL );
 		PAPIERROR( "setitimer start errno %d", errno );
@@ -253,9 +344,31 @@ mpx_restore_signal( void )
 	}
 }
 
+/* Throw away the signals pending for this thread; it must be held. */
+static void
+mpx_drain_signal( void )
+{
+	struct timespec zero = { 0, 0 };
+
+	while ( sigtimedwait( &sigreset, NULL, &zero ) > 0 )
+		MPXDBG( "dropped a pending signal\n" );
+}
+
+/* Stop the timer driving thread t, or the process itimer if t is
+ * NULL or has no timer of its own.
+ */
 static void
-mpx_shutdown_itimer( void )
+mpx_shutdown_itimer( Threadlist * t )
 {
+#ifdef MPX_THREAD_TIMERS
+	if ( ( t != NULL ) && ( t->timer_state > 0 ) ) {
+		MPXDBG( "thread timer off\n" );
+		mpx_arm_thread_timer( t, &itimestop );
+		return;
+	}
+#else
+	( void ) t;
+#endif
 	MPXDBG( "setitimer off\n" );
 	if ( _papi_os_info.itimer_num != PAPI_NULL ) {
 		if ( setitimer( _papi_os_info.itimer_num,
@@ -264,6 +377,26 @@ mpx_shutdown_itimer( void )
 	}
 }
 
+#ifdef MPX_THREAD_TIMERS
+/* Check the record a thread timer signal carries before using it.
+ * Only the thread that armed a timer receives its signals, and
+ * MPX_shutdown clears the magic and deletes every timer, then discards
+ * the signals still pending, before it frees a record, so this needs
+ * no lock and no walk of the thread list.
+ */
+static Threadlist *
+mpx_timer_thread( void *ptr )
+{
+	Threadlist *t = ( Threadlist * ) ptr;
+
+	if ( ( __atomic_load_n( &t->magic, __ATOMIC_ACQUIRE ) == MPX_THREAD_MAGIC ) &&
+	     ( t->timer_state > 0 ) &&
+	     ( t->ktid == ( int ) syscall( __NR_gettid ) ) )
+		return t;
+	return NULL;
+}
+#endif
+
 static MasterEvent *
 get_my_threads_master_event_list( void )
 {
@@ -342,6 +475,14 @@ mpx_add_event( MPX_EventSet ** mpx_events, int EventCode, int domain,
 
 		t->head = NULL;
 		t->cur_event = NULL;
+		t->ticks_left = 0;
+		t->total_c = 0;
+		t->timer = 0;
+		t->timer_state = 0;
+		t->timer_sig = 0;
+		t->timer_clock = 0;
+		t->ktid = 0;
+		t->magic = MPX_THREAD_MAGIC;
 		t->next = tlist;
 		tlist = t;
 		MPXDBG( "New head is at %p(%lu).\n", tlist,
@@ -424,11 +565,6 @@ mpx_remove_event( MPX_EventSet ** mpx_events, int EventCode )
 	return ( PAPI_OK );
 }
 
-#ifdef MPX_DEBUG_TIMER
-static long long lastcall;
-#endif
-
-
 #ifdef _POWER6
 /* POWER6 can always count PM_RUN_CYC on counter 6 in domain
    PAPI_DOM_ALL, and can count it on other domains on counters
@@ -441,95 +577,110 @@ int _PNE_PM_RUN_CYC;
 #endif
 
 
+/* Record one slice's rate for the error estimate of PAPI_read_estimates */
+inline_static void
+mpx_add_sample( MasterEvent * mev, double x )
+{
+	mev->slices++;
+	mev->rate_sum += x;
+	mev->rate_sum2 += x * x;
+}
+
+/* Squared coefficient of variation of an event's slice rates, or -1
+ * if there are too few slices to tell.
+ */
+static double
+mpx_cv2( long long n, double sum, double sum2 )
+{
+	double mean, var;
+
+	if ( n < 2 || sum == 0.0 )
+		return -1.0;
+	mean = sum / ( double ) n;
+	var = ( sum2 - sum * mean ) / ( double ) ( n - 1 );
+	if ( var < 0.0 )
+		var = 0.0;
+	return var / ( mean * mean );
+}
+
+/* Timer ticks the next slice of mev should last.  Events that asked
+ * for adaptive slices get about as many ticks as their coefficient of
+ * variation is multiple of the average over the thread's adaptive
+ * events, so time goes where the estimates are noisiest.  Compares
+ * squares to stay clear of sqrt() in the signal handler.
+ */
+static int
+mpx_slice_ticks( MasterEvent * mev, MasterEvent * head )
+{
+	MasterEvent *e;
+	double cv2, sum = 0.0;
+	int n = 0, ticks;
+
+	if ( ( mev == NULL ) || ( mev->adaptive == 0 ) )
+		return 1;
+	cv2 = mpx_cv2( mev->slices, mev->rate_sum, mev->rate_sum2 );
+	if ( cv2 <= 0.0 )
+		return 1;
+
+	for ( e = head; e != NULL; e = e->next ) {
+		double c;
+
+		if ( !e->active || !e->adaptive )
+			continue;
+		c = mpx_cv2( e->slices, e->rate_sum, e->rate_sum2 );
+		if ( c >= 0.0 ) {
+			sum += c;
+			n++;
+		}
+	}
+	if ( sum <= 0.0 )
+		return 1;
+
+	/* ticks = cv / mean cv rounded and clamped, compared as squares */
+	cv2 *= ( double ) n / sum;
+	for ( ticks = 1; ticks < MPX_MAX_TICKS; ticks++ ) {
+		if ( cv2 < ( ticks + 0.5 ) * ( ticks + 0.5 ) )
+			break;
+	}
+	return ticks;
+}
+
 static void
-mpx_handler( int signal )
+mpx_handler( int signal, siginfo_t * info, void *context )
 {
 	int retval;
 	MasterEvent *mev, *head;
 	Threadlist *me = NULL;
-#ifdef REGENERATE
-	int lastthread;
-#endif
+	int timed = 0;
 #ifdef MPX_DEBUG_OVERHEAD
 	long long usec;
 	int didwork = 0;
 	usec = PAPI_get_real_usec(  );
 #endif
-#ifdef MPX_DEBUG_TIMER
-	long long thiscall;
-#endif
 
-	signal = signal;		 /* unused */
+	( void ) signal;		 /* unused */
+	( void ) context;
 
 	MPXDBG( "Handler in thread\n" );
 
-	/* This handler can be invoked either when a timer expires
-	 * or when another thread in this handler responding to the
-	 * timer signals other threads.  We have to distinguish
-	 * these two cases so that we don't get infinite loop of 
-	 * handler calls.  To do that, we look at the value of
-	 * threads_responding.  We assume that only one thread can
-	 * be active in this signal handler at a time, since the
-	 * invoking signal is blocked while the handler is active.
-	 * If threads_responding == 0, the current thread caught
-	 * the original timer signal.  (This thread may not have
-	 * any active event lists itself, though.)  This first
-	 * thread sends a signal to each of the other threads in
-	 * our list of threads that have master events lists.  If
-	 * threads_responding != 0, then this thread was signaled
-	 * by another thread.  We decrement that value and look
-	 * for an active events.  threads_responding should
-	 * reach zero when all active threads have handled their
-	 * signal.  It's probably possible for a thread to die
-	 * before it responds to a signal; if that happens,
-	 * threads_responding won't reach zero until the next
-	 * timer signal happens.  Then the signalled thread won't
-	 * signal any other threads.  If that happens only
-	 * occasionally, there should be no harm.  Likewise if
-	 * a new thread is added that fails to get signalled.
-	 * As for locking, we have to lock this list to prevent
-	 * another thread from modifying it, but if *this* thread
-	 * is trying to update the list (from another function) and
-	 * is signaled while it holds the lock, we will have deadlock.
-	 * Therefore, noninterrupt functions that update *this* list
-	 * must disable the signal that invokes this handler.
+	/* A thread timer signals only the thread that armed it and
+	 * carries that thread's record, so there is nothing to forward
+	 * and no shared state to lock.  With the process itimer any
+	 * thread may catch the signal and we have to find out whose
+	 * events to rotate.
 	 */
-
-#ifdef PTHREADS
-	_papi_hwi_lock( MULTIPLEX_LOCK );
-
-	if ( threads_responding == 0 ) {	/* this thread caught the timer sig */
-		/* Signal the other threads with event lists */
-#ifdef MPX_DEBUG_TIMER
-		thiscall = _papi_hwd_get_real_usec(  );
-		MPXDBG( "last signal was %lld usec ago\n", thiscall - lastcall );
-		lastcall = thiscall;
-#endif
-		MPXDBG( "%#x caught it, tlist is %p\n", self, tlist );
-		for ( t = tlist; t != NULL; t = t->next ) {
-			if ( pthread_equal( t->thr, self ) == 0 ) {
-				++threads_responding;
-				retval = pthread_kill( t->thr, _papi_os_info.itimer_sig );
-				assert( retval == 0 );
-#ifdef MPX_DEBUG_SIGNALS
-				MPXDBG( "%#x signaling %#x\n", self, t->thr );
-#endif
-			}
-		}
-	} else {
-#ifdef MPX_DEBUG_SIGNALS
-		MPXDBG( "%#x was tapped, tr = %d\n", self, threads_responding );
-#endif
-		--threads_responding;
-	}
-#ifdef REGENERATE
-	lastthread = ( threads_responding == 0 );
-#endif
-	_papi_hwi_unlock( MULTIPLEX_LOCK );
+#ifdef MPX_THREAD_TIMERS
+	if ( ( info != NULL ) && ( info->si_code == SI_TIMER ) &&
+		 ( info->si_value.sival_ptr != NULL ) ) {
+		timed = 1;
+		me = mpx_timer_thread( info->si_value.sival_ptr );
+		head = ( me != NULL ) ? me->head : NULL;
+	} else
+#else
+	( void ) info;
 #endif
-
-	/* See if this thread has an active event list */
 	head = get_my_threads_master_event_list(  );
+
 	if ( head != NULL ) {
 
 		/* Get the thread header for this master event set.  It's
@@ -570,6 +721,7 @@ mpx_handler( int signal )
 					if ( cycles >= MPX_MINCYC ) {	/* Only update current rate on a decent slice */
 						cur_event->rate_estimate =
 							( double ) counts[0] / ( double ) cycles;
+						mpx_add_sample( cur_event, cur_event->rate_estimate );
 					}
 					cur_event->count_estimate +=
 						( long long ) ( ( double ) total_cycles *
@@ -584,6 +736,7 @@ mpx_handler( int signal )
 					 */
 					if ( cycles >= MPX_MINCYC ) {
 						cur_event->cycles += 1;
+						mpx_add_sample( cur_event, ( double ) counts[0] );
 					} else {
 						cur_event->count -= counts[0];
 					}
@@ -605,7 +758,12 @@ mpx_handler( int signal )
 			 * but only after considerating all the other
 			 * possible events.
 			 */
-			if ( ( retval != PAPI_OK ) ||
+			if ( ( retval == PAPI_OK ) && ( cycles >= MPX_MINCYC ) &&
+				 ( --me->ticks_left > 0 ) ) {
+				/* A noisy adaptive event keeps the counters
+				 * for another tick.
+				 */
+			} else if ( ( retval != PAPI_OK ) ||
 				 ( ( retval == PAPI_OK ) && ( cycles >= MPX_MINCYC ) ) ) {
 				for ( mev =
 					  ( cur_event->next == NULL ) ? head : cur_event->next;
@@ -617,6 +775,7 @@ mpx_handler( int signal )
 						break;
 					}
 				}
+				me->ticks_left = mpx_slice_ticks( me->cur_event, head );
 			}
 
 			if ( me->cur_event->active ) {
@@ -628,7 +787,7 @@ mpx_handler( int signal )
 		}
 	}
 #ifdef ANY_THREAD_GETS_SIGNAL
-	else {
+	else if ( !timed ) {
 		Threadlist *t;
 		for ( t = tlist; t != NULL; t = t->next ) {
 			if ( ( t->tid == _papi_hwi_thread_id_fn(  ) ) ||
@@ -655,15 +814,19 @@ mpx_handler( int signal )
 	 * accurate data collection.  However, using the
 	 * MIN_CYCLES check above should alleviate this.
 	 */
-	/* Reset the timer once all threads have responded */
-	if ( lastthread ) {
+	/* Reset the timer that brought us here */
+#ifdef MPX_THREAD_TIMERS
+	if ( timed ) {
+		if ( me != NULL )
+			mpx_arm_thread_timer( me, &itime );
+	} else
+#endif
+	{
 		retval = setitimer( _papi_os_info.itimer_num, &itime, NULL );
 		assert( retval == 0 );
-#ifdef MPX_DEBUG_TIMER
-		MPXDBG( "timer restarted by %lx\n", me->tid );
-#endif
 	}
 #endif
+	( void ) timed;
 
 #ifdef MPX_DEBUG_OVERHEAD
 	usec = _papi_hwd_get_real_usec(  ) - usec;
@@ -689,7 +852,7 @@ MPX_add_events( MPX_EventSet ** mpx_events, int *event_list, int num_events,
 }
 
 int
-MPX_start( MPX_EventSet * mpx_events )
+MPX_start( MPX_EventSet * mpx_events, int flags )
 {
 	int retval = PAPI_OK;
 	int i;
@@ -721,9 +884,12 @@ MPX_start( MPX_EventSet * mpx_events )
 	/* Make all events in this set active, and for those
 	 * already active, get the current count and cycles.
 	 */
+	mpx_events->adaptive = ( ( flags & PAPI_MULTIPLEX_ADAPTIVE ) != 0 );
+
 	for ( i = 0; i < mpx_events->num_events; i++ ) {
 		MasterEvent *mev = mpx_events->mev[i];
 
+		mev->adaptive += mpx_events->adaptive;
 		if ( mev->active++ ) {
 			mpx_events->start_values[i] = mev->count_estimate;
 			mpx_events->start_hc[i] = mev->cycles;
@@ -770,7 +936,14 @@ MPX_start( MPX_EventSet * mpx_events )
 			mev->rate_estimate = 0.0;
 			mev->prev_total_c = current_thread_mpx_c;
 			mev->count = 0;
+			mev->slices = 0;
+			mev->rate_sum = mev->rate_sum2 = 0.0;
 		}
+		mpx_events->start_slices[i] = mpx_events->stop_slices[i] =
+			mev->slices;
+		mpx_events->start_sum[i] = mpx_events->stop_sum[i] = mev->rate_sum;
+		mpx_events->start_sum2[i] = mpx_events->stop_sum2[i] =
+			mev->rate_sum2;
 		/* Adjust start value to include events and cycles
 		 * counted previously for this event set.
 		 */
@@ -783,6 +956,7 @@ MPX_start( MPX_EventSet * mpx_events )
 		/* Pick an events at random to start. */
 		int index = ( rand_r( &randomseed ) % mpx_events->num_events );
 		t->cur_event = mpx_events->mev[index];
+		t->ticks_left = 1;
 		t->total_c = 0;
 		t->cur_event->prev_total_c = 0;
 		mpx_events->start_c = 0;
@@ -814,7 +988,7 @@ MPX_start( MPX_EventSet * mpx_events )
 
 	mpx_release(  );
 
-	retval = mpx_startup_itimer(  );
+	retval = mpx_startup_itimer( t );
 
 	return retval;
 }
@@ -856,6 +1030,9 @@ MPX_read( MPX_EventSet * mpx_events, long long *values, int called_by_stop )
 			else {
 				mpx_events->stop_values[i] = mev->count;
 			}
+			mpx_events->stop_slices[i] = mev->slices;
+			mpx_events->stop_sum[i] = mev->rate_sum;
+			mpx_events->stop_sum2[i] = mev->rate_sum2;
 #ifdef MPX_NONDECR_HYBRID
 			/* If we are called from MPX_stop() then      */
                         /* adjust the final values based on the       */
@@ -933,6 +1110,76 @@ MPX_read( MPX_EventSet * mpx_events, long long *values, int called_by_stop )
 	return PAPI_OK;
 }
 
+/* Square root by Newton's method, libpapi does not link libm */
+static double
+mpx_sqrt( double x )
+{
+	double r;
+	int i;
+
+	if ( x <= 0.0 )
+		return 0.0;
+	r = x > 1.0 ? x : 1.0;
+	for ( i = 0; i < 64; i++ ) {
+		double next = 0.5 * ( r + x / r );
+		if ( next >= r )
+			break;
+		r = next;
+	}
+	return r;
+}
+
+/* Like MPX_read, but also bound each value by the spread of the
+ * per-slice rates it was extrapolated from.  The standard error of
+ * the mean rate is scaled by the cycles the value covers, and the
+ * interval is mean +/- 1.96 standard errors.
+ */
+int
+MPX_read_estimates( MPX_EventSet * mpx_events, long long *values,
+		    PAPI_estimate_t * estimates )
+{
+	int i, retval;
+	long long n;
+	double sum, sum2, mean, var, se, scale;
+
+	retval = MPX_read( mpx_events, values, 0 );
+	if ( retval != PAPI_OK )
+		return retval;
+
+	for ( i = 0; i < mpx_events->num_events; i++ ) {
+		MasterEvent *mev = mpx_events->mev[i];
+
+		n = mpx_events->stop_slices[i] - mpx_events->start_slices[i];
+		sum = mpx_events->stop_sum[i] - mpx_events->start_sum[i];
+		sum2 = mpx_events->stop_sum2[i] - mpx_events->start_sum2[i];
+
+		estimates[i].value = values[i];
+		estimates[i].slices = ( int ) n;
+		if ( n < 2 ) {
+			estimates[i].std_error = -1;
+			estimates[i].low = estimates[i].high = values[i];
+			continue;
+		}
+
+		mean = sum / ( double ) n;
+		var = ( sum2 - sum * mean ) / ( double ) ( n - 1 );
+		se = mpx_sqrt( var / ( double ) n );
+
+		/* rates are averaged per slice, counts cover the cycles */
+		scale = mev->is_a_rate ? 1.0 :
+			( double ) ( mpx_events->stop_c - mpx_events->start_c );
+		se *= scale;
+
+		estimates[i].std_error = ( long long ) ( se + 0.5 );
+		estimates[i].low = values[i] - ( long long ) ( 1.96 * se );
+		if ( estimates[i].low < 0 )
+			estimates[i].low = 0;
+		estimates[i].high = values[i] + ( long long ) ( 1.96 * se );
+	}
+
+	return PAPI_OK;
+}
+
 int
 MPX_reset( MPX_EventSet * mpx_events )
 {
@@ -959,6 +1206,9 @@ MPX_reset( MPX_EventSet * mpx_events )
 			mpx_events->start_values[i] += values[i];
 		}
 		mpx_events->start_hc[i] = mev->cycles;
+		mpx_events->start_slices[i] = mpx_events->stop_slices[i];
+		mpx_events->start_sum[i] = mpx_events->stop_sum[i];
+		mpx_events->start_sum2[i] = mpx_events->stop_sum2[i];
 	}
 
 	/* Set the start time for this set to the current cycle count */
@@ -1015,6 +1265,7 @@ MPX_stop( MPX_EventSet * mpx_events, long long *values )
 	cur_mpx_event = -1;
 	for ( i = 0; i < mpx_events->num_events; i++ ) {
 		--mpx_events->mev[i]->active;
+		mpx_events->mev[i]->adaptive -= mpx_events->adaptive;
 		if ( mpx_events->mev[i] == cur_event )
 			cur_mpx_event = i;
 	}
@@ -1047,10 +1298,11 @@ MPX_stop( MPX_EventSet * mpx_events, long long *values )
 			}
 
 			if ( thr->cur_event != NULL ) {
+				thr->ticks_left = 1;
 				retval = PAPI_start( thr->cur_event->papi_event );
 				assert( retval == PAPI_OK );
 			} else {
-				mpx_shutdown_itimer(  );
+				mpx_shutdown_itimer( thr );
 			}
 		}
 	}
@@ -1101,19 +1353,39 @@ MPX_cleanup( MPX_EventSet ** mpx_events )
 void
 MPX_shutdown( void )
 {
-	MPXDBG( "%d\n", getpid(  ) );
-	mpx_shutdown_itimer(  );
-	mpx_restore_signal(  );
+	Threadlist *next, *t;
 
-	if ( tlist ) {
-	       Threadlist *next,*t=tlist;
+	MPXDBG( "%d\n", getpid(  ) );
 
-		while(t!=NULL) {
-		   next=t->next;
-		   papi_free( t );
-		   t = next;			
+	/* Unlink the records, delete their timers and discard the
+	 * signals still queued before freeing them, so a handler never
+	 * sees a record that is gone.
+	 */
+	mpx_hold(  );
+	_papi_hwi_lock( MULTIPLEX_LOCK );
+	mpx_shutdown_itimer( NULL );
+	t = tlist;
+	tlist = NULL;
+	for ( next = t; next != NULL; next = next->next ) {
+#ifdef MPX_THREAD_TIMERS
+		if ( next->timer_state > 0 ) {
+			syscall( __NR_timer_delete, next->timer );
+			next->timer_state = 0;
 		}
-		tlist = NULL;
+#endif
+		__atomic_store_n( &next->magic, 0, __ATOMIC_RELEASE );
+	}
+	_papi_hwi_unlock( MULTIPLEX_LOCK );
+
+	/* Ignoring the signal discards what is pending in other threads */
+	mpx_drain_signal(  );
+	mpx_restore_signal(  );
+	mpx_release(  );
+
+	while ( t != NULL ) {
+		next = t->next;
+		papi_free( t );
+		t = next;
 	}
 }
 
@@ -1162,7 +1434,7 @@ mpx_init( int interval_ns )
 #endif
 	tlist = NULL;
 	mpx_hold(  );
-	mpx_shutdown_itimer(  );
+	mpx_shutdown_itimer( NULL );
 	mpx_init_timers( interval_ns / 1000 );
 
 	return ( PAPI_OK );
@@ -1216,6 +1488,9 @@ mpx_insert_events( MPX_EventSet *mpx_events, int *event_list,
 		   mev->rate_estimate = 0.0;
 		   mev->count_estimate = 0;
 		   mev->is_a_rate = 0;
+		   mev->slices = 0;
+		   mev->rate_sum = mev->rate_sum2 = 0.0;
+		   mev->adaptive = 0;
 		   mev->papi_event = PAPI_NULL;
 			
 		   retval = PAPI_create_eventset( &( mev->papi_event ) );
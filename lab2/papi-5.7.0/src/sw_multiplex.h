@@ -26,6 +26,13 @@ typedef struct _MPX_EventSet {
   long long start_values[PAPI_MAX_SW_MPX_EVENTS];
   long long stop_values[PAPI_MAX_SW_MPX_EVENTS];
   long long start_hc[PAPI_MAX_SW_MPX_EVENTS];
+  /** Rate sample sums of each event at start and at the last read */
+  long long start_slices[PAPI_MAX_SW_MPX_EVENTS];
+  long long stop_slices[PAPI_MAX_SW_MPX_EVENTS];
+  double start_sum[PAPI_MAX_SW_MPX_EVENTS], start_sum2[PAPI_MAX_SW_MPX_EVENTS];
+  double stop_sum[PAPI_MAX_SW_MPX_EVENTS], stop_sum2[PAPI_MAX_SW_MPX_EVENTS];
+  /** Started with PAPI_MULTIPLEX_ADAPTIVE */
+  int adaptive;
 } MPX_EventSet;
 
 typedef struct EventSetMultiplexInfo {
@@ -46,6 +53,8 @@ int MPX_cleanup( MPX_EventSet ** mpx_events );
 void MPX_shutdown( void );
 int MPX_reset( MPX_EventSet * mpx_events );
 int MPX_read( MPX_EventSet * mpx_events, long long *values, int called_by_stop );
-int MPX_start( MPX_EventSet * mpx_events );
+int MPX_read_estimates( MPX_EventSet * mpx_events, long long *values,
+			PAPI_estimate_t * estimates );
+int MPX_start( MPX_EventSet * mpx_events, int flags );
 
 #endif /* MULTIPLEX_H */
@@ -18,6 +18,9 @@
 #include "papi_memory.h"
 #include <string.h>
 #include <unistd.h>
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+#include <pthread.h>
+#endif
 
 /*****************/
 /* BEGIN GLOBALS */
@@ -27,16 +30,36 @@
    extern int _papi_hwi_init_global_threads(void);
    extern int _papi_hwi_shutdown_thread(ThreadInfo_t *thread); */
 
-/* list of threads, gets initialized to master process with TID of getpid() */
+/* table of threads, gets initialized to master process with TID of getpid() */
+
+ThreadTable_t *volatile _papi_hwi_thread_table;
 
-volatile ThreadInfo_t *_papi_hwi_thread_head;
+ThreadInfo_t *_papi_hwi_thread_master;
 
 /* If we have TLS, this variable ALWAYS points to our thread descriptor. It's like magic! */
 
 #if defined(HAVE_THREAD_LOCAL_STORAGE)
 THREAD_LOCAL_STORAGE_KEYWORD ThreadInfo_t *_papi_hwi_my_thread;
+
+/* The hazard record this thread publishes its lookups in */
+
+THREAD_LOCAL_STORAGE_KEYWORD ThreadHazard_t *_papi_hwi_my_hazard;
+#endif
+
+/* Every hazard record handed out, never shrinks; records whose thread
+   has exited are marked free for the next new thread */
+
+static ThreadHazard_t *volatile thread_hazards;
+
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+static pthread_key_t thread_hazard_key;
+static pthread_once_t thread_hazard_once = PTHREAD_ONCE_INIT;
 #endif
 
+/* Removed threads not freed yet, protected by THREADS_LOCK */
+
+static ThreadInfo_t *retired_threads;
+
 /* Function that returns and unsigned long thread identifier */
 
 unsigned long ( *_papi_hwi_thread_id_fn ) ( void );
@@ -182,31 +205,289 @@ free_thread( ThreadInfo_t ** thread )
 	*thread = NULL;
 }
 
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+/* At thread exit, give the record back for the next thread to claim */
+static void
+release_thread_hazard( void *arg )
+{
+	ThreadHazard_t *hazard = ( ThreadHazard_t * ) arg;
+
+	if ( _papi_hwi_my_hazard == hazard )
+		_papi_hwi_my_hazard = NULL;
+	__atomic_store_n( &hazard->thread, NULL, __ATOMIC_SEQ_CST );
+	__atomic_store_n( &hazard->table, NULL, __ATOMIC_SEQ_CST );
+	__atomic_store_n( &hazard->in_use, 0, __ATOMIC_RELEASE );
+}
+
+static void
+thread_hazard_key_create( void )
+{
+	pthread_key_create( &thread_hazard_key, release_thread_hazard );
+}
+#endif
+
+ThreadHazard_t *
+_papi_hwi_new_thread_hazard( void )
+{
+	ThreadHazard_t *hazard, *head;
+
+	for ( hazard = __atomic_load_n( &thread_hazards, __ATOMIC_ACQUIRE );
+		  hazard != NULL; hazard = hazard->next ) {
+		if ( ( hazard->in_use == 0 ) &&
+			 __sync_bool_compare_and_swap( &hazard->in_use, 0, 1 ) )
+			break;
+	}
+
+	if ( hazard == NULL ) {
+		/* Plain calloc: a record outlives PAPI_shutdown, which frees all */
+		/* papi_malloc memory, since the thread's TLS still points at it  */
+		hazard = ( ThreadHazard_t * ) calloc( 1, sizeof ( ThreadHazard_t ) );
+		if ( hazard == NULL )
+			return ( NULL );
+		hazard->in_use = 1;
+
+		head = __atomic_load_n( &thread_hazards, __ATOMIC_ACQUIRE );
+		do {
+			hazard->next = head;
+		} while ( !__atomic_compare_exchange_n( &thread_hazards, &head, hazard, 0,
+							__ATOMIC_RELEASE, __ATOMIC_ACQUIRE ) );
+	}
+
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	pthread_once( &thread_hazard_once, thread_hazard_key_create );
+	pthread_setspecific( thread_hazard_key, hazard );
+#endif
+
+	return ( hazard );
+}
+
+static int
+thread_is_hazard( ThreadInfo_t * thread )
+{
+	ThreadHazard_t *hazard;
+
+	for ( hazard = __atomic_load_n( &thread_hazards, __ATOMIC_ACQUIRE );
+		  hazard != NULL; hazard = hazard->next ) {
+		if ( __atomic_load_n( &hazard->thread, __ATOMIC_SEQ_CST ) == thread )
+			return ( 1 );
+	}
+	return ( 0 );
+}
+
+static int
+table_is_hazard( ThreadTable_t * table )
+{
+	ThreadHazard_t *hazard;
+
+	for ( hazard = __atomic_load_n( &thread_hazards, __ATOMIC_ACQUIRE );
+		  hazard != NULL; hazard = hazard->next ) {
+		if ( __atomic_load_n( &hazard->table, __ATOMIC_SEQ_CST ) == table )
+			return ( 1 );
+	}
+	return ( 0 );
+}
+
+/* Must be called with THREADS_LOCK held.  Free the retired tables no
+   lookup is probing; a lookup can only start on the current table. */
+
+static void
+free_unused_tables( void )
+{
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	ThreadTable_t **prev, *tmp;
+
+	if ( _papi_hwi_thread_table == NULL )
+		return;
+
+	prev = &_papi_hwi_thread_table->retired;
+	while ( ( tmp = *prev ) != NULL ) {
+		if ( table_is_hazard( tmp ) ) {
+			prev = &tmp->retired;
+			continue;
+		}
+		*prev = tmp->retired;
+		THRDBG( "Freeing retired thread table %p\n", tmp );
+		papi_free( tmp );
+	}
+#endif
+}
+
+/* Queue a thread that is out of the table for freeing, then free the
+   retired threads no lookup holds any more.  Without TLS there are no
+   hazard records, so they all wait for free_retired_threads. */
+
+static void
+retire_thread( ThreadInfo_t * thread )
+{
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	ThreadInfo_t **prev, *tmp;
+#endif
+
+	_papi_hwi_lock( THREADS_LOCK );
+
+	thread->retired_next = retired_threads;
+	retired_threads = thread;
+
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	prev = &retired_threads;
+	while ( ( tmp = *prev ) != NULL ) {
+		if ( thread_is_hazard( tmp ) ) {
+			prev = &tmp->retired_next;
+			continue;
+		}
+		*prev = tmp->retired_next;
+		free_thread( &tmp );
+	}
+#endif
+	free_unused_tables(  );
+
+	_papi_hwi_unlock( THREADS_LOCK );
+}
+
+/* At global shutdown: nothing looks threads up any more */
+
+static void
+free_retired_threads( void )
+{
+	ThreadHazard_t *hazard;
+	ThreadInfo_t *tmp;
+
+	while ( ( tmp = retired_threads ) != NULL ) {
+		retired_threads = tmp->retired_next;
+		free_thread( &tmp );
+	}
+
+	for ( hazard = thread_hazards; hazard != NULL; hazard = hazard->next ) {
+		hazard->thread = NULL;
+		hazard->table = NULL;
+	}
+}
+
+#define THREAD_TABLE_MIN_SLOTS 64
+
+static ThreadTable_t *
+allocate_thread_table( unsigned long nslots )
+{
+	ThreadTable_t *table;
+	unsigned long i;
+
+	table = ( ThreadTable_t * ) papi_calloc( 1, sizeof ( ThreadTable_t ) +
+						  nslots * sizeof ( ThreadSlot_t ) );
+	if ( table == NULL )
+		return ( NULL );
+	table->mask = nslots - 1;
+	for ( i = 0; i < nslots; i++ )
+		table->slots[i].tid = PAPI_THREAD_SLOT_EMPTY;
+
+	return table;
+}
+
+/* Find the slot for tid: the slot already holding it, live or removed,
+   otherwise the empty slot ending its probe sequence. */
+
+static ThreadSlot_t *
+find_thread_slot( ThreadTable_t * table, unsigned long tid )
+{
+	unsigned long i;
+
+	for ( i = _papi_hwi_hash_tid( tid ) & table->mask;; i = ( i + 1 ) & table->mask ) {
+		if ( ( table->slots[i].tid == tid ) ||
+			 ( table->slots[i].tid == PAPI_THREAD_SLOT_EMPTY ) )
+			return ( &table->slots[i] );
+	}
+}
+
+/* Must be called with THREADS_LOCK held.  The new table only gets the
+   live threads, so it also sheds the removed ones. */
+
+static int
+grow_thread_table( void )
+{
+	ThreadTable_t *old = _papi_hwi_thread_table, *table;
+	ThreadSlot_t *slot;
+	unsigned long i, nslots = THREAD_TABLE_MIN_SLOTS;
+
+	while ( nslots < ( ( old ? old->live + 1 : 1 ) * 4 ) )
+		nslots <<= 1;
+
+	table = allocate_thread_table( nslots );
+	if ( table == NULL )
+		return ( PAPI_ENOMEM );
+
+	if ( old ) {
+		for ( i = 0; i <= old->mask; i++ ) {
+			if ( old->slots[i].thread == NULL )
+				continue;
+			slot = find_thread_slot( table, old->slots[i].tid );
+			slot->thread = old->slots[i].thread;
+			slot->tid = old->slots[i].tid;
+			table->used++;
+			table->live++;
+		}
+	}
+	table->retired = old;
+
+	/* Ordered before free_unused_tables reads the hazards */
+	__atomic_store_n( &_papi_hwi_thread_table, table, __ATOMIC_SEQ_CST );
+
+	THRDBG( "Thread table now %ld slots at %p\n", nslots, table );
+
+	free_unused_tables(  );
+
+	return ( PAPI_OK );
+}
+
 static void
+free_thread_tables( void )
+{
+	ThreadTable_t *table, *retired;
+
+	for ( table = _papi_hwi_thread_table; table != NULL; table = retired ) {
+		retired = table->retired;
+		papi_free( table );
+	}
+	_papi_hwi_thread_table = NULL;
+}
+
+static int
 insert_thread( ThreadInfo_t * entry, int tid )
 {
+	ThreadTable_t *table;
+	ThreadSlot_t *slot;
+
+	/* The one tid that cannot be stored */
+	if ( entry->tid == PAPI_THREAD_SLOT_EMPTY )
+		return ( PAPI_EINVAL );
+
 	_papi_hwi_lock( THREADS_LOCK );
 
-	if ( _papi_hwi_thread_head == NULL ) {	/* 0 elements */
-		THRDBG( "_papi_hwi_thread_head is NULL\n" );
-		entry->next = entry;
-	} else if ( _papi_hwi_thread_head->next == _papi_hwi_thread_head ) {	/* 1 elements */
-		THRDBG( "_papi_hwi_thread_head was thread %ld at %p\n",
-				_papi_hwi_thread_head->tid, _papi_hwi_thread_head );
-		_papi_hwi_thread_head->next = entry;
-		entry->next = ( ThreadInfo_t * ) _papi_hwi_thread_head;
-	} else {				 /* 2+ elements */
+	table = _papi_hwi_thread_table;
+	if ( ( table == NULL ) || ( ( table->used + 1 ) * 2 > table->mask + 1 ) ) {
+		if ( grow_thread_table(  ) != PAPI_OK ) {
+			_papi_hwi_unlock( THREADS_LOCK );
+			return ( PAPI_ENOMEM );
+		}
+		table = _papi_hwi_thread_table;
+	}
 
-		THRDBG( "_papi_hwi_thread_head was thread %ld at %p\n",
-				_papi_hwi_thread_head->tid, _papi_hwi_thread_head );
-		entry->next = _papi_hwi_thread_head->next;
-		_papi_hwi_thread_head->next = entry;
+	slot = find_thread_slot( table, entry->tid );
+	if ( slot->thread != NULL ) {
+		THRDBG( "Thread %ld already in the thread table at %p!\n",
+				entry->tid, slot->thread );
+		_papi_hwi_unlock( THREADS_LOCK );
+		return ( PAPI_EBUG );
 	}
 
-	_papi_hwi_thread_head = entry;
+	/* Publish the thread pointer before a new tid makes it reachable */
+	__atomic_store_n( &slot->thread, entry, __ATOMIC_RELEASE );
+	if ( slot->tid == PAPI_THREAD_SLOT_EMPTY ) {
+		__atomic_store_n( &slot->tid, entry->tid, __ATOMIC_RELEASE );
+		table->used++;
+	}
+	table->live++;
 
-	THRDBG( "_papi_hwi_thread_head now thread %ld at %p\n",
-			_papi_hwi_thread_head->tid, _papi_hwi_thread_head );
+	THRDBG( "Thread %ld at %p inserted, %ld live threads\n",
+			entry->tid, entry, table->live );
 
 	_papi_hwi_unlock( THREADS_LOCK );
 
@@ -220,48 +501,43 @@ insert_thread( ThreadInfo_t * entry, int tid )
 #else
 	( void ) tid;
 #endif
+
+	return ( PAPI_OK );
 }
 
 static int
 remove_thread( ThreadInfo_t * entry )
 {
-	ThreadInfo_t *tmp = NULL, *prev = NULL;
+	ThreadTable_t *table;
+	ThreadSlot_t *slot;
+	int found = 0;
 
 	_papi_hwi_lock( THREADS_LOCK );
 
-	THRDBG( "_papi_hwi_thread_head was thread %ld at %p\n",
-			_papi_hwi_thread_head->tid, _papi_hwi_thread_head );
-
-	/* Find the preceding element and the matched element,
-	   short circuit if we've seen the head twice */
-
-	for ( tmp = ( ThreadInfo_t * ) _papi_hwi_thread_head;
-		  ( entry != tmp ) || ( prev == NULL ); tmp = tmp->next ) {
-		prev = tmp;
+	/* Readers may still be probing a retired table, clear it there too */
+	for ( table = _papi_hwi_thread_table; table != NULL; table = table->retired ) {
+		slot = find_thread_slot( table, entry->tid );
+		if ( slot->thread != entry )
+			continue;
+		/* Ordered before retire_thread reads the hazards */
+		__atomic_store_n( &slot->thread, NULL, __ATOMIC_SEQ_CST );
+		if ( table == _papi_hwi_thread_table ) {
+			table->live--;
+			found = 1;
+		}
 	}
 
-	if ( tmp != entry ) {
-		THRDBG( "Thread %ld at %p was not found in the thread list!\n",
+	if ( !found ) {
+		THRDBG( "Thread %ld at %p was not found in the thread table!\n",
 				entry->tid, entry );
+		_papi_hwi_unlock( THREADS_LOCK );
 		return ( PAPI_EBUG );
 	}
 
-	/* Only 1 element in list */
+	if ( _papi_hwi_thread_master == entry )
+		_papi_hwi_thread_master = NULL;
 
-	if ( prev == tmp ) {
-		_papi_hwi_thread_head = NULL;
-		tmp->next = NULL;
-		THRDBG( "_papi_hwi_thread_head now NULL\n" );
-	} else {
-		prev->next = tmp->next;
-		/* If we're removing the head, better advance it! */
-		if ( _papi_hwi_thread_head == tmp ) {
-			_papi_hwi_thread_head = tmp->next;
-			THRDBG( "_papi_hwi_thread_head now thread %ld at %p\n",
-					_papi_hwi_thread_head->tid, _papi_hwi_thread_head );
-		}
-		THRDBG( "Removed thread %p from list\n", tmp );
-	}
+	THRDBG( "Removed thread %p from table\n", entry );
 
 	_papi_hwi_unlock( THREADS_LOCK );
 
@@ -274,6 +550,28 @@ remove_thread( ThreadInfo_t * entry )
 	return PAPI_OK;
 }
 
+/* Copy out the live threads.  Returns how many were found, at most max. */
+
+static int
+snapshot_threads( ThreadInfo_t ** where, int max )
+{
+	ThreadTable_t *table;
+	ThreadInfo_t *thread;
+	unsigned long i;
+	int n = 0;
+
+	table = __atomic_load_n( &_papi_hwi_thread_table, __ATOMIC_ACQUIRE );
+	if ( table == NULL )
+		return ( 0 );
+
+	for ( i = 0; ( i <= table->mask ) && ( n < max ); i++ ) {
+		thread = __atomic_load_n( &table->slots[i].thread, __ATOMIC_ACQUIRE );
+		if ( thread != NULL )
+			where[n++] = thread;
+	}
+	return ( n );
+}
+
 int
 _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid )
 {
@@ -286,24 +584,79 @@ _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid )
 		return PAPI_ENOMEM;
 	}
 
-	/* Call the component to fill in anything special. */
+	/* Call the component to fill in anything special.  A delayed    */
+	/* component is published under CMPINIT_LOCK after it has walked */
+	/* the thread table, so holding it until we are in the table     */
+	/* means each component sees this thread exactly once.           */
+
+	_papi_hwi_lock( CMPINIT_LOCK );
 
 	for ( i = 0; i < papi_num_components; i++ ) {
 	    if (_papi_hwd[i]->cmp_info.disabled) continue;
 	    retval = _papi_hwd[i]->init_thread( thread->context[i] );
 	    if ( retval ) {
+	       _papi_hwi_unlock( CMPINIT_LOCK );
 	       free_thread( &thread );
 	       *dest = NULL;
 	       return retval;
 	    }
 	}
 
-	insert_thread( thread, tid );
+	retval = insert_thread( thread, tid );
+	if ( retval != PAPI_OK ) {
+		for ( i = 0; i < papi_num_components; i++ ) {
+			if (_papi_hwd[i]->cmp_info.disabled) continue;
+			_papi_hwd[i]->shutdown_thread( thread->context[i] );
+		}
+		_papi_hwi_unlock( CMPINIT_LOCK );
+		free_thread( &thread );
+		*dest = NULL;
+		return retval;
+	}
+
+	_papi_hwi_unlock( CMPINIT_LOCK );
 
 	*dest = thread;
 	return PAPI_OK;
 }
 
+/* Call init_thread of a component initialized after the library,
+   for every thread that is already registered. */
+
+int
+_papi_hwi_init_thread_component( int cidx )
+{
+	int retval = PAPI_OK;
+	ThreadTable_t *table;
+	ThreadInfo_t *thread;
+	unsigned long i, j;
+
+	_papi_hwi_lock( THREADS_LOCK );
+
+	table = _papi_hwi_thread_table;
+	for ( i = 0; ( table != NULL ) && ( i <= table->mask ); i++ ) {
+		thread = table->slots[i].thread;
+		if ( thread == NULL )
+			continue;
+		retval = _papi_hwd[cidx]->init_thread( thread->context[cidx] );
+		if ( retval != PAPI_OK )
+			break;
+	}
+
+	/* Undo the threads already done */
+	if ( retval != PAPI_OK ) {
+		for ( j = 0; j < i; j++ ) {
+			thread = table->slots[j].thread;
+			if ( thread != NULL )
+				_papi_hwd[cidx]->shutdown_thread( thread->context[cidx] );
+		}
+	}
+
+	_papi_hwi_unlock( THREADS_LOCK );
+
+	return retval;
+}
+
 #if defined(ANY_THREAD_GETS_SIGNAL)
 
 /* This is ONLY defined for systems that enable ANY_THREAD_GETS_SIGNAL
@@ -315,12 +668,23 @@ _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid )
 int
 _papi_hwi_broadcast_signal( unsigned int mytid )
 {
-	int i, retval, didsomething = 0;
-	volatile ThreadInfo_t *foo = NULL;
+	int i, j, num_threads, retval;
+	ThreadInfo_t *foo = NULL;
+	ThreadInfo_t **threads;
 
 	_papi_hwi_lock( THREADS_LOCK );
 
-	for ( foo = _papi_hwi_thread_head; foo != NULL; foo = foo->next ) {
+	num_threads = ( int ) _papi_hwi_thread_table->live;
+	threads = ( ThreadInfo_t ** ) papi_malloc( sizeof ( ThreadInfo_t * ) *
+						  ( size_t ) num_threads );
+	if ( threads == NULL ) {
+		_papi_hwi_unlock( THREADS_LOCK );
+		return ( PAPI_ENOMEM );
+	}
+	num_threads = snapshot_threads( threads, num_threads );
+
+	for ( j = 0; j < num_threads; j++ ) {
+		foo = threads[j];
 		/* xxxx Should this be hardcoded to index 0 or walk the list or what? */
 		for ( i = 0; i < papi_num_components; i++ ) {
 			if ( ( foo->tid != mytid ) && ( foo->running_eventset[i] ) &&
@@ -332,13 +696,15 @@ _papi_hwi_broadcast_signal( unsigned int mytid )
 				  (foo->running_eventset[i]->state & PAPI_OVERFLOWING ? _papi_hwd[i]->cmp_info.hardware_intr_sig : _papi_os_info.itimer_sig));
 			  retval = (*_papi_hwi_thread_kill_fn)(foo->tid, 
 				  (foo->running_eventset[i]->state & PAPI_OVERFLOWING ? _papi_hwd[i]->cmp_info.hardware_intr_sig : _papi_os_info.itimer_sig));
-			  if (retval != 0)
+			  if (retval != 0) {
+				papi_free( threads );
+				_papi_hwi_unlock( THREADS_LOCK );
 				return(PAPI_EMISC);
+			  }
 			}
 		}
-		if ( foo->next == _papi_hwi_thread_head )
-		  break;
 	}
+	papi_free( threads );
 	_papi_hwi_unlock( THREADS_LOCK );
 
 	return ( PAPI_OK );
@@ -354,7 +720,11 @@ _papi_hwi_set_thread_id_fn( unsigned long ( *id_fn ) ( void ) )
 #if !defined(ANY_THREAD_GETS_SIGNAL)
 	/* Check for multiple threads still in the list, if so, we can't change it */
 
-	if ( _papi_hwi_thread_head->next != _papi_hwi_thread_head )
+	ThreadInfo_t *master = _papi_hwi_thread_master;
+	unsigned long new_tid;
+	int retval;
+
+	if ( ( master == NULL ) || ( _papi_hwi_thread_table->live != 1 ) )
 		return ( PAPI_EINVAL );
 
 	/* We can't change the thread id function from one to another, 
@@ -368,11 +738,23 @@ _papi_hwi_set_thread_id_fn( unsigned long ( *id_fn ) ( void ) )
 	THRDBG( "Set new thread id function to %p\n", id_fn );
 
 	if ( id_fn )
-		_papi_hwi_thread_head->tid = ( *_papi_hwi_thread_id_fn ) (  );
+		new_tid = ( *_papi_hwi_thread_id_fn ) (  );
 	else
-		_papi_hwi_thread_head->tid = ( unsigned long ) getpid(  );
+		new_tid = ( unsigned long ) getpid(  );
+
+	/* The tid is the table key, so re-file the master under its new one */
+	if ( new_tid != master->tid ) {
+		retval = remove_thread( master );
+		if ( retval != PAPI_OK )
+			return ( retval );
+		master->tid = new_tid;
+		retval = insert_thread( master, 0 );
+		if ( retval != PAPI_OK )
+			return ( retval );
+		_papi_hwi_thread_master = master;
+	}
 
-	THRDBG( "New master tid is %ld\n", _papi_hwi_thread_head->tid );
+	THRDBG( "New master tid is %ld\n", master->tid );
 #else
 	THRDBG( "Skipping set of thread id function\n" );
 #endif
@@ -435,6 +817,9 @@ _papi_hwi_shutdown_thread( ThreadInfo_t * thread, int force_shutdown )
 
                 _papi_hwi_thread_free_eventsets(tid);
 
+		/* Out of the table and shut down as one step, so a delayed */
+		/* component is either in both walks or in neither         */
+		_papi_hwi_lock( CMPINIT_LOCK );
 		remove_thread( thread );
 		THRDBG( "Shutting down thread %ld at %p\n", thread->tid, thread );
 		for( i = 0; i < papi_num_components; i++ ) {
@@ -442,7 +827,14 @@ _papi_hwi_shutdown_thread( ThreadInfo_t * thread, int force_shutdown )
 		   retval = _papi_hwd[i]->shutdown_thread( thread->context[i]);
 		   if ( retval != PAPI_OK ) failure = retval;
 		}
-		free_thread( &thread );
+		_papi_hwi_unlock( CMPINIT_LOCK );
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+		/* Our own last lookup need not keep it */
+		if ( _papi_hwi_my_hazard && _papi_hwi_my_hazard->thread == thread )
+			__atomic_store_n( &_papi_hwi_my_hazard->thread, NULL, __ATOMIC_SEQ_CST );
+#endif
+		/* Lock-free readers may still hold it, so it is only retired */
+		retire_thread( thread );
 		return ( failure );
 	}
 
@@ -457,7 +849,7 @@ int
 _papi_hwi_shutdown_global_threads( void )
 {
         int err,num_threads,i;
-	ThreadInfo_t *tmp,*next;
+	ThreadInfo_t *tmp,**threads;
 	unsigned long our_tid;
 
 	tmp = _papi_hwi_lookup_thread( 0 );
@@ -474,23 +866,24 @@ _papi_hwi_shutdown_global_threads( void )
 
 	   err = _papi_hwi_shutdown_thread( tmp, 1 );
 
-	   /* count threads */
-	   tmp = ( ThreadInfo_t * ) _papi_hwi_thread_head;
-	   num_threads=0;
-	   while(tmp!=NULL) {
-	      num_threads++;
-	      if (tmp->next==_papi_hwi_thread_head) break;
-	      tmp=tmp->next;
-	   }
-
 	   /* Shut down all threads allocated by this thread */
-	   /* Urgh it's a circular list where we removed in the loop  */
-	   /* so the only sane way to do it is get a count in advance */
-	   tmp = ( ThreadInfo_t * ) _papi_hwi_thread_head;
+	   /* Shutting down removes from the table, so work  */
+	   /* from a snapshot taken in advance               */
+	   num_threads = _papi_hwi_thread_table ?
+			( int ) _papi_hwi_thread_table->live : 0;
+	   threads = ( ThreadInfo_t ** ) papi_malloc( sizeof ( ThreadInfo_t * ) *
+						     ( size_t ) ( num_threads + 1 ) );
+	   if ( threads == NULL ) {
+	      err = PAPI_ENOMEM;
+	      num_threads = 0;
+	   }
+	   else {
+	      num_threads = snapshot_threads( threads, num_threads );
+	   }
 
 	   for(i=0;i<num_threads;i++) {
 
-	      next=tmp->next;
+	      tmp=threads[i];
 
 	      THRDBG("looking at #%d %ld our_tid: %ld alloc_tid: %ld\n",
 		     i,tmp->tid,our_tid,tmp->allocator_tid);
@@ -498,16 +891,17 @@ _papi_hwi_shutdown_global_threads( void )
 		 THRDBG("Also removing thread %ld\n",tmp->tid);
 	         err = _papi_hwi_shutdown_thread( tmp, 1 );
 
-	      tmp=next;
-
 	   }
+
+	   if ( threads != NULL )
+	      papi_free( threads );
 	}
 
 
 #ifdef DEBUG
 	if ( ISLEVEL( DEBUG_THREADS ) ) {
-		if ( _papi_hwi_thread_head ) {
-			THRDBG( "Thread head %p still exists!\n", _papi_hwi_thread_head );
+		if ( _papi_hwi_thread_table && _papi_hwi_thread_table->live ) {
+			THRDBG( "%ld threads still exist!\n", _papi_hwi_thread_table->live );
 		}
 	}
 #endif
@@ -515,7 +909,9 @@ _papi_hwi_shutdown_global_threads( void )
 #if defined(HAVE_THREAD_LOCAL_STORAGE)
 	_papi_hwi_my_thread = NULL;
 #endif
-	_papi_hwi_thread_head = NULL;
+	free_thread_tables(  );
+	free_retired_threads(  );
+	_papi_hwi_thread_master = NULL;
 	_papi_hwi_thread_id_fn = NULL;
 #if defined(ANY_THREAD_GETS_SIGNAL)
 	_papi_hwi_thread_kill_fn = NULL;
@@ -535,7 +931,8 @@ _papi_hwi_init_global_threads( void )
 #if defined(HAVE_THREAD_LOCAL_STORAGE)
 	_papi_hwi_my_thread = NULL;
 #endif
-	_papi_hwi_thread_head = NULL;
+	_papi_hwi_thread_table = NULL;
+	_papi_hwi_thread_master = NULL;
 	_papi_hwi_thread_id_fn = NULL;
 #if defined(ANY_THREAD_GETS_SIGNAL)
 	_papi_hwi_thread_kill_fn = NULL;
@@ -543,6 +940,7 @@ _papi_hwi_init_global_threads( void )
 
 	retval = _papi_hwi_initialize_thread( &tmp , 0);
 	if ( retval == PAPI_OK ) {
+	   _papi_hwi_thread_master = tmp;
 	   retval = lookup_and_set_thread_symbols(  );
 	}
 
@@ -555,12 +953,18 @@ int
 _papi_hwi_gather_all_thrspec_data( int tag, PAPI_all_thr_spec_t * where )
 {
 	int didsomething = 0;
+	ThreadTable_t *table;
 	ThreadInfo_t *foo = NULL;
+	unsigned long i;
 
 	_papi_hwi_lock( THREADS_LOCK );
 
-	for ( foo = ( ThreadInfo_t * ) _papi_hwi_thread_head; foo != NULL;
-		  foo = foo->next ) {
+	table = _papi_hwi_thread_table;
+	for ( i = 0; ( table != NULL ) && ( i <= table->mask ); i++ ) {
+		foo = table->slots[i].thread;
+		if ( foo == NULL )
+			continue;
+
 		/* If we want thread ID's */
 		if ( where->id )
 			memcpy( &where->id[didsomething], &foo->tid,
@@ -576,9 +980,6 @@ _papi_hwi_gather_all_thrspec_data( int tag, PAPI_all_thr_spec_t * where )
 			if ( didsomething >= where->num )
 				break;
 		}
-
-		if ( foo->next == _papi_hwi_thread_head )
-			break;
 	}
 
 	where->num = didsomething;
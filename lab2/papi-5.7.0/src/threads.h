@@ -24,18 +24,81 @@ typedef struct _ThreadInfo
 {
 	unsigned long int tid;
 	unsigned long int allocator_tid;
-	struct _ThreadInfo *next;
 	hwd_context_t **context;
 	void *thread_storage[PAPI_MAX_TLS];
 	EventSetInfo_t **running_eventset;
 	EventSetInfo_t *from_esi;          /* ESI used for last update this control state */
 	int wants_signal;
+	struct _ThreadInfo *retired_next;  /* removed, waiting for readers to let go */
 } ThreadInfo_t;
 
-/** The list of threads, gets initialized to master process with TID of getpid() 
+/** One slot of the thread table.  A slot's tid is written once, after
+ *	its thread pointer, and never cleared; removing a thread only NULLs
+ *	the pointer, so a reader that matched the tid can never pick up a
+ *	different thread's descriptor.  0 is a valid tid (the master thread
+ *	under PAPI_thread_init(omp_get_thread_num), or a custom tid), so
+ *	empty slots hold PAPI_THREAD_SLOT_EMPTY instead.
  *	@internal */
 
-extern volatile ThreadInfo_t *_papi_hwi_thread_head;
+#define PAPI_THREAD_SLOT_EMPTY (~0UL)
+
+typedef struct _ThreadSlot
+{
+	volatile unsigned long int tid;	/* PAPI_THREAD_SLOT_EMPTY: empty */
+	ThreadInfo_t *volatile thread;	/* NULL: removed */
+} ThreadSlot_t;
+
+/** Open addressing table of threads keyed by tid.  Readers take no lock;
+ *	writers serialize on THREADS_LOCK and grow the table by publishing a
+ *	new copy.  Replaced tables are kept on the retired list, and still
+ *	see removals, until no lookup is probing them (see ThreadHazard_t)
+ *	or, without TLS, until _papi_hwi_shutdown_global_threads.
+ *	Descriptors are not freed on removal but retired the same way.
+ *	@internal */
+
+typedef struct _ThreadTable
+{
+	unsigned long int mask;		/* number of slots - 1 */
+	unsigned long int used;		/* slots with a tid, live or removed */
+	unsigned long int live;		/* slots with a thread */
+	struct _ThreadTable *retired;
+	ThreadSlot_t slots[];
+} ThreadTable_t;
+
+/** The table of threads, gets initialized to master process with TID of getpid() 
+ *	@internal */
+
+extern ThreadTable_t *volatile _papi_hwi_thread_table;
+
+/** Hazard pointers of a thread that looks threads up in the table.
+ *	thread holds the last descriptor the thread found, which stays
+ *	protected until the same thread looks up another one; table holds
+ *	the table a lookup is probing, for just as long as it probes.
+ *	Retired descriptors and tables are freed once no hazard points at
+ *	them.  Records are never freed, since a reader may be walking the
+ *	list, but go back to the list when their thread exits for the next
+ *	new thread to reuse.  Without TLS retired descriptors and tables
+ *	wait for _papi_hwi_shutdown_global_threads instead.
+ *	@internal */
+
+typedef struct _ThreadHazard
+{
+	ThreadInfo_t *volatile thread;
+	struct _ThreadTable *volatile table;
+	volatile int in_use;
+	struct _ThreadHazard *next;
+} ThreadHazard_t;
+
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+extern THREAD_LOCAL_STORAGE_KEYWORD ThreadHazard_t *_papi_hwi_my_hazard;
+#endif
+
+extern ThreadHazard_t *_papi_hwi_new_thread_hazard( void );
+
+/** The thread created by _papi_hwi_init_global_threads
+ *	@internal */
+
+extern ThreadInfo_t *_papi_hwi_thread_master;
 
 /* If we have TLS, this variable ALWAYS points to our thread descriptor. It's like magic! */
 
@@ -54,6 +117,7 @@ extern unsigned long int ( *_papi_hwi_thread_id_fn ) ( void );
 extern int ( *_papi_hwi_thread_kill_fn ) ( int, int );
 
 extern int _papi_hwi_initialize_thread( ThreadInfo_t ** dest, int tid );
+extern int _papi_hwi_init_thread_component( int cidx );
 extern int _papi_hwi_init_global_threads( void );
 extern int _papi_hwi_shutdown_thread( ThreadInfo_t * thread, int force );
 extern int _papi_hwi_shutdown_global_threads( void );
@@ -88,6 +152,71 @@ _papi_hwi_unlock( int lck )
 	return ( PAPI_OK );
 }
 
+inline_static unsigned long int
+_papi_hwi_hash_tid( unsigned long int tid )
+{
+	/* pthread_self() values are aligned pointers, mix the high bits in */
+	tid ^= tid >> 17;
+	tid *= 0x9E3779B97F4A7C15ULL;
+	return tid ^ ( tid >> 29 );
+}
+
+inline_static ThreadInfo_t *
+_papi_hwi_lookup_in_thread_table( unsigned long int tid )
+{
+	ThreadTable_t *table;
+	ThreadInfo_t *thread;
+	unsigned long int i, slot_tid;
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	ThreadHazard_t *hazard = _papi_hwi_my_hazard;
+
+	if ( hazard == NULL ) {
+		hazard = _papi_hwi_new_thread_hazard(  );
+		if ( hazard == NULL )
+			return ( NULL );
+		_papi_hwi_my_hazard = hazard;
+	}
+#endif
+
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	/* Same dance for the table, which may be retired under us */
+	do {
+		table = __atomic_load_n( &_papi_hwi_thread_table, __ATOMIC_SEQ_CST );
+		__atomic_store_n( &hazard->table, table, __ATOMIC_SEQ_CST );
+	} while ( table != __atomic_load_n( &_papi_hwi_thread_table, __ATOMIC_SEQ_CST ) );
+#else
+	table = __atomic_load_n( &_papi_hwi_thread_table, __ATOMIC_ACQUIRE );
+#endif
+	if ( table == NULL )
+		return ( NULL );
+
+	/* The table is never more than half used, so this terminates */
+	thread = NULL;
+	for ( i = _papi_hwi_hash_tid( tid ) & table->mask;; i = ( i + 1 ) & table->mask ) {
+		slot_tid = __atomic_load_n( &table->slots[i].tid, __ATOMIC_ACQUIRE );
+		if ( slot_tid == PAPI_THREAD_SLOT_EMPTY )
+			break;
+		if ( slot_tid != tid )
+			continue;
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+		/* Publish the hazard, then make sure the thread was not */
+		/* removed before the remover could have seen it         */
+		do {
+			thread = __atomic_load_n( &table->slots[i].thread, __ATOMIC_SEQ_CST );
+			__atomic_store_n( &hazard->thread, thread, __ATOMIC_SEQ_CST );
+		} while ( thread != __atomic_load_n( &table->slots[i].thread, __ATOMIC_SEQ_CST ) );
+#else
+		thread = __atomic_load_n( &table->slots[i].thread, __ATOMIC_ACQUIRE );
+#endif
+		break;
+	}
+
+#if defined(HAVE_THREAD_LOCAL_STORAGE)
+	__atomic_store_n( &hazard->table, NULL, __ATOMIC_RELEASE );
+#endif
+	return ( thread );
+}
+
 inline_static ThreadInfo_t *
 _papi_hwi_lookup_thread( int custom_tid )
 {
@@ -103,8 +232,8 @@ _papi_hwi_lookup_thread( int custom_tid )
 #else
 	   if ( _papi_hwi_thread_id_fn == NULL ) {
 	      THRDBG( "Threads not initialized, returning master thread at %p\n",
-				_papi_hwi_thread_head );
-	      return ( ( ThreadInfo_t * ) _papi_hwi_thread_head );
+				_papi_hwi_thread_master );
+	      return ( _papi_hwi_thread_master );
 	   }
 
 	   tid = ( *_papi_hwi_thread_id_fn ) (  );
@@ -115,28 +244,14 @@ _papi_hwi_lookup_thread( int custom_tid )
 	}
 	THRDBG( "Threads initialized, looking for thread %#lx\n", tid );
 
-	_papi_hwi_lock( THREADS_LOCK );
-
-	tmp = ( ThreadInfo_t * ) _papi_hwi_thread_head;
-	while ( tmp != NULL ) {
-		THRDBG( "Examining thread tid %#lx at %p\n", tmp->tid, tmp );
-		if ( tmp->tid == tid )
-			break;
-		tmp = tmp->next;
-		if ( tmp == _papi_hwi_thread_head ) {
-			tmp = NULL;
-			break;
-		}
-	}
+	tmp = _papi_hwi_lookup_in_thread_table( tid );
 
 	if ( tmp ) {
-		_papi_hwi_thread_head = tmp;
 		THRDBG( "Found thread %ld at %p\n", tid, tmp );
 	} else {
 		THRDBG( "Did not find tid %ld\n", tid );
 	}
 
-	_papi_hwi_unlock( THREADS_LOCK );
 	return ( tmp );
 
 }
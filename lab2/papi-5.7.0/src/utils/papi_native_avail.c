@@ -453,8 +453,8 @@ main( int argc, char **argv )
 		const PAPI_component_info_t *component;
 		component=PAPI_get_component_info(cid);
 
-		/* Skip disabled components */
-		if (component->disabled) continue;
+		/* Skip disabled components; delayed ones start on enumeration */
+		if (component->disabled && component->disabled != PAPI_EDELAY_INIT) continue;
 
 		printf( "===============================================================================\n" );
 		printf( " Native Events in Component: %s\n",component->name);
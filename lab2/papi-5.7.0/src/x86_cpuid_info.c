@@ -1528,3 +1528,18 @@ _x86_detect_hypervisor(char *vendor_name)
   }
   return 0;
 }
+
+/* Returns 1 if the TSC ticks at a constant rate in all P- and C-states */
+/* Returns 0 if it does not, or if the CPU cannot tell us.              */
+int
+_x86_detect_invariant_tsc( void )
+{
+  unsigned int eax, ebx, ecx, edx;
+
+  cpuid2(&eax, &ebx, &ecx, &edx, 0x80000000, 0);
+  if (eax < 0x80000007) return 0;
+
+  /* Advanced power management leaf, edx bit 8 is "invariant TSC" */
+  cpuid2(&eax, &ebx, &ecx, &edx, 0x80000007, 0);
+  return (edx & 0x100) ? 1 : 0;
+}